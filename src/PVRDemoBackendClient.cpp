@@ -0,0 +1,574 @@
+/*
+ *  Copyright (C) 2011-2020 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2011 Pulse-Eight (http://www.pulse-eight.com/)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "PVRDemoBackendClient.h"
+#include "PVRDemoStats.h"
+
+#include <algorithm>
+#include <chrono>
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace ADDON;
+using namespace P8PLATFORM;
+
+namespace
+{
+#ifdef MSG_NOSIGNAL
+const int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+const int SEND_FLAGS = 0;
+#endif
+
+#ifdef PVRDEMO_ENABLE_STATS
+/* an entry point per op, timed from sending its batch to reading its response */
+int OpEntryPoint(uint16_t iOp)
+{
+  static const std::vector<int> entryPoints = [] {
+    static std::string names[PVRDemoBackendProtocol::OP_COUNT];
+    std::vector<int> ids;
+    for (uint16_t i = 0; i < PVRDemoBackendProtocol::OP_COUNT; ++i)
+    {
+      names[i] = std::string("Backend") + PVRDemoBackendProtocol::OpName(i);
+      ids.push_back(PVRDemoStats::Register(names[i].c_str()));
+    }
+    return ids;
+  }();
+  return entryPoints[iOp < PVRDemoBackendProtocol::OP_COUNT ? iOp : 0];
+}
+#endif
+}
+
+/* one socket to the backend, used by one caller at a time */
+class PVRDemoBackendClient::Connection
+{
+public:
+  explicit Connection(int fd) : m_fd(fd) {}
+  ~Connection(void) { close(m_fd); }
+
+  static std::unique_ptr<Connection> Open(const PVRDemoBackendProtocol::Address& address)
+  {
+    int fd = -1;
+    if (address.bUnix)
+    {
+      struct sockaddr_un addr = {};
+      addr.sun_family = AF_UNIX;
+      if (address.strPath.size() >= sizeof(addr.sun_path))
+        return nullptr;
+      strncpy(addr.sun_path, address.strPath.c_str(), sizeof(addr.sun_path) - 1);
+
+      fd = socket(AF_UNIX, SOCK_STREAM, 0);
+      if (fd < 0 || connect(fd, (const struct sockaddr*)&addr, sizeof(addr)) != 0)
+      {
+        PVRDEMO_LOG(LOG_ERROR, "%s - cannot connect to '%s': %s", __FUNCTION__, address.strPath.c_str(), strerror(errno));
+        if (fd >= 0)
+          close(fd);
+        return nullptr;
+      }
+    }
+    else
+    {
+      struct addrinfo hints = {};
+      hints.ai_family = AF_UNSPEC;
+      hints.ai_socktype = SOCK_STREAM;
+      struct addrinfo* pResult = NULL;
+      const std::string strPort = std::to_string(address.iPort);
+      if (getaddrinfo(address.strHost.c_str(), strPort.c_str(), &hints, &pResult) != 0)
+      {
+        PVRDEMO_LOG(LOG_ERROR, "%s - cannot resolve '%s'", __FUNCTION__, address.strHost.c_str());
+        return nullptr;
+      }
+
+      for (struct addrinfo* pAddr = pResult; pAddr && fd < 0; pAddr = pAddr->ai_next)
+      {
+        fd = socket(pAddr->ai_family, pAddr->ai_socktype, pAddr->ai_protocol);
+        if (fd >= 0 && connect(fd, pAddr->ai_addr, pAddr->ai_addrlen) != 0)
+        {
+          close(fd);
+          fd = -1;
+        }
+      }
+      freeaddrinfo(pResult);
+      if (fd < 0)
+      {
+        PVRDEMO_LOG(LOG_ERROR, "%s - cannot connect to %s:%d", __FUNCTION__, address.strHost.c_str(), address.iPort);
+        return nullptr;
+      }
+
+      /* a batch goes out in one write, there is nothing to coalesce */
+      int iNoDelay = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &iNoDelay, sizeof(iNoDelay));
+    }
+
+    struct timeval timeout;
+    timeout.tv_sec = TIMEOUT_MS / 1000;
+    timeout.tv_usec = (TIMEOUT_MS % 1000) * 1000;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+#ifdef SO_NOSIGPIPE
+    int iNoSigPipe = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &iNoSigPipe, sizeof(iNoSigPipe));
+#endif
+
+    return std::unique_ptr<Connection>(new Connection(fd));
+  }
+
+  bool Send(const uint8_t* pData, size_t iSize)
+  {
+    while (iSize > 0)
+    {
+      const ssize_t iSent = send(m_fd, pData, iSize, SEND_FLAGS);
+      if (iSent < 0 && errno == EINTR)
+        continue;
+      if (iSent <= 0)
+        return false;
+      pData += iSent;
+      iSize -= (size_t)iSent;
+    }
+    return true;
+  }
+
+  bool Receive(uint8_t* pData, size_t iSize)
+  {
+    while (iSize > 0)
+    {
+      const ssize_t iRead = recv(m_fd, pData, iSize, 0);
+      if (iRead < 0 && errno == EINTR)
+        continue;
+      if (iRead <= 0)
+        return false;
+      pData += iRead;
+      iSize -= (size_t)iRead;
+    }
+    return true;
+  }
+
+private:
+  const int m_fd;
+};
+
+const int PVRDemoBackendClient::TIMEOUT_MS;
+
+PVRDemoBackendClient::PVRDemoBackendClient(const std::string& strAddress, int iConnections) :
+  m_strAddress(strAddress),
+  m_bValidAddress(PVRDemoBackendProtocol::ParseAddress(strAddress, m_address)),
+  m_iNextRequestId(1),
+  m_bConnected(false),
+  m_iOpen(0),
+  m_iMaxConnections(std::max(1, iConnections)),
+  m_bGreeted(false)
+{
+  if (!m_bValidAddress)
+    PVRDEMO_LOG(LOG_ERROR, "%s - invalid backend address '%s'", __FUNCTION__, strAddress.c_str());
+}
+
+PVRDemoBackendClient::~PVRDemoBackendClient(void)
+{
+}
+
+std::unique_ptr<PVRDemoBackendClient::Connection> PVRDemoBackendClient::Acquire(void)
+{
+  if (!m_bValidAddress)
+    return nullptr;
+
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(TIMEOUT_MS);
+  CLockObject lock(m_mutex);
+  for (;;)
+  {
+    if (!m_idle.empty())
+    {
+      std::unique_ptr<Connection> connection = std::move(m_idle.back());
+      m_idle.pop_back();
+      return connection;
+    }
+
+    if (m_iOpen < m_iMaxConnections)
+    {
+      ++m_iOpen;
+      lock.Unlock();
+      std::unique_ptr<Connection> connection = Connection::Open(m_address);
+      lock.Lock();
+      if (!connection)
+      {
+        --m_iOpen;
+        m_released.Signal();
+      }
+      return connection;
+    }
+
+    /* every connection is in use, wait for one to come back */
+    const int64_t iLeftMs = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+    if (iLeftMs <= 0)
+    {
+      PVRDEMO_LOG(LOG_ERROR, "%s - all %d backend connections stayed busy", __FUNCTION__, m_iMaxConnections);
+      return nullptr;
+    }
+    lock.Unlock();
+    m_released.Wait((uint32_t)iLeftMs);
+    lock.Lock();
+  }
+}
+
+void PVRDemoBackendClient::Release(std::unique_ptr<Connection> connection)
+{
+  {
+    CLockObject lock(m_mutex);
+    /* a pool that shrank closes the connections it has too many of */
+    if (connection && m_iOpen <= m_iMaxConnections)
+      m_idle.push_back(std::move(connection));
+    else
+      --m_iOpen;
+  }
+  m_released.Signal();
+}
+
+void PVRDemoBackendClient::SetMaxConnections(int iConnections)
+{
+  std::vector<std::unique_ptr<Connection>> surplus;
+  {
+    CLockObject lock(m_mutex);
+    m_iMaxConnections = std::max(1, iConnections);
+    while (m_iOpen > m_iMaxConnections && !m_idle.empty())
+    {
+      surplus.push_back(std::move(m_idle.back()));
+      m_idle.pop_back();
+      --m_iOpen;
+    }
+  }
+  /* callers waiting for a connection may open one now */
+  m_released.Signal();
+  PVRDEMO_LOG(LOG_DEBUG, "%s - %d connections to '%s', closed %zu", __FUNCTION__, iConnections, m_strAddress.c_str(), surplus.size());
+}
+
+void PVRDemoBackendClient::CloseIdle(void)
+{
+  std::vector<std::unique_ptr<Connection>> idle;
+  {
+    CLockObject lock(m_mutex);
+    idle.swap(m_idle);
+    m_iOpen -= (int)idle.size();
+  }
+  m_released.Signal();
+}
+
+bool PVRDemoBackendClient::Connect(void)
+{
+  {
+    CLockObject lock(m_mutex);
+    if (m_bGreeted)
+      return true;
+  }
+
+  PVRDemoBackendMessage hello;
+  hello.PutU32(PVRDemoBackendProtocol::VERSION);
+  Response response;
+  if (!Call(PVRDemoBackendProtocol::OP_HELLO, hello, response))
+    return false;
+
+  uint32_t iVersion = 0;
+  std::string strName;
+  std::string strVersion;
+  response.payload.GetU32(iVersion);
+  response.payload.GetString(strName);
+  response.payload.GetString(strVersion);
+  if (response.iStatus != PVRDemoBackendProtocol::STATUS_OK || response.payload.Failed() ||
+      iVersion != PVRDemoBackendProtocol::VERSION)
+  {
+    PVRDEMO_LOG(LOG_ERROR, "%s - '%s' does not speak protocol version %u", __FUNCTION__, m_strAddress.c_str(),
+                PVRDemoBackendProtocol::VERSION);
+    return false;
+  }
+
+  PVRDEMO_LOG(LOG_INFO, "%s - connected to %s %s at '%s'", __FUNCTION__, strName.c_str(), strVersion.c_str(), m_strAddress.c_str());
+  CLockObject lock(m_mutex);
+  m_strBackendName = strName;
+  m_strBackendVersion = strVersion;
+  m_bGreeted = true;
+  return true;
+}
+
+bool PVRDemoBackendClient::Call(const std::vector<Request>& requests, std::vector<Response>& responses)
+{
+#ifdef PVRDEMO_ENABLE_STATS
+  static const int iRoundTrip = PVRDemoStats::Register("BackendRoundTrip");
+  PVRDemoStatsScope statsScope(iRoundTrip);
+#endif
+  responses.clear();
+  if (requests.empty())
+    return true;
+
+  std::unique_ptr<Connection> connection = Acquire();
+  if (!connection)
+  {
+    m_bConnected = false;
+    return false;
+  }
+
+  /* the whole batch in one buffer and one write */
+  const uint32_t iFirstId = m_iNextRequestId.fetch_add((uint32_t)requests.size());
+  std::vector<uint8_t> buffer;
+  size_t iSize = 0;
+  for (const auto& request : requests)
+    iSize += PVRDemoBackendProtocol::HEADER_SIZE + request.payload.Data().size();
+  buffer.reserve(iSize);
+  for (size_t i = 0; i < requests.size(); ++i)
+  {
+    const std::vector<uint8_t>& payload = requests[i].payload.Data();
+    PVRDemoBackendProtocol::Header header = { (uint32_t)payload.size(), iFirstId + (uint32_t)i, requests[i].iOp,
+                                              PVRDemoBackendProtocol::STATUS_OK };
+    uint8_t headerData[PVRDemoBackendProtocol::HEADER_SIZE];
+    PVRDemoBackendProtocol::PutHeader(header, headerData);
+    buffer.insert(buffer.end(), headerData, headerData + sizeof(headerData));
+    buffer.insert(buffer.end(), payload.begin(), payload.end());
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+#ifdef PVRDEMO_ENABLE_STATS
+  const uint64_t iSentTicks = PVRDemoStats::Now();
+#endif
+  bool bOk = connection->Send(buffer.data(), buffer.size());
+
+  size_t iReceived = 0;
+  responses.resize(requests.size());
+  for (size_t i = 0; bOk && i < requests.size(); ++i)
+  {
+    uint8_t headerData[PVRDemoBackendProtocol::HEADER_SIZE];
+    PVRDemoBackendProtocol::Header header;
+    bOk = connection->Receive(headerData, sizeof(headerData));
+    if (!bOk)
+      break;
+
+    PVRDemoBackendProtocol::GetHeader(headerData, header);
+    if (header.iRequestId != iFirstId + (uint32_t)i || header.iOp != requests[i].iOp ||
+        header.iLength > PVRDemoBackendProtocol::MAX_PAYLOAD)
+    {
+      PVRDEMO_LOG(LOG_ERROR, "%s - unexpected response %u to %s request %u", __FUNCTION__, header.iRequestId,
+                  PVRDemoBackendProtocol::OpName(requests[i].iOp), iFirstId + (uint32_t)i);
+      bOk = false;
+      break;
+    }
+
+    std::vector<uint8_t>& payload = responses[i].payload.Data();
+    payload.resize(header.iLength);
+    bOk = header.iLength == 0 || connection->Receive(payload.data(), payload.size());
+    responses[i].iStatus = header.iStatus;
+    iReceived += sizeof(headerData) + header.iLength;
+
+#ifdef PVRDEMO_ENABLE_STATS
+    const int iEntryPoint = OpEntryPoint(header.iOp);
+    const int iPrevious = PVRDemoStats::Enter(iEntryPoint);
+    PVRDemoStats::Count(PVRDEMO_COUNTER_BYTES, header.iLength);
+    PVRDemoStats::Leave(iEntryPoint, iPrevious, iSentTicks);
+#endif
+  }
+
+  /* a connection that failed halfway may still have responses on the way, it is not reused */
+  if (!bOk)
+  {
+    PVRDEMO_LOG(LOG_ERROR, "%s - connection to '%s' failed: %s", __FUNCTION__, m_strAddress.c_str(), strerror(errno));
+    connection.reset();
+    responses.clear();
+  }
+  Release(std::move(connection));
+  m_bConnected = bOk;
+  if (!bOk)
+    return false;
+
+  PVRDEMO_STATS_COUNT(PVRDEMO_COUNTER_BYTES, iReceived);
+  const double fMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  PVRDEMO_LOG(LOG_DEBUG, "%s - %zu requests, %zu bytes out, %zu bytes in, %.2f ms, %.1f MB/s", __FUNCTION__,
+              requests.size(), buffer.size(), iReceived, fMs, fMs > 0 ? (double)iReceived / fMs / 1000.0 : 0.0);
+  return true;
+}
+
+bool PVRDemoBackendClient::Call(uint16_t iOp, const PVRDemoBackendMessage& payload, Response& response)
+{
+  std::vector<Request> requests(1);
+  requests[0].iOp = iOp;
+  requests[0].payload = payload;
+  std::vector<Response> responses;
+  if (!Call(requests, responses))
+    return false;
+  response = std::move(responses[0]);
+  return true;
+}
+
+std::string PVRDemoBackendClient::BackendName(void) const
+{
+  CLockObject lock(m_mutex);
+  return m_strBackendName;
+}
+
+std::string PVRDemoBackendClient::BackendVersion(void) const
+{
+  CLockObject lock(m_mutex);
+  return m_strBackendVersion;
+}
+
+std::atomic<int> PVRDemoBackendGuide::s_iBatchChannels(DEFAULT_BACKEND_EPG_CHANNELS);
+std::atomic<int> PVRDemoBackendGuide::s_iPipelinedBatches(DEFAULT_BACKEND_EPG_DEPTH);
+
+PVRDemoBackendGuide::PVRDemoBackendGuide(std::shared_ptr<PVRDemoBackendClient> client, std::vector<int> channelUids) :
+  m_client(std::move(client)),
+  m_channelUids(std::move(channelUids))
+{
+}
+
+bool PVRDemoBackendGuide::Covers(int iChannelUid) const
+{
+  return std::find(m_channelUids.begin(), m_channelUids.end(), iChannelUid) != m_channelUids.end();
+}
+
+std::shared_ptr<const PVRDemoEpgShard> PVRDemoBackendGuide::Find(int iChannelUid, time_t iStart, time_t iEnd) const
+{
+  for (const auto& window : m_windows)
+  {
+    if (window->iStart <= iStart && window->iEnd >= iEnd && window->guide.find(iChannelUid) != window->guide.end())
+      return window;
+  }
+  return nullptr;
+}
+
+void PVRDemoBackendGuide::Fetch(int iChannelUid, time_t iStart, time_t iEnd, PVRDemoEpgShardList& shards)
+{
+  shards.clear();
+
+  std::vector<int> batch;
+  {
+    CLockObject lock(m_mutex);
+    std::shared_ptr<const PVRDemoEpgShard> window = Find(iChannelUid, iStart, iEnd);
+    if (window)
+    {
+      PVRDEMO_STATS_COUNT(PVRDEMO_COUNTER_CACHE_HITS, 1);
+      shards.push_back(std::move(window));
+      return;
+    }
+
+    /* the channel and those after it that are not cached for this window either */
+    auto it = std::find(m_channelUids.begin(), m_channelUids.end(), iChannelUid);
+    batch.push_back(iChannelUid);
+    const size_t iMaxBatch = (size_t)s_iBatchChannels.load(std::memory_order_relaxed) * s_iPipelinedBatches.load(std::memory_order_relaxed);
+    for (++it; it != m_channelUids.end() && batch.size() < iMaxBatch; ++it)
+    {
+      if (!Find(*it, iStart, iEnd))
+        batch.push_back(*it);
+    }
+  }
+
+  /* fetched without the lock; a window fetched twice meanwhile is harmless */
+  PVRDEMO_STATS_COUNT(PVRDEMO_COUNTER_CACHE_MISSES, 1);
+  std::shared_ptr<const PVRDemoEpgShard> window = FetchBatch(batch, iStart, iEnd);
+  if (!window)
+    return;
+
+  CLockObject lock(m_mutex);
+  /* windows a request falls outside of are from an earlier import */
+  m_windows.erase(std::remove_if(m_windows.begin(), m_windows.end(),
+                                 [iStart, iEnd](const std::shared_ptr<const PVRDemoEpgShard>& cached) {
+                                   return cached->iStart > iStart || cached->iEnd < iEnd;
+                                 }),
+                  m_windows.end());
+  m_windows.push_back(window);
+  shards.push_back(std::move(window));
+}
+
+std::shared_ptr<const PVRDemoEpgShard> PVRDemoBackendGuide::FetchBatch(const std::vector<int>& channelUids, time_t iStart, time_t iEnd) const
+{
+  PVRDEMO_STATS_SCOPE();
+  const size_t iBatchChannels = (size_t)s_iBatchChannels.load(std::memory_order_relaxed);
+  std::vector<PVRDemoBackendClient::Request> requests;
+  for (size_t iFirst = 0; iFirst < channelUids.size(); iFirst += iBatchChannels)
+  {
+    const size_t iLast = std::min(channelUids.size(), iFirst + iBatchChannels);
+    PVRDemoBackendClient::Request request;
+    request.iOp = PVRDemoBackendProtocol::OP_EPG;
+    request.payload.PutI64((int64_t)iStart);
+    request.payload.PutI64((int64_t)iEnd);
+    request.payload.PutU32((uint32_t)(iLast - iFirst));
+    for (size_t i = iFirst; i < iLast; ++i)
+      request.payload.PutI32(channelUids[i]);
+    requests.push_back(std::move(request));
+  }
+
+  std::vector<PVRDemoBackendClient::Response> responses;
+  if (!m_client->Call(requests, responses))
+    return nullptr;
+
+  /* windows come and go with Kodi's imports, so their plots never go to a file of their own */
+  std::shared_ptr<PVRDemoTextStore> texts = PVRDemoTextStore::Create(
+    (PVRDemoTextStore::Mode)std::min(g_iColdText, (int)PVRDemoTextStore::MODE_MEMORY), g_strUserPath);
+  std::shared_ptr<PVRDemoEpgShard> window = std::make_shared<PVRDemoEpgShard>();
+  window->iStart = iStart;
+  window->iEnd = iEnd;
+
+  size_t iEntries = 0;
+  for (auto& response : responses)
+  {
+    PVRDemoBackendMessage& payload = response.payload;
+    uint32_t iChannels = 0;
+    if (response.iStatus != PVRDemoBackendProtocol::STATUS_OK || !payload.GetU32(iChannels))
+    {
+      PVRDEMO_LOG(LOG_ERROR, "%s - the backend refused an EPG request", __FUNCTION__);
+      return nullptr;
+    }
+
+    for (uint32_t iChannel = 0; iChannel < iChannels; ++iChannel)
+    {
+      int iChannelUid = 0;
+      uint32_t iTags = 0;
+      payload.GetI32(iChannelUid);
+      payload.GetU32(iTags);
+
+      /* a channel without programmes in the window is cached as well */
+      std::vector<PVRDemoEpgEntry>& entries = window->guide[iChannelUid];
+      for (uint32_t iTag = 0; iTag < iTags && !payload.Failed(); ++iTag)
+      {
+        PVRDemoEpgEntry entry;
+        entry.iChannelId = iChannelUid;
+        if (PVRDemoBackendProtocol::GetEpgEntry(payload, *texts, entry))
+          entries.push_back(std::move(entry));
+      }
+      iEntries += entries.size();
+    }
+
+    if (payload.Failed())
+    {
+      PVRDEMO_LOG(LOG_ERROR, "%s - malformed EPG response", __FUNCTION__);
+      return nullptr;
+    }
+  }
+  texts->Seal();
+
+  PVRDEMO_LOG(LOG_DEBUG, "%s - fetched %zu entries of %zu channels in %zu requests", __FUNCTION__, iEntries,
+              channelUids.size(), requests.size());
+  return window;
+}
+
+size_t PVRDemoBackendGuide::CachedWindows(void) const
+{
+  CLockObject lock(m_mutex);
+  return m_windows.size();
+}
+
+void PVRDemoBackendGuide::Drop(void)
+{
+  CLockObject lock(m_mutex);
+  m_windows.clear();
+}
+
+void PVRDemoBackendGuide::SetPrefetch(int iBatchChannels, int iPipelinedBatches)
+{
+  s_iBatchChannels.store(std::max(1, iBatchChannels), std::memory_order_relaxed);
+  s_iPipelinedBatches.store(std::max(1, iPipelinedBatches), std::memory_order_relaxed);
+}
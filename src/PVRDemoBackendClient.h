@@ -0,0 +1,146 @@
+/*
+ *  Copyright (C) 2011-2020 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2011 Pulse-Eight (http://www.pulse-eight.com/)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include "p8-platform/threads/mutex.h"
+#include "PVRDemoBackendProtocol.h"
+#include "PVRDemoData.h"
+
+/*!
+ * The add-on's side of pvrdemo-backend. Connections are pooled and opened
+ * as callers need them, up to a fixed number; a connection that fails is
+ * closed and the next caller opens a fresh one.
+ *
+ * Call() writes a whole batch of requests to one connection before reading
+ * any response, so a batch costs one round trip however many requests it
+ * holds. Callers on other threads use other connections meanwhile.
+ */
+class PVRDemoBackendClient
+{
+public:
+  static const int TIMEOUT_MS = 10000;
+
+  struct Request
+  {
+    uint16_t              iOp;
+    PVRDemoBackendMessage payload;
+  };
+
+  struct Response
+  {
+    uint16_t              iStatus;
+    PVRDemoBackendMessage payload;
+  };
+
+  PVRDemoBackendClient(const std::string& strAddress, int iConnections);
+  ~PVRDemoBackendClient(void);
+
+  /* whether this client talks to the backend the settings ask for */
+  bool Matches(const std::string& strAddress) const { return strAddress == m_strAddress; }
+
+  /*!
+   * Let the pool grow to iConnections, or shrink to it: idle connections
+   * beyond it are closed now, busy ones as their calls return.
+   */
+  void SetMaxConnections(int iConnections);
+
+  /* greet the backend unless that was done already; false if it cannot be reached */
+  bool Connect(void);
+
+  /*!
+   * Send requests back to back on one pooled connection, then read their
+   * responses into responses, in the same order. False if the backend
+   * could not be reached or the connection failed on the way; requests
+   * the backend refused come back with a status other than STATUS_OK.
+   */
+  bool Call(const std::vector<Request>& requests, std::vector<Response>& responses);
+
+  /* a single request and its response */
+  bool Call(uint16_t iOp, const PVRDemoBackendMessage& payload, Response& response);
+
+  const std::string& Address(void) const { return m_strAddress; }
+  std::string Hostname(void) const { return m_address.bUnix ? "" : m_address.strHost; }
+  std::string BackendName(void) const;
+  std::string BackendVersion(void) const;
+
+  /* whether the last call reached the backend */
+  bool IsConnected(void) const { return m_bConnected; }
+
+  /* close the connections no call is using, as they would not survive a standby anyway */
+  void CloseIdle(void);
+
+private:
+  class Connection;
+
+  std::unique_ptr<Connection> Acquire(void);
+  void Release(std::unique_ptr<Connection> connection);
+
+  const std::string                        m_strAddress;
+  PVRDemoBackendProtocol::Address          m_address;
+  bool                                     m_bValidAddress;
+  std::atomic<uint32_t>                    m_iNextRequestId;
+  std::atomic<bool>                        m_bConnected;
+
+  mutable P8PLATFORM::CMutex               m_mutex;        // guards everything below
+  P8PLATFORM::CEvent                       m_released;     // a connection went back to the pool
+  std::vector<std::unique_ptr<Connection>> m_idle;
+  int                                      m_iOpen;        // idle and in use
+  int                                      m_iMaxConnections;
+  bool                                     m_bGreeted;
+  std::string                              m_strBackendName;
+  std::string                              m_strBackendVersion;
+};
+
+/*!
+ * The guide of a backend. Kodi asks for one channel's guide after the
+ * other during an EPG import, so a channel that is not cached is fetched
+ * together with the ones that follow it: a batch of channels to an EPG
+ * request and a number of requests to a round trip, see SetPrefetch().
+ *
+ * Fetched windows are kept until a request falls outside them, so what
+ * stays cached follows the window Kodi asks for. Like the data set it
+ * belongs to, the guide is never refreshed; a reload brings a new one.
+ */
+class PVRDemoBackendGuide
+{
+public:
+  PVRDemoBackendGuide(std::shared_ptr<PVRDemoBackendClient> client, std::vector<int> channelUids);
+
+  bool Covers(int iChannelUid) const;
+
+  /*!
+   * The window of the guide that holds the channel between iStart and
+   * iEnd, fetched unless it is cached. Empty if the backend failed.
+   */
+  void Fetch(int iChannelUid, time_t iStart, time_t iEnd, PVRDemoEpgShardList& shards);
+
+  size_t CachedWindows(void) const;
+
+  /* forget every fetched window */
+  void Drop(void);
+
+  /* channels to an EPG request and requests to a round trip, for the next fetch of every guide */
+  static void SetPrefetch(int iBatchChannels, int iPipelinedBatches);
+
+private:
+  std::shared_ptr<const PVRDemoEpgShard> Find(int iChannelUid, time_t iStart, time_t iEnd) const;
+  std::shared_ptr<const PVRDemoEpgShard> FetchBatch(const std::vector<int>& channelUids, time_t iStart, time_t iEnd) const;
+
+  static std::atomic<int>                             s_iBatchChannels;
+  static std::atomic<int>                             s_iPipelinedBatches;
+
+  const std::shared_ptr<PVRDemoBackendClient>         m_client;
+  const std::vector<int>                              m_channelUids;  // in the backend's order
+  mutable P8PLATFORM::CMutex                          m_mutex;        // guards m_windows
+  std::vector<std::shared_ptr<const PVRDemoEpgShard>> m_windows;      // each a batch of channels
+};
@@ -0,0 +1,360 @@
+/*
+ *  Copyright (C) 2011-2020 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2011 Pulse-Eight (http://www.pulse-eight.com/)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "PVRDemoBackendProtocol.h"
+#include "PVRDemoData.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+void PVRDemoBackendMessage::PutU32(uint32_t iValue)
+{
+  const uint8_t bytes[4] = { (uint8_t)iValue, (uint8_t)(iValue >> 8), (uint8_t)(iValue >> 16), (uint8_t)(iValue >> 24) };
+  m_data.insert(m_data.end(), bytes, bytes + 4);
+}
+
+void PVRDemoBackendMessage::PutI64(int64_t iValue)
+{
+  PutU32((uint32_t)(uint64_t)iValue);
+  PutU32((uint32_t)((uint64_t)iValue >> 32));
+}
+
+void PVRDemoBackendMessage::PutString(const char* strValue)
+{
+  const size_t iLength = strValue ? strlen(strValue) : 0;
+  PutU32((uint32_t)iLength);
+  m_data.insert(m_data.end(), (const uint8_t*)strValue, (const uint8_t*)strValue + iLength);
+}
+
+void PVRDemoBackendMessage::SetU32(size_t iOffset, uint32_t iValue)
+{
+  m_data[iOffset]     = (uint8_t)iValue;
+  m_data[iOffset + 1] = (uint8_t)(iValue >> 8);
+  m_data[iOffset + 2] = (uint8_t)(iValue >> 16);
+  m_data[iOffset + 3] = (uint8_t)(iValue >> 24);
+}
+
+bool PVRDemoBackendMessage::Take(size_t iSize, const uint8_t*& pData)
+{
+  if (m_bFailed || m_data.size() - m_iRead < iSize)
+  {
+    m_bFailed = true;
+    return false;
+  }
+  pData = m_data.data() + m_iRead;
+  m_iRead += iSize;
+  return true;
+}
+
+bool PVRDemoBackendMessage::GetU8(uint8_t& iValue)
+{
+  const uint8_t* pData;
+  if (!Take(1, pData))
+    return false;
+  iValue = pData[0];
+  return true;
+}
+
+bool PVRDemoBackendMessage::GetU32(uint32_t& iValue)
+{
+  const uint8_t* pData;
+  if (!Take(4, pData))
+    return false;
+  iValue = (uint32_t)pData[0] | ((uint32_t)pData[1] << 8) | ((uint32_t)pData[2] << 16) | ((uint32_t)pData[3] << 24);
+  return true;
+}
+
+bool PVRDemoBackendMessage::GetI32(int& iValue)
+{
+  uint32_t iRaw;
+  if (!GetU32(iRaw))
+    return false;
+  iValue = (int)(int32_t)iRaw;
+  return true;
+}
+
+bool PVRDemoBackendMessage::GetI64(int64_t& iValue)
+{
+  uint32_t iLow, iHigh;
+  if (!GetU32(iLow) || !GetU32(iHigh))
+    return false;
+  iValue = (int64_t)(((uint64_t)iHigh << 32) | iLow);
+  return true;
+}
+
+bool PVRDemoBackendMessage::GetTime(time_t& iValue)
+{
+  int64_t iRaw;
+  if (!GetI64(iRaw))
+    return false;
+  iValue = (time_t)iRaw;
+  return true;
+}
+
+bool PVRDemoBackendMessage::GetString(std::string& strValue)
+{
+  uint32_t iLength;
+  const uint8_t* pData;
+  if (!GetU32(iLength) || !Take(iLength, pData))
+    return false;
+  strValue.assign((const char*)pData, iLength);
+  return true;
+}
+
+void PVRDemoBackendProtocol::PutHeader(const Header& header, uint8_t* pData)
+{
+  const uint32_t words[2] = { header.iLength, header.iRequestId };
+  for (int i = 0; i < 2; ++i)
+  {
+    for (int iByte = 0; iByte < 4; ++iByte)
+      pData[i * 4 + iByte] = (uint8_t)(words[i] >> (8 * iByte));
+  }
+  pData[8]  = (uint8_t)header.iOp;
+  pData[9]  = (uint8_t)(header.iOp >> 8);
+  pData[10] = (uint8_t)header.iStatus;
+  pData[11] = (uint8_t)(header.iStatus >> 8);
+}
+
+void PVRDemoBackendProtocol::GetHeader(const uint8_t* pData, Header& header)
+{
+  header.iLength    = (uint32_t)pData[0] | ((uint32_t)pData[1] << 8) | ((uint32_t)pData[2] << 16) | ((uint32_t)pData[3] << 24);
+  header.iRequestId = (uint32_t)pData[4] | ((uint32_t)pData[5] << 8) | ((uint32_t)pData[6] << 16) | ((uint32_t)pData[7] << 24);
+  header.iOp        = (uint16_t)(pData[8] | (pData[9] << 8));
+  header.iStatus    = (uint16_t)(pData[10] | (pData[11] << 8));
+}
+
+const char* PVRDemoBackendProtocol::OpName(uint16_t iOp)
+{
+  static const char* const names[OP_COUNT] =
+  {
+    "Unknown", "Hello", "Channels", "Groups", "Recordings", "Timers", "Epg",
+    "DeleteRecording", "UndeleteRecording", "DeleteTrash"
+  };
+  return iOp < OP_COUNT ? names[iOp] : names[0];
+}
+
+bool PVRDemoBackendProtocol::ParseAddress(const std::string& strAddress, Address& address)
+{
+  address = Address();
+  if (strAddress.compare(0, 5, "unix:") == 0 || (!strAddress.empty() && strAddress[0] == '/'))
+  {
+    address.bUnix = true;
+    address.strPath = strAddress[0] == '/' ? strAddress : strAddress.substr(5);
+    return !address.strPath.empty();
+  }
+
+  /* [::1]:port for IPv6, host:port or a bare host otherwise */
+  std::string strPort;
+  if (!strAddress.empty() && strAddress[0] == '[')
+  {
+    const size_t iClose = strAddress.find(']');
+    if (iClose == std::string::npos)
+      return false;
+    address.strHost = strAddress.substr(1, iClose - 1);
+    if (iClose + 1 < strAddress.size())
+    {
+      if (strAddress[iClose + 1] != ':')
+        return false;
+      strPort = strAddress.substr(iClose + 2);
+    }
+  }
+  else
+  {
+    const size_t iColon = strAddress.rfind(':');
+    address.strHost = strAddress.substr(0, iColon);
+    if (iColon != std::string::npos)
+      strPort = strAddress.substr(iColon + 1);
+  }
+
+  if (!strPort.empty())
+  {
+    char* pEnd;
+    const long iPort = strtol(strPort.c_str(), &pEnd, 10);
+    if (*pEnd != '\0' || iPort < 1 || iPort > 65535)
+      return false;
+    address.iPort = (int)iPort;
+  }
+  return !address.strHost.empty();
+}
+
+/*
+ * Records. Fields are written in the order they are read below; a change
+ * to either side is a new VERSION.
+ */
+
+void PVRDemoBackendProtocol::PutChannel(PVRDemoBackendMessage& message, const PVR_CHANNEL& channel, const std::string& strStreamURL)
+{
+  message.PutI32((int32_t)channel.iUniqueId);
+  message.PutU8(channel.bIsRadio ? 1 : 0);
+  message.PutI32((int32_t)channel.iChannelNumber);
+  message.PutI32((int32_t)channel.iSubChannelNumber);
+  message.PutI32((int32_t)channel.iEncryptionSystem);
+  message.PutString(channel.strChannelName);
+  message.PutString(channel.strIconPath);
+  message.PutString(strStreamURL);
+}
+
+bool PVRDemoBackendProtocol::GetChannel(PVRDemoBackendMessage& message, PVRDemoChannel& channel)
+{
+  uint8_t bRadio = 0;
+  message.GetI32(channel.iUniqueId);
+  message.GetU8(bRadio);
+  message.GetI32(channel.iChannelNumber);
+  message.GetI32(channel.iSubChannelNumber);
+  message.GetI32(channel.iEncryptionSystem);
+  message.GetString(channel.strChannelName);
+  message.GetString(channel.strIconPath);
+  message.GetString(channel.strStreamURL);
+  channel.bRadio = bRadio != 0;
+  channel.epg.clear();
+  return !message.Failed();
+}
+
+void PVRDemoBackendProtocol::PutGroup(PVRDemoBackendMessage& message, const PVR_CHANNEL_GROUP& group, const std::vector<int>& memberUids)
+{
+  message.PutString(group.strGroupName);
+  message.PutU8(group.bIsRadio ? 1 : 0);
+  message.PutI32((int32_t)group.iPosition);
+  message.PutU32((uint32_t)memberUids.size());
+  for (int iUid : memberUids)
+    message.PutI32(iUid);
+}
+
+bool PVRDemoBackendProtocol::GetGroup(PVRDemoBackendMessage& message, PVRDemoChannelGroup& group, std::vector<int>& memberUids)
+{
+  uint8_t bRadio = 0;
+  uint32_t iMembers = 0;
+  message.GetString(group.strGroupName);
+  message.GetU8(bRadio);
+  message.GetI32(group.iPosition);
+  message.GetU32(iMembers);
+  group.bRadio = bRadio != 0;
+
+  memberUids.clear();
+  for (uint32_t i = 0; i < iMembers && !message.Failed(); ++i)
+  {
+    int iUid = 0;
+    message.GetI32(iUid);
+    memberUids.push_back(iUid);
+  }
+  return !message.Failed();
+}
+
+void PVRDemoBackendProtocol::PutRecording(PVRDemoBackendMessage& message, const PVR_RECORDING& recording, const std::string& strStreamURL)
+{
+  message.PutString(recording.strRecordingId);
+  message.PutU8(recording.channelType == PVR_RECORDING_CHANNEL_TYPE_RADIO ? 1 : 0);
+  message.PutI64((int64_t)recording.recordingTime);
+  message.PutI32((int32_t)recording.iDuration);
+  message.PutI32((int32_t)recording.iGenreType);
+  message.PutI32((int32_t)recording.iGenreSubType);
+  message.PutI32((int32_t)recording.iSeriesNumber);
+  message.PutI32((int32_t)recording.iEpisodeNumber);
+  message.PutString(recording.strTitle);
+  message.PutString(recording.strEpisodeName);
+  message.PutString(recording.strChannelName);
+  message.PutString(recording.strDirectory);
+  message.PutString(recording.strPlotOutline);
+  message.PutString(recording.strPlot);
+  message.PutString(strStreamURL);
+}
+
+bool PVRDemoBackendProtocol::GetRecording(PVRDemoBackendMessage& message, PVRDemoTextStore& texts, PVRDemoRecording& recording)
+{
+  uint8_t bRadio = 0;
+  std::string strPlotOutline;
+  std::string strPlot;
+  message.GetString(recording.strRecordingId);
+  message.GetU8(bRadio);
+  message.GetTime(recording.recordingTime);
+  message.GetI32(recording.iDuration);
+  message.GetI32(recording.iGenreType);
+  message.GetI32(recording.iGenreSubType);
+  message.GetI32(recording.iSeriesNumber);
+  message.GetI32(recording.iEpisodeNumber);
+  message.GetString(recording.strTitle);
+  message.GetString(recording.strEpisodeName);
+  message.GetString(recording.strChannelName);
+  message.GetString(recording.strDirectory);
+  message.GetString(strPlotOutline);
+  message.GetString(strPlot);
+  message.GetString(recording.strStreamURL);
+  if (message.Failed())
+    return false;
+
+  recording.bRadio         = bRadio != 0;
+  recording.strPlotOutline = texts.Add(strPlotOutline);
+  recording.strPlot        = texts.Add(strPlot);
+  return true;
+}
+
+void PVRDemoBackendProtocol::PutTimer(PVRDemoBackendMessage& message, const PVR_TIMER& timer)
+{
+  message.PutI32((int32_t)timer.iClientChannelUid);
+  message.PutI64((int64_t)timer.startTime);
+  message.PutI64((int64_t)timer.endTime);
+  message.PutI32((int32_t)timer.state);
+  message.PutString(timer.strTitle);
+  message.PutString(timer.strSummary);
+}
+
+bool PVRDemoBackendProtocol::GetTimer(PVRDemoBackendMessage& message, PVRDemoTimer& timer)
+{
+  int iState = PVR_TIMER_STATE_NEW;
+  message.GetI32(timer.iChannelId);
+  message.GetTime(timer.startTime);
+  message.GetTime(timer.endTime);
+  message.GetI32(iState);
+  message.GetString(timer.strTitle);
+  message.GetString(timer.strSummary);
+  timer.state = (PVR_TIMER_STATE)iState;
+  return !message.Failed();
+}
+
+void PVRDemoBackendProtocol::PutEpgTag(PVRDemoBackendMessage& message, const EPG_TAG& tag)
+{
+  message.PutU32(tag.iUniqueBroadcastId);
+  message.PutI64((int64_t)tag.startTime);
+  message.PutI64((int64_t)tag.endTime);
+  message.PutI32(tag.iGenreType);
+  message.PutI32(tag.iGenreSubType);
+  message.PutI32(tag.iSeriesNumber);
+  message.PutI32(tag.iEpisodeNumber);
+  message.PutString(tag.strTitle);
+  message.PutString(tag.strEpisodeName);
+  message.PutString(tag.strIconPath);
+  message.PutString(tag.strPlotOutline);
+  message.PutString(tag.strPlot);
+}
+
+bool PVRDemoBackendProtocol::GetEpgEntry(PVRDemoBackendMessage& message, PVRDemoTextStore& texts, PVRDemoEpgEntry& entry)
+{
+  uint32_t iBroadcastId = 0;
+  std::string strPlotOutline;
+  std::string strPlot;
+  message.GetU32(iBroadcastId);
+  message.GetTime(entry.startTime);
+  message.GetTime(entry.endTime);
+  message.GetI32(entry.iGenreType);
+  message.GetI32(entry.iGenreSubType);
+  message.GetI32(entry.iSeriesNumber);
+  message.GetI32(entry.iEpisodeNumber);
+  message.GetString(entry.strTitle);
+  message.GetString(entry.strEpisodeName);
+  message.GetString(entry.strIconPath);
+  message.GetString(strPlotOutline);
+  message.GetString(strPlot);
+  if (message.Failed())
+    return false;
+
+  /* the backend's ids are final, they are handed to Kodi as they are */
+  entry.iBroadcastId   = (int)iBroadcastId;
+  entry.strPlotOutline = texts.Add(strPlotOutline);
+  entry.strPlot        = texts.Add(strPlot);
+  return true;
+}
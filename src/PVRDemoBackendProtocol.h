@@ -0,0 +1,147 @@
+/*
+ *  Copyright (C) 2011-2020 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2011 Pulse-Eight (http://www.pulse-eight.com/)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "kodi/xbmc_pvr_types.h"
+
+struct PVRDemoChannel;
+struct PVRDemoChannelGroup;
+struct PVRDemoEpgEntry;
+struct PVRDemoRecording;
+struct PVRDemoTimer;
+class PVRDemoTextStore;
+
+/*!
+ * The payload of one message, written front to back by the sender and read
+ * front to back by the receiver. Integers are little endian, strings are a
+ * uint32 length followed by their bytes. A read past the end fails and
+ * leaves the message failed for every later read.
+ */
+class PVRDemoBackendMessage
+{
+public:
+  PVRDemoBackendMessage(void) : m_iRead(0), m_bFailed(false) {}
+
+  void PutU8(uint8_t iValue) { m_data.push_back(iValue); }
+  void PutU32(uint32_t iValue);
+  void PutI32(int32_t iValue) { PutU32((uint32_t)iValue); }
+  void PutI64(int64_t iValue);
+  void PutString(const char* strValue);
+  void PutString(const std::string& strValue) { PutString(strValue.c_str()); }
+
+  /* a uint32 to be filled in with SetU32() once it is known, like a count */
+  size_t ReserveU32(void) { PutU32(0); return m_data.size() - 4; }
+  void SetU32(size_t iOffset, uint32_t iValue);
+
+  bool GetU8(uint8_t& iValue);
+  bool GetU32(uint32_t& iValue);
+  bool GetI32(int& iValue);
+  bool GetI64(int64_t& iValue);
+  bool GetTime(time_t& iValue);
+  bool GetString(std::string& strValue);
+
+  bool Failed(void) const { return m_bFailed; }
+  bool AtEnd(void) const { return m_iRead == m_data.size(); }
+
+  std::vector<uint8_t>& Data(void) { return m_data; }
+  const std::vector<uint8_t>& Data(void) const { return m_data; }
+
+private:
+  bool Take(size_t iSize, const uint8_t*& pData);
+
+  std::vector<uint8_t> m_data;
+  size_t               m_iRead;
+  bool                 m_bFailed;
+};
+
+/*!
+ * What the add-on and pvrdemo-backend say to each other. Every message is a
+ * header followed by its payload:
+ *
+ *   uint32 length of the payload
+ *   uint32 request id, echoed by the response
+ *   uint16 op
+ *   uint16 status, STATUS_OK in requests
+ *
+ * A connection carries any number of requests without waiting for their
+ * responses, and the backend answers them in the order they came in. The
+ * records are what the add-on hands to Kodi, plus the stream URLs it keeps
+ * for itself.
+ */
+class PVRDemoBackendProtocol
+{
+public:
+  static const uint32_t VERSION      = 1;
+  static const size_t   HEADER_SIZE  = 12;
+  static const uint32_t MAX_PAYLOAD  = 256 * 1024 * 1024;
+  static const int      DEFAULT_PORT = 34890;
+
+  enum Op
+  {
+    OP_HELLO = 1,          // uint32 version -> uint32 version, string name, string version
+    OP_CHANNELS,           // -> uint32 count, channels, TV and radio
+    OP_GROUPS,             // -> uint32 count, groups with the unique ids of their members
+    OP_RECORDINGS,         // uint8 deleted -> uint32 count, recordings
+    OP_TIMERS,             // -> uint32 count, timers
+    OP_EPG,                // int64 start, int64 end, uint32 count, channel uids -> per channel: int32 uid, uint32 count, tags
+    OP_DELETE_RECORDING,   // string recording id
+    OP_UNDELETE_RECORDING, // string recording id
+    OP_DELETE_TRASH,
+    OP_COUNT
+  };
+
+  enum Status
+  {
+    STATUS_OK,
+    STATUS_FAILED,       // the backend could not do it
+    STATUS_BAD_REQUEST   // unknown op or malformed payload
+  };
+
+  struct Header
+  {
+    uint32_t iLength;
+    uint32_t iRequestId;
+    uint16_t iOp;
+    uint16_t iStatus;
+  };
+
+  static void PutHeader(const Header& header, uint8_t* pData);
+  static void GetHeader(const uint8_t* pData, Header& header);
+
+  /* name of an op for logs and statistics, never NULL */
+  static const char* OpName(uint16_t iOp);
+
+  /* where a backend listens: "unix:/path", an absolute path, or "host[:port]" */
+  struct Address
+  {
+    bool        bUnix = false;
+    std::string strPath;
+    std::string strHost;
+    int         iPort = DEFAULT_PORT;
+  };
+
+  static bool ParseAddress(const std::string& strAddress, Address& address);
+
+  /* records, written by the backend from the structs the add-on hands to Kodi */
+  static void PutChannel(PVRDemoBackendMessage& message, const PVR_CHANNEL& channel, const std::string& strStreamURL);
+  static void PutGroup(PVRDemoBackendMessage& message, const PVR_CHANNEL_GROUP& group, const std::vector<int>& memberUids);
+  static void PutRecording(PVRDemoBackendMessage& message, const PVR_RECORDING& recording, const std::string& strStreamURL);
+  static void PutTimer(PVRDemoBackendMessage& message, const PVR_TIMER& timer);
+  static void PutEpgTag(PVRDemoBackendMessage& message, const EPG_TAG& tag);
+
+  /* and read by the add-on into its own model; plots go into texts */
+  static bool GetChannel(PVRDemoBackendMessage& message, PVRDemoChannel& channel);
+  static bool GetGroup(PVRDemoBackendMessage& message, PVRDemoChannelGroup& group, std::vector<int>& memberUids);
+  static bool GetRecording(PVRDemoBackendMessage& message, PVRDemoTextStore& texts, PVRDemoRecording& recording);
+  static bool GetTimer(PVRDemoBackendMessage& message, PVRDemoTimer& timer);
+  static bool GetEpgEntry(PVRDemoBackendMessage& message, PVRDemoTextStore& texts, PVRDemoEpgEntry& entry);
+};
@@ -8,58 +8,199 @@
 
 #include "util/XMLUtils.h"
 #include "PVRDemoData.h"
+#include "PVRDemoBackendClient.h"
+#include "PVRDemoEpgShards.h"
+#include "PVRDemoIconCache.h"
+#include "PVRDemoSnapshot.h"
+#include "PVRDemoStats.h"
+#include "PVRDemoXmltv.h"
 #include "p8-platform/util/StringUtils.h"
 
+#include <algorithm>
+#include <dirent.h>
+#include <limits>
+#include <map>
+#include <sys/stat.h>
+#include <unordered_set>
+
 using namespace std;
 using namespace ADDON;
 
-PVRDemoData::PVRDemoData(void)
+namespace
+{
+/* version 0: every list is there and empty, so readers see no data rather than none at all when a load fails */
+std::shared_ptr<PVRDemoDataSet> EmptyDataSet(void)
+{
+  std::shared_ptr<PVRDemoDataSet> data = std::make_shared<PVRDemoDataSet>();
+  data->channels          = std::make_shared<const std::vector<PVRDemoChannel>>();
+  data->groups            = std::make_shared<const std::vector<PVRDemoChannelGroup>>();
+  data->recordings        = std::make_shared<const std::vector<PVRDemoRecording>>();
+  data->recordingsDeleted = std::make_shared<const std::vector<PVRDemoRecording>>();
+  data->timers            = std::make_shared<const std::vector<PVRDemoTimer>>();
+  data->scheduleIds       = std::make_shared<const std::vector<unsigned int>>();
+  return data;
+}
+}
+
+PVRDemoData::PVRDemoData(const std::string& strSnapshotFile) :
+  m_dataset(EmptyDataSet())
 {
-  m_iEpgStart = -1;
   m_strDefaultIcon =  "http://www.royalty-free.tv/news/wp-content/uploads/2011/06/cc-logo1.jpg";
   m_strDefaultMovie = "";
 
-  LoadDemoData();
+  if (strSnapshotFile.empty() || !LoadSnapshot(strSnapshotFile))
+    Load();
 }
 
 PVRDemoData::~PVRDemoData(void)
 {
-  m_channels.clear();
-  m_groups.clear();
 }
 
 std::string PVRDemoData::GetSettingsFile() const
 {
   string settingFile = g_strClientPath;
-  if (settingFile.at(settingFile.size() - 1) == '\\' ||
-      settingFile.at(settingFile.size() - 1) == '/')
+  if (!settingFile.empty() &&
+      (settingFile.at(settingFile.size() - 1) == '\\' ||
+       settingFile.at(settingFile.size() - 1) == '/'))
     settingFile.append("PVRDemoAddonSettings.xml");
   else
     settingFile.append("/PVRDemoAddonSettings.xml");
   return settingFile;
 }
 
+bool PVRDemoData::Load(void)
+{
+  if (!StringSetting(g_strBackendAddress).empty())
+    return LoadBackendData();
+
+#ifdef PVRDEMO_STATIC_DATA
+  return LoadStaticData(g_staticDemoData);
+#else
+  return LoadDemoData();
+#endif
+}
+
+namespace
+{
+/* a path of the data set; relative ones are taken from the directory of the data file */
+std::string DataPath(const std::string& strDirectory, const std::string& strPath)
+{
+  if (strPath.empty() || strPath[0] == '/' || strPath[0] == '\\' || (strPath.size() > 1 && strPath[1] == ':'))
+    return strPath;
+  return strDirectory + strPath;
+}
+
+/*!
+ * A section of the data file. A manifest names a file for it instead, as in
+ * <channels file="channels.xml"/>, whose root element is the section. False
+ * if that file cannot be read.
+ */
+bool LoadSection(TiXmlElement* pRootElement, const char* strSection, const std::string& strDirectory,
+                 TiXmlDocument& doc, TiXmlElement*& pElement, std::vector<PVRDemoSourceFile>& sources)
+{
+  pElement = pRootElement->FirstChildElement(strSection);
+  const char* strFile = pElement ? pElement->Attribute("file") : NULL;
+  if (!strFile)
+    return true;
+
+  const std::string strPath = DataPath(strDirectory, strFile);
+  pElement = NULL;
+  if (!doc.LoadFile(strPath) || strcmp(doc.RootElement()->Value(), strSection) != 0)
+  {
+    PVRDEMO_LOG(LOG_ERROR, "invalid demo data (no <%s> tag found in '%s')", strSection, strPath.c_str());
+    return false;
+  }
+
+  pElement = doc.RootElement();
+  PVRDemoSourceFile source;
+  if (PVRDemoSnapshot::Stat(strPath, source))
+    sources.push_back(source);
+  return true;
+}
+
+/*
+ * An airing of the demo schedule has its entry's id in the upper bits of
+ * its broadcast id and its cycle, counted from the epoch, in the lower
+ * SCHEDULE_CYCLE_BITS. The ids of the entries are resolved once per version
+ * across every channel, so two airings only share an id when they are
+ * 2^12 cycles of one entry apart, whatever window they are fetched in.
+ */
+const unsigned int SCHEDULE_CYCLE_BITS = 12;
+
+template<typename Channels>
+std::shared_ptr<const std::vector<unsigned int>> ResolveScheduleIds(const Channels& channels)
+{
+  size_t iEntries = 0;
+  for (const auto& channel : channels)
+    iEntries += channel.epg.size();
+
+  /* a table at most half full, or collisions are left as they are */
+  const bool bResolve = iEntries < (1u << (32 - SCHEDULE_CYCLE_BITS)) / 2;
+  if (!bResolve)
+    PVRDEMO_LOG(LOG_ERROR, "%s - %zu EPG entries are too many for unique broadcast ids", __FUNCTION__, iEntries);
+
+  std::shared_ptr<std::vector<unsigned int>> ids = std::make_shared<std::vector<unsigned int>>();
+  ids->reserve(iEntries);
+  std::unordered_set<unsigned int> taken;
+  for (const auto& channel : channels)
+  {
+    for (const auto& entry : channel.epg)
+    {
+      unsigned int iId = PVRDemoData::BroadcastId(channel.iUniqueId, entry.iBroadcastId, entry.startTime) >> SCHEDULE_CYCLE_BITS;
+      for (unsigned int iAttempt = 1; iId == 0 || (bResolve && !taken.insert(iId).second); ++iAttempt)
+        iId = PVRDemoData::BroadcastId(channel.iUniqueId, entry.iBroadcastId, entry.startTime, iAttempt) >> SCHEDULE_CYCLE_BITS;
+      ids->push_back(iId);
+    }
+  }
+  return ids;
+}
+}
+
 bool PVRDemoData::LoadDemoData(void)
 {
+  PVRDEMO_STATS_SCOPE();
   TiXmlDocument xmlDoc;
   string strSettingsFile = GetSettingsFile();
 
   if (!xmlDoc.LoadFile(strSettingsFile))
   {
-    XBMC->Log(LOG_ERROR, "invalid demo data (no/invalid data file found at '%s')", strSettingsFile.c_str());
+    PVRDEMO_LOG(LOG_ERROR, "invalid demo data (no/invalid data file found at '%s')", strSettingsFile.c_str());
     return false;
   }
 
   TiXmlElement *pRootElement = xmlDoc.RootElement();
   if (strcmp(pRootElement->Value(), "demo") != 0)
   {
-    XBMC->Log(LOG_ERROR, "invalid demo data (no <demo> tag found)");
+    PVRDEMO_LOG(LOG_ERROR, "invalid demo data (no <demo> tag found)");
     return false;
   }
 
+  /* files a manifest names are found next to it */
+  const std::string strDirectory = strSettingsFile.substr(0, strSettingsFile.find_last_of("/\\") + 1);
+  TiXmlDocument sectionDoc;
+
+  /* one resolver for every time expression of this load */
+  std::shared_ptr<const PVRDemoTimeResolver> times = std::make_shared<PVRDemoTimeResolver>(time(nullptr));
+
+  /* what a snapshot of this load depends on */
+  std::vector<PVRDemoSourceFile> sources(1);
+  if (!PVRDemoSnapshot::Stat(strSettingsFile, sources[0]))
+    sources.clear();
+
+  /* plots and plot outlines of everything below, the guide included */
+  std::shared_ptr<PVRDemoTextStore> texts = PVRDemoTextStore::Create((PVRDemoTextStore::Mode)g_iColdText, g_strUserPath);
+
+  std::vector<PVRDemoChannel>      channels;
+  std::vector<PVRDemoChannelGroup> groups;
+  std::vector<PVRDemoRecording>    recordings;
+  std::vector<PVRDemoRecording>    recordingsDeleted;
+  std::vector<PVRDemoTimer>        timers;
+
   /* load channels */
   int iUniqueChannelId = 0;
-  TiXmlElement *pElement = pRootElement->FirstChildElement("channels");
+  TiXmlElement *pElement = NULL;
+  if (!LoadSection(pRootElement, "channels", strDirectory, sectionDoc, pElement, sources))
+    return false;
   if (pElement)
   {
     TiXmlNode *pChannelNode = NULL;
@@ -67,13 +208,14 @@ bool PVRDemoData::LoadDemoData(void)
     {
       PVRDemoChannel channel;
       if (ScanXMLChannelData(pChannelNode, ++iUniqueChannelId, channel))
-        m_channels.push_back(channel);
+        channels.push_back(channel);
     }
   }
 
   /* load channel groups */
   int iUniqueGroupId = 0;
-  pElement = pRootElement->FirstChildElement("channelgroups");
+  if (!LoadSection(pRootElement, "channelgroups", strDirectory, sectionDoc, pElement, sources))
+    return false;
   if (pElement)
   {
     TiXmlNode *pGroupNode = NULL;
@@ -81,72 +223,530 @@ bool PVRDemoData::LoadDemoData(void)
     {
       PVRDemoChannelGroup group;
       if (ScanXMLChannelGroupData(pGroupNode, ++iUniqueGroupId, group))
-        m_groups.push_back(group);
+        groups.push_back(group);
     }
   }
 
   /* load EPG entries */
-  pElement = pRootElement->FirstChildElement("epg");
+  if (!LoadSection(pRootElement, "epg", strDirectory, sectionDoc, pElement, sources))
+    return false;
   if (pElement)
   {
     TiXmlNode *pEpgNode = NULL;
     while ((pEpgNode = pElement->IterateChildren(pEpgNode)) != NULL)
     {
-      ScanXMLEpgData(pEpgNode);
+      ScanXMLEpgData(pEpgNode, channels, *texts);
     }
   }
 
   /* load recordings */
   iUniqueGroupId = 0; // reset unique ids
-  pElement = pRootElement->FirstChildElement("recordings");
+  if (!LoadSection(pRootElement, "recordings", strDirectory, sectionDoc, pElement, sources))
+    return false;
   if (pElement)
   {
     TiXmlNode *pRecordingNode = NULL;
     while ((pRecordingNode = pElement->IterateChildren(pRecordingNode)) != NULL)
     {
       PVRDemoRecording recording;
-      if (ScanXMLRecordingData(pRecordingNode, ++iUniqueGroupId, recording))
-        m_recordings.push_back(recording);
+      if (ScanXMLRecordingData(pRecordingNode, ++iUniqueGroupId, *times, *texts, recording))
+        recordings.push_back(recording);
     }
   }
 
   /* load deleted recordings */
-  pElement = pRootElement->FirstChildElement("recordingsdeleted");
+  if (!LoadSection(pRootElement, "recordingsdeleted", strDirectory, sectionDoc, pElement, sources))
+    return false;
   if (pElement)
   {
     TiXmlNode *pRecordingNode = NULL;
     while ((pRecordingNode = pElement->IterateChildren(pRecordingNode)) != NULL)
     {
       PVRDemoRecording recording;
-      if (ScanXMLRecordingData(pRecordingNode, ++iUniqueGroupId, recording))
-        m_recordingsDeleted.push_back(recording);
+      if (ScanXMLRecordingData(pRecordingNode, ++iUniqueGroupId, *times, *texts, recording))
+        recordingsDeleted.push_back(recording);
     }
   }
 
+  /* recordings the add-on made, each described by a sidecar next to it */
+  ScanRecordedFiles(PVRDemoIOEngine::Shared(), RecordingDirectory(), *times, *texts, recordings, sources);
+
   /* load timers */
-  pElement = pRootElement->FirstChildElement("timers");
+  if (!LoadSection(pRootElement, "timers", strDirectory, sectionDoc, pElement, sources))
+    return false;
   if (pElement)
   {
     TiXmlNode *pTimerNode = NULL;
     while ((pTimerNode = pElement->IterateChildren(pTimerNode)) != NULL)
     {
       PVRDemoTimer timer;
-      if (ScanXMLTimerData(pTimerNode, timer))
-        m_timers.push_back(timer);
+      if (ScanXMLTimerData(pTimerNode, channels, *times, timer))
+        timers.push_back(timer);
+    }
+  }
+
+  /* a manifest's guide is read day by day, as Kodi asks for it */
+  std::shared_ptr<PVRDemoEpgShards> shards;
+  pElement = pRootElement->FirstChildElement("guide");
+  if (pElement)
+    shards = ScanXMLGuideShards(pElement, strDirectory, channels, *times);
+
+  /* icons are checked, read and scaled once here instead of on every transfer */
+  PVRDemoIconCache icons(g_strClientPath, g_iIconSize > 0 ? g_strUserPath + "icons" : "", g_iIconSize);
+  for (auto& channel : channels)
+  {
+    icons.Add(channel.strIconPath, m_strDefaultIcon);
+    for (auto& entry : channel.epg)
+      icons.Add(entry.strIconPath);
+  }
+
+  /* an XMLTV guide replaces the demo schedule of the channels it covers */
+  std::shared_ptr<const PVRDemoGuide> guide;
+  const std::string strXmltvFile = StringSetting(g_strXmltvFile);
+  if (!strXmltvFile.empty())
+  {
+    std::shared_ptr<PVRDemoGuide> imported = std::make_shared<PVRDemoGuide>();
+    PVRDemoXmltvImporter importer(texts);
+    for (const auto& channel : channels)
+      importer.AddChannel(channel.strChannelName, channel.iUniqueId);
+    if (importer.Import(strXmltvFile, *imported))
+    {
+      for (auto& channel : *imported)
+        for (auto& entry : channel.second)
+          icons.Add(entry.strIconPath);
+      guide = imported;
+    }
+
+    PVRDemoSourceFile source;
+    if (PVRDemoSnapshot::Stat(strXmltvFile, source))
+      sources.push_back(source);
+  }
+  texts->Seal();
+
+  icons.Resolve();
+  for (const auto& strFile : icons.Files())
+  {
+    PVRDemoSourceFile source;
+    if (PVRDemoSnapshot::Stat(strFile, source))
+      sources.push_back(source);
+  }
+
+  size_t iEpgEntries = 0;
+  for (const auto& channel : channels)
+    iEpgEntries += channel.epg.size();
+  PVRDEMO_LOG(LOG_INFO, "%s - loaded %zu channels, %zu groups, %zu EPG entries, %zu recordings, %zu timers",
+              __FUNCTION__, channels.size(), groups.size(), iEpgEntries, recordings.size(), timers.size());
+
+  std::shared_ptr<const std::vector<unsigned int>> scheduleIds = ResolveScheduleIds(channels);
+  return Update([&](PVRDemoDataSet& data) {
+    data.tables            = nullptr;
+    data.times             = times;
+    data.channels          = std::make_shared<const std::vector<PVRDemoChannel>>(std::move(channels));
+    data.scheduleIds       = scheduleIds;
+    data.groups            = std::make_shared<const std::vector<PVRDemoChannelGroup>>(std::move(groups));
+    data.recordings        = std::make_shared<const std::vector<PVRDemoRecording>>(std::move(recordings));
+    data.recordingsDeleted = std::make_shared<const std::vector<PVRDemoRecording>>(std::move(recordingsDeleted));
+    data.timers            = std::make_shared<const std::vector<PVRDemoTimer>>(std::move(timers));
+    data.guide             = guide;
+    data.shards            = shards;
+    data.backend           = nullptr;
+    data.backendGuide      = nullptr;
+    /* shards are read from their files as they are needed, a snapshot cannot stand in for them */
+    data.sources           = shards ? nullptr : std::make_shared<const std::vector<PVRDemoSourceFile>>(std::move(sources));
+    return true;
+  });
+}
+
+bool PVRDemoData::LoadStaticData(const PVRDemoStaticDataSet& tables)
+{
+  PVRDEMO_STATS_SCOPE();
+
+  /* time expressions in the tables are resolved against the moment of loading */
+  std::shared_ptr<const PVRDemoTimeResolver> times = std::make_shared<PVRDemoTimeResolver>(time(nullptr));
+
+  std::shared_ptr<PVRDemoTextStore> texts = PVRDemoTextStore::Create((PVRDemoTextStore::Mode)g_iColdText, g_strUserPath);
+
+  /* recordings the add-on made are not in the tables */
+  std::vector<PVRDemoRecording>  recorded;
+  std::vector<PVRDemoSourceFile> sources;
+  ScanRecordedFiles(PVRDemoIOEngine::Shared(), RecordingDirectory(), *times, *texts, recorded, sources);
+
+  /* an XMLTV guide replaces the demo schedule of the channels it covers */
+  std::shared_ptr<const PVRDemoGuide> guide;
+  const std::string strXmltvFile = StringSetting(g_strXmltvFile);
+  if (!strXmltvFile.empty())
+  {
+    std::shared_ptr<PVRDemoGuide> imported = std::make_shared<PVRDemoGuide>();
+    PVRDemoXmltvImporter importer(texts);
+    for (const auto& channel : tables.channels)
+      importer.AddChannel(channel.strChannelName.c_str(), channel.iUniqueId);
+    if (importer.Import(strXmltvFile, *imported))
+      guide = imported;
+  }
+  texts->Seal();
+
+  PVRDEMO_LOG(LOG_INFO, "%s - using %zu generated channels, %zu groups, %zu recordings, %zu timers",
+              __FUNCTION__, tables.channels.size(), tables.groups.size(), tables.recordings.size() + recorded.size(),
+              tables.timers.size());
+
+  std::shared_ptr<const std::vector<unsigned int>> scheduleIds = ResolveScheduleIds(tables.channels);
+  return Update([&](PVRDemoDataSet& data) {
+    data.tables            = &tables;
+    data.times             = times;
+    data.channels          = nullptr;
+    data.scheduleIds       = scheduleIds;
+    data.groups            = nullptr;
+    data.recordings        = nullptr;
+    data.recordingsDeleted = nullptr;
+    data.timers            = nullptr;
+    data.guide             = guide;
+    data.shards            = nullptr;
+    data.backend           = nullptr;
+    data.backendGuide      = nullptr;
+    data.sources           = nullptr;
+    if (!recorded.empty())
+    {
+      MaterialiseRecordings(data);
+      std::shared_ptr<std::vector<PVRDemoRecording>> recordings = std::make_shared<std::vector<PVRDemoRecording>>(*data.recordings);
+      recordings->insert(recordings->end(), recorded.begin(), recorded.end());
+      data.recordings = std::move(recordings);
     }
+    return true;
+  });
+}
+
+bool PVRDemoData::LoadBackendData(void)
+{
+  PVRDEMO_STATS_SCOPE();
+
+  /* the pool of the current version is kept while the address stays the same */
+  const std::string strAddress = StringSetting(g_strBackendAddress);
+  std::shared_ptr<PVRDemoBackendClient> backend = Snapshot()->backend;
+  if (backend && backend->Matches(strAddress))
+    backend->SetMaxConnections(g_iBackendConnections);
+  else
+    backend = std::make_shared<PVRDemoBackendClient>(strAddress, g_iBackendConnections);
+
+  /* everything but the guide in one round trip */
+  static const uint16_t ops[] = { PVRDemoBackendProtocol::OP_CHANNELS, PVRDemoBackendProtocol::OP_GROUPS,
+                                  PVRDemoBackendProtocol::OP_RECORDINGS, PVRDemoBackendProtocol::OP_RECORDINGS,
+                                  PVRDemoBackendProtocol::OP_TIMERS };
+  std::vector<PVRDemoBackendClient::Request> requests(sizeof(ops) / sizeof(ops[0]));
+  for (size_t i = 0; i < requests.size(); ++i)
+    requests[i].iOp = ops[i];
+  requests[2].payload.PutU8(0);
+  requests[3].payload.PutU8(1);
+
+  std::vector<PVRDemoBackendClient::Response> responses;
+  bool bOk = backend->Connect() && backend->Call(requests, responses);
+  for (size_t i = 0; bOk && i < responses.size(); ++i)
+    bOk = responses[i].iStatus == PVRDemoBackendProtocol::STATUS_OK;
+
+  std::shared_ptr<PVRDemoTextStore> texts = PVRDemoTextStore::Create((PVRDemoTextStore::Mode)g_iColdText, g_strUserPath);
+  std::vector<PVRDemoChannel>      channels;
+  std::vector<PVRDemoChannelGroup> groups;
+  std::vector<PVRDemoRecording>    recordings;
+  std::vector<PVRDemoRecording>    recordingsDeleted;
+  std::vector<PVRDemoTimer>        timers;
+
+  /* each section starts with its count */
+  auto read = [&bOk, &responses](size_t iResponse, const std::function<bool(PVRDemoBackendMessage&)>& readOne) {
+    uint32_t iCount = 0;
+    if (!bOk || !responses[iResponse].payload.GetU32(iCount))
+    {
+      bOk = false;
+      return;
+    }
+    for (uint32_t i = 0; bOk && i < iCount; ++i)
+      bOk = readOne(responses[iResponse].payload);
+  };
+
+  read(0, [&channels](PVRDemoBackendMessage& message) {
+    PVRDemoChannel channel;
+    channels.push_back(channel);
+    return PVRDemoBackendProtocol::GetChannel(message, channels.back());
+  });
+
+  /* members are kept as positions in the channel list, the backend sends unique ids */
+  std::unordered_map<int, int> positions;
+  for (size_t i = 0; i < channels.size(); ++i)
+    positions[channels[i].iUniqueId] = (int)i + 1;
+  read(1, [&groups, &positions](PVRDemoBackendMessage& message) {
+    PVRDemoChannelGroup group;
+    std::vector<int> memberUids;
+    if (!PVRDemoBackendProtocol::GetGroup(message, group, memberUids))
+      return false;
+    group.iGroupId = (int)groups.size() + 1;
+    for (int iUid : memberUids)
+    {
+      auto position = positions.find(iUid);
+      if (position != positions.end())
+        group.members.push_back(position->second);
+    }
+    groups.push_back(std::move(group));
+    return true;
+  });
+
+  read(2, [&recordings, &texts](PVRDemoBackendMessage& message) {
+    PVRDemoRecording recording;
+    if (!PVRDemoBackendProtocol::GetRecording(message, *texts, recording))
+      return false;
+    recordings.push_back(std::move(recording));
+    return true;
+  });
+  read(3, [&recordingsDeleted, &texts](PVRDemoBackendMessage& message) {
+    PVRDemoRecording recording;
+    if (!PVRDemoBackendProtocol::GetRecording(message, *texts, recording))
+      return false;
+    recordingsDeleted.push_back(std::move(recording));
+    return true;
+  });
+  read(4, [&timers](PVRDemoBackendMessage& message) {
+    PVRDemoTimer timer;
+    if (!PVRDemoBackendProtocol::GetTimer(message, timer))
+      return false;
+    timers.push_back(std::move(timer));
+    return true;
+  });
+  texts->Seal();
+
+  if (!bOk)
+  {
+    PVRDEMO_LOG(LOG_ERROR, "%s - cannot load the data of the backend at '%s'", __FUNCTION__, strAddress.c_str());
+
+    /* without any version yet, the empty one keeps the client so a reload can reach the backend */
+    if (Snapshot()->iVersion == 0)
+    {
+      Update([&backend](PVRDemoDataSet& data) {
+        data.backend = backend;
+        return true;
+      });
+    }
+    return false;
   }
 
+  std::vector<int> channelUids;
+  for (const auto& channel : channels)
+    channelUids.push_back(channel.iUniqueId);
+
+  PVRDEMO_LOG(LOG_INFO, "%s - loaded %zu channels, %zu groups, %zu recordings, %zu timers from '%s'",
+              __FUNCTION__, channels.size(), groups.size(), recordings.size(), timers.size(), strAddress.c_str());
+
+  std::shared_ptr<const std::vector<unsigned int>> scheduleIds = ResolveScheduleIds(channels);
+  return Update([&](PVRDemoDataSet& data) {
+    data.tables            = nullptr;
+    data.times             = nullptr;
+    data.channels          = std::make_shared<const std::vector<PVRDemoChannel>>(std::move(channels));
+    data.scheduleIds       = scheduleIds;
+    data.groups            = std::make_shared<const std::vector<PVRDemoChannelGroup>>(std::move(groups));
+    data.recordings        = std::make_shared<const std::vector<PVRDemoRecording>>(std::move(recordings));
+    data.recordingsDeleted = std::make_shared<const std::vector<PVRDemoRecording>>(std::move(recordingsDeleted));
+    data.timers            = std::make_shared<const std::vector<PVRDemoTimer>>(std::move(timers));
+    data.guide             = nullptr;
+    data.shards            = nullptr;
+    data.backend           = backend;
+    data.backendGuide      = std::make_shared<PVRDemoBackendGuide>(backend, std::move(channelUids));
+    data.sources           = nullptr;
+    return true;
+  });
+}
+
+bool PVRDemoData::Reload(void)
+{
+  if (!Load())
+    return false;
+
+  PVRDEMO_LOG(LOG_DEBUG, "%s - published demo data version %llu", __FUNCTION__,
+              (unsigned long long)Snapshot()->iVersion);
   return true;
 }
 
-int PVRDemoData::GetChannelsAmount(void)
+bool PVRDemoData::LoadSnapshot(const std::string& strFile)
 {
-  return m_channels.size();
+  PVRDEMO_STATS_SCOPE();
+
+  /* only a data file is snapshotted, the backend and the generated tables are always read afresh */
+#ifdef PVRDEMO_STATIC_DATA
+  return false;
+#else
+  if (!StringSetting(g_strBackendAddress).empty())
+    return false;
+
+  std::shared_ptr<const PVRDemoTimeResolver> times = std::make_shared<PVRDemoTimeResolver>(time(nullptr));
+  std::shared_ptr<PVRDemoTextStore> texts = PVRDemoTextStore::Create((PVRDemoTextStore::Mode)g_iColdText, g_strUserPath);
+  PVRDemoDataSet loaded;
+  if (!PVRDemoSnapshot::Load(strFile, *times, *texts, loaded))
+    return false;
+  texts->Seal();
+
+  std::shared_ptr<const std::vector<unsigned int>> scheduleIds = ResolveScheduleIds(*loaded.channels);
+  return Update([&](PVRDemoDataSet& data) {
+    data.tables            = nullptr;
+    data.times             = times;
+    data.channels          = loaded.channels;
+    data.scheduleIds       = scheduleIds;
+    data.groups            = loaded.groups;
+    data.recordings        = loaded.recordings;
+    data.recordingsDeleted = loaded.recordingsDeleted;
+    data.timers            = loaded.timers;
+    data.guide             = loaded.guide;
+    data.shards            = nullptr;
+    data.backend           = nullptr;
+    data.backendGuide      = nullptr;
+    data.sources           = loaded.sources;
+    return true;
+  });
+#endif
 }
 
-PVR_ERROR PVRDemoData::GetChannels(ADDON_HANDLE handle, bool bRadio)
+bool PVRDemoData::SaveSnapshot(const std::string& strFile) const
+{
+  return PVRDemoSnapshot::Save(*Snapshot(), strFile);
+}
+
+void PVRDemoData::ResolveTimes(PVRDemoDataSet& data, const PVRDemoTimeResolver& times)
 {
-  for (const auto& channel : m_channels)
+  auto resolveRecordings = [&times](std::shared_ptr<const std::vector<PVRDemoRecording>>& section) {
+    if (!section)
+      return;
+    std::shared_ptr<std::vector<PVRDemoRecording>> recordings = std::make_shared<std::vector<PVRDemoRecording>>(*section);
+    for (auto& recording : *recordings)
+    {
+      if (!recording.strRecordingTime.empty())
+        times.Resolve(recording.strRecordingTime.c_str(), -1, recording.recordingTime);
+    }
+    section = std::move(recordings);
+  };
+  resolveRecordings(data.recordings);
+  resolveRecordings(data.recordingsDeleted);
+
+  if (data.timers)
+  {
+    std::shared_ptr<std::vector<PVRDemoTimer>> timers = std::make_shared<std::vector<PVRDemoTimer>>(*data.timers);
+    for (auto& timer : *timers)
+    {
+      if (!timer.strStartTime.empty())
+        times.Resolve(timer.strStartTime.c_str(), 0, timer.startTime);
+      if (!timer.strEndTime.empty())
+        times.Resolve(timer.strEndTime.c_str(), 0, timer.endTime);
+    }
+    data.timers = std::move(timers);
+  }
+}
+
+bool PVRDemoData::RefreshTimes(void)
+{
+  PVRDEMO_STATS_SCOPE();
+  std::shared_ptr<const PVRDemoDataSet> current = Snapshot();
+  std::shared_ptr<const PVRDemoTimeResolver> times = std::make_shared<PVRDemoTimeResolver>(time(nullptr));
+  if (!current->times || current->times->Today() == times->Today())
+    return false;
+
+  PVRDEMO_LOG(LOG_INFO, "%s - the day changed, resolving recording and timer times again", __FUNCTION__);
+  if (current->shards)
+    return Reload();
+
+  /* the generated tables are resolved on every read, by the new resolver from now on */
+  return Update([&](PVRDemoDataSet& data) {
+    if (data.times != current->times)
+      return false; // reloaded in the meantime
+    data.times = times;
+    ResolveTimes(data, *times);
+    return true;
+  });
+}
+
+void PVRDemoData::DropCaches(void)
+{
+  PVRDEMO_STATS_SCOPE();
+  std::shared_ptr<const PVRDemoDataSet> data = Snapshot();
+  if (data->shards)
+    data->shards->Drop();
+  if (data->backendGuide)
+    data->backendGuide->Drop();
+  if (data->backend)
+    data->backend->CloseIdle();
+  PVRDemoTextStore::DropCaches();
+}
+
+bool PVRDemoData::Update(const std::function<bool(PVRDemoDataSet&)>& mutate)
+{
+  P8PLATFORM::CLockObject lock(m_writeMutex);
+
+  std::shared_ptr<PVRDemoDataSet> next = std::make_shared<PVRDemoDataSet>(*Snapshot());
+  if (!mutate(*next))
+    return false;
+
+  ++next->iVersion;
+  m_dataset.Store(std::move(next));
+  return true;
+}
+
+namespace
+{
+/*
+ * The read paths are templates shared by the vectors of a loaded data file
+ * and the generated tables.
+ */
+
+void CopyIconPath(char* strDest, size_t iSize, const PVRDemoChannel& channel, const std::string&)
+{
+  strncpy(strDest, channel.strIconPath.c_str(), iSize - 1);
+}
+
+void CopyIconPath(char* strDest, size_t iSize, const PVRDemoStaticChannel& channel, const std::string& strDefaultIcon)
+{
+  if (channel.bIconInAddon)
+    snprintf(strDest, iSize, "%s%s", g_strClientPath.c_str(), channel.strIconPath.c_str());
+  else
+    strncpy(strDest, strDefaultIcon.c_str(), iSize - 1);
+}
+
+std::string IconPath(const PVRDemoStaticChannel& channel, const std::string& strDefaultIcon)
+{
+  return channel.bIconInAddon ? g_strClientPath + channel.strIconPath.c_str() : strDefaultIcon;
+}
+
+/* a time expression from the tables, 0 when the data file gave none */
+time_t TableTime(const PVRDemoStaticString& strTime, int iDefaultDay, const PVRDemoDataSet& data)
+{
+  time_t iTime;
+  return data.times->Resolve(strTime.c_str(), iDefaultDay, iTime) ? iTime : 0;
+}
+
+time_t RecordingTime(const PVRDemoRecording& recording, const PVRDemoDataSet&)
+{
+  return recording.recordingTime;
+}
+
+time_t RecordingTime(const PVRDemoStaticRecording& recording, const PVRDemoDataSet& data)
+{
+  return TableTime(recording.strRecordingTime, -1, data);
+}
+
+time_t TimerStartTime(const PVRDemoTimer& timer, const PVRDemoDataSet&) { return timer.startTime; }
+time_t TimerEndTime(const PVRDemoTimer& timer, const PVRDemoDataSet&) { return timer.endTime; }
+time_t TimerStartTime(const PVRDemoStaticTimer& timer, const PVRDemoDataSet& data) { return TableTime(timer.strStartTime, 0, data); }
+time_t TimerEndTime(const PVRDemoStaticTimer& timer, const PVRDemoDataSet& data) { return TableTime(timer.strEndTime, 0, data); }
+
+PVRDemoTimer TimerFromTable(const PVRDemoStaticTimer& thisTimer, const PVRDemoDataSet& data)
+{
+  PVRDemoTimer timer;
+  timer.iChannelId   = thisTimer.iChannelId;
+  timer.startTime    = TimerStartTime(thisTimer, data);
+  timer.endTime      = TimerEndTime(thisTimer, data);
+  timer.state        = thisTimer.state;
+  timer.strTitle     = thisTimer.strTitle.c_str();
+  timer.strSummary   = thisTimer.strSummary.c_str();
+  timer.strStartTime = thisTimer.strStartTime.c_str();
+  timer.strEndTime   = thisTimer.strEndTime.c_str();
+  return timer;
+}
+
+template<typename Channels>
+void TransferChannels(ADDON_HANDLE handle, const Channels& channels, bool bRadio, const std::string& strDefaultIcon)
+{
+  for (const auto& channel : channels)
   {
     if (channel.bRadio == bRadio)
     {
@@ -158,48 +758,32 @@ PVR_ERROR PVRDemoData::GetChannels(ADDON_HANDLE handle, bool bRadio)
       xbmcChannel.iSubChannelNumber = channel.iSubChannelNumber;
       strncpy(xbmcChannel.strChannelName, channel.strChannelName.c_str(), sizeof(xbmcChannel.strChannelName) - 1);
       xbmcChannel.iEncryptionSystem = channel.iEncryptionSystem;
-      strncpy(xbmcChannel.strIconPath, channel.strIconPath.c_str(), sizeof(xbmcChannel.strIconPath) - 1);
+      CopyIconPath(xbmcChannel.strIconPath, sizeof(xbmcChannel.strIconPath), channel, strDefaultIcon);
       xbmcChannel.bIsHidden         = false;
 
       PVR->TransferChannelEntry(handle, &xbmcChannel);
+      PVRDEMO_STATS_COUNT(PVRDEMO_COUNTER_ENTRIES, 1);
     }
   }
-
-  return PVR_ERROR_NO_ERROR;
 }
 
-bool PVRDemoData::GetChannel(const PVR_CHANNEL &channel, PVRDemoChannel &myChannel)
+template<typename Channels>
+const typename Channels::value_type* FindChannel(const Channels& channels, int iUniqueId)
 {
-  for (const auto& thisChannel : m_channels)
+  for (const auto& channel : channels)
   {
-    if (thisChannel.iUniqueId == (int) channel.iUniqueId)
-    {
-      myChannel.iUniqueId         = thisChannel.iUniqueId;
-      myChannel.bRadio            = thisChannel.bRadio;
-      myChannel.iChannelNumber    = thisChannel.iChannelNumber;
-      myChannel.iSubChannelNumber = thisChannel.iSubChannelNumber;
-      myChannel.iEncryptionSystem = thisChannel.iEncryptionSystem;
-      myChannel.strChannelName    = thisChannel.strChannelName;
-      myChannel.strIconPath       = thisChannel.strIconPath;
-      myChannel.strStreamURL      = thisChannel.strStreamURL;
-
-      return true;
-    }
+    if (channel.iUniqueId == iUniqueId)
+      return &channel;
   }
-
-  return false;
-}
-
-int PVRDemoData::GetChannelGroupsAmount(void)
-{
-  return m_groups.size();
+  return nullptr;
 }
 
-PVR_ERROR PVRDemoData::GetChannelGroups(ADDON_HANDLE handle, bool bRadio)
+template<typename Groups>
+void TransferChannelGroups(ADDON_HANDLE handle, const Groups& groups, bool bRadio)
 {
-  for (unsigned int iGroupPtr = 0; iGroupPtr < m_groups.size(); iGroupPtr++)
+  for (unsigned int iGroupPtr = 0; iGroupPtr < groups.size(); iGroupPtr++)
   {
-    PVRDemoChannelGroup &group = m_groups.at(iGroupPtr);
+    const auto &group = groups.at(iGroupPtr);
     if (group.bRadio == bRadio)
     {
       PVR_CHANNEL_GROUP xbmcGroup = {};
@@ -209,25 +793,25 @@ PVR_ERROR PVRDemoData::GetChannelGroups(ADDON_HANDLE handle, bool bRadio)
       strncpy(xbmcGroup.strGroupName, group.strGroupName.c_str(), sizeof(xbmcGroup.strGroupName) - 1);
 
       PVR->TransferChannelGroup(handle, &xbmcGroup);
+      PVRDEMO_STATS_COUNT(PVRDEMO_COUNTER_ENTRIES, 1);
     }
   }
-
-  return PVR_ERROR_NO_ERROR;
 }
 
-PVR_ERROR PVRDemoData::GetChannelGroupMembers(ADDON_HANDLE handle, const PVR_CHANNEL_GROUP &group)
+template<typename Groups, typename Channels>
+void TransferChannelGroupMembers(ADDON_HANDLE handle, const Groups& groups, const Channels& channels, const PVR_CHANNEL_GROUP &group)
 {
-  for (unsigned int iGroupPtr = 0; iGroupPtr < m_groups.size(); iGroupPtr++)
+  for (unsigned int iGroupPtr = 0; iGroupPtr < groups.size(); iGroupPtr++)
   {
-    PVRDemoChannelGroup &myGroup = m_groups.at(iGroupPtr);
+    const auto &myGroup = groups.at(iGroupPtr);
     if (!strcmp(myGroup.strGroupName.c_str(),group.strGroupName))
     {
       for (unsigned int iChannelPtr = 0; iChannelPtr < myGroup.members.size(); iChannelPtr++)
       {
         int iId = myGroup.members.at(iChannelPtr) - 1;
-        if (iId < 0 || iId > (int)m_channels.size() - 1)
+        if (iId < 0 || iId > (int)channels.size() - 1)
           continue;
-        PVRDemoChannel &channel = m_channels.at(iId);
+        const auto &channel = channels.at(iId);
         PVR_CHANNEL_GROUP_MEMBER xbmcGroupMember = {};
 
         strncpy(xbmcGroupMember.strGroupName, group.strGroupName, sizeof(xbmcGroupMember.strGroupName) - 1);
@@ -236,41 +820,54 @@ PVR_ERROR PVRDemoData::GetChannelGroupMembers(ADDON_HANDLE handle, const PVR_CHA
         xbmcGroupMember.iSubChannelNumber = channel.iSubChannelNumber;
 
         PVR->TransferChannelGroupMember(handle, &xbmcGroupMember);
+        PVRDEMO_STATS_COUNT(PVRDEMO_COUNTER_ENTRIES, 1);
       }
     }
   }
-
-  return PVR_ERROR_NO_ERROR;
 }
 
-PVR_ERROR PVRDemoData::GetEPGForChannel(ADDON_HANDLE handle, int iChannelUid, time_t iStart, time_t iEnd)
+/*
+ * The demo schedule of a channel between iStart and iEnd, each tag handed
+ * to emit. A channel's entries repeat every cycle, a cycle being as long as
+ * its last entry's end. Cycles are counted from the epoch, so an airing
+ * keeps its start time and broadcast id across restarts; ids holds the
+ * resolved ids of the entries of all channels, see ResolveScheduleIds().
+ */
+template<typename Channels, typename Emit>
+void GenerateEpg(const Channels& channels, const std::vector<unsigned int>& ids, int iChannelUid, time_t iStart, time_t iEnd, Emit emit)
 {
-  if (m_iEpgStart == -1)
-    m_iEpgStart = iStart;
-
-  time_t iLastEndTime = m_iEpgStart + 1;
-  int iAddBroadcastId = 0;
-
-  for (unsigned int iChannelPtr = 0; iChannelPtr < m_channels.size(); iChannelPtr++)
+  size_t iFirst = 0;
+  for (const auto& myChannel : channels)
   {
-    PVRDemoChannel &myChannel = m_channels.at(iChannelPtr);
-    if (myChannel.iUniqueId != iChannelUid)
+    const size_t iChannelFirst = iFirst;
+    iFirst += myChannel.epg.size();
+    if (myChannel.iUniqueId != iChannelUid || myChannel.epg.empty() || iFirst > ids.size())
       continue;
 
-    while (iLastEndTime < iEnd && myChannel.epg.size() > 0)
+    const time_t iCycle = myChannel.epg[myChannel.epg.size() - 1].endTime;
+    if (iCycle <= 0)
+      continue;
+
+    /* from the cycle before the one iStart falls into, its entries may run on */
+    time_t iCycleStart = (iStart / iCycle - (iStart % iCycle < 0 ? 1 : 0) - 1) * iCycle;
+    for (; iCycleStart < iEnd; iCycleStart += iCycle)
     {
-      time_t iLastEndTimeTmp = 0;
-      for (unsigned int iEntryPtr = 0; iEntryPtr < myChannel.epg.size(); iEntryPtr++)
+      const unsigned int iCycleBits = (unsigned int)(iCycleStart / iCycle) & ((1u << SCHEDULE_CYCLE_BITS) - 1);
+      for (size_t i = 0; i < myChannel.epg.size(); ++i)
       {
-        PVRDemoEpgEntry &myTag = myChannel.epg.at(iEntryPtr);
+        const auto& myTag = myChannel.epg[i];
+        const time_t iTagStart = iCycleStart + myTag.startTime;
+        const time_t iTagEnd = iCycleStart + myTag.endTime;
+        if (iTagEnd <= iStart || iTagStart >= iEnd)
+          continue;
 
         EPG_TAG tag = {};
 
-        tag.iUniqueBroadcastId = myTag.iBroadcastId + iAddBroadcastId;
+        tag.iUniqueBroadcastId = (ids[iChannelFirst + i] << SCHEDULE_CYCLE_BITS) | iCycleBits;
         tag.iUniqueChannelId   = iChannelUid;
         tag.strTitle           = myTag.strTitle.c_str();
-        tag.startTime          = myTag.startTime + iLastEndTime;
-        tag.endTime            = myTag.endTime + iLastEndTime;
+        tag.startTime          = iTagStart;
+        tag.endTime            = iTagEnd;
         tag.strPlotOutline     = myTag.strPlotOutline.c_str();
         tag.strPlot            = myTag.strPlot.c_str();
         tag.strIconPath        = myTag.strIconPath.c_str();
@@ -278,37 +875,61 @@ PVR_ERROR PVRDemoData::GetEPGForChannel(ADDON_HANDLE handle, int iChannelUid, ti
         tag.iGenreSubType      = myTag.iGenreSubType;
         tag.iFlags             = EPG_TAG_FLAG_UNDEFINED;
         tag.iSeriesNumber      = myTag.iSeriesNumber;
-        tag.iEpisodeNumber     = myTag.iEpisodeNumber;;
+        tag.iEpisodeNumber     = myTag.iEpisodeNumber;
         tag.iEpisodePartNumber = EPG_TAG_INVALID_SERIES_EPISODE;
         tag.strEpisodeName     = myTag.strEpisodeName.c_str();
-        tag.strFirstAired = "";
+        tag.strFirstAired      = "";
 
-        iLastEndTimeTmp = tag.endTime;
-
-        PVR->TransferEpgEntry(handle, &tag);
+        emit(tag);
       }
-
-      iLastEndTime = iLastEndTimeTmp;
-      iAddBroadcastId += myChannel.epg.size();
     }
   }
-
-  return PVR_ERROR_NO_ERROR;
 }
 
-int PVRDemoData::GetRecordingsAmount(bool bDeleted)
+/*!
+ * The imported guide of a channel between iStart and iEnd, each tag handed
+ * to emit. Entries that start before iNotBefore are skipped, they belong
+ * to the shard before.
+ */
+template<typename Emit>
+void GenerateGuide(const std::vector<PVRDemoEpgEntry>& entries, time_t iStart, time_t iEnd, time_t iNotBefore, Emit emit)
 {
-  return bDeleted ? m_recordingsDeleted.size() : m_recordings.size();
+  /* entries do not overlap, so end times are sorted as well */
+  auto it = std::partition_point(entries.begin(), entries.end(),
+                                 [iStart](const PVRDemoEpgEntry& entry) { return entry.endTime <= iStart; });
+  for (; it != entries.end() && it->startTime < iEnd; ++it)
+  {
+    if (it->startTime < iNotBefore)
+      continue;
+
+    EPG_TAG tag = {};
+
+    tag.iUniqueBroadcastId = it->iBroadcastId;
+    tag.iUniqueChannelId   = it->iChannelId;
+    tag.strTitle           = it->strTitle.c_str();
+    tag.startTime          = it->startTime;
+    tag.endTime            = it->endTime;
+    tag.strPlotOutline     = it->strPlotOutline.c_str();
+    tag.strPlot            = it->strPlot.c_str();
+    tag.strIconPath        = it->strIconPath.c_str();
+    tag.iGenreType         = it->iGenreType;
+    tag.iGenreSubType      = it->iGenreSubType;
+    tag.iFlags             = EPG_TAG_FLAG_UNDEFINED;
+    tag.iSeriesNumber      = it->iSeriesNumber;
+    tag.iEpisodeNumber     = it->iEpisodeNumber;
+    tag.iEpisodePartNumber = EPG_TAG_INVALID_SERIES_EPISODE;
+    tag.strEpisodeName     = it->strEpisodeName.c_str();
+    tag.strFirstAired      = "";
+
+    emit(tag);
+  }
 }
 
-PVR_ERROR PVRDemoData::GetRecordings(ADDON_HANDLE handle, bool bDeleted)
+template<typename Recordings>
+void TransferRecordings(ADDON_HANDLE handle, const Recordings& recordings, bool bDeleted, const PVRDemoDataSet& data)
 {
-  std::vector<PVRDemoRecording> *recordings = bDeleted ? &m_recordingsDeleted : &m_recordings;
-
-  for (std::vector<PVRDemoRecording>::iterator it = recordings->begin() ; it != recordings->end() ; it++)
+  for (const auto& recording : recordings)
   {
-    PVRDemoRecording &recording = *it;
-
     PVR_RECORDING xbmcRecording = {};
     xbmcRecording.iSeriesNumber = PVR_RECORDING_INVALID_SERIES_EPISODE;
     xbmcRecording.iEpisodeNumber = PVR_RECORDING_INVALID_SERIES_EPISODE;
@@ -316,7 +937,7 @@ PVR_ERROR PVRDemoData::GetRecordings(ADDON_HANDLE handle, bool bDeleted)
     xbmcRecording.iDuration     = recording.iDuration;
     xbmcRecording.iGenreType    = recording.iGenreType;
     xbmcRecording.iGenreSubType = recording.iGenreSubType;
-    xbmcRecording.recordingTime = recording.recordingTime;
+    xbmcRecording.recordingTime = RecordingTime(recording, data);
     xbmcRecording.iEpisodeNumber = recording.iEpisodeNumber;
     xbmcRecording.iSeriesNumber = recording.iSeriesNumber;
     xbmcRecording.bIsDeleted    = bDeleted;
@@ -334,14 +955,14 @@ PVR_ERROR PVRDemoData::GetRecordings(ADDON_HANDLE handle, bool bDeleted)
     xbmcRecording.iChannelUid = PVR_CHANNEL_INVALID_UID;
 
     PVR->TransferRecordingEntry(handle, &xbmcRecording);
+    PVRDEMO_STATS_COUNT(PVRDEMO_COUNTER_ENTRIES, 1);
   }
-
-  return PVR_ERROR_NO_ERROR;
 }
 
-std::string PVRDemoData::GetRecordingURL(const PVR_RECORDING &recording)
+template<typename Recordings>
+std::string FindRecordingURL(const Recordings& recordings, const PVR_RECORDING &recording)
 {
-  for (const auto& thisRecording : m_recordings)
+  for (const auto& thisRecording : recordings)
   {
     if (thisRecording.strRecordingId == recording.strRecordingId)
     {
@@ -352,18 +973,12 @@ std::string PVRDemoData::GetRecordingURL(const PVR_RECORDING &recording)
   return "";
 }
 
-int PVRDemoData::GetTimersAmount(void)
-{
-  return m_timers.size();
-}
-
-PVR_ERROR PVRDemoData::GetTimers(ADDON_HANDLE handle)
+template<typename Timers>
+void TransferTimers(ADDON_HANDLE handle, const Timers& timers, const PVRDemoDataSet& data)
 {
   unsigned int i = PVR_TIMER_NO_CLIENT_INDEX + 1;
-  for (std::vector<PVRDemoTimer>::iterator it = m_timers.begin() ; it != m_timers.end() ; it++)
+  for (const auto& timer : timers)
   {
-    PVRDemoTimer &timer = *it;
-
     PVR_TIMER xbmcTimer = {};
 
     /* TODO: Implement own timer types to get support for the timer features introduced with PVR API 1.9.7 */
@@ -371,19 +986,480 @@ PVR_ERROR PVRDemoData::GetTimers(ADDON_HANDLE handle)
 
     xbmcTimer.iClientIndex      = i++;
     xbmcTimer.iClientChannelUid = timer.iChannelId;
-    xbmcTimer.startTime         = timer.startTime;
-    xbmcTimer.endTime           = timer.endTime;
+    xbmcTimer.startTime         = TimerStartTime(timer, data);
+    xbmcTimer.endTime           = TimerEndTime(timer, data);
     xbmcTimer.state             = timer.state;
 
-    strncpy(xbmcTimer.strTitle, timer.strTitle.c_str(), sizeof(timer.strTitle) - 1);
-    strncpy(xbmcTimer.strSummary, timer.strSummary.c_str(), sizeof(timer.strSummary) - 1);
+    strncpy(xbmcTimer.strTitle, timer.strTitle.c_str(), sizeof(xbmcTimer.strTitle) - 1);
+    strncpy(xbmcTimer.strSummary, timer.strSummary.c_str(), sizeof(xbmcTimer.strSummary) - 1);
 
     PVR->TransferTimerEntry(handle, &xbmcTimer);
+    PVRDEMO_STATS_COUNT(PVRDEMO_COUNTER_ENTRIES, 1);
+  }
+}
+}
+
+int PVRDemoData::GetChannelsAmount(void)
+{
+  const Reader data(m_dataset);
+  if (data->channels)
+    return data->channels->size();
+  return data->tables ? data->tables->channels.size() : 0;
+}
+
+PVR_ERROR PVRDemoData::GetChannels(ADDON_HANDLE handle, bool bRadio)
+{
+  const Reader data(m_dataset);
+  if (data->channels)
+    TransferChannels(handle, *data->channels, bRadio, m_strDefaultIcon);
+  else if (data->tables)
+    TransferChannels(handle, data->tables->channels, bRadio, m_strDefaultIcon);
+
+  return PVR_ERROR_NO_ERROR;
+}
+
+bool PVRDemoData::GetChannel(const PVR_CHANNEL &channel, PVRDemoChannel &myChannel)
+{
+  const Reader data(m_dataset);
+  if (!data->channels)
+  {
+    if (!data->tables)
+      return false;
+
+    const PVRDemoStaticChannel* thisChannel = FindChannel(data->tables->channels, (int) channel.iUniqueId);
+    if (!thisChannel)
+      return false;
+
+    myChannel.iUniqueId         = thisChannel->iUniqueId;
+    myChannel.bRadio            = thisChannel->bRadio;
+    myChannel.iChannelNumber    = thisChannel->iChannelNumber;
+    myChannel.iSubChannelNumber = thisChannel->iSubChannelNumber;
+    myChannel.iEncryptionSystem = thisChannel->iEncryptionSystem;
+    myChannel.strChannelName    = thisChannel->strChannelName.c_str();
+    myChannel.strIconPath       = IconPath(*thisChannel, m_strDefaultIcon);
+    myChannel.strStreamURL      = thisChannel->strStreamURL.c_str();
+
+    return true;
+  }
+
+  const PVRDemoChannel* thisChannel = FindChannel(*data->channels, (int) channel.iUniqueId);
+  if (!thisChannel)
+    return false;
+
+  myChannel.iUniqueId         = thisChannel->iUniqueId;
+  myChannel.bRadio            = thisChannel->bRadio;
+  myChannel.iChannelNumber    = thisChannel->iChannelNumber;
+  myChannel.iSubChannelNumber = thisChannel->iSubChannelNumber;
+  myChannel.iEncryptionSystem = thisChannel->iEncryptionSystem;
+  myChannel.strChannelName    = thisChannel->strChannelName;
+  myChannel.strIconPath       = thisChannel->strIconPath;
+  myChannel.strStreamURL      = thisChannel->strStreamURL;
+
+  return true;
+}
+
+std::vector<int> PVRDemoData::GetChannelUids(void)
+{
+  const Reader data(m_dataset);
+  std::vector<int> uids;
+  if (data->channels)
+  {
+    for (const auto& channel : *data->channels)
+      uids.push_back(channel.iUniqueId);
+  }
+  else if (data->tables)
+  {
+    for (const auto& channel : data->tables->channels)
+      uids.push_back(channel.iUniqueId);
+  }
+  return uids;
+}
+
+int PVRDemoData::GetChannelGroupsAmount(void)
+{
+  const Reader data(m_dataset);
+  if (data->groups)
+    return data->groups->size();
+  return data->tables ? data->tables->groups.size() : 0;
+}
+
+PVR_ERROR PVRDemoData::GetChannelGroups(ADDON_HANDLE handle, bool bRadio)
+{
+  const Reader data(m_dataset);
+  if (data->groups)
+    TransferChannelGroups(handle, *data->groups, bRadio);
+  else if (data->tables)
+    TransferChannelGroups(handle, data->tables->groups, bRadio);
+
+  return PVR_ERROR_NO_ERROR;
+}
+
+PVR_ERROR PVRDemoData::GetChannelGroupMembers(ADDON_HANDLE handle, const PVR_CHANNEL_GROUP &group)
+{
+  /* groups and channels come from the same source, neither is ever changed */
+  const Reader data(m_dataset);
+  if (data->groups)
+    TransferChannelGroupMembers(handle, *data->groups, *data->channels, group);
+  else if (data->tables)
+    TransferChannelGroupMembers(handle, data->tables->groups, data->tables->channels, group);
+
+  return PVR_ERROR_NO_ERROR;
+}
+
+PVR_ERROR PVRDemoData::GetEPGForChannel(ADDON_HANDLE handle, int iChannelUid, time_t iStart, time_t iEnd)
+{
+  /* kept per thread, so a warm transfer allocates nothing */
+  static thread_local PVRDemoEpgShardList shards;
+
+  ForEachEpgTag(*Reader(m_dataset), iChannelUid, iStart, iEnd, shards, [handle](const EPG_TAG& tag) {
+    PVR->TransferEpgEntry(handle, &tag);
+    PVRDEMO_STATS_COUNT(PVRDEMO_COUNTER_ENTRIES, 1);
+  });
+  shards.clear();
+
+  return PVR_ERROR_NO_ERROR;
+}
+
+void PVRDemoData::GetEpgTags(const PVRDemoDataSet& data, int iChannelUid, time_t iStart, time_t iEnd,
+                             std::vector<EPG_TAG>& tags, PVRDemoEpgShardList& shards) const
+{
+  tags.clear();
+  ForEachEpgTag(data, iChannelUid, iStart, iEnd, shards, [&tags](const EPG_TAG& tag) { tags.push_back(tag); });
+}
+
+unsigned int PVRDemoData::BroadcastId(int iChannelUid, int iEntryId, time_t iStart, unsigned int iAttempt)
+{
+  /* splitmix64's finaliser over all three, then folded into Kodi's 32 bits */
+  auto mix = [](uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+  };
+  uint64_t iHash = mix(((uint64_t)(uint32_t)iChannelUid << 32) | (uint32_t)iEntryId);
+  iHash = mix(iHash ^ (uint64_t)(int64_t)iStart);
+  if (iAttempt > 0)
+    iHash = mix(iHash + iAttempt);
+
+  const unsigned int iId = (unsigned int)(iHash ^ (iHash >> 32));
+  return iId != EPG_TAG_INVALID_UID ? iId : 1;
+}
+
+template<typename Emit>
+void PVRDemoData::ForEachEpgTag(const PVRDemoDataSet& data, int iChannelUid, time_t iStart, time_t iEnd,
+                                PVRDemoEpgShardList& shards, Emit emit)
+{
+  shards.clear();
+  if (data.guide)
+  {
+    auto guide = data.guide->find(iChannelUid);
+    if (guide != data.guide->end())
+    {
+      GenerateGuide(guide->second, iStart, iEnd, std::numeric_limits<time_t>::min(), emit);
+      return;
+    }
+  }
+
+  if (data.shards && data.shards->Covers(iChannelUid))
+  {
+    /* a programme that runs past midnight is in both days' shards, the first one in the window hands it out */
+    data.shards->Fetch(iChannelUid, iStart, iEnd, shards);
+    time_t iNotBefore = std::numeric_limits<time_t>::min();
+    for (const auto& shard : shards)
+    {
+      auto guide = shard->guide.find(iChannelUid);
+      if (guide != shard->guide.end())
+        GenerateGuide(guide->second, iStart, iEnd, iNotBefore, emit);
+      iNotBefore = shard->iEnd;
+    }
+    return;
+  }
+
+  if (data.backendGuide && data.backendGuide->Covers(iChannelUid))
+  {
+    data.backendGuide->Fetch(iChannelUid, iStart, iEnd, shards);
+    for (const auto& window : shards)
+    {
+      auto guide = window->guide.find(iChannelUid);
+      if (guide != window->guide.end())
+        GenerateGuide(guide->second, iStart, iEnd, std::numeric_limits<time_t>::min(), emit);
+    }
+    return;
+  }
+
+  if (!data.scheduleIds)
+    return;
+  if (data.channels)
+    GenerateEpg(*data.channels, *data.scheduleIds, iChannelUid, iStart, iEnd, emit);
+  else if (data.tables)
+    GenerateEpg(data.tables->channels, *data.scheduleIds, iChannelUid, iStart, iEnd, emit);
+}
+
+int PVRDemoData::GetRecordingsAmount(bool bDeleted)
+{
+  const Reader data(m_dataset);
+  if (!data->recordings)
+  {
+    if (!data->tables)
+      return 0;
+    return bDeleted ? data->tables->recordingsDeleted.size() : data->tables->recordings.size();
+  }
+  return bDeleted ? data->recordingsDeleted->size() : data->recordings->size();
+}
+
+PVR_ERROR PVRDemoData::GetRecordings(ADDON_HANDLE handle, bool bDeleted)
+{
+  const Reader data(m_dataset);
+  if (data->recordings)
+    TransferRecordings(handle, bDeleted ? *data->recordingsDeleted : *data->recordings, bDeleted, *data);
+  else if (data->tables)
+    TransferRecordings(handle, bDeleted ? data->tables->recordingsDeleted : data->tables->recordings, bDeleted, *data);
+
+  return PVR_ERROR_NO_ERROR;
+}
+
+std::string PVRDemoData::GetRecordingURL(const PVR_RECORDING &recording)
+{
+  const Reader data(m_dataset);
+  if (!data->recordings)
+    return data->tables ? FindRecordingURL(data->tables->recordings, recording) : "";
+  return FindRecordingURL(*data->recordings, recording);
+}
+
+namespace
+{
+/* move one recording between the active list and the trash */
+bool MoveRecording(std::shared_ptr<const std::vector<PVRDemoRecording>>& from,
+                   std::shared_ptr<const std::vector<PVRDemoRecording>>& to,
+                   const std::string& strRecordingId)
+{
+  auto it = std::find_if(from->begin(), from->end(),
+                         [&strRecordingId](const PVRDemoRecording& recording) { return recording.strRecordingId == strRecordingId; });
+  if (it == from->end())
+    return false;
+
+  std::shared_ptr<std::vector<PVRDemoRecording>> target = std::make_shared<std::vector<PVRDemoRecording>>(*to);
+  target->push_back(*it);
+
+  std::shared_ptr<std::vector<PVRDemoRecording>> source = std::make_shared<std::vector<PVRDemoRecording>>(*from);
+  source->erase(source->begin() + (it - from->begin()));
+
+  from = std::move(source);
+  to = std::move(target);
+  return true;
+}
+}
+
+void PVRDemoData::MaterialiseRecordings(PVRDemoDataSet& data)
+{
+  if (data.recordings)
+    return;
+
+  auto copy = [&data](const PVRDemoStaticArray<PVRDemoStaticRecording>& table) {
+    std::shared_ptr<std::vector<PVRDemoRecording>> recordings = std::make_shared<std::vector<PVRDemoRecording>>();
+    recordings->reserve(table.size());
+    for (const auto& thisRecording : table)
+    {
+      PVRDemoRecording recording;
+      recording.bRadio         = thisRecording.bRadio;
+      recording.iDuration      = thisRecording.iDuration;
+      recording.iGenreType     = thisRecording.iGenreType;
+      recording.iGenreSubType  = thisRecording.iGenreSubType;
+      recording.iSeriesNumber  = thisRecording.iSeriesNumber;
+      recording.iEpisodeNumber = thisRecording.iEpisodeNumber;
+      recording.strChannelName = thisRecording.strChannelName.c_str();
+      recording.strPlotOutline = PVRDemoText(thisRecording.strPlotOutline.c_str());
+      recording.strPlot        = PVRDemoText(thisRecording.strPlot.c_str());
+      recording.strRecordingId = thisRecording.strRecordingId.c_str();
+      recording.strStreamURL   = thisRecording.strStreamURL.c_str();
+      recording.strTitle       = thisRecording.strTitle.c_str();
+      recording.strEpisodeName = thisRecording.strEpisodeName.c_str();
+      recording.strDirectory   = thisRecording.strDirectory.c_str();
+      recording.recordingTime  = RecordingTime(thisRecording, data);
+      recording.strRecordingTime = thisRecording.strRecordingTime.c_str();
+      recordings->push_back(recording);
+    }
+    return std::shared_ptr<const std::vector<PVRDemoRecording>>(std::move(recordings));
+  };
+
+  if (!data.tables)
+  {
+    data.recordings        = std::make_shared<const std::vector<PVRDemoRecording>>();
+    data.recordingsDeleted = std::make_shared<const std::vector<PVRDemoRecording>>();
+    return;
+  }
+
+  data.recordings        = copy(data.tables->recordings);
+  data.recordingsDeleted = copy(data.tables->recordingsDeleted);
+}
+
+void PVRDemoData::MaterialiseTimers(PVRDemoDataSet& data)
+{
+  if (data.timers)
+    return;
+
+  std::shared_ptr<std::vector<PVRDemoTimer>> timers = std::make_shared<std::vector<PVRDemoTimer>>();
+  if (data.tables)
+  {
+    timers->reserve(data.tables->timers.size());
+    for (const auto& thisTimer : data.tables->timers)
+      timers->push_back(TimerFromTable(thisTimer, data));
+  }
+  data.timers = std::move(timers);
+}
+
+bool PVRDemoData::ForwardRecordingChange(uint16_t iOp, const std::string& strRecordingId)
+{
+  std::shared_ptr<PVRDemoBackendClient> backend = Snapshot()->backend;
+  if (!backend)
+    return true;
+
+  PVRDemoBackendMessage payload;
+  if (iOp != PVRDemoBackendProtocol::OP_DELETE_TRASH)
+    payload.PutString(strRecordingId);
+  PVRDemoBackendClient::Response response;
+  if (!backend->Call(iOp, payload, response) || response.iStatus != PVRDemoBackendProtocol::STATUS_OK)
+  {
+    PVRDEMO_LOG(LOG_ERROR, "%s - the backend did not take %s of '%s'", __FUNCTION__, PVRDemoBackendProtocol::OpName(iOp),
+                strRecordingId.c_str());
+    return false;
+  }
+  return true;
+}
+
+PVR_ERROR PVRDemoData::DeleteRecording(const PVR_RECORDING &recording)
+{
+  const std::string strRecordingId = recording.strRecordingId;
+  if (!ForwardRecordingChange(PVRDemoBackendProtocol::OP_DELETE_RECORDING, strRecordingId))
+    return PVR_ERROR_SERVER_ERROR;
+  if (!Update([&strRecordingId](PVRDemoDataSet& data) {
+        MaterialiseRecordings(data);
+        return MoveRecording(data.recordings, data.recordingsDeleted, strRecordingId);
+      }))
+    return PVR_ERROR_INVALID_PARAMETERS;
+
+  PVR->TriggerRecordingUpdate();
+  return PVR_ERROR_NO_ERROR;
+}
+
+PVR_ERROR PVRDemoData::UndeleteRecording(const PVR_RECORDING &recording)
+{
+  const std::string strRecordingId = recording.strRecordingId;
+  if (!ForwardRecordingChange(PVRDemoBackendProtocol::OP_UNDELETE_RECORDING, strRecordingId))
+    return PVR_ERROR_SERVER_ERROR;
+  if (!Update([&strRecordingId](PVRDemoDataSet& data) {
+        MaterialiseRecordings(data);
+        return MoveRecording(data.recordingsDeleted, data.recordings, strRecordingId);
+      }))
+    return PVR_ERROR_INVALID_PARAMETERS;
+
+  PVR->TriggerRecordingUpdate();
+  return PVR_ERROR_NO_ERROR;
+}
+
+PVR_ERROR PVRDemoData::DeleteAllRecordingsFromTrash(void)
+{
+  if (!ForwardRecordingChange(PVRDemoBackendProtocol::OP_DELETE_TRASH, ""))
+    return PVR_ERROR_SERVER_ERROR;
+  std::shared_ptr<const std::vector<PVRDemoRecording>> trash;
+  Update([&trash](PVRDemoDataSet& data) {
+    MaterialiseRecordings(data);
+    if (data.recordingsDeleted->empty())
+      return false;
+    trash = data.recordingsDeleted;
+    data.recordingsDeleted = std::make_shared<const std::vector<PVRDemoRecording>>();
+    return true;
+  });
+
+  /* the files of recordings the add-on made go with them */
+  if (trash)
+  {
+    for (const auto& recording : *trash)
+    {
+      const std::string strSidecar = SidecarFile(recording.strStreamURL);
+      struct stat info;
+      if (stat(strSidecar.c_str(), &info) == 0 && remove(recording.strStreamURL.c_str()) == 0)
+        remove(strSidecar.c_str());
+    }
   }
 
+  PVR->TriggerRecordingUpdate();
   return PVR_ERROR_NO_ERROR;
 }
 
+int PVRDemoData::GetTimersAmount(void)
+{
+  const Reader data(m_dataset);
+  if (data->timers)
+    return data->timers->size();
+  return data->tables ? data->tables->timers.size() : 0;
+}
+
+PVR_ERROR PVRDemoData::GetTimers(ADDON_HANDLE handle)
+{
+  const Reader data(m_dataset);
+  if (data->timers)
+    TransferTimers(handle, *data->timers, *data);
+  else if (data->tables)
+    TransferTimers(handle, data->tables->timers, *data);
+
+  return PVR_ERROR_NO_ERROR;
+}
+
+std::vector<PVRDemoTimer> PVRDemoData::GetTimerList(void)
+{
+  const Reader data(m_dataset);
+  if (data->timers)
+    return *data->timers;
+
+  std::vector<PVRDemoTimer> timers;
+  if (!data->tables)
+    return timers;
+  for (const auto& thisTimer : data->tables->timers)
+    timers.push_back(TimerFromTable(thisTimer, *data));
+  return timers;
+}
+
+bool PVRDemoData::SetTimerState(int iChannelId, time_t startTime, time_t endTime, PVR_TIMER_STATE state)
+{
+  return Update([&](PVRDemoDataSet& data) {
+    MaterialiseTimers(data);
+    auto it = std::find_if(data.timers->begin(), data.timers->end(), [&](const PVRDemoTimer& timer) {
+      return timer.iChannelId == iChannelId && timer.startTime == startTime && timer.endTime == endTime;
+    });
+    if (it == data.timers->end() || it->state == state)
+      return false;
+
+    std::shared_ptr<std::vector<PVRDemoTimer>> timers = std::make_shared<std::vector<PVRDemoTimer>>(*data.timers);
+    (*timers)[it - data.timers->begin()].state = state;
+    data.timers = std::move(timers);
+    return true;
+  });
+}
+
+bool PVRDemoData::AddRecording(const PVRDemoRecording& recording)
+{
+  return Update([&recording](PVRDemoDataSet& data) {
+    MaterialiseRecordings(data);
+    std::shared_ptr<std::vector<PVRDemoRecording>> recordings = std::make_shared<std::vector<PVRDemoRecording>>(*data.recordings);
+    recordings->push_back(recording);
+    data.recordings = std::move(recordings);
+
+    /* the snapshot stays current with the directory as it is now */
+    if (data.sources)
+    {
+      const std::string strDirectory = recording.strStreamURL.substr(0, recording.strStreamURL.find_last_of('/') + 1);
+      std::shared_ptr<std::vector<PVRDemoSourceFile>> sources = std::make_shared<std::vector<PVRDemoSourceFile>>(*data.sources);
+      for (auto& source : *sources)
+      {
+        if (source.strPath == strDirectory)
+          PVRDemoSnapshot::Stat(strDirectory, source);
+      }
+      data.sources = std::move(sources);
+    }
+    return true;
+  });
+}
+
 bool PVRDemoData::ScanXMLChannelData(const TiXmlNode* pChannelNode, int iUniqueChannelId, PVRDemoChannel& channel)
 {
   std::string strTmp;
@@ -409,11 +1485,11 @@ bool PVRDemoData::ScanXMLChannelData(const TiXmlNode* pChannelNode, int iUniqueC
   if (!XMLUtils::GetInt(pChannelNode, "encryption", channel.iEncryptionSystem))
     channel.iEncryptionSystem = 0;
 
-  /* icon path */
+  /* icon path, resolved with the other icons of the load */
   if (!XMLUtils::GetString(pChannelNode, "icon", strTmp))
-    channel.strIconPath = m_strDefaultIcon;
+    channel.strIconPath.clear();
   else
-    channel.strIconPath = g_strClientPath + strTmp;
+    channel.strIconPath = strTmp;
 
   /* stream url */
   if (!XMLUtils::GetString(pChannelNode, "stream", strTmp))
@@ -453,21 +1529,35 @@ bool PVRDemoData::ScanXMLChannelGroupData(const TiXmlNode* pGroupNode, int iUniq
   return true;
 }
 
-bool PVRDemoData::ScanXMLEpgData(const TiXmlNode* pEpgNode)
+bool PVRDemoData::ScanXMLEpgData(const TiXmlNode* pEpgNode, std::vector<PVRDemoChannel>& channels, PVRDemoTextStore& texts)
+{
+  PVRDemoEpgEntry entry;
+  int iChannel;
+  if (!ScanXMLEpgEntry(pEpgNode, texts, iChannel, entry))
+    return false;
+
+  PVRDemoChannel& channel = channels.at(iChannel - 1);
+  entry.iChannelId = channel.iUniqueId;
+
+  PVRDEMO_LOG(LOG_DEBUG, "loaded EPG entry '%s' channel '%d' start '%d' end '%d'", entry.strTitle.c_str(), entry.iChannelId, entry.startTime, entry.endTime);
+
+  channel.epg.push_back(entry);
+
+  return true;
+}
+
+bool PVRDemoData::ScanXMLEpgEntry(const TiXmlNode* pEpgNode, PVRDemoTextStore& texts, int& iChannel, PVRDemoEpgEntry& entry)
 {
   std::string strTmp;
   int iTmp;
-  PVRDemoEpgEntry entry;
 
   /* broadcast id */
   if (!XMLUtils::GetInt(pEpgNode, "broadcastid", entry.iBroadcastId))
     return false;
 
   /* channel id */
-  if (!XMLUtils::GetInt(pEpgNode, "channelid", iTmp))
+  if (!XMLUtils::GetInt(pEpgNode, "channelid", iChannel))
     return false;
-  PVRDemoChannel& channel = m_channels.at(iTmp - 1);
-  entry.iChannelId = channel.iUniqueId;
 
   /* title */
   if (!XMLUtils::GetString(pEpgNode, "title", strTmp))
@@ -486,11 +1576,11 @@ bool PVRDemoData::ScanXMLEpgData(const TiXmlNode* pEpgNode)
 
   /* plot */
   if (XMLUtils::GetString(pEpgNode, "plot", strTmp))
-    entry.strPlot = strTmp;
+    entry.strPlot = texts.Add(strTmp);
 
   /* plot outline */
   if (XMLUtils::GetString(pEpgNode, "plotoutline", strTmp))
-    entry.strPlotOutline = strTmp;
+    entry.strPlotOutline = texts.Add(strTmp);
 
   if (!XMLUtils::GetInt(pEpgNode, "series", entry.iSeriesNumber))
     entry.iSeriesNumber = EPG_TAG_INVALID_SERIES_EPISODE;
@@ -511,14 +1601,113 @@ bool PVRDemoData::ScanXMLEpgData(const TiXmlNode* pEpgNode)
   /* genre subtype */
   XMLUtils::GetInt(pEpgNode, "genresubtype", entry.iGenreSubType);
 
-  XBMC->Log(LOG_DEBUG, "loaded EPG entry '%s' channel '%d' start '%d' end '%d'", entry.strTitle.c_str(), entry.iChannelId, entry.startTime, entry.endTime);
+  return true;
+}
 
-  channel.epg.push_back(entry);
+std::shared_ptr<PVRDemoEpgShards> PVRDemoData::ScanXMLGuideShards(const TiXmlElement* pGuideElement, const std::string& strDirectory,
+                                                                  const std::vector<PVRDemoChannel>& channels, const PVRDemoTimeResolver& times)
+{
+  /* unique ids by the channel ids of the data file, which the shards use as its <epg> does */
+  std::vector<int> channelUids;
+  for (const auto& channel : channels)
+    channelUids.push_back(channel.iUniqueId);
+
+  std::shared_ptr<PVRDemoEpgShards> shards = std::make_shared<PVRDemoEpgShards>(
+    [channelUids](const PVRDemoEpgShards::Shard& shard, PVRDemoGuide& guide) {
+      return LoadEpgShard(shard.strFile, shard.iStart, channelUids, guide);
+    });
+
+  /* <shard day="+1d" channels="1-50">guide/1-a.xml</shard>, grouped by channel block */
+  std::map<std::string, std::vector<PVRDemoEpgShards::Shard>> blocks;
+  for (const TiXmlElement* pShard = pGuideElement->FirstChildElement("shard"); pShard != NULL; pShard = pShard->NextSiblingElement("shard"))
+  {
+    const char* strDay = pShard->Attribute("day");
+    const char* strChannels = pShard->Attribute("channels");
+    const char* strFile = pShard->GetText();
+    time_t iDay;
+    struct tm tm;
+    if (!strDay || !strChannels || !strFile || !times.Resolve(strDay, 0, iDay) || !PVRDemoTimeResolver::LocalTm(iDay, tm))
+    {
+      PVRDEMO_LOG(LOG_ERROR, "%s - ignoring a shard without a valid day, channels or file", __FUNCTION__);
+      continue;
+    }
+
+    const int64_t iCivilDay = PVRDemoTimeResolver::DaysFromCivil(tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday);
+    blocks[strChannels].push_back({ times.LocalTime(iCivilDay, 0), times.LocalTime(iCivilDay + 1, 0), DataPath(strDirectory, strFile) });
+  }
+
+  size_t iShards = 0;
+  for (auto& block : blocks)
+  {
+    int iFirst = 0;
+    int iLast = 0;
+    const int iFields = sscanf(block.first.c_str(), "%d-%d", &iFirst, &iLast);
+    if (iFields == 1)
+      iLast = iFirst;
+
+    std::vector<int> blockUids;
+    for (int iChannel = std::max(iFirst, 1); iFields >= 1 && iChannel <= std::min(iLast, (int)channelUids.size()); ++iChannel)
+      blockUids.push_back(channelUids[iChannel - 1]);
+
+    const size_t iBlockShards = block.second.size();
+    if (blockUids.empty() || !shards->AddBlock(blockUids, std::move(block.second)))
+    {
+      PVRDEMO_LOG(LOG_ERROR, "%s - ignoring the shards of channels '%s', which are unknown or in another block", __FUNCTION__,
+                  block.first.c_str());
+      continue;
+    }
+    iShards += iBlockShards;
+  }
 
+  PVRDEMO_LOG(LOG_INFO, "%s - guide of %zu shards in %zu channel blocks", __FUNCTION__, iShards, shards->Blocks());
+  return shards->Blocks() > 0 ? shards : nullptr;
+}
+
+bool PVRDemoData::LoadEpgShard(const std::string& strFile, time_t iShardStart, const std::vector<int>& channelUids, PVRDemoGuide& guide)
+{
+  TiXmlDocument xmlDoc;
+  if (!xmlDoc.LoadFile(strFile))
+    return false;
+
+  TiXmlElement *pRootElement = xmlDoc.RootElement();
+  if (strcmp(pRootElement->Value(), "guide") != 0)
+    return false;
+
+  /* shards come and go with the window, so their plots never go to a file of their own */
+  std::shared_ptr<PVRDemoTextStore> texts = PVRDemoTextStore::Create(
+    (PVRDemoTextStore::Mode)std::min(g_iColdText, (int)PVRDemoTextStore::MODE_MEMORY), g_strUserPath);
+
+  /* times are seconds from the shard's midnight, as those of <epg> are from the start of the cycle */
+  TiXmlNode *pEpgNode = NULL;
+  while ((pEpgNode = pRootElement->IterateChildren(pEpgNode)) != NULL)
+  {
+    PVRDemoEpgEntry entry;
+    int iChannel;
+    if (!ScanXMLEpgEntry(pEpgNode, *texts, iChannel, entry))
+      continue;
+    if (iChannel < 1 || iChannel > (int)channelUids.size())
+    {
+      PVRDEMO_LOG(LOG_ERROR, "%s - '%s' has an entry of unknown channel %d", __FUNCTION__, strFile.c_str(), iChannel);
+      continue;
+    }
+
+    entry.iChannelId   = channelUids[iChannel - 1];
+    entry.startTime   += iShardStart;
+    entry.endTime     += iShardStart;
+    entry.iBroadcastId = (int)BroadcastId(entry.iChannelId, entry.iBroadcastId, entry.startTime);
+    guide[entry.iChannelId].push_back(std::move(entry));
+  }
+  texts->Seal();
+
+  for (auto& channel : guide)
+  {
+    std::sort(channel.second.begin(), channel.second.end(),
+              [](const PVRDemoEpgEntry& a, const PVRDemoEpgEntry& b) { return a.startTime < b.startTime; });
+  }
   return true;
 }
 
-bool PVRDemoData::ScanXMLRecordingData(const TiXmlNode* pRecordingNode, int iUniqueGroupId, PVRDemoRecording& recording)
+bool PVRDemoData::ScanXMLRecordingData(const TiXmlNode* pRecordingNode, int iUniqueGroupId, const PVRDemoTimeResolver& times, PVRDemoTextStore& texts, PVRDemoRecording& recording)
 {
   std::string strTmp;
 
@@ -549,11 +1738,11 @@ bool PVRDemoData::ScanXMLRecordingData(const TiXmlNode* pRecordingNode, int iUni
 
   /* plot */
   if (XMLUtils::GetString(pRecordingNode, "plot", strTmp))
-    recording.strPlot = strTmp;
+    recording.strPlot = texts.Add(strTmp);
 
   /* plot outline */
   if (XMLUtils::GetString(pRecordingNode, "plotoutline", strTmp))
-    recording.strPlotOutline = strTmp;
+    recording.strPlotOutline = texts.Add(strTmp);
 
   /* Episode Name */
   if (XMLUtils::GetString(pRecordingNode, "episodetitle", strTmp))
@@ -576,38 +1765,133 @@ bool PVRDemoData::ScanXMLRecordingData(const TiXmlNode* pRecordingNode, int iUni
   /* duration */
   XMLUtils::GetInt(pRecordingNode, "duration", recording.iDuration);
 
-  /* recording time */
+  /* recording time, yesterday unless it says otherwise */
+  recording.recordingTime = 0;
   if (XMLUtils::GetString(pRecordingNode, "time", strTmp))
   {
-    time_t timeNow = time(nullptr);
-    struct tm* now = localtime(&timeNow);
+    times.Resolve(strTmp.c_str(), -1, recording.recordingTime);
+    recording.strRecordingTime = strTmp;
+  }
 
-    auto delim = strTmp.find(':');
-    if (delim != std::string::npos)
-    {
-      now->tm_hour = std::stoi(StringUtils::Left(strTmp, delim));
-      now->tm_min  = std::stoi(StringUtils::Mid(strTmp, (delim + 1)));
-      now->tm_mday--; // yesterday
+  return true;
+}
+
+std::string PVRDemoData::RecordingDirectory(void)
+{
+  std::string strDirectory = StringSetting(g_strRecordingDirectory);
+  if (strDirectory.empty())
+  {
+    if (g_strUserPath.empty())
+      return "";
+    strDirectory = g_strUserPath;
+    if (strDirectory[strDirectory.size() - 1] != '/' && strDirectory[strDirectory.size() - 1] != '\\')
+      strDirectory += '/';
+    return strDirectory + "recordings/";
+  }
+  if (strDirectory[strDirectory.size() - 1] != '/' && strDirectory[strDirectory.size() - 1] != '\\')
+    strDirectory += '/';
+  return strDirectory;
+}
+
+void PVRDemoData::ScanRecordedFiles(PVRDemoIOEngine& engine, const std::string& strDirectory, const PVRDemoTimeResolver& times,
+                                    PVRDemoTextStore& texts, std::vector<PVRDemoRecording>& recordings, std::vector<PVRDemoSourceFile>& sources)
+{
+  static const std::string strSuffix = SidecarFile("");
 
-      recording.recordingTime = mktime(now);
+  DIR* dir = strDirectory.empty() ? NULL : opendir(strDirectory.c_str());
+  if (!dir)
+    return;
+
+  std::vector<std::string> sidecars;
+  struct dirent* entry;
+  while ((entry = readdir(dir)) != NULL)
+  {
+    const std::string strName = entry->d_name;
+    if (strName.size() > strSuffix.size() && strName.compare(strName.size() - strSuffix.size(), strSuffix.size(), strSuffix) == 0)
+      sidecars.push_back(strDirectory + strName);
+  }
+  closedir(dir);
+  std::sort(sidecars.begin(), sidecars.end());
+
+  PVRDemoSourceFile source;
+  if (PVRDemoSnapshot::Stat(strDirectory, source))
+    sources.push_back(source);
+
+  /* every recording and its sidecar at once; a recording that was removed by hand leaves its sidecar behind */
+  std::vector<std::string> files(sidecars.size());
+  std::vector<PVRDemoIOEngine::Request> stats(sidecars.size() * 2);
+  for (size_t i = 0; i < sidecars.size(); ++i)
+  {
+    files[i] = sidecars[i].substr(0, sidecars[i].size() - strSuffix.size());
+    stats[2 * i].operation     = PVRDemoIOEngine::IO_STAT;
+    stats[2 * i].strPath       = files[i].c_str();
+    stats[2 * i + 1].operation = PVRDemoIOEngine::IO_STAT;
+    stats[2 * i + 1].strPath   = sidecars[i].c_str();
+  }
+  engine.Run(stats);
+
+  std::vector<size_t> found;
+  std::vector<PVRDemoIOEngine::Request> opens;
+  for (size_t i = 0; i < sidecars.size(); ++i)
+  {
+    if (stats[2 * i].iResult != 0 || stats[2 * i + 1].iResult != 0)
+      continue;
+    found.push_back(i);
+    opens.emplace_back();
+    opens.back().operation = PVRDemoIOEngine::IO_OPEN;
+    opens.back().strPath   = sidecars[i].c_str();
+  }
+  engine.Run(opens);
+
+  std::vector<std::string> contents(found.size());
+  std::vector<PVRDemoIOEngine::Request> reads(found.size()), closes;
+  for (size_t i = 0; i < found.size(); ++i)
+  {
+    if (opens[i].iResult < 0)
+      continue;
+    contents[i].resize((size_t)stats[2 * found[i] + 1].iFileSize);
+    reads[i].fd      = (int)opens[i].iResult;
+    reads[i].pBuffer = reinterpret_cast<uint8_t*>(&contents[i][0]);
+    reads[i].iSize   = contents[i].size();
+    closes.emplace_back();
+    closes.back().operation = PVRDemoIOEngine::IO_CLOSE;
+    closes.back().fd        = (int)opens[i].iResult;
+  }
+  engine.Run(reads);
+  engine.Run(closes);
+
+  const size_t iKnown = recordings.size();
+  for (size_t i = 0; i < found.size(); ++i)
+  {
+    const std::string& strFile = files[found[i]];
+    TiXmlDocument sidecar;
+    PVRDemoRecording recording;
+    if (opens[i].iResult >= 0 && reads[i].iResult == (int64_t)contents[i].size())
+      sidecar.Parse(contents[i].c_str());
+    if (sidecar.Error() || !sidecar.RootElement() || !ScanXMLRecordingData(sidecar.RootElement(), 0, times, texts, recording))
+    {
+      PVRDEMO_LOG(LOG_ERROR, "%s - cannot read '%s'", __FUNCTION__, sidecars[found[i]].c_str());
+      continue;
     }
+
+    /* named after its file, so the id stays the same from one load to the next */
+    recording.strRecordingId = strFile;
+    recording.strStreamURL   = strFile;
+    recordings.push_back(recording);
   }
 
-  return true;
+  PVRDEMO_LOG(LOG_DEBUG, "%s - %zu recordings in '%s'", __FUNCTION__, recordings.size() - iKnown, strDirectory.c_str());
 }
 
-bool PVRDemoData::ScanXMLTimerData(const TiXmlNode* pTimerNode, PVRDemoTimer& timer)
+bool PVRDemoData::ScanXMLTimerData(const TiXmlNode* pTimerNode, const std::vector<PVRDemoChannel>& channels, const PVRDemoTimeResolver& times, PVRDemoTimer& timer)
 {
   std::string strTmp;
   int iTmp;
 
-  time_t timeNow = time(nullptr);
-  struct tm* now = localtime(&timeNow);
-
   /* channel id */
   if (!XMLUtils::GetInt(pTimerNode, "channelid", iTmp))
     return false;
-  PVRDemoChannel &channel = m_channels.at(iTmp - 1);
+  const PVRDemoChannel &channel = channels.at(iTmp - 1);
   timer.iChannelId = channel.iUniqueId;
 
   /* state */
@@ -624,32 +1908,22 @@ bool PVRDemoData::ScanXMLTimerData(const TiXmlNode* pTimerNode, PVRDemoTimer& ti
     return false;
   timer.strSummary = strTmp;
 
-  /* start time */
+  /* start time, today unless it says otherwise */
+  timer.startTime = 0;
   if (XMLUtils::GetString(pTimerNode, "starttime", strTmp))
   {
-    auto delim = strTmp.find(':');
-    if (delim != std::string::npos)
-    {
-      now->tm_hour = std::stoi(StringUtils::Left(strTmp, delim));
-      now->tm_min  = std::stoi(StringUtils::Mid(strTmp, delim + 1));
-
-      timer.startTime = mktime(now);
-    }
+    times.Resolve(strTmp.c_str(), 0, timer.startTime);
+    timer.strStartTime = strTmp;
   }
 
   /* end time */
+  timer.endTime = 0;
   if (XMLUtils::GetString(pTimerNode, "endtime", strTmp))
   {
-    auto delim = strTmp.find(':');
-    if (delim != std::string::npos)
-    {
-      now->tm_hour = std::stoi(StringUtils::Left(strTmp, delim));
-      now->tm_min  = std::stoi(StringUtils::Mid(strTmp, delim + 1));
-
-      timer.endTime = mktime(now);
-    }
+    times.Resolve(strTmp.c_str(), 0, timer.endTime);
+    timer.strEndTime = strTmp;
   }
 
-  XBMC->Log(LOG_DEBUG, "loaded timer '%s' channel '%d' start '%d' end '%d'", timer.strTitle.c_str(), timer.iChannelId, timer.startTime, timer.endTime);
+  PVRDEMO_LOG(LOG_DEBUG, "loaded timer '%s' channel '%d' start '%d' end '%d'", timer.strTitle.c_str(), timer.iChannelId, timer.startTime, timer.endTime);
   return true;
 }
@@ -8,10 +8,24 @@
 
 #pragma once
 
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <unordered_map>
 #include <vector>
 #include "p8-platform/os.h"
+#include "p8-platform/threads/mutex.h"
 #include "client.h"
+#include "PVRDemoIOEngine.h"
+#include "PVRDemoPublished.h"
+#include "PVRDemoStaticData.h"
+#include "PVRDemoTextStore.h"
+#include "PVRDemoTime.h"
 
+class PVRDemoBackendClient;
+class PVRDemoBackendGuide;
+class PVRDemoEpgShards;
+class TiXmlElement;
 class TiXmlNode;
 
 struct PVRDemoEpgEntry
@@ -21,8 +35,8 @@ struct PVRDemoEpgEntry
   int         iChannelId;
   time_t      startTime;
   time_t      endTime;
-  std::string strPlotOutline;
-  std::string strPlot;
+  PVRDemoText strPlotOutline;
+  PVRDemoText strPlot;
   std::string strIconPath;
   int         iGenreType;
   int         iGenreSubType;
@@ -57,14 +71,15 @@ struct PVRDemoRecording
   int         iSeriesNumber;
   int         iEpisodeNumber;
   std::string strChannelName;
-  std::string strPlotOutline;
-  std::string strPlot;
+  PVRDemoText strPlotOutline;
+  PVRDemoText strPlot;
   std::string strRecordingId;
   std::string strStreamURL;
   std::string strTitle;
   std::string strEpisodeName;
   std::string strDirectory;
   time_t      recordingTime;
+  std::string strRecordingTime;  // the expression recordingTime was resolved from, if any
 };
 
 struct PVRDemoTimer
@@ -75,6 +90,8 @@ struct PVRDemoTimer
   PVR_TIMER_STATE state;
   std::string     strTitle;
   std::string     strSummary;
+  std::string     strStartTime;  // the expressions the times were resolved from, if any
+  std::string     strEndTime;
 };
 
 struct PVRDemoChannelGroup
@@ -86,12 +103,72 @@ struct PVRDemoChannelGroup
   std::vector<int> members;
 };
 
+/* absolute time EPG per channel unique id, sorted by start time */
+typedef std::unordered_map<int, std::vector<PVRDemoEpgEntry>> PVRDemoGuide;
+
+/* one day of a sharded guide, for the channels of one block */
+struct PVRDemoEpgShard
+{
+  time_t       iStart;
+  time_t       iEnd;
+  PVRDemoGuide guide;
+};
+
+typedef std::vector<std::shared_ptr<const PVRDemoEpgShard>> PVRDemoEpgShardList;
+
+/* a file a version of the data was read from, as it was when it was read */
+struct PVRDemoSourceFile
+{
+  std::string strPath;
+  int64_t     iSize;
+  int64_t     iModified;
+};
+
+/*!
+ * One immutable version of the demo data. Sections are shared between
+ * versions, so a writer only copies the section it changes.
+ *
+ * When the add-on is built with PVRDEMO_STATIC_DATA the sections start out
+ * null and are read from the generated tables instead; a writer turns the
+ * section it changes into a vector first. A null section without tables
+ * reads as empty.
+ */
+struct PVRDemoDataSet
+{
+  uint64_t                                                iVersion = 0;
+  const PVRDemoStaticDataSet*                             tables = nullptr;
+  std::shared_ptr<const PVRDemoTimeResolver>              times;  // resolved the time expressions, null if there were none
+  std::shared_ptr<const std::vector<PVRDemoChannel>>      channels;
+  std::shared_ptr<const std::vector<PVRDemoChannelGroup>> groups;
+  std::shared_ptr<const std::vector<PVRDemoRecording>>    recordings;
+  std::shared_ptr<const std::vector<PVRDemoRecording>>    recordingsDeleted;
+  std::shared_ptr<const std::vector<PVRDemoTimer>>        timers;
+  std::shared_ptr<const std::vector<unsigned int>>        scheduleIds; // of the channels' <epg> entries, all channels in order
+  std::shared_ptr<const PVRDemoGuide>                     guide; // imported XMLTV, may be null
+  std::shared_ptr<PVRDemoEpgShards>                       shards; // guide of a manifest, loads itself, may be null
+  std::shared_ptr<PVRDemoBackendClient>                   backend; // where the data came from, null for local data
+  std::shared_ptr<PVRDemoBackendGuide>                    backendGuide; // guide of the backend, fetches itself, may be null
+  std::shared_ptr<const std::vector<PVRDemoSourceFile>>   sources; // files of a data file that can be snapshotted, else null
+};
+
+/*!
+ * Readers pin the current version with a Reader, which neither locks nor
+ * touches a reference count, see PVRDemoPublished; Snapshot() also takes a
+ * reference, for keeping a version beyond the call. Writers build the next
+ * version from the current one and publish it. Old versions are freed once
+ * no reader pins them and their last reference is dropped.
+ */
 class PVRDemoData
 {
 public:
-  PVRDemoData(void);
+  /* starts from the snapshot in strSnapshotFile if it is still current, see PVRDemoSnapshot */
+  explicit PVRDemoData(const std::string& strSnapshotFile = "");
   virtual ~PVRDemoData(void);
 
+  typedef PVRDemoPublished<const PVRDemoDataSet>::Reader Reader;
+
+  std::shared_ptr<const PVRDemoDataSet> Snapshot(void) const { return m_dataset.Load(); }
+
   int GetChannelsAmount(void);
   PVR_ERROR GetChannels(ADDON_HANDLE handle, bool bRadio);
   bool GetChannel(const PVR_CHANNEL &channel, PVRDemoChannel &myChannel);
@@ -102,29 +179,152 @@ public:
 
   PVR_ERROR GetEPGForChannel(ADDON_HANDLE handle, int iChannelUid, time_t iStart, time_t iEnd);
 
+  /*!
+   * The tags GetEPGForChannel() would hand to Kodi from version data. They
+   * point into data and into shards, which must outlive them, and their
+   * plots stay valid while the calling thread holds a PVRDemoTextPin.
+   */
+  void GetEpgTags(const PVRDemoDataSet& data, int iChannelUid, time_t iStart, time_t iEnd,
+                  std::vector<EPG_TAG>& tags, PVRDemoEpgShardList& shards) const;
+
+  /*!
+   * The id of one airing: a hash of the channel, the entry of the data file
+   * and the start time, so it is the same in every run. Collisions are
+   * resolved with the next iAttempt. Never EPG_TAG_INVALID_UID. The demo
+   * schedule hashes the start of an entry within its cycle and keeps only
+   * the upper bits, the lower ones count the cycles.
+   */
+  static unsigned int BroadcastId(int iChannelUid, int iEntryId, time_t iStart, unsigned int iAttempt = 0);
+
   int GetRecordingsAmount(bool bDeleted);
   PVR_ERROR GetRecordings(ADDON_HANDLE handle, bool bDeleted);
   std::string GetRecordingURL(const PVR_RECORDING &recording);
+  PVR_ERROR DeleteRecording(const PVR_RECORDING &recording);
+  PVR_ERROR UndeleteRecording(const PVR_RECORDING &recording);
+  PVR_ERROR DeleteAllRecordingsFromTrash(void);
 
   int GetTimersAmount(void);
   PVR_ERROR GetTimers(ADDON_HANDLE handle);
 
+  /* the timers of the current version with their times resolved */
+  std::vector<PVRDemoTimer> GetTimerList(void);
+
+  /*!
+   * Set the state of the timer on iChannelId from startTime to endTime.
+   * False if there is no such timer or it has the state already.
+   */
+  bool SetTimerState(int iChannelId, time_t startTime, time_t endTime, PVR_TIMER_STATE state);
+
+  /*!
+   * Add a recording the add-on made. Its file and sidecar are in the
+   * recordings directory already, so the next load finds it there.
+   */
+  bool AddRecording(const PVRDemoRecording& recording);
+
+  /* the recordingdirectory setting, else recordings/ in the profile; empty if there is neither */
+  static std::string RecordingDirectory(void);
+
+  /* the file next to a recording that describes it like a <recording> of the data file */
+  static std::string SidecarFile(const std::string& strFile) { return strFile + ".xml"; }
+
+  /*!
+   * Re-read the data file, or fetch the data again from the backend, and
+   * publish it as a new version. The current version stays in place if
+   * the data cannot be loaded.
+   */
+  bool Reload(void);
+
+  /*!
+   * Resolve the time expressions of recordings and timers again if the
+   * local day changed since they were, as after a night in standby. A
+   * manifest's shards are laid out by day, so a sharded data file is read
+   * again instead. False if nothing changed.
+   */
+  bool RefreshTimes(void);
+
+  /* write the current version for a later start, false if it did not come from a plain data file */
+  bool SaveSnapshot(const std::string& strFile) const;
+
+  /*!
+   * Let go of what is read again on demand: loaded guide shards, fetched
+   * guide windows, idle backend connections and decompressed plots.
+   */
+  void DropCaches(void);
+
   std::string GetSettingsFile() const;
+
+  /* unique ids of all channels, for triggering their EPG updates */
+  std::vector<int> GetChannelUids(void);
+
+#ifdef PVRDEMO_BUILD_BENCHMARKS
+  /* defined by pvrdemo-bench, whose build alone declares it, to reach the loaders and scanners */
+  class BenchmarkAccess;
+#endif
+
 protected:
+  /*
+   * The backend when one is set, else the generated tables when built with
+   * PVRDEMO_STATIC_DATA, else the data file
+   */
+  bool Load(void);
   bool LoadDemoData(void);
+  bool LoadStaticData(const PVRDemoStaticDataSet& tables);
+  bool LoadBackendData(void);
+  bool LoadSnapshot(const std::string& strFile);
+
+  /*!
+   * Serialise writers, let mutate edit a copy of the current version and
+   * publish it if mutate returns true.
+   */
+  bool Update(const std::function<bool(PVRDemoDataSet&)>& mutate);
+
 private:
+  /*!
+   * The imported guide of the channel if it has one, else its shards of the
+   * manifest, else the demo schedule. Shards the tags point into are added
+   * to shards.
+   */
+  template<typename Emit>
+  static void ForEachEpgTag(const PVRDemoDataSet& data, int iChannelUid, time_t iStart, time_t iEnd,
+                            PVRDemoEpgShardList& shards, Emit emit);
+
+  /* the guide of a manifest's <guide> section, null if it has none */
+  std::shared_ptr<PVRDemoEpgShards> ScanXMLGuideShards(const TiXmlElement* pGuideElement, const std::string& strDirectory,
+                                                       const std::vector<PVRDemoChannel>& channels, const PVRDemoTimeResolver& times);
+
+  /* read one shard file; channel ids and times as in the manifest's data file */
+  static bool LoadEpgShard(const std::string& strFile, time_t iShardStart, const std::vector<int>& channelUids, PVRDemoGuide& guide);
+
+  /* copy the generated recordings into the data set before changing them */
+  static void MaterialiseRecordings(PVRDemoDataSet& data);
+
+  /* and the generated timers */
+  static void MaterialiseTimers(PVRDemoDataSet& data);
+
+  /*!
+   * The recordings the add-on made in strDirectory, one per sidecar whose
+   * recording is still there. The directory is added to sources, files
+   * coming or going change its modification time. The files are checked,
+   * opened, read and closed in four batches on engine, whatever their number.
+   */
+  void ScanRecordedFiles(PVRDemoIOEngine& engine, const std::string& strDirectory, const PVRDemoTimeResolver& times,
+                         PVRDemoTextStore& texts, std::vector<PVRDemoRecording>& recordings, std::vector<PVRDemoSourceFile>& sources);
+
+  /* the recordings and timers of data with their expressions resolved by times */
+  static void ResolveTimes(PVRDemoDataSet& data, const PVRDemoTimeResolver& times);
+
+  /* have the backend change a recording first, if the data came from one */
+  bool ForwardRecordingChange(uint16_t iOp, const std::string& strRecordingId);
+
   bool ScanXMLChannelData(const TiXmlNode* pChannelNode, int iUniqueChannelId, PVRDemoChannel& channel);
   bool ScanXMLChannelGroupData(const TiXmlNode* pGroupNode, int iUniqueGroupId, PVRDemoChannelGroup& group);
-  bool ScanXMLEpgData(const TiXmlNode* pEpgNode);
-  bool ScanXMLRecordingData(const TiXmlNode* pRecordingNode, int iUniqueGroupId, PVRDemoRecording& recording);
-  bool ScanXMLTimerData(const TiXmlNode* pTimerNode, PVRDemoTimer& timer);
-
-  std::vector<PVRDemoChannelGroup> m_groups;
-  std::vector<PVRDemoChannel>      m_channels;
-  std::vector<PVRDemoRecording>    m_recordings;
-  std::vector<PVRDemoRecording>    m_recordingsDeleted;
-  std::vector<PVRDemoTimer>        m_timers;
-  time_t                           m_iEpgStart;
-  std::string                      m_strDefaultIcon;
-  std::string                      m_strDefaultMovie;
+  bool ScanXMLEpgData(const TiXmlNode* pEpgNode, std::vector<PVRDemoChannel>& channels, PVRDemoTextStore& texts);
+  static bool ScanXMLEpgEntry(const TiXmlNode* pEpgNode, PVRDemoTextStore& texts, int& iChannel, PVRDemoEpgEntry& entry);
+  bool ScanXMLRecordingData(const TiXmlNode* pRecordingNode, int iUniqueGroupId, const PVRDemoTimeResolver& times, PVRDemoTextStore& texts, PVRDemoRecording& recording);
+  bool ScanXMLTimerData(const TiXmlNode* pTimerNode, const std::vector<PVRDemoChannel>& channels, const PVRDemoTimeResolver& times, PVRDemoTimer& timer);
+
+  PVRDemoPublished<const PVRDemoDataSet> m_dataset;
+  P8PLATFORM::CMutex                    m_writeMutex;
+  std::string                           m_strDefaultIcon;
+  std::string                           m_strDefaultMovie;
 };
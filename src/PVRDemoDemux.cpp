@@ -0,0 +1,499 @@
+/*
+ *  Copyright (C) 2011-2020 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2011 Pulse-Eight (http://www.pulse-eight.com/)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "PVRDemoDemux.h"
+
+#include <chrono>
+#include <utility>
+
+using namespace ADDON;
+
+namespace
+{
+const size_t INPUT_SIZE         = PVRDemoDemux::TS_PACKET_SIZE * 348; // ~64 KiB
+const size_t QUEUE_SIZE         = 256;
+const size_t VIDEO_PES_RESERVE  = 512 * 1024;
+const size_t OTHER_PES_RESERVE  = 64 * 1024;
+const int    PROBE_READS        = 64;
+const uint8_t TS_SYNC_BYTE      = 0x47;
+
+int64_t ParseTimestamp(const uint8_t* p)
+{
+  return ((int64_t)((p[0] >> 1) & 0x07) << 30) |
+         ((int64_t)p[1] << 22) |
+         ((int64_t)(p[2] >> 1) << 15) |
+         ((int64_t)p[3] << 7) |
+         ((int64_t)p[4] >> 1);
+}
+
+bool HasOptionalPesHeader(uint8_t iStreamId)
+{
+  return iStreamId != 0xBC && iStreamId != 0xBE && iStreamId != 0xBF &&
+         iStreamId != 0xF0 && iStreamId != 0xF1 && iStreamId != 0xF2 &&
+         iStreamId != 0xF8 && iStreamId != 0xFF;
+}
+}
+
+PVRDemoDemux::PVRDemoDemux(const InputReader& reader) :
+  m_reader(reader),
+  m_input(INPUT_SIZE),
+  m_iInputStart(0),
+  m_iInputEnd(0),
+  m_iPmtPid(-1),
+  m_iPmtVersion(-1),
+  m_iSectionPid(-1),
+  m_queue(QUEUE_SIZE),
+  m_iQueueHead(0),
+  m_iQueueCount(0),
+  m_bAborted(false),
+  m_iTsPackets(0),
+  m_iDemuxPackets(0),
+  m_iBufferGrowths(0),
+  m_iBytesIn(0),
+  m_iParseNs(0)
+{
+  m_section.reserve(4096);
+}
+
+PVRDemoDemux::~PVRDemoDemux(void)
+{
+  ClearQueue();
+
+  if (m_iTsPackets > 0)
+  {
+    double fSeconds = (double)m_iParseNs / 1e9;
+    PVRDEMO_LOG(LOG_DEBUG, "%s - demuxed %llu TS packets into %llu packets, %.1f ns per TS packet, %.1f Mbit/s, %llu buffer growths",
+                __FUNCTION__, (unsigned long long)m_iTsPackets, (unsigned long long)m_iDemuxPackets,
+                (double)m_iParseNs / m_iTsPackets, fSeconds > 0 ? (double)m_iBytesIn * 8 / 1e6 / fSeconds : 0.0,
+                (unsigned long long)m_iBufferGrowths);
+  }
+}
+
+bool PVRDemoDemux::FillInput(void)
+{
+  if (m_iInputStart > 0)
+  {
+    memmove(m_input.data(), m_input.data() + m_iInputStart, m_iInputEnd - m_iInputStart);
+    m_iInputEnd -= m_iInputStart;
+    m_iInputStart = 0;
+  }
+
+  int iRead = m_reader(m_input.data() + m_iInputEnd, (unsigned int)(m_input.size() - m_iInputEnd));
+  if (iRead <= 0)
+    return false;
+
+  m_iInputEnd += iRead;
+  m_iBytesIn += iRead;
+  return true;
+}
+
+DemuxPacket* PVRDemoDemux::Read(void)
+{
+  if (m_bAborted)
+    return NULL;
+
+  const auto start = std::chrono::steady_clock::now();
+  bool bInput = true;
+  while (m_iQueueCount == 0 && bInput)
+  {
+    ParseBuffered();
+    if (m_iQueueCount == 0)
+      bInput = FillInput();
+  }
+  m_iParseNs += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+  if (m_iQueueCount == 0)
+    return NULL;
+
+  DemuxPacket* pPacket = m_queue[m_iQueueHead];
+  m_iQueueHead = (m_iQueueHead + 1) % m_queue.size();
+  --m_iQueueCount;
+  return pPacket;
+}
+
+void PVRDemoDemux::ParseBuffered(void)
+{
+  /* a TS packet completes at most one PES plus a stream change */
+  while (m_iInputEnd - m_iInputStart >= (size_t)TS_PACKET_SIZE && m_iQueueCount + 2 <= m_queue.size())
+  {
+    const uint8_t* pPacket = m_input.data() + m_iInputStart;
+    if (pPacket[0] != TS_SYNC_BYTE)
+    {
+      ++m_iInputStart;
+      continue;
+    }
+
+    ParseTsPacket(pPacket);
+    m_iInputStart += TS_PACKET_SIZE;
+  }
+}
+
+void PVRDemoDemux::ParseTsPacket(const uint8_t* pPacket)
+{
+  ++m_iTsPackets;
+
+  if (pPacket[1] & 0x80) // transport error indicator
+    return;
+
+  const uint16_t iPid = ((pPacket[1] & 0x1F) << 8) | pPacket[2];
+  const bool bUnitStart = (pPacket[1] & 0x40) != 0;
+  const uint8_t iAdaptation = (pPacket[3] >> 4) & 0x03;
+
+  size_t iOffset = 4;
+  if (iAdaptation & 0x02)
+    iOffset += 1 + pPacket[4];
+  if (!(iAdaptation & 0x01) || iOffset >= (size_t)TS_PACKET_SIZE)
+    return;
+
+  const uint8_t* pPayload = pPacket + iOffset;
+  size_t iPayloadSize = TS_PACKET_SIZE - iOffset;
+
+  if (iPid == 0 || (int)iPid == m_iPmtPid)
+  {
+    if (bUnitStart)
+    {
+      const size_t iPointer = pPayload[0];
+      if (iPointer + 1 >= iPayloadSize)
+        return;
+      m_section.assign(pPayload + 1 + iPointer, pPayload + iPayloadSize);
+      m_iSectionPid = iPid;
+    }
+    else if (m_iSectionPid == (int)iPid)
+      m_section.insert(m_section.end(), pPayload, pPayload + iPayloadSize);
+    else
+      return;
+
+    if (m_section.size() < 3)
+      return;
+    const size_t iSectionSize = 3 + (((m_section[1] & 0x0F) << 8) | m_section[2]);
+    if (m_section.size() < iSectionSize)
+      return;
+
+    if (iPid == 0)
+      ParsePat(m_section.data(), iSectionSize);
+    else
+      ParsePmt(m_section.data(), iSectionSize);
+    m_section.clear();
+    m_iSectionPid = -1;
+    return;
+  }
+
+  Stream* stream = FindStream(iPid);
+  if (!stream)
+    return;
+
+  if (bUnitStart)
+  {
+    if (stream->bStarted && !stream->pes.empty())
+      EmitPes(*stream);
+    stream->pes.clear();
+    stream->iExpectedSize = 0;
+    stream->bStarted = true;
+  }
+  if (!stream->bStarted)
+    return;
+
+  if (stream->pes.size() + iPayloadSize > stream->pes.capacity())
+    ++m_iBufferGrowths;
+  stream->pes.insert(stream->pes.end(), pPayload, pPayload + iPayloadSize);
+
+  if (bUnitStart && stream->pes.size() >= 6)
+  {
+    const size_t iPesLength = (stream->pes[4] << 8) | stream->pes[5];
+    stream->iExpectedSize = iPesLength ? 6 + iPesLength : 0;
+  }
+
+  /* bounded PES (audio, subtitles) can go out as soon as it is complete */
+  if (stream->iExpectedSize && stream->pes.size() >= stream->iExpectedSize)
+  {
+    EmitPes(*stream);
+    stream->pes.clear();
+    stream->bStarted = false;
+  }
+}
+
+void PVRDemoDemux::ParsePat(const uint8_t* pData, size_t iSize)
+{
+  if (iSize < 12 || pData[0] != 0x00)
+    return;
+
+  for (size_t iPos = 8; iPos + 4 <= iSize - 4; iPos += 4)
+  {
+    const uint16_t iProgram = (pData[iPos] << 8) | pData[iPos + 1];
+    const uint16_t iPid = ((pData[iPos + 2] & 0x1F) << 8) | pData[iPos + 3];
+    if (iProgram != 0)
+    {
+      if (m_iPmtPid != iPid)
+      {
+        m_iPmtPid = iPid;
+        m_iPmtVersion = -1;
+      }
+      return;
+    }
+  }
+}
+
+void PVRDemoDemux::ParsePmt(const uint8_t* pData, size_t iSize)
+{
+  if (iSize < 16 || pData[0] != 0x02)
+    return;
+
+  const int iVersion = (pData[5] >> 1) & 0x1F;
+  if (iVersion == m_iPmtVersion)
+    return;
+
+  std::vector<Stream> streams;
+  const size_t iProgramInfo = ((pData[10] & 0x0F) << 8) | pData[11];
+  size_t iPos = 12 + iProgramInfo;
+  while (iPos + 5 <= iSize - 4)
+  {
+    const uint8_t iStreamType = pData[iPos];
+    const uint16_t iPid = ((pData[iPos + 1] & 0x1F) << 8) | pData[iPos + 2];
+    const size_t iInfoSize = ((pData[iPos + 3] & 0x0F) << 8) | pData[iPos + 4];
+    if (iPos + 5 + iInfoSize > iSize - 4)
+      break;
+
+    Stream stream;
+    stream.codec = CodecForStream(iStreamType, pData + iPos + 5, iInfoSize, stream.strLanguage);
+    iPos += 5 + iInfoSize;
+    if (stream.codec.codec_type == XBMC_CODEC_TYPE_UNKNOWN)
+      continue;
+
+    /* keep the reassembly buffers and clocks of streams that survive the PMT update */
+    Stream* existing = FindStream(iPid);
+    if (existing)
+    {
+      stream.pes.swap(existing->pes);
+      stream.iLastPts = existing->iLastPts;
+      stream.iPtsWrapOffset = existing->iPtsWrapOffset;
+    }
+    else
+    {
+      stream.pes.reserve(stream.codec.codec_type == XBMC_CODEC_TYPE_VIDEO ? VIDEO_PES_RESERVE : OTHER_PES_RESERVE);
+      stream.iLastPts = -1;
+      stream.iPtsWrapOffset = 0;
+    }
+
+    stream.iPid = iPid;
+    stream.iStreamType = iStreamType;
+    stream.pes.clear();
+    stream.iExpectedSize = 0;
+    stream.bStarted = false;
+    streams.push_back(std::move(stream));
+  }
+
+  m_streams.swap(streams);
+  m_iPmtVersion = iVersion;
+
+  PVRDEMO_LOG(LOG_DEBUG, "%s - PMT version %d on PID %d with %u streams", __FUNCTION__, iVersion, m_iPmtPid, (unsigned int)m_streams.size());
+
+  DemuxPacket* pPacket = PVR->AllocateDemuxPacket(0);
+  if (pPacket)
+  {
+    pPacket->iStreamId = DMX_SPECIALID_STREAMCHANGE;
+    Enqueue(pPacket);
+  }
+}
+
+xbmc_codec_t PVRDemoDemux::CodecForStream(uint8_t iStreamType, const uint8_t* pDescriptors, size_t iSize, char* strLanguage)
+{
+  const char* strCodec = NULL;
+  memset(strLanguage, 0, 4);
+
+  switch (iStreamType)
+  {
+    case 0x01:
+    case 0x02: strCodec = "mpeg2video"; break;
+    case 0x03:
+    case 0x04: strCodec = "mp2"; break;
+    case 0x0F: strCodec = "aac"; break;
+    case 0x11: strCodec = "aac_latm"; break;
+    case 0x1B: strCodec = "h264"; break;
+    case 0x24: strCodec = "hevc"; break;
+    case 0x81: strCodec = "ac3"; break;
+    case 0x87: strCodec = "eac3"; break;
+    default: break;
+  }
+
+  /* private data streams are identified by their descriptors */
+  for (size_t iPos = 0; iPos + 2 <= iSize; iPos += 2 + pDescriptors[iPos + 1])
+  {
+    const uint8_t iTag = pDescriptors[iPos];
+    const uint8_t iLength = pDescriptors[iPos + 1];
+    if (iPos + 2 + iLength > iSize)
+      break;
+
+    if (iTag == 0x0A && iLength >= 3)
+      memcpy(strLanguage, pDescriptors + iPos + 2, 3);
+    else if (iStreamType == 0x06 && iTag == 0x6A)
+      strCodec = "ac3";
+    else if (iStreamType == 0x06 && iTag == 0x7A)
+      strCodec = "eac3";
+    else if (iStreamType == 0x06 && iTag == 0x59)
+      strCodec = "dvbsub";
+    else if (iStreamType == 0x06 && iTag == 0x56)
+      strCodec = "teletext";
+  }
+
+  if (!strCodec)
+  {
+    xbmc_codec_t unknown = { XBMC_CODEC_TYPE_UNKNOWN, XBMC_INVALID_CODEC_ID };
+    return unknown;
+  }
+  return PVR->GetCodecByName(strCodec);
+}
+
+double PVRDemoDemux::ToDvdTime(Stream& stream, int64_t iPts90k)
+{
+  /* The 33 bit clock wraps roughly every 26.5 hours. Each stream unwraps
+   * its own timestamps, and a timestamp is taken as the one nearest the
+   * last of its stream: a DTS from just before the wrap that follows a PTS
+   * from just after it is not pushed a whole wrap ahead. */
+  const int64_t iWrap = (int64_t)1 << 33;
+  int64_t iPts = iPts90k + stream.iPtsWrapOffset;
+  if (stream.iLastPts >= 0 && iPts < stream.iLastPts - iWrap / 2)
+  {
+    stream.iPtsWrapOffset += iWrap;
+    iPts += iWrap;
+  }
+  else if (stream.iLastPts >= 0 && iPts > stream.iLastPts + iWrap / 2 && iPts >= iWrap)
+    iPts -= iWrap;
+  stream.iLastPts = iPts;
+  return (double)iPts * DVD_TIME_BASE / 90000.0;
+}
+
+void PVRDemoDemux::EmitPes(Stream& stream)
+{
+  const std::vector<uint8_t>& pes = stream.pes;
+  if (pes.size() < 9 || pes[0] != 0x00 || pes[1] != 0x00 || pes[2] != 0x01)
+    return;
+
+  size_t iHeaderSize = 6;
+  double fPts = DVD_NOPTS_VALUE;
+  double fDts = DVD_NOPTS_VALUE;
+  if (HasOptionalPesHeader(pes[3]))
+  {
+    const uint8_t iFlags = pes[7];
+    iHeaderSize = 9 + pes[8];
+    if ((iFlags & 0x80) && pes.size() >= 14)
+      fPts = fDts = ToDvdTime(stream, ParseTimestamp(&pes[9]));
+    if ((iFlags & 0xC0) == 0xC0 && pes.size() >= 19)
+      fDts = ToDvdTime(stream, ParseTimestamp(&pes[14]));
+  }
+
+  size_t iEnd = pes.size();
+  if (stream.iExpectedSize && stream.iExpectedSize < iEnd)
+    iEnd = stream.iExpectedSize;
+  if (iHeaderSize >= iEnd)
+    return;
+
+  const int iPayloadSize = (int)(iEnd - iHeaderSize);
+  DemuxPacket* pPacket = PVR->AllocateDemuxPacket(iPayloadSize);
+  if (!pPacket)
+    return;
+
+  memcpy(pPacket->pData, pes.data() + iHeaderSize, iPayloadSize);
+  pPacket->iSize     = iPayloadSize;
+  pPacket->iStreamId = stream.iPid;
+  pPacket->pts       = fPts;
+  pPacket->dts       = fDts;
+  Enqueue(pPacket);
+}
+
+void PVRDemoDemux::Enqueue(DemuxPacket* pPacket)
+{
+  if (m_iQueueCount == m_queue.size())
+  {
+    /* cannot happen with the headroom check in Read(); drop rather than grow */
+    PVR->FreeDemuxPacket(pPacket);
+    return;
+  }
+
+  m_queue[(m_iQueueHead + m_iQueueCount) % m_queue.size()] = pPacket;
+  ++m_iQueueCount;
+  ++m_iDemuxPackets;
+}
+
+PVRDemoDemux::Stream* PVRDemoDemux::FindStream(uint16_t iPid)
+{
+  for (auto& stream : m_streams)
+  {
+    if (stream.iPid == iPid)
+      return &stream;
+  }
+  return NULL;
+}
+
+void PVRDemoDemux::ClearQueue(void)
+{
+  while (m_iQueueCount > 0)
+  {
+    PVR->FreeDemuxPacket(m_queue[m_iQueueHead]);
+    m_iQueueHead = (m_iQueueHead + 1) % m_queue.size();
+    --m_iQueueCount;
+  }
+  m_iQueueHead = 0;
+}
+
+void PVRDemoDemux::Flush(void)
+{
+  ClearQueue();
+  for (auto& stream : m_streams)
+  {
+    stream.pes.clear();
+    stream.iExpectedSize = 0;
+    stream.bStarted = false;
+    stream.iLastPts = -1;
+  }
+  m_section.clear();
+  m_iSectionPid = -1;
+  m_iInputStart = m_iInputEnd = 0;
+}
+
+void PVRDemoDemux::Reset(void)
+{
+  Flush();
+  for (auto& stream : m_streams)
+    stream.iPtsWrapOffset = 0;
+  m_bAborted = false;
+}
+
+void PVRDemoDemux::Abort(void)
+{
+  m_bAborted = true;
+  Flush();
+}
+
+bool PVRDemoDemux::GetStreamProperties(PVR_STREAM_PROPERTIES* props)
+{
+  /* Kodi asks right after opening; read ahead until the PMT has been seen */
+  for (int iRead = 0; m_iPmtVersion < 0 && iRead < PROBE_READS && !m_bAborted; ++iRead)
+  {
+    ParseBuffered();
+    if (m_iPmtVersion < 0 && !FillInput())
+      break;
+  }
+
+  if (m_iPmtVersion < 0)
+    return false;
+
+  props->iStreamCount = 0;
+  for (const auto& stream : m_streams)
+  {
+    if (props->iStreamCount >= PVR_STREAM_MAX_STREAMS)
+      break;
+
+    auto& entry = props->stream[props->iStreamCount++];
+    memset(&entry, 0, sizeof(entry));
+    entry.iPID       = stream.iPid;
+    entry.iCodecType = stream.codec.codec_type;
+    entry.iCodecId   = stream.codec.codec_id;
+    memcpy(entry.strLanguage, stream.strLanguage, sizeof(entry.strLanguage));
+  }
+  return true;
+}
@@ -0,0 +1,89 @@
+/*
+ *  Copyright (C) 2011-2020 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2011 Pulse-Eight (http://www.pulse-eight.com/)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <functional>
+#include <vector>
+#include "client.h"
+
+/*!
+ * Minimal MPEG-TS demuxer used when the add-on does the demuxing itself.
+ *
+ * It follows the first program in the PAT, reassembles PES packets per PID
+ * and hands them to Kodi as DemuxPackets. Reassembly buffers are allocated
+ * once per stream and reused, and completed packets wait in a fixed-size
+ * queue, so steady-state demuxing does no heap allocation of its own.
+ */
+class PVRDemoDemux
+{
+public:
+  typedef std::function<int(unsigned char*, unsigned int)> InputReader;
+
+  static const int TS_PACKET_SIZE = 188;
+
+  explicit PVRDemoDemux(const InputReader& reader);
+  ~PVRDemoDemux(void);
+
+  DemuxPacket* Read(void);
+  void Flush(void);
+  void Reset(void);
+  void Abort(void);
+
+  bool GetStreamProperties(PVR_STREAM_PROPERTIES* props);
+
+private:
+  struct Stream
+  {
+    uint16_t             iPid;
+    uint8_t              iStreamType;
+    xbmc_codec_t         codec;
+    char                 strLanguage[4];
+    std::vector<uint8_t> pes;          // reassembly buffer, capacity is kept
+    size_t               iExpectedSize;
+    bool                 bStarted;
+    int64_t              iLastPts;      // unwrapped PTS or DTS, -1 until the first
+    int64_t              iPtsWrapOffset;
+  };
+
+  bool FillInput(void);
+  void ParseBuffered(void);
+  void ParseTsPacket(const uint8_t* pPacket);
+  void ParsePat(const uint8_t* pData, size_t iSize);
+  void ParsePmt(const uint8_t* pData, size_t iSize);
+  void EmitPes(Stream& stream);
+  void Enqueue(DemuxPacket* pPacket);
+  Stream* FindStream(uint16_t iPid);
+  void ClearQueue(void);
+  static xbmc_codec_t CodecForStream(uint8_t iStreamType, const uint8_t* pDescriptors, size_t iSize, char* strLanguage);
+  static double ToDvdTime(Stream& stream, int64_t iPts90k);
+
+  InputReader           m_reader;
+  std::vector<uint8_t>  m_input;
+  size_t                m_iInputStart;
+  size_t                m_iInputEnd;
+
+  int                   m_iPmtPid;
+  int                   m_iPmtVersion;
+  std::vector<Stream>   m_streams;
+  std::vector<uint8_t>  m_section;      // PSI section reassembly
+  int                   m_iSectionPid;
+
+  std::vector<DemuxPacket*> m_queue;    // fixed-capacity ring of ready packets
+  size_t                m_iQueueHead;
+  size_t                m_iQueueCount;
+
+  bool                  m_bAborted;
+
+  /* statistics, logged on destruction */
+  uint64_t              m_iTsPackets;
+  uint64_t              m_iDemuxPackets;
+  uint64_t              m_iBufferGrowths;
+  uint64_t              m_iBytesIn;
+  int64_t               m_iParseNs;
+};
@@ -0,0 +1,152 @@
+/*
+ *  Copyright (C) 2011-2020 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2011 Pulse-Eight (http://www.pulse-eight.com/)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "PVRDemoEpgShards.h"
+#include "PVRDemoLog.h"
+#include "PVRDemoStats.h"
+
+#include <algorithm>
+
+using namespace ADDON;
+using namespace P8PLATFORM;
+
+PVRDemoEpgShards::PVRDemoEpgShards(Loader loader) :
+  m_loader(std::move(loader))
+{
+}
+
+bool PVRDemoEpgShards::AddBlock(const std::vector<int>& channelUids, std::vector<Shard> shards)
+{
+  for (int iChannelUid : channelUids)
+  {
+    if (Covers(iChannelUid))
+      return false;
+  }
+
+  std::sort(shards.begin(), shards.end(), [](const Shard& a, const Shard& b) { return a.iStart < b.iStart; });
+
+  Block block;
+  block.channelUids = channelUids;
+  for (auto& shard : shards)
+    block.slots.push_back({ std::move(shard), nullptr });
+
+  for (int iChannelUid : channelUids)
+    m_blockOfChannel[iChannelUid] = m_blocks.size();
+  m_blocks.push_back(std::move(block));
+  return true;
+}
+
+void PVRDemoEpgShards::Fetch(int iChannelUid, time_t iStart, time_t iEnd, PVRDemoEpgShardList& shards)
+{
+  shards.clear();
+  auto it = m_blockOfChannel.find(iChannelUid);
+  if (it == m_blockOfChannel.end())
+    return;
+  Block& block = m_blocks[it->second];
+
+  CLockObject lock(m_mutex);
+  for (auto& slot : block.slots)
+  {
+    if (slot.shard.iEnd <= iStart || slot.shard.iStart >= iEnd)
+    {
+      if (slot.loaded)
+      {
+        PVRDEMO_LOG(LOG_DEBUG, "%s - evicting '%s'", __FUNCTION__, slot.shard.strFile.c_str());
+        slot.loaded.reset();
+      }
+      continue;
+    }
+
+    if (slot.loaded)
+    {
+      PVRDEMO_STATS_COUNT(PVRDEMO_COUNTER_CACHE_HITS, 1);
+      shards.push_back(slot.loaded);
+      continue;
+    }
+
+    /* read without the lock; if another request read the shard meanwhile, its copy wins */
+    PVRDEMO_STATS_COUNT(PVRDEMO_COUNTER_CACHE_MISSES, 1);
+    lock.Unlock();
+    std::shared_ptr<const PVRDemoEpgShard> loaded = LoadShard(block, slot.shard);
+    lock.Lock();
+    if (!slot.loaded)
+      slot.loaded = std::move(loaded);
+    shards.push_back(slot.loaded);
+  }
+}
+
+void PVRDemoEpgShards::Drop(void)
+{
+  CLockObject lock(m_mutex);
+  for (auto& block : m_blocks)
+  {
+    for (auto& slot : block.slots)
+      slot.loaded.reset();
+  }
+}
+
+std::shared_ptr<const PVRDemoEpgShard> PVRDemoEpgShards::LoadShard(const Block& block, const Shard& shard) const
+{
+  PVRDEMO_STATS_SCOPE();
+  std::shared_ptr<PVRDemoEpgShard> loaded = std::make_shared<PVRDemoEpgShard>();
+  loaded->iStart = shard.iStart;
+  loaded->iEnd = shard.iEnd;
+
+  if (!m_loader(shard, loaded->guide))
+  {
+    PVRDEMO_LOG(LOG_ERROR, "%s - cannot read EPG shard '%s'", __FUNCTION__, shard.strFile.c_str());
+    loaded->guide.clear();
+    return loaded;
+  }
+
+  size_t iEntries = 0;
+  for (auto it = loaded->guide.begin(); it != loaded->guide.end();)
+  {
+    if (std::find(block.channelUids.begin(), block.channelUids.end(), it->first) == block.channelUids.end())
+    {
+      PVRDEMO_LOG(LOG_ERROR, "%s - '%s' has entries of channel %d, which is not in its block", __FUNCTION__,
+                  shard.strFile.c_str(), it->first);
+      it = loaded->guide.erase(it);
+      continue;
+    }
+    iEntries += it->second.size();
+    ++it;
+  }
+
+  PVRDEMO_LOG(LOG_DEBUG, "%s - read %zu entries from '%s'", __FUNCTION__, iEntries, shard.strFile.c_str());
+  return loaded;
+}
+
+size_t PVRDemoEpgShards::LoadedShards(void) const
+{
+  CLockObject lock(m_mutex);
+  size_t iShards = 0;
+  for (const auto& block : m_blocks)
+  {
+    for (const auto& slot : block.slots)
+      iShards += slot.loaded ? 1 : 0;
+  }
+  return iShards;
+}
+
+size_t PVRDemoEpgShards::LoadedEntries(void) const
+{
+  CLockObject lock(m_mutex);
+  size_t iEntries = 0;
+  for (const auto& block : m_blocks)
+  {
+    for (const auto& slot : block.slots)
+    {
+      if (!slot.loaded)
+        continue;
+      for (const auto& channel : slot.loaded->guide)
+        iEntries += channel.second.size();
+    }
+  }
+  return iEntries;
+}
@@ -0,0 +1,83 @@
+/*
+ *  Copyright (C) 2011-2020 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2011 Pulse-Eight (http://www.pulse-eight.com/)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "p8-platform/threads/mutex.h"
+#include "PVRDemoData.h"
+
+/*!
+ * The guide of a sharded data set. The manifest lists one file per day and
+ * block of channels; a shard is read when a request first touches its day
+ * and dropped again once a request for its block no longer covers it, so
+ * what stays loaded follows the window Kodi asks for rather than the
+ * whole horizon of the guide.
+ *
+ * The shards are shared by every version of the data that was published
+ * from the same load. Fetched shards stay valid for as long as the caller
+ * holds them, evicted or not.
+ */
+class PVRDemoEpgShards
+{
+public:
+  /* a shard of the manifest */
+  struct Shard
+  {
+    time_t      iStart;  // midnight of its day
+    time_t      iEnd;    // midnight of the next day
+    std::string strFile;
+  };
+
+  /* reads the file of a shard into its guide; a shard that fails is kept empty */
+  typedef std::function<bool(const Shard& shard, PVRDemoGuide& guide)> Loader;
+
+  explicit PVRDemoEpgShards(Loader loader);
+
+  /* add a block of channels and its shards, false if a channel has a block already */
+  bool AddBlock(const std::vector<int>& channelUids, std::vector<Shard> shards);
+
+  bool Covers(int iChannelUid) const { return m_blockOfChannel.find(iChannelUid) != m_blockOfChannel.end(); }
+
+  /*!
+   * The shards of the channel's block that overlap iStart to iEnd, by start
+   * time, read where they are not loaded. The block's other shards are
+   * evicted.
+   */
+  void Fetch(int iChannelUid, time_t iStart, time_t iEnd, PVRDemoEpgShardList& shards);
+
+  /* evict every loaded shard; the next request reads what it needs again */
+  void Drop(void);
+
+  size_t Blocks(void) const { return m_blocks.size(); }
+  size_t LoadedShards(void) const;
+  size_t LoadedEntries(void) const;
+
+private:
+  struct Slot
+  {
+    Shard                                  shard;
+    std::shared_ptr<const PVRDemoEpgShard> loaded;
+  };
+
+  struct Block
+  {
+    std::vector<int>  channelUids;
+    std::vector<Slot> slots;  // by start time
+  };
+
+  std::shared_ptr<const PVRDemoEpgShard> LoadShard(const Block& block, const Shard& shard) const;
+
+  Loader                            m_loader;
+  std::vector<Block>                m_blocks;          // fixed once the data is published
+  std::unordered_map<int, size_t>   m_blockOfChannel;
+  mutable P8PLATFORM::CMutex        m_mutex;           // guards the slots' loaded shards
+};
@@ -0,0 +1,237 @@
+/*
+ *  Copyright (C) 2011-2020 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2011 Pulse-Eight (http://www.pulse-eight.com/)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "PVRDemoEpgTracker.h"
+#include "PVRDemoLog.h"
+
+#include <algorithm>
+#include <string.h>
+
+using namespace ADDON;
+using namespace P8PLATFORM;
+
+namespace
+{
+
+bool SameString(const char* strA, const char* strB)
+{
+  if (strA == strB)
+    return true;
+  if (!strA || !strB)
+    return false;
+  return strcmp(strA, strB) == 0;
+}
+
+/* everything of a tag Kodi shows or stores */
+bool SameTag(const EPG_TAG& a, const EPG_TAG& b)
+{
+  return a.iUniqueChannelId == b.iUniqueChannelId &&
+         a.startTime == b.startTime &&
+         a.endTime == b.endTime &&
+         a.iYear == b.iYear &&
+         a.iGenreType == b.iGenreType &&
+         a.iGenreSubType == b.iGenreSubType &&
+         a.iParentalRating == b.iParentalRating &&
+         a.iStarRating == b.iStarRating &&
+         a.iSeriesNumber == b.iSeriesNumber &&
+         a.iEpisodeNumber == b.iEpisodeNumber &&
+         a.iEpisodePartNumber == b.iEpisodePartNumber &&
+         a.iFlags == b.iFlags &&
+         SameString(a.strTitle, b.strTitle) &&
+         SameString(a.strPlotOutline, b.strPlotOutline) &&
+         SameString(a.strPlot, b.strPlot) &&
+         SameString(a.strOriginalTitle, b.strOriginalTitle) &&
+         SameString(a.strCast, b.strCast) &&
+         SameString(a.strDirector, b.strDirector) &&
+         SameString(a.strWriter, b.strWriter) &&
+         SameString(a.strIMDBNumber, b.strIMDBNumber) &&
+         SameString(a.strIconPath, b.strIconPath) &&
+         SameString(a.strGenreDescription, b.strGenreDescription) &&
+         SameString(a.strFirstAired, b.strFirstAired) &&
+         SameString(a.strEpisodeName, b.strEpisodeName) &&
+         SameString(a.strSeriesLink, b.strSeriesLink);
+}
+
+/* the tags ordered by broadcast id, false if an id occurs twice */
+bool SortById(const std::vector<EPG_TAG>& tags, std::vector<const EPG_TAG*>& sorted)
+{
+  sorted.clear();
+  sorted.reserve(tags.size());
+  for (const auto& tag : tags)
+    sorted.push_back(&tag);
+
+  auto byId = [](const EPG_TAG* a, const EPG_TAG* b) { return a->iUniqueBroadcastId < b->iUniqueBroadcastId; };
+  auto sameId = [](const EPG_TAG* a, const EPG_TAG* b) { return a->iUniqueBroadcastId == b->iUniqueBroadcastId; };
+  std::sort(sorted.begin(), sorted.end(), byId);
+  return std::adjacent_find(sorted.begin(), sorted.end(), sameId) == sorted.end();
+}
+
+}
+
+PVRDemoEpgTracker::PVRDemoEpgTracker(PVRDemoData& data) :
+  m_data(data),
+  m_changedEvent(true),
+  m_notified(data.Snapshot())
+{
+  CreateThread(false);
+}
+
+PVRDemoEpgTracker::~PVRDemoEpgTracker(void)
+{
+  StopThread(-1);
+  m_changedEvent.Signal();
+  StopThread();
+}
+
+void PVRDemoEpgTracker::Fetched(int iChannelUid, time_t iStart, time_t iEnd)
+{
+  const uint64_t iVersion = m_data.Snapshot()->iVersion;
+
+  CLockObject lock(m_mutex);
+  auto it = m_channels.find(iChannelUid);
+  if (it == m_channels.end())
+  {
+    m_channels[iChannelUid] = { iStart, iEnd, iVersion };
+    return;
+  }
+
+  /* Kodi keeps what it fetched before, so the window only grows */
+  Channel& channel = it->second;
+  channel.iStart   = std::min(channel.iStart, iStart);
+  channel.iEnd     = std::max(channel.iEnd, iEnd);
+  channel.iVersion = iVersion;
+}
+
+void PVRDemoEpgTracker::Changed(void)
+{
+  m_changedEvent.Signal();
+}
+
+uint64_t PVRDemoEpgTracker::Generation(int iChannelUid) const
+{
+  CLockObject lock(m_mutex);
+  auto it = m_generations.find(iChannelUid);
+  return it != m_generations.end() ? it->second : 0;
+}
+
+void PVRDemoEpgTracker::Flush(void)
+{
+  CLockObject flushLock(m_flushMutex);
+
+  std::shared_ptr<const PVRDemoDataSet> current = m_data.Snapshot();
+  std::shared_ptr<const PVRDemoDataSet> previous;
+  std::unordered_map<int, Channel> channels;
+  {
+    CLockObject lock(m_mutex);
+    previous = m_notified;
+    channels = m_channels;
+  }
+  if (previous->iVersion == current->iVersion)
+    return;
+
+  std::vector<EPG_TAG> before;
+  std::vector<EPG_TAG> after;
+  PVRDemoEpgShardList beforeShards;
+  PVRDemoEpgShardList afterShards;
+  std::vector<Change> changes;
+  std::vector<int> touched;
+  size_t iEvents = 0;
+  size_t iFullUpdates = 0;
+
+  for (int iChannelUid : m_data.GetChannelUids())
+  {
+    auto channel = channels.find(iChannelUid);
+    if (channel != channels.end() && channel->second.iVersion >= current->iVersion)
+      continue;  // fetched after the change
+
+    /* the tags' plots and shards stay where they are until their events went out */
+    PVRDemoTextPin pin;
+    bool bDiffed = false;
+    if (channel != channels.end())
+    {
+      m_data.GetEpgTags(*previous, iChannelUid, channel->second.iStart, channel->second.iEnd, before, beforeShards);
+      m_data.GetEpgTags(*current, iChannelUid, channel->second.iStart, channel->second.iEnd, after, afterShards);
+      bDiffed = Diff(before, after, MAX_EVENTS_PER_CHANNEL, changes);
+    }
+
+    if (!bDiffed)
+    {
+      PVR->TriggerEpgUpdate(iChannelUid);
+      touched.push_back(iChannelUid);
+      ++iFullUpdates;
+    }
+    else if (!changes.empty())
+    {
+      /* the tags point into previous and current, both held until the end of the batch */
+      for (const auto& change : changes)
+        PVR->EpgEventStateChange(const_cast<EPG_TAG*>(change.tag), change.state);
+      touched.push_back(iChannelUid);
+      iEvents += changes.size();
+    }
+  }
+
+  {
+    CLockObject lock(m_mutex);
+    m_notified = current;
+    for (int iChannelUid : touched)
+      ++m_generations[iChannelUid];
+  }
+
+  PVRDEMO_LOG(LOG_INFO, "%s - data version %llu: %zu EPG events, %zu channels updated in full",
+              __FUNCTION__, (unsigned long long)current->iVersion, iEvents, iFullUpdates);
+}
+
+bool PVRDemoEpgTracker::Diff(const std::vector<EPG_TAG>& before, const std::vector<EPG_TAG>& after,
+                             size_t iMaxChanges, std::vector<Change>& changes)
+{
+  changes.clear();
+
+  std::vector<const EPG_TAG*> oldTags;
+  std::vector<const EPG_TAG*> newTags;
+  if (!SortById(before, oldTags) || !SortById(after, newTags))
+    return false;
+
+  /* merge the two id orders */
+  size_t i = 0;
+  size_t j = 0;
+  while (i < oldTags.size() || j < newTags.size())
+  {
+    if (j == newTags.size() || (i < oldTags.size() && oldTags[i]->iUniqueBroadcastId < newTags[j]->iUniqueBroadcastId))
+      changes.push_back({ oldTags[i++], EPG_EVENT_DELETED });
+    else if (i == oldTags.size() || newTags[j]->iUniqueBroadcastId < oldTags[i]->iUniqueBroadcastId)
+      changes.push_back({ newTags[j++], EPG_EVENT_CREATED });
+    else
+    {
+      if (!SameTag(*oldTags[i], *newTags[j]))
+        changes.push_back({ newTags[j], EPG_EVENT_UPDATED });
+      ++i;
+      ++j;
+    }
+
+    if (changes.size() > iMaxChanges)
+      return false;
+  }
+
+  return true;
+}
+
+void* PVRDemoEpgTracker::Process(void)
+{
+  while (!IsStopped())
+  {
+    m_changedEvent.Wait();
+    if (IsStopped())
+      break;
+
+    /* let the changes that follow this one join its batch */
+    Sleep(COALESCE_MS);
+    if (!IsStopped())
+      Flush();
+  }
+  return NULL;
+}
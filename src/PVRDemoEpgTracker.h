@@ -0,0 +1,82 @@
+/*
+ *  Copyright (C) 2011-2020 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2011 Pulse-Eight (http://www.pulse-eight.com/)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "p8-platform/threads/mutex.h"
+#include "p8-platform/threads/threads.h"
+#include "PVRDemoData.h"
+
+/*!
+ * Tells Kodi what changed in the guide instead of making it fetch every
+ * channel again. The tracker remembers which part of each channel's guide
+ * Kodi has fetched and which version of the data it was last told about.
+ *
+ * Changes published within COALESCE_MS of each other are sent as one
+ * batch: per channel, the tags Kodi holds are diffed against the current
+ * version by broadcast id and every broadcast that was created, updated or
+ * deleted goes out once through EpgEventStateChange. A channel with more
+ * than MAX_EVENTS_PER_CHANNEL changes, or whose guide Kodi has not fetched
+ * yet, gets a TriggerEpgUpdate instead.
+ */
+class PVRDemoEpgTracker : public P8PLATFORM::CThread
+{
+public:
+  static const size_t MAX_EVENTS_PER_CHANNEL = 64;
+  static const int    COALESCE_MS = 500;
+
+  struct Change
+  {
+    const EPG_TAG*  tag;
+    EPG_EVENT_STATE state;
+  };
+
+  explicit PVRDemoEpgTracker(PVRDemoData& data);
+  ~PVRDemoEpgTracker(void) override;
+
+  /* Kodi is about to fetch the guide of a channel between iStart and iEnd */
+  void Fetched(int iChannelUid, time_t iStart, time_t iEnd);
+
+  /* a new version of the data was published */
+  void Changed(void);
+
+  /* send what changed since the last batch now */
+  void Flush(void);
+
+  /* counts the batches and full updates that touched the channel */
+  uint64_t Generation(int iChannelUid) const;
+
+  /*!
+   * Changes that turn before into after, false if there are more than
+   * iMaxChanges or a broadcast id is not unique on either side.
+   */
+  static bool Diff(const std::vector<EPG_TAG>& before, const std::vector<EPG_TAG>& after,
+                   size_t iMaxChanges, std::vector<Change>& changes);
+
+protected:
+  void* Process(void) override;
+
+private:
+  struct Channel
+  {
+    time_t   iStart;
+    time_t   iEnd;
+    uint64_t iVersion;  // data version current when Kodi last fetched
+  };
+
+  PVRDemoData&                          m_data;
+  mutable P8PLATFORM::CMutex            m_mutex;
+  P8PLATFORM::CMutex                    m_flushMutex;  // one batch at a time
+  P8PLATFORM::CEvent                    m_changedEvent;
+  std::unordered_map<int, Channel>      m_channels;
+  std::unordered_map<int, uint64_t>     m_generations;
+  std::shared_ptr<const PVRDemoDataSet> m_notified;    // the version Kodi was last told about
+};
@@ -0,0 +1,642 @@
+/*
+ *  Copyright (C) 2011-2020 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2011 Pulse-Eight (http://www.pulse-eight.com/)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "PVRDemoIOEngine.h"
+#include "PVRDemoStats.h"
+#include "client.h"
+
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#ifndef TARGET_WINDOWS
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+#ifdef PVRDEMO_HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+using namespace ADDON;
+using namespace P8PLATFORM;
+
+#ifdef PVRDEMO_HAVE_IO_URING
+namespace
+{
+
+static_assert(sizeof(struct statx) <= 256, "struct statx does not fit the request");
+
+int UringSetup(unsigned int iEntries, struct io_uring_params* params)
+{
+  return (int)syscall(__NR_io_uring_setup, iEntries, params);
+}
+
+int UringEnter(int fd, unsigned int iSubmit, unsigned int iWaitFor, unsigned int iFlags)
+{
+  return (int)syscall(__NR_io_uring_enter, fd, iSubmit, iWaitFor, iFlags, NULL, 0);
+}
+
+int UringRegister(int fd, unsigned int iOpcode, const void* arg, unsigned int iArgs)
+{
+  return (int)syscall(__NR_io_uring_register, fd, iOpcode, arg, iArgs);
+}
+
+/* the kernel moves the heads and tails of the rings behind our back */
+unsigned int LoadAcquire(const unsigned int* p)
+{
+  return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+void StoreRelease(unsigned int* p, unsigned int iValue)
+{
+  __atomic_store_n(p, iValue, __ATOMIC_RELEASE);
+}
+
+}
+
+struct PVRDemoIOEngine::Ring
+{
+  int                  fd = -1;
+  void*                pRings = MAP_FAILED;
+  size_t               iRingsSize = 0;
+  void*                pCompletionRing = MAP_FAILED;  // only where the kernel maps the two rings apart
+  size_t               iCompletionRingSize = 0;
+  struct io_uring_sqe* pEntries = (struct io_uring_sqe*)MAP_FAILED;
+  size_t               iEntriesSize = 0;
+
+  unsigned int*        pSubmitHead = nullptr;
+  unsigned int*        pSubmitTail = nullptr;
+  unsigned int         iSubmitMask = 0;
+  unsigned int         iSubmitEntries = 0;
+  unsigned int*        pCompleteHead = nullptr;
+  unsigned int*        pCompleteTail = nullptr;
+  unsigned int         iCompleteMask = 0;
+  struct io_uring_cqe* pCompletions = nullptr;
+
+  ~Ring(void)
+  {
+    if (pEntries != MAP_FAILED)
+      munmap(pEntries, iEntriesSize);
+    if (pCompletionRing != MAP_FAILED)
+      munmap(pCompletionRing, iCompletionRingSize);
+    if (pRings != MAP_FAILED)
+      munmap(pRings, iRingsSize);
+    if (fd >= 0)
+      close(fd);
+  }
+};
+#else
+struct PVRDemoIOEngine::Ring
+{
+};
+#endif
+
+PVRDemoIOEngine& PVRDemoIOEngine::Shared(void)
+{
+  static PVRDemoIOEngine engine;
+  return engine;
+}
+
+PVRDemoIOEngine::PVRDemoIOEngine(bool bUring) :
+  m_pBuffers(nullptr),
+  m_bRegistered(false),
+  m_iRequests(0),
+  m_iSyscalls(0)
+{
+  /* page aligned, as direct and fixed buffer reads want them */
+  if (posix_memalign(reinterpret_cast<void**>(&m_pBuffers), 4096, (size_t)BUFFER_COUNT * BUFFER_SIZE) != 0)
+    m_pBuffers = nullptr;
+  else
+  {
+    for (int i = BUFFER_COUNT - 1; i >= 0; --i)
+      m_freeBuffers.push_back(i);
+  }
+
+  if (bUring && SetupRing())
+  {
+    m_reaper.reset(new Reaper(*this));
+    m_reaper->CreateThread(false);
+  }
+  else
+    m_pool.reset(new PVRDemoIOPool(PVRDemoIOPool::DefaultThreadCount()));
+
+  PVRDEMO_LOG(LOG_DEBUG, "%s - %s, %u buffers of %u KiB%s", __FUNCTION__, IsUring() ? "io_uring" : "blocking calls on a thread pool",
+              m_pBuffers ? BUFFER_COUNT : 0, (unsigned int)(BUFFER_SIZE / 1024), m_bRegistered ? ", registered" : "");
+}
+
+PVRDemoIOEngine::~PVRDemoIOEngine(void)
+{
+#ifdef PVRDEMO_HAVE_IO_URING
+  if (m_reaper)
+  {
+    /* a no-op wakes the reaper up to see it should stop */
+    m_reaper->StopThread(-1);
+    Request wakeUp;
+    wakeUp.operation = IO_CLOSE;
+    Submit(wakeUp);
+    m_reaper->StopThread();
+    m_reaper.reset();
+  }
+  if (m_bRegistered)
+    UringRegister(m_ring->fd, IORING_UNREGISTER_BUFFERS, NULL, 0);
+#endif
+  m_ring.reset();
+  m_pool.reset();
+  free(m_pBuffers);
+}
+
+bool PVRDemoIOEngine::SetupRing(void)
+{
+#ifdef PVRDEMO_HAVE_IO_URING
+  std::unique_ptr<Ring> ring(new Ring);
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  ring->fd = UringSetup(QUEUE_DEPTH, &params);
+  if (ring->fd < 0)
+  {
+    PVRDEMO_LOG(LOG_INFO, "%s - no io_uring: %s", __FUNCTION__, strerror(errno));
+    return false;
+  }
+
+  /* completions beyond the ring are kept by the kernel from 5.5 on, so nothing ever bounds the requests in flight */
+  if (!(params.features & IORING_FEAT_NODROP))
+  {
+    PVRDEMO_LOG(LOG_INFO, "%s - io_uring of this kernel may drop completions", __FUNCTION__);
+    return false;
+  }
+
+  const size_t iSubmitSize = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+  const size_t iCompleteSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  const bool bSingleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  ring->iRingsSize = bSingleMap ? std::max(iSubmitSize, iCompleteSize) : iSubmitSize;
+  ring->pRings = mmap(NULL, ring->iRingsSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+  if (ring->pRings == MAP_FAILED)
+    return false;
+  uint8_t* pCompletionRing = static_cast<uint8_t*>(ring->pRings);
+  if (!bSingleMap)
+  {
+    ring->iCompletionRingSize = iCompleteSize;
+    ring->pCompletionRing = mmap(NULL, iCompleteSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+    if (ring->pCompletionRing == MAP_FAILED)
+      return false;
+    pCompletionRing = static_cast<uint8_t*>(ring->pCompletionRing);
+  }
+  ring->iEntriesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+  ring->pEntries = static_cast<struct io_uring_sqe*>(mmap(NULL, ring->iEntriesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                                          ring->fd, IORING_OFF_SQES));
+  if (ring->pEntries == MAP_FAILED)
+    return false;
+
+  uint8_t* pSubmitRing = static_cast<uint8_t*>(ring->pRings);
+  ring->pSubmitHead    = reinterpret_cast<unsigned int*>(pSubmitRing + params.sq_off.head);
+  ring->pSubmitTail    = reinterpret_cast<unsigned int*>(pSubmitRing + params.sq_off.tail);
+  ring->iSubmitMask    = *reinterpret_cast<unsigned int*>(pSubmitRing + params.sq_off.ring_mask);
+  ring->iSubmitEntries = params.sq_entries;
+  ring->pCompleteHead  = reinterpret_cast<unsigned int*>(pCompletionRing + params.cq_off.head);
+  ring->pCompleteTail  = reinterpret_cast<unsigned int*>(pCompletionRing + params.cq_off.tail);
+  ring->iCompleteMask  = *reinterpret_cast<unsigned int*>(pCompletionRing + params.cq_off.ring_mask);
+  ring->pCompletions   = reinterpret_cast<struct io_uring_cqe*>(pCompletionRing + params.cq_off.cqes);
+
+  /* entry i of the queue is always submission entry i */
+  unsigned int* pArray = reinterpret_cast<unsigned int*>(pSubmitRing + params.sq_off.array);
+  for (unsigned int i = 0; i < params.sq_entries; ++i)
+    pArray[i] = i;
+
+  /* the operations used came with 5.6, which is also the first kernel with probing */
+  std::vector<uint8_t> probeData(sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op));
+  struct io_uring_probe* probe = reinterpret_cast<struct io_uring_probe*>(probeData.data());
+  if (UringRegister(ring->fd, IORING_REGISTER_PROBE, probe, 256) < 0)
+  {
+    PVRDEMO_LOG(LOG_INFO, "%s - io_uring of this kernel is too old", __FUNCTION__);
+    return false;
+  }
+  for (int iOpcode : { IORING_OP_READ, IORING_OP_READ_FIXED, IORING_OP_OPENAT, IORING_OP_STATX, IORING_OP_CLOSE, IORING_OP_NOP })
+  {
+    if (iOpcode >= probe->ops_len || !(probe->ops[iOpcode].flags & IO_URING_OP_SUPPORTED))
+    {
+      PVRDEMO_LOG(LOG_INFO, "%s - io_uring of this kernel lacks operation %d", __FUNCTION__, iOpcode);
+      return false;
+    }
+  }
+
+  /* pinned memory counts against RLIMIT_MEMLOCK, plain reads do without */
+  if (m_pBuffers)
+  {
+    std::vector<struct iovec> buffers(BUFFER_COUNT);
+    for (unsigned int i = 0; i < BUFFER_COUNT; ++i)
+    {
+      buffers[i].iov_base = Buffer((int)i);
+      buffers[i].iov_len  = BUFFER_SIZE;
+    }
+    m_bRegistered = UringRegister(ring->fd, IORING_REGISTER_BUFFERS, buffers.data(), BUFFER_COUNT) == 0;
+    if (!m_bRegistered)
+      PVRDEMO_LOG(LOG_DEBUG, "%s - buffers not registered: %s", __FUNCTION__, strerror(errno));
+  }
+
+  m_ring = std::move(ring);
+  return true;
+#else
+  return false;
+#endif
+}
+
+void PVRDemoIOEngine::Submit(Request* const* requests, size_t iCount)
+{
+  for (size_t i = 0; i < iCount; ++i)
+  {
+    requests[i]->m_engine = this;
+    requests[i]->bDone    = false;
+    requests[i]->iResult  = 0;
+  }
+  m_iRequests += iCount;
+
+  if (m_ring)
+  {
+    SubmitToRing(requests, iCount);
+    return;
+  }
+  for (size_t i = 0; i < iCount; ++i)
+    m_pool->Submit(requests[i]);
+}
+
+void PVRDemoIOEngine::SubmitToRing(Request* const* requests, size_t iCount)
+{
+#ifdef PVRDEMO_HAVE_IO_URING
+  CLockObject lock(m_submitMutex);
+  Ring& ring = *m_ring;
+  unsigned int iTail = *ring.pSubmitTail;
+  unsigned int iPending = 0;
+  size_t iNext = 0;
+
+  while (iNext < iCount || iPending > 0)
+  {
+    /* fill what the queue has room for, then hand it all over with one call */
+    while (iNext < iCount && iTail - LoadAcquire(ring.pSubmitHead) < ring.iSubmitEntries)
+    {
+      Request& request = *requests[iNext++];
+      struct io_uring_sqe& entry = ring.pEntries[iTail & ring.iSubmitMask];
+      memset(&entry, 0, sizeof(entry));
+      entry.user_data = (uint64_t)(uintptr_t)&request;
+      switch (request.operation)
+      {
+        case IO_READ:
+          entry.opcode = m_bRegistered && request.iBuffer >= 0 ? IORING_OP_READ_FIXED : IORING_OP_READ;
+          entry.fd     = request.fd;
+          entry.addr   = (uint64_t)(uintptr_t)(request.iBuffer >= 0 ? Buffer(request.iBuffer) : request.pBuffer);
+          entry.len    = (uint32_t)request.iSize;
+          entry.off    = request.iOffset;
+          if (entry.opcode == IORING_OP_READ_FIXED)
+            entry.buf_index = (uint16_t)request.iBuffer;
+          break;
+        case IO_OPEN:
+          entry.opcode     = IORING_OP_OPENAT;
+          entry.fd         = AT_FDCWD;
+          entry.addr       = (uint64_t)(uintptr_t)request.strPath;
+          entry.open_flags = O_RDONLY | O_CLOEXEC;
+          break;
+        case IO_STAT:
+          entry.opcode = IORING_OP_STATX;
+          entry.fd     = AT_FDCWD;
+          entry.addr   = (uint64_t)(uintptr_t)request.strPath;
+          entry.len    = STATX_SIZE | STATX_MTIME;
+          entry.off    = (uint64_t)(uintptr_t)request.m_statx;
+          break;
+        case IO_CLOSE:
+          /* without a descriptor, a no-op that only wakes the reaper */
+          entry.opcode = request.fd >= 0 ? IORING_OP_CLOSE : IORING_OP_NOP;
+          entry.fd     = request.fd;
+          break;
+      }
+      ++iTail;
+      ++iPending;
+    }
+    StoreRelease(ring.pSubmitTail, iTail);
+
+    const int iSubmitted = UringEnter(ring.fd, iPending, 0, 0);
+    ++m_iSyscalls;
+    if (iSubmitted > 0)
+      iPending -= (unsigned int)std::min<int>(iSubmitted, (int)iPending);
+    else if (iSubmitted < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+    {
+      const int iError = errno;
+      PVRDEMO_LOG(LOG_ERROR, "%s - io_uring_enter failed: %s", __FUNCTION__, strerror(iError));
+
+      /*
+       * The kernel only takes entries inside io_uring_enter(), so those it
+       * did not take are withdrawn, and they and the rest of the batch fail
+       * rather than leave their owners waiting.
+       */
+      iTail -= iPending;
+      StoreRelease(ring.pSubmitTail, iTail);
+      CLockObject completionLock(m_mutex);
+      for (size_t i = iNext - iPending; i < iCount; ++i)
+      {
+        requests[i]->iResult = -iError;
+        requests[i]->bDone = true;
+      }
+      m_completed.Broadcast();
+      break;
+    }
+    else if (iSubmitted < 0 && errno != EINTR)
+      usleep(100);  // the kernel is short of memory for the requests or of room for completions
+  }
+#else
+  (void)requests;
+  (void)iCount;
+#endif
+}
+
+void* PVRDemoIOEngine::Reaper::Process(void)
+{
+#ifdef PVRDEMO_HAVE_IO_URING
+  while (!IsStopped())
+  {
+    if (UringEnter(m_engine.m_ring->fd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+    {
+      PVRDEMO_LOG(LOG_ERROR, "%s - io_uring_enter failed: %s", __FUNCTION__, strerror(errno));
+      break;
+    }
+    ++m_engine.m_iSyscalls;
+    m_engine.Reap();
+  }
+#endif
+  return NULL;
+}
+
+void PVRDemoIOEngine::Reap(void)
+{
+#ifdef PVRDEMO_HAVE_IO_URING
+  Ring& ring = *m_ring;
+  CLockObject lock(m_mutex);
+  unsigned int iHead = *ring.pCompleteHead;
+  const unsigned int iTail = LoadAcquire(ring.pCompleteTail);
+  if (iHead == iTail)
+    return;
+
+  for (; iHead != iTail; ++iHead)
+  {
+    const struct io_uring_cqe& completion = ring.pCompletions[iHead & ring.iCompleteMask];
+    Request* request = reinterpret_cast<Request*>((uintptr_t)completion.user_data);
+    request->iResult = completion.res;
+    if (request->operation == IO_STAT && completion.res == 0)
+    {
+      const struct statx* info = reinterpret_cast<const struct statx*>(request->m_statx);
+      request->iFileSize = info->stx_size;
+      request->iModified = info->stx_mtime.tv_sec;
+    }
+    request->bDone = true;
+  }
+  StoreRelease(ring.pCompleteHead, iHead);
+  m_completed.Broadcast();
+#endif
+}
+
+PVRDemoIOTask::StepResult PVRDemoIOEngine::Request::RunStep(void)
+{
+  m_engine->RunBlocking(*this);
+  m_engine->Complete(*this);
+  return STEP_DONE;
+}
+
+void PVRDemoIOEngine::RunBlocking(Request& request)
+{
+  ++m_iSyscalls;
+#ifdef TARGET_WINDOWS
+  request.iResult = -ENOSYS;
+#else
+  switch (request.operation)
+  {
+    case IO_READ:
+    {
+      ssize_t iRead;
+      do
+      {
+        iRead = pread(request.fd, request.iBuffer >= 0 ? Buffer(request.iBuffer) : request.pBuffer, request.iSize, (off_t)request.iOffset);
+      } while (iRead < 0 && errno == EINTR);
+      request.iResult = iRead < 0 ? -errno : iRead;
+      break;
+    }
+    case IO_OPEN:
+    {
+      const int fd = open(request.strPath, O_RDONLY | O_CLOEXEC);
+      request.iResult = fd < 0 ? -errno : fd;
+      break;
+    }
+    case IO_STAT:
+    {
+      struct stat info;
+      request.iResult = stat(request.strPath, &info) != 0 ? -errno : 0;
+      if (request.iResult == 0)
+      {
+        request.iFileSize = (uint64_t)info.st_size;
+        request.iModified = (int64_t)info.st_mtime;
+      }
+      break;
+    }
+    case IO_CLOSE:
+      request.iResult = request.fd >= 0 && close(request.fd) != 0 ? -errno : 0;
+      break;
+  }
+#endif
+}
+
+void PVRDemoIOEngine::Complete(Request& request)
+{
+  CLockObject lock(m_mutex);
+  request.bDone = true;
+  m_completed.Broadcast();
+}
+
+void PVRDemoIOEngine::Wait(Request& request)
+{
+  CLockObject lock(m_mutex);
+  m_completed.Wait(m_mutex, request.bDone);
+}
+
+void PVRDemoIOEngine::Run(std::vector<Request>& requests)
+{
+  std::vector<Request*> batch(requests.size());
+  for (size_t i = 0; i < requests.size(); ++i)
+    batch[i] = &requests[i];
+  Submit(batch.data(), batch.size());
+  for (auto& request : requests)
+    Wait(request);
+}
+
+int PVRDemoIOEngine::AcquireBuffer(void)
+{
+  CLockObject lock(m_mutex);
+  if (m_freeBuffers.empty())
+    return -1;
+  const int iBuffer = m_freeBuffers.back();
+  m_freeBuffers.pop_back();
+  return iBuffer;
+}
+
+void PVRDemoIOEngine::ReleaseBuffer(int iBuffer)
+{
+  if (iBuffer < 0)
+    return;
+  CLockObject lock(m_mutex);
+  m_freeBuffers.push_back(iBuffer);
+}
+
+PVRDemoIOEngine::Statistics PVRDemoIOEngine::GetStatistics(void) const
+{
+  return { m_iRequests.load(), m_iSyscalls.load() };
+}
+
+PVRDemoReadahead::PVRDemoReadahead(PVRDemoIOEngine& engine, int fd) :
+  m_engine(engine),
+  m_fd(fd),
+  m_iFirst(0),
+  m_iIdle(0),
+  m_iNextOffset(0),
+  m_bStarted(false)
+{
+  m_windows.reserve(DEPTH);
+  for (unsigned int i = 0; i < DEPTH; ++i)
+  {
+    const int iBuffer = m_engine.AcquireBuffer();
+    if (iBuffer < 0)
+      break;
+    m_windows.emplace_back();
+    m_windows.back().iBuffer = iBuffer;
+  }
+}
+
+PVRDemoReadahead::~PVRDemoReadahead(void)
+{
+  Drain();
+  for (auto& window : m_windows)
+    m_engine.ReleaseBuffer(window.iBuffer);
+}
+
+void PVRDemoReadahead::Issue(PVRDemoIOEngine::Request& window, uint64_t iOffset)
+{
+  window.operation = PVRDemoIOEngine::IO_READ;
+  window.fd        = m_fd;
+  window.iSize     = PVRDemoIOEngine::BUFFER_SIZE;
+  window.iOffset   = iOffset;
+}
+
+void PVRDemoReadahead::Start(uint64_t iOffset)
+{
+  Drain();
+  std::vector<PVRDemoIOEngine::Request*> batch;
+  for (auto& window : m_windows)
+  {
+    Issue(window, iOffset);
+    iOffset += PVRDemoIOEngine::BUFFER_SIZE;
+    batch.push_back(&window);
+  }
+  m_engine.Submit(batch.data(), batch.size());
+  m_iFirst      = 0;
+  m_iIdle       = 0;
+  m_iNextOffset = iOffset;
+  m_bStarted    = true;
+}
+
+void PVRDemoReadahead::Flush(void)
+{
+  const unsigned int iWindows = (unsigned int)m_windows.size();
+  PVRDemoIOEngine::Request* batch[DEPTH];
+  for (unsigned int i = 0; i < m_iIdle; ++i)
+    batch[i] = &m_windows[(m_iFirst + iWindows - m_iIdle + i) % iWindows];
+  m_engine.Submit(batch, m_iIdle);
+  m_iIdle = 0;
+}
+
+void PVRDemoReadahead::Drain(void)
+{
+  if (!m_bStarted)
+    return;
+  for (auto& window : m_windows)
+    m_engine.Wait(window);
+  m_bStarted = false;
+}
+
+int64_t PVRDemoReadahead::Read(uint8_t* pBuffer, size_t iSize, uint64_t iOffset)
+{
+  /* no buffer left to read ahead with, read just what was asked for */
+  if (m_windows.empty())
+  {
+    std::vector<PVRDemoIOEngine::Request> read(1);
+    read[0].fd      = m_fd;
+    read[0].pBuffer = pBuffer;
+    read[0].iSize   = iSize;
+    read[0].iOffset = iOffset;
+    m_engine.Run(read);
+    return read[0].iResult;
+  }
+
+  const unsigned int iWindows = (unsigned int)m_windows.size();
+  const uint64_t iWindowStart = m_windows[m_iFirst].iOffset;
+  if (!m_bStarted || iOffset < iWindowStart || iOffset >= iWindowStart + PVRDemoIOEngine::BUFFER_SIZE)
+    Start(iOffset);
+
+  size_t iCopied = 0;
+  bool bEnd = false;
+  while (iCopied < iSize && !bEnd)
+  {
+    /* the reader caught up with the windows it freed */
+    if (m_iIdle == iWindows)
+      Flush();
+
+    PVRDemoIOEngine::Request& window = m_windows[m_iFirst];
+    if (window.bDone)
+      PVRDEMO_STATS_COUNT(PVRDEMO_COUNTER_CACHE_HITS, 1);
+    else
+    {
+      PVRDEMO_STATS_COUNT(PVRDEMO_COUNTER_CACHE_MISSES, 1);
+      m_engine.Wait(window);
+    }
+
+    if (window.iResult < 0)
+    {
+      const int64_t iError = window.iResult;
+      Drain();
+      if (iCopied > 0)
+        break;
+      return iError;
+    }
+
+    const uint64_t iEnd = window.iOffset + (uint64_t)window.iResult;
+    if (iOffset < iEnd)
+    {
+      const size_t iCopy = (size_t)std::min<uint64_t>(iSize - iCopied, iEnd - iOffset);
+      memcpy(pBuffer + iCopied, m_engine.Buffer(window.iBuffer) + (iOffset - window.iOffset), iCopy);
+      iCopied += iCopy;
+      iOffset += iCopy;
+    }
+    if (iOffset < iEnd)
+      break;
+
+    /* a short window is where the file ends for now */
+    if ((size_t)window.iResult < PVRDemoIOEngine::BUFFER_SIZE)
+    {
+      bEnd = true;
+      break;
+    }
+    Issue(window, m_iNextOffset);
+    m_iNextOffset += PVRDemoIOEngine::BUFFER_SIZE;
+    m_iFirst = (m_iFirst + 1) % iWindows;
+    ++m_iIdle;
+  }
+
+  /* the windows past the end are only waited for, the next read starts them over */
+  if (bEnd)
+    Drain();
+  else if (m_iIdle >= (iWindows + 1) / 2)
+    Flush();
+  return (int64_t)iCopied;
+}
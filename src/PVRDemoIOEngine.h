@@ -0,0 +1,170 @@
+/*
+ *  Copyright (C) 2011-2020 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2011 Pulse-Eight (http://www.pulse-eight.com/)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "p8-platform/threads/mutex.h"
+#include "p8-platform/threads/threads.h"
+#include "PVRDemoIOPool.h"
+
+/*!
+ * Asynchronous file I/O shared by the whole add-on: the reads of recordings
+ * being played and the scans of the recordings directory.
+ *
+ * Requests are queued with Submit() and complete in any order; the owner
+ * keeps a request where it is until Wait() returns for it. On Linux 5.6 and
+ * later the engine runs on one io_uring: a batch of requests is handed to
+ * the kernel with a single system call, and one thread reaps the
+ * completions for everybody. The engine's buffers are registered with the
+ * ring where the memory lock limit allows, so reads into them skip mapping
+ * the pages on every request. Elsewhere requests run as blocking calls on a
+ * PVRDemoIOPool of its own.
+ */
+class PVRDemoIOEngine
+{
+public:
+  static const unsigned int QUEUE_DEPTH  = 128;
+  static const unsigned int BUFFER_COUNT = 64;          // enough for every session to read ahead
+  static const size_t       BUFFER_SIZE  = 128 * 1024;
+
+  enum Operation
+  {
+    IO_READ,   // iSize bytes at iOffset of fd into pBuffer, or into engine buffer iBuffer
+    IO_OPEN,   // strPath for reading, the descriptor is the result
+    IO_STAT,   // strPath, into iFileSize and iModified
+    IO_CLOSE   // fd
+  };
+
+  class Request : private PVRDemoIOTask
+  {
+  public:
+    Operation     operation = IO_READ;
+    int           fd        = -1;
+    const char*   strPath   = nullptr;  // must stay valid until the request completed
+    uint8_t*      pBuffer   = nullptr;
+    int           iBuffer   = -1;
+    size_t        iSize     = 0;
+    uint64_t      iOffset   = 0;
+
+    /* valid once done */
+    int64_t       iResult   = 0;        // bytes read or the descriptor opened, -errno on failure
+    uint64_t      iFileSize = 0;
+    int64_t       iModified = 0;
+    volatile bool bDone     = false;
+
+  private:
+    friend class PVRDemoIOEngine;
+    StepResult RunStep(void) override;
+
+    PVRDemoIOEngine*   m_engine = nullptr;
+    alignas(8) uint8_t m_statx[256];  // the kernel's struct statx while an IO_STAT is in flight
+  };
+
+  struct Statistics
+  {
+    uint64_t iRequests;
+    uint64_t iSyscalls;  // io_uring_enter() calls, or the blocking calls made instead
+  };
+
+  /* the engine everything in the add-on shares, created on first use */
+  static PVRDemoIOEngine& Shared(void);
+
+  /* bUring false runs every request on the thread pool, as on kernels without io_uring */
+  explicit PVRDemoIOEngine(bool bUring = true);
+  ~PVRDemoIOEngine(void);
+
+  void Submit(Request* const* requests, size_t iCount);
+  void Submit(Request& request) { Request* pRequest = &request; Submit(&pRequest, 1); }
+  void Wait(Request& request);
+
+  /* submit the lot as one batch and wait for all of it */
+  void Run(std::vector<Request>& requests);
+
+  /* one of the engine's buffers of BUFFER_SIZE, -1 if all are taken */
+  int AcquireBuffer(void);
+  void ReleaseBuffer(int iBuffer);
+  uint8_t* Buffer(int iBuffer) const { return m_pBuffers + (size_t)iBuffer * BUFFER_SIZE; }
+
+  bool IsUring(void) const { return m_ring != nullptr; }
+  bool HasRegisteredBuffers(void) const { return m_bRegistered; }
+  Statistics GetStatistics(void) const;
+
+private:
+  struct Ring;
+
+  class Reaper : public P8PLATFORM::CThread
+  {
+  public:
+    explicit Reaper(PVRDemoIOEngine& engine) : m_engine(engine) {}
+
+  protected:
+    void* Process(void) override;
+
+  private:
+    PVRDemoIOEngine& m_engine;
+  };
+
+  bool SetupRing(void);
+  void SubmitToRing(Request* const* requests, size_t iCount);
+  void Reap(void);
+  void RunBlocking(Request& request);
+  void Complete(Request& request);
+
+  std::unique_ptr<Ring>                    m_ring;
+  std::unique_ptr<Reaper>                  m_reaper;
+  std::unique_ptr<PVRDemoIOPool>           m_pool;          // without a ring
+  P8PLATFORM::CMutex                       m_submitMutex;   // guards the submission queue
+  P8PLATFORM::CMutex                       m_mutex;         // guards completions and the free buffers
+  P8PLATFORM::CCondition<volatile bool>    m_completed;
+  uint8_t*                                 m_pBuffers;
+  bool                                     m_bRegistered;
+  std::vector<int>                         m_freeBuffers;
+  std::atomic<uint64_t>                    m_iRequests;
+  std::atomic<uint64_t>                    m_iSyscalls;
+};
+
+/*!
+ * Sequential reader of one file that keeps up to DEPTH windows of
+ * BUFFER_SIZE in flight ahead of the reader. Once the reader is done with
+ * half of them, those are read again for the next stretches of the file,
+ * together in one submission. A read that is not where the windows are, a
+ * seek, starts them over there.
+ *
+ * A short window is the end of the file for now; the windows start over
+ * on the next read, so a file that is still growing is followed.
+ */
+class PVRDemoReadahead
+{
+public:
+  static const unsigned int DEPTH = 4;
+
+  PVRDemoReadahead(PVRDemoIOEngine& engine, int fd);
+  ~PVRDemoReadahead(void);
+
+  /* like pread() */
+  int64_t Read(uint8_t* pBuffer, size_t iSize, uint64_t iOffset);
+
+private:
+  void Start(uint64_t iOffset);
+  void Flush(void);
+  void Drain(void);
+  void Issue(PVRDemoIOEngine::Request& request, uint64_t iOffset);
+
+  PVRDemoIOEngine&                      m_engine;
+  const int                             m_fd;
+  std::vector<PVRDemoIOEngine::Request> m_windows;     // in file order from m_iFirst on, each on a buffer of its own
+  unsigned int                          m_iFirst;
+  unsigned int                          m_iIdle;       // windows before m_iFirst the reader is done with, not read again yet
+  uint64_t                              m_iNextOffset; // of the window to read after the last one
+  bool                                  m_bStarted;
+};
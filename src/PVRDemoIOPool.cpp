@@ -0,0 +1,166 @@
+/*
+ *  Copyright (C) 2011-2020 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2011 Pulse-Eight (http://www.pulse-eight.com/)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "PVRDemoIOPool.h"
+#include "client.h"
+#include "p8-platform/util/timeutils.h"
+
+#include <algorithm>
+#include <thread>
+
+using namespace ADDON;
+using namespace P8PLATFORM;
+
+PVRDemoIOPool::PVRDemoIOPool(unsigned int iThreads) :
+  m_workEvent(true),
+  m_stepEvent(true)
+{
+  Resize(iThreads);
+}
+
+PVRDemoIOPool::~PVRDemoIOPool(void)
+{
+  CLockObject lock(m_workersMutex);
+  for (auto& worker : m_workers)
+    worker->StopThread(-1);
+  m_workEvent.Broadcast();
+  for (auto& worker : m_workers)
+    worker->StopThread();
+}
+
+void PVRDemoIOPool::Resize(unsigned int iThreads)
+{
+  if (iThreads == 0)
+    iThreads = DefaultThreadCount();
+
+  CLockObject lock(m_workersMutex);
+  const size_t iBefore = m_workers.size();
+  while (m_workers.size() < iThreads)
+  {
+    m_workers.emplace_back(new Worker(*this));
+    m_workers.back()->CreateThread(false);
+  }
+
+  if (m_workers.size() > iThreads)
+  {
+    std::vector<std::unique_ptr<Worker>> surplus;
+    for (size_t i = iThreads; i < m_workers.size(); ++i)
+      surplus.push_back(std::move(m_workers[i]));
+    m_workers.resize(iThreads);
+
+    /* wake the ones waiting for work, the others stop after their step */
+    for (auto& worker : surplus)
+      worker->StopThread(-1);
+    m_workEvent.Broadcast();
+    for (auto& worker : surplus)
+      worker->StopThread();
+  }
+
+  PVRDEMO_LOG(LOG_DEBUG, "%s - %zu I/O threads, %u before", __FUNCTION__, m_workers.size(), (unsigned int)iBefore);
+}
+
+unsigned int PVRDemoIOPool::ThreadCount(void) const
+{
+  CLockObject lock(m_workersMutex);
+  return (unsigned int)m_workers.size();
+}
+
+unsigned int PVRDemoIOPool::DefaultThreadCount(void)
+{
+  /* producers mostly wait on I/O, a few threads serve many sessions */
+  unsigned int iCores = std::thread::hardware_concurrency();
+  return std::max(1u, std::min(iCores, 4u));
+}
+
+void PVRDemoIOPool::Submit(PVRDemoIOTask* task)
+{
+  {
+    CLockObject lock(m_mutex);
+    m_entries.push_back({ task, 0, false });
+  }
+  m_workEvent.Signal();
+}
+
+void PVRDemoIOPool::Cancel(PVRDemoIOTask* task)
+{
+  while (true)
+  {
+    {
+      CLockObject lock(m_mutex);
+      auto it = std::find_if(m_entries.begin(), m_entries.end(),
+                             [task](const Entry& entry) { return entry.task == task; });
+      if (it == m_entries.end())
+        return;
+      if (!it->bRunning)
+      {
+        m_entries.erase(it);
+        return;
+      }
+    }
+    m_stepEvent.Wait(10);
+  }
+}
+
+void PVRDemoIOPool::RunNext(void)
+{
+  std::list<Entry>::iterator it;
+  int64_t iWaitMs = 0;
+  {
+    CLockObject lock(m_mutex);
+    const int64_t iNow = GetTimeMs();
+    int64_t iWake = iNow + 100;
+
+    for (it = m_entries.begin(); it != m_entries.end(); ++it)
+    {
+      if (it->bRunning)
+        continue;
+      if (it->iNotBefore <= iNow)
+        break;
+      iWake = std::min(iWake, it->iNotBefore);
+    }
+
+    if (it != m_entries.end())
+      it->bRunning = true;
+    else
+      iWaitMs = std::max<int64_t>(1, iWake - iNow);
+  }
+
+  if (iWaitMs > 0)
+  {
+    m_workEvent.Wait((uint32_t)iWaitMs);
+    return;
+  }
+
+  /* list iterators stay valid: only Cancel() and the running worker erase,
+   * and Cancel() waits for bRunning to clear */
+  const PVRDemoIOTask::StepResult result = it->task->RunStep();
+
+  {
+    CLockObject lock(m_mutex);
+    it->bRunning = false;
+    if (result == PVRDemoIOTask::STEP_DONE)
+      m_entries.erase(it);
+    else
+    {
+      it->iNotBefore = result == PVRDemoIOTask::STEP_IDLE ? GetTimeMs() + IDLE_BACKOFF_MS : 0;
+      m_entries.splice(m_entries.end(), m_entries, it);
+    }
+  }
+  m_stepEvent.Broadcast();
+
+  /* let another worker pick up the task we just re-queued */
+  if (result == PVRDemoIOTask::STEP_PROGRESS)
+    m_workEvent.Signal();
+}
+
+void* PVRDemoIOPool::Worker::Process(void)
+{
+  while (!IsStopped())
+    m_pool.RunNext();
+  return NULL;
+}
@@ -0,0 +1,94 @@
+/*
+ *  Copyright (C) 2011-2020 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2011 Pulse-Eight (http://www.pulse-eight.com/)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <list>
+#include <memory>
+#include <vector>
+#include "p8-platform/threads/mutex.h"
+#include "p8-platform/threads/threads.h"
+
+/*!
+ * Unit of work run by the I/O pool. RunStep() must not block for long: it
+ * moves at most one chunk and reports whether there is more to do.
+ */
+class PVRDemoIOTask
+{
+public:
+  enum StepResult
+  {
+    STEP_PROGRESS, // did some work, run again soon
+    STEP_IDLE,     // nothing to do right now, back off
+    STEP_DONE      // finished, drop from the pool
+  };
+
+  virtual ~PVRDemoIOTask(void) {}
+  virtual StepResult RunStep(void) = 0;
+};
+
+/*!
+ * Set of worker threads shared by all stream sessions. Tasks are stepped
+ * round-robin; a task is never stepped by two workers at once. The pool
+ * lock only guards scheduling, data moves outside of it.
+ */
+class PVRDemoIOPool
+{
+public:
+  static const int IDLE_BACKOFF_MS = 5;
+
+  explicit PVRDemoIOPool(unsigned int iThreads);
+  ~PVRDemoIOPool(void);
+
+  void Submit(PVRDemoIOTask* task);
+
+  /*!
+   * Remove a task, waiting for a step in progress to finish. The task is
+   * never touched by the pool once this returns.
+   */
+  void Cancel(PVRDemoIOTask* task);
+
+  /*!
+   * Start or stop workers until there are iThreads, 0 for the default.
+   * Tasks stay queued; a worker that stops finishes its step first.
+   */
+  void Resize(unsigned int iThreads);
+
+  unsigned int ThreadCount(void) const;
+
+  static unsigned int DefaultThreadCount(void);
+
+private:
+  class Worker : public P8PLATFORM::CThread
+  {
+  public:
+    explicit Worker(PVRDemoIOPool& pool) : m_pool(pool) {}
+
+  protected:
+    void* Process(void) override;
+
+  private:
+    PVRDemoIOPool& m_pool;
+  };
+
+  struct Entry
+  {
+    PVRDemoIOTask* task;
+    int64_t        iNotBefore;
+    bool           bRunning;
+  };
+
+  void RunNext(void);
+
+  P8PLATFORM::CMutex                   m_mutex;
+  P8PLATFORM::CEvent                   m_workEvent;
+  P8PLATFORM::CEvent                   m_stepEvent;
+  std::list<Entry>                     m_entries;
+  mutable P8PLATFORM::CMutex           m_workersMutex;  // guards m_workers, never taken by the workers
+  std::vector<std::unique_ptr<Worker>> m_workers;
+};
@@ -0,0 +1,234 @@
+/*
+ *  Copyright (C) 2011-2020 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2011 Pulse-Eight (http://www.pulse-eight.com/)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "PVRDemoIconCache.h"
+#include "PVRDemoLog.h"
+#include "PVRDemoPng.h"
+#include "PVRDemoStats.h"
+#include "p8-platform/util/timeutils.h"
+
+#include <algorithm>
+#include <atomic>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <thread>
+
+using namespace ADDON;
+
+namespace
+{
+
+const unsigned int MAX_THREADS = 8;
+
+/* fn(i) for every i below iCount, spread over a few threads */
+template<typename Fn>
+void ParallelFor(size_t iCount, Fn fn)
+{
+  const unsigned int iCores = std::max(std::thread::hardware_concurrency(), 1u);
+  const unsigned int iThreads = (unsigned int)std::min<size_t>(std::min(iCores, MAX_THREADS), iCount);
+  std::atomic<size_t> iNext(0);
+  auto run = [&]() {
+    for (size_t i = iNext++; i < iCount; i = iNext++)
+      fn(i);
+  };
+
+  std::vector<std::thread> threads;
+  for (unsigned int i = 1; i < iThreads; ++i)
+    threads.emplace_back(run);
+  run();
+  for (auto& thread : threads)
+    thread.join();
+}
+
+/* FNV-1a over the content and its size */
+uint64_t ContentHash(const std::vector<uint8_t>& data)
+{
+  uint64_t iHash = 0xcbf29ce484222325ULL;
+  for (uint8_t iByte : data)
+    iHash = (iHash ^ iByte) * 0x100000001b3ULL;
+  return (iHash ^ data.size()) * 0x100000001b3ULL;
+}
+
+bool ReadFile(const std::string& strFile, std::vector<uint8_t>& data)
+{
+  FILE* file = fopen(strFile.c_str(), "rb");
+  if (!file)
+    return false;
+
+  bool bRead = fseek(file, 0, SEEK_END) == 0;
+  const long iSize = bRead ? ftell(file) : -1;
+  if (iSize >= 0 && fseek(file, 0, SEEK_SET) == 0)
+  {
+    data.resize((size_t)iSize);
+    bRead = fread(data.data(), 1, data.size(), file) == data.size();
+  }
+  fclose(file);
+  return bRead && iSize >= 0;
+}
+
+/* the add-on's profile directory may not exist before settings are saved */
+void CreateDirectories(const std::string& strFile)
+{
+  for (size_t iPos = strFile.find('/', 1); iPos != std::string::npos; iPos = strFile.find('/', iPos + 1))
+    mkdir(strFile.substr(0, iPos).c_str(), 0755);
+}
+
+}
+
+PVRDemoIconCache::PVRDemoIconCache(const std::string& strBaseDirectory, const std::string& strThumbnailDirectory, int iThumbnailSize) :
+  m_strBaseDirectory(strBaseDirectory),
+  m_strThumbnailDirectory(strThumbnailDirectory),
+  m_iThumbnailSize(iThumbnailSize)
+{
+  if (!m_strThumbnailDirectory.empty() && m_strThumbnailDirectory.back() != '/' && m_strThumbnailDirectory.back() != '\\')
+    m_strThumbnailDirectory += '/';
+}
+
+void PVRDemoIconCache::Add(std::string& strPath, const std::string& strFallback)
+{
+  if (strPath.empty())
+  {
+    strPath = strFallback;
+    return;
+  }
+  /* a URL, Kodi fetches it itself */
+  if (strPath.find("://") != std::string::npos)
+    return;
+
+  size_t iFallback = std::find(m_fallbacks.begin(), m_fallbacks.end(), strFallback) - m_fallbacks.begin();
+  if (iFallback == m_fallbacks.size())
+    m_fallbacks.push_back(strFallback);
+
+  auto it = m_iconsByPath.find(strPath);
+  if (it == m_iconsByPath.end())
+  {
+    const bool bAbsolute = strPath[0] == '/' || strPath[0] == '\\' || (strPath.size() > 1 && strPath[1] == ':');
+    Icon icon;
+    icon.strFile = bAbsolute ? strPath : m_strBaseDirectory + strPath;
+    it = m_iconsByPath.emplace(strPath, m_icons.size()).first;
+    m_icons.push_back(std::move(icon));
+  }
+  m_references.push_back({ &strPath, it->second, iFallback });
+}
+
+void PVRDemoIconCache::Resolve(void)
+{
+  PVRDEMO_STATS_SCOPE();
+  const int64_t iStartMs = P8PLATFORM::GetTimeMs();
+
+  ParallelFor(m_icons.size(), [this](size_t i) {
+    Icon& icon = m_icons[i];
+    icon.bFound = ReadFile(icon.strFile, icon.data);
+    if (icon.bFound)
+      icon.iHash = ContentHash(icon.data);
+  });
+
+  /* the first icon with a content stands for all icons with it */
+  std::unordered_map<uint64_t, size_t> assetsByHash;
+  std::vector<size_t> assets;
+  std::vector<size_t> assetOf(m_icons.size());
+  size_t iBytes = 0, iMissing = 0;
+  for (size_t i = 0; i < m_icons.size(); ++i)
+  {
+    const Icon& icon = m_icons[i];
+    if (!icon.bFound)
+    {
+      PVRDEMO_LOG(LOG_NOTICE, "%s - icon '%s' not found", __FUNCTION__, icon.strFile.c_str());
+      ++iMissing;
+      continue;
+    }
+    iBytes += icon.data.size();
+    m_files.push_back(icon.strFile);
+
+    auto inserted = assetsByHash.emplace(icon.iHash, i);
+    assetOf[i] = inserted.first->second;
+    if (inserted.second)
+      assets.push_back(i);
+  }
+
+  ParallelFor(assets.size(), [this, &assets](size_t i) {
+    Icon& icon = m_icons[assets[i]];
+    const std::string strThumbnail = Thumbnail(icon);
+    icon.strResolved = strThumbnail.empty() ? icon.strFile : strThumbnail;
+  });
+
+  size_t iThumbnails = 0;
+  for (size_t iAsset : assets)
+  {
+    if (m_icons[iAsset].strResolved != m_icons[iAsset].strFile)
+    {
+      m_files.push_back(m_icons[iAsset].strResolved);
+      ++iThumbnails;
+    }
+  }
+  for (size_t i = 0; i < m_icons.size(); ++i)
+  {
+    if (m_icons[i].bFound)
+      m_icons[i].strResolved = m_icons[assetOf[i]].strResolved;
+    std::vector<uint8_t>().swap(m_icons[i].data);
+  }
+
+  for (const Reference& reference : m_references)
+  {
+    const Icon& icon = m_icons[reference.iIcon];
+    *reference.pPath = icon.bFound ? icon.strResolved : m_fallbacks[reference.iFallback];
+  }
+
+  PVRDEMO_STATS_COUNT(PVRDEMO_COUNTER_ICON_BYTES, iBytes);
+  PVRDEMO_LOG(LOG_INFO, "%s - %zu icons in %zu files, %zu distinct images, %zu missing, %zu thumbnails, %lld ms",
+              __FUNCTION__, m_references.size(), m_icons.size(), assets.size(), iMissing, iThumbnails,
+              (long long)(P8PLATFORM::GetTimeMs() - iStartMs));
+}
+
+std::string PVRDemoIconCache::Thumbnail(const Icon& icon) const
+{
+  int iWidth, iHeight;
+  if (m_strThumbnailDirectory.empty() || m_iThumbnailSize <= 0 ||
+      !PVRDemoPng::Size(icon.data.data(), icon.data.size(), iWidth, iHeight) ||
+      std::max(iWidth, iHeight) <= m_iThumbnailSize)
+    return "";
+
+  char strName[64];
+  snprintf(strName, sizeof(strName), "%016llx-%d.png", (unsigned long long)icon.iHash, m_iThumbnailSize);
+  const std::string strThumbnail = m_strThumbnailDirectory + strName;
+
+  /* made by an earlier load */
+  struct stat info;
+  if (stat(strThumbnail.c_str(), &info) == 0 && info.st_size > 0)
+    return strThumbnail;
+
+  PVRDemoImage image, scaled;
+  if (!PVRDemoPng::Decode(icon.data.data(), icon.data.size(), image))
+  {
+    PVRDEMO_LOG(LOG_DEBUG, "%s - cannot scale '%s', using it as it is", __FUNCTION__, icon.strFile.c_str());
+    return "";
+  }
+  PVRDemoPng::Scale(image, m_iThumbnailSize, scaled);
+  std::vector<uint8_t> encoded;
+  PVRDemoPng::Encode(scaled, encoded);
+
+  CreateDirectories(strThumbnail);
+  const std::string strTemporary = strThumbnail + ".tmp";
+  FILE* file = fopen(strTemporary.c_str(), "wb");
+  if (!file)
+  {
+    PVRDEMO_LOG(LOG_ERROR, "%s - cannot write '%s'", __FUNCTION__, strTemporary.c_str());
+    return "";
+  }
+  const bool bWritten = fwrite(encoded.data(), 1, encoded.size(), file) == encoded.size();
+  if (fclose(file) != 0 || !bWritten || rename(strTemporary.c_str(), strThumbnail.c_str()) != 0)
+  {
+    PVRDEMO_LOG(LOG_ERROR, "%s - cannot write '%s'", __FUNCTION__, strThumbnail.c_str());
+    remove(strTemporary.c_str());
+    return "";
+  }
+
+  PVRDEMO_LOG(LOG_DEBUG, "%s - '%s' %dx%d, %zu bytes as '%s' %dx%d, %zu bytes", __FUNCTION__, icon.strFile.c_str(),
+              iWidth, iHeight, icon.data.size(), strThumbnail.c_str(), scaled.iWidth, scaled.iHeight, encoded.size());
+  return strThumbnail;
+}
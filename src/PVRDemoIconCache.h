@@ -0,0 +1,73 @@
+/*
+ *  Copyright (C) 2011-2020 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2011 Pulse-Eight (http://www.pulse-eight.com/)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/*!
+ * Resolves the icons of one load before the data is published, so the
+ * transfer functions hand Kodi a finished path.
+ *
+ * Paths are collected with Add() and resolved together by Resolve(): each
+ * distinct local file is read and hashed once, on several threads. Files
+ * with the same content resolve to one path, the first one added, so Kodi
+ * fetches and caches the image once. A PNG larger than the thumbnail size
+ * is scaled down into the thumbnail directory, named by its content hash;
+ * later loads find it there and do not scale it again. Missing files get
+ * the fallback of the reference; URLs are left as they are.
+ */
+class PVRDemoIconCache
+{
+public:
+  /*!
+   * Relative paths are taken from strBaseDirectory. Thumbnails are not
+   * made if strThumbnailDirectory is empty or iThumbnailSize is 0.
+   */
+  PVRDemoIconCache(const std::string& strBaseDirectory, const std::string& strThumbnailDirectory, int iThumbnailSize);
+
+  /* have strPath resolved in place by Resolve(); it must stay where it is until then */
+  void Add(std::string& strPath, const std::string& strFallback = "");
+
+  void Resolve(void);
+
+  /* the local files the resolved paths depend on, thumbnails included */
+  const std::vector<std::string>& Files(void) const { return m_files; }
+
+private:
+  struct Icon
+  {
+    std::string          strFile;      // absolute path of the file
+    std::string          strResolved;  // what its references become, empty if the file was not found
+    bool                 bFound = false;
+    uint64_t             iHash = 0;
+    std::vector<uint8_t> data;         // content while resolving
+  };
+
+  struct Reference
+  {
+    std::string* pPath;
+    size_t       iIcon;
+    size_t       iFallback;
+  };
+
+  /* the thumbnail of icon in the thumbnail directory, made if it is not there; empty if it has none */
+  std::string Thumbnail(const Icon& icon) const;
+
+  std::string                             m_strBaseDirectory;
+  std::string                             m_strThumbnailDirectory;
+  int                                     m_iThumbnailSize;
+  std::vector<Icon>                       m_icons;
+  std::unordered_map<std::string, size_t> m_iconsByPath;  // path as written to its icon
+  std::vector<std::string>                m_fallbacks;
+  std::vector<Reference>                  m_references;
+  std::vector<std::string>                m_files;
+};
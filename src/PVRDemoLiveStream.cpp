@@ -0,0 +1,292 @@
+/*
+ *  Copyright (C) 2011-2020 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2011 Pulse-Eight (http://www.pulse-eight.com/)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "PVRDemoLiveStream.h"
+#include "PVRDemoStats.h"
+#include "client.h"
+#include "p8-platform/util/timeutils.h"
+
+#include <algorithm>
+
+using namespace ADDON;
+using namespace P8PLATFORM;
+
+PVRDemoLiveStream::PVRDemoLiveStream(std::shared_ptr<PVRDemoIOPool> pool, PVRDemoStreamSource* source, size_t iBufferSize, PVRDemoTimeshiftBuffer* timeshift) :
+  m_pool(std::move(pool)),
+  m_source(source),
+  m_timeshift(timeshift),
+  m_iReadPosition(0),
+  m_bPaused(false),
+  m_buffer(iBufferSize),
+  m_bOpen(false),
+  m_bEndOfStream(false),
+  m_iBytesProduced(0),
+  m_iBytesConsumed(0),
+  m_iUnderruns(0)
+{
+}
+
+PVRDemoLiveStream::~PVRDemoLiveStream(void)
+{
+  Close();
+}
+
+bool PVRDemoLiveStream::Open(void)
+{
+  if (!m_source || !m_source->Open())
+    return false;
+
+  if (m_timeshift)
+  {
+    if (!m_timeshift->Open())
+    {
+      PVRDEMO_LOG(LOG_ERROR, "%s - cannot open timeshift buffer, falling back to plain live", __FUNCTION__);
+      m_timeshift.reset();
+    }
+    else
+      m_chunk.resize(CHUNK_SIZE);
+  }
+
+  m_bEndOfStream = false;
+  m_bOpen = true;
+  m_pool->Submit(this);
+
+  PVRDEMO_LOG(LOG_DEBUG, "%s - live stream opened, buffer %u KiB%s", __FUNCTION__,
+              (unsigned int)(m_buffer.Capacity() / 1024), m_timeshift ? ", timeshift enabled" : "");
+  return true;
+}
+
+void PVRDemoLiveStream::Close(void)
+{
+  if (!m_bOpen)
+    return;
+  m_bOpen = false;
+
+  m_pool->Cancel(this);
+  m_source->Close();
+  if (m_timeshift)
+    m_timeshift->Close();
+}
+
+int PVRDemoLiveStream::Read(unsigned char* pBuffer, unsigned int iBufferSize)
+{
+  if (m_timeshift)
+    return ReadTimeshift(pBuffer, iBufferSize);
+
+  size_t iRead = m_buffer.Read(pBuffer, iBufferSize);
+  if (iRead == 0 && !m_bEndOfStream)
+  {
+    ++m_iUnderruns;
+    PVRDEMO_STATS_COUNT(PVRDEMO_COUNTER_CACHE_MISSES, 1);
+    int64_t iDeadline = GetTimeMs() + READ_TIMEOUT_MS;
+    while (iRead == 0 && !m_bEndOfStream)
+    {
+      int64_t iLeft = iDeadline - GetTimeMs();
+      if (iLeft <= 0)
+        break;
+      m_dataEvent.Wait((uint32_t)iLeft);
+      iRead = m_buffer.Read(pBuffer, iBufferSize);
+    }
+  }
+  else if (iRead > 0)
+    PVRDEMO_STATS_COUNT(PVRDEMO_COUNTER_CACHE_HITS, 1);
+
+  /* the producer commits its last chunk before it marks the end, which an
+   * empty read may have raced with; only a read after seeing the end is final */
+  if (iRead == 0 && m_bEndOfStream)
+  {
+    iRead = m_buffer.Read(pBuffer, iBufferSize);
+    if (iRead == 0)
+      return -1;
+  }
+
+  if (iRead > 0)
+    m_iBytesConsumed += iRead;
+  return (int)iRead;
+}
+
+int PVRDemoLiveStream::ReadTimeshift(unsigned char* pBuffer, unsigned int iBufferSize)
+{
+  const uint64_t iStart = m_timeshift->StartPosition();
+  if (m_iReadPosition < iStart)
+  {
+    PVRDEMO_LOG(LOG_DEBUG, "%s - reader fell out of the timeshift window, skipping %llu bytes",
+                __FUNCTION__, (unsigned long long)(iStart - m_iReadPosition));
+    m_iReadPosition = iStart;
+  }
+
+  if (!m_timeshift->WaitForData(m_iReadPosition, 0))
+  {
+    if (!m_bEndOfStream)
+    {
+      ++m_iUnderruns;
+      PVRDEMO_STATS_COUNT(PVRDEMO_COUNTER_CACHE_MISSES, 1);
+      int64_t iDeadline = GetTimeMs() + READ_TIMEOUT_MS;
+      while (!m_bEndOfStream && !m_timeshift->WaitForData(m_iReadPosition, 50))
+      {
+        if (GetTimeMs() >= iDeadline)
+          return 0;
+      }
+    }
+
+    /* as in Read(), what was written before the end was marked is still to come */
+    if (m_bEndOfStream && !m_timeshift->WaitForData(m_iReadPosition, 0))
+      return -1;
+  }
+  else
+    PVRDEMO_STATS_COUNT(PVRDEMO_COUNTER_CACHE_HITS, 1);
+
+  ssize_t iRead;
+  while ((iRead = m_timeshift->Read(m_iReadPosition, pBuffer, iBufferSize)) == 0)
+  {
+    /* the writer dropped the segment we were about to read */
+    if (m_iReadPosition >= m_timeshift->StartPosition())
+      return 0;
+    m_iReadPosition = m_timeshift->StartPosition();
+  }
+
+  m_iReadPosition += iRead;
+  m_iBytesConsumed += iRead;
+  return (int)iRead;
+}
+
+bool PVRDemoLiveStream::IsRealTime(void) const
+{
+  if (!m_timeshift)
+    return true;
+
+  /* within a couple of chunks of the live edge counts as live */
+  return !m_bPaused && m_timeshift->EndPosition() - m_iReadPosition <= 4 * CHUNK_SIZE;
+}
+
+void PVRDemoLiveStream::Pause(bool bPaused)
+{
+  /* nothing to stop: the producer keeps writing to disk while paused */
+  m_bPaused = bPaused;
+}
+
+long long PVRDemoLiveStream::Seek(long long iPosition, int iWhence)
+{
+  if (!m_timeshift)
+    return -1;
+
+  long long iTarget;
+  switch (iWhence)
+  {
+    case SEEK_SET:
+      iTarget = iPosition;
+      break;
+    case SEEK_CUR:
+      iTarget = (long long)m_iReadPosition + iPosition;
+      break;
+    case SEEK_END:
+      iTarget = (long long)m_timeshift->EndPosition() + iPosition;
+      break;
+    default:
+      return -1;
+  }
+
+  const long long iStart = (long long)m_timeshift->StartPosition();
+  const long long iEnd = (long long)m_timeshift->EndPosition();
+  m_iReadPosition = (uint64_t)std::max(iStart, std::min(iTarget, iEnd));
+  return (long long)m_iReadPosition;
+}
+
+long long PVRDemoLiveStream::Length(void) const
+{
+  return m_timeshift ? (long long)m_timeshift->EndPosition() : -1;
+}
+
+bool PVRDemoLiveStream::SeekTime(double fTimeMs, bool bBackwards, double* fStartPts)
+{
+  if (!m_timeshift)
+    return false;
+
+  const int64_t iStart = m_timeshift->StartTime();
+  const int64_t iEnd = m_timeshift->EndTime();
+  const int64_t iTarget = std::max(iStart, std::min((int64_t)fTimeMs, iEnd));
+
+  m_iReadPosition = m_timeshift->PositionForTime(iTarget, bBackwards);
+  if (fStartPts)
+  {
+    /* a forward seek past the last index point lands on the live end */
+    const int64_t iTime = m_iReadPosition >= m_timeshift->EndPosition() ? iEnd : m_timeshift->TimeForPosition(m_iReadPosition);
+    *fStartPts = (double)iTime * DVD_TIME_BASE / 1000;
+  }
+  return true;
+}
+
+bool PVRDemoLiveStream::GetTimes(PVR_STREAM_TIMES* times) const
+{
+  if (!m_timeshift)
+    return false;
+
+  /* pts values are relative to the moment the stream was opened */
+  times->startTime = m_timeshift->OpenTime();
+  times->ptsStart  = 0;
+  times->ptsBegin  = m_timeshift->StartTime() * DVD_TIME_BASE / 1000;
+  times->ptsEnd    = m_timeshift->EndTime() * DVD_TIME_BASE / 1000;
+  return true;
+}
+
+PVRDemoIOTask::StepResult PVRDemoLiveStream::ProduceTimeshift(void)
+{
+  /* an unpaced source would fill the whole timeshift window in seconds, so
+   * it is kept no further ahead of the reader than the live buffer size */
+  if (!m_source->IsPaced() && m_timeshift->EndPosition() - m_iReadPosition >= m_buffer.Capacity())
+    return STEP_IDLE;
+
+  ssize_t iRead = m_source->Read(m_chunk.data(), m_chunk.size(), 0);
+  if (iRead < 0)
+    return EndOfStream();
+  if (iRead == 0)
+    return STEP_IDLE;
+
+  if (!m_timeshift->Write(m_chunk.data(), (size_t)iRead))
+    return EndOfStream();
+
+  m_iBytesProduced += iRead;
+  return STEP_PROGRESS;
+}
+
+PVRDemoIOTask::StepResult PVRDemoLiveStream::EndOfStream(void)
+{
+  PVRDEMO_LOG(LOG_DEBUG, "%s - end of live source", __FUNCTION__);
+  m_bEndOfStream = true;
+  m_dataEvent.Signal();
+  return STEP_DONE;
+}
+
+PVRDemoIOTask::StepResult PVRDemoLiveStream::RunStep(void)
+{
+  if (m_timeshift)
+    return ProduceTimeshift();
+
+  uint8_t* pSpan;
+  size_t iSpan = m_buffer.GetWriteSpan(pSpan);
+  if (iSpan == 0)
+  {
+    /* consumer is behind; wait for it rather than dropping data */
+    return STEP_IDLE;
+  }
+
+  if (iSpan > (size_t)CHUNK_SIZE)
+    iSpan = CHUNK_SIZE;
+
+  /* never block a shared worker, the pool backs off on idle instead */
+  ssize_t iRead = m_source->Read(pSpan, iSpan, 0);
+  if (iRead < 0)
+    return EndOfStream();
+  if (iRead == 0)
+    return STEP_IDLE;
+
+  m_buffer.CommitWrite((size_t)iRead);
+  m_iBytesProduced += iRead;
+  m_dataEvent.Signal();
+  return STEP_PROGRESS;
+}
@@ -0,0 +1,77 @@
+/*
+ *  Copyright (C) 2011-2020 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2011 Pulse-Eight (http://www.pulse-eight.com/)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "p8-platform/threads/threads.h"
+#include "client.h"
+#include "PVRDemoIOPool.h"
+#include "PVRDemoRingBuffer.h"
+#include "PVRDemoStreamSource.h"
+#include "PVRDemoTimeshift.h"
+
+/*!
+ * Live stream served by the add-on. A producer task on the shared I/O pool
+ * reads from the channel's source straight into the ring buffer; Read()
+ * drains it without taking any lock.
+ *
+ * With a timeshift buffer attached the producer appends to the on-disk store
+ * instead and the reader keeps its own position in it, which makes the stream
+ * pausable and seekable.
+ */
+class PVRDemoLiveStream : public PVRDemoIOTask
+{
+public:
+  static const int CHUNK_SIZE = 64 * 1024;
+  static const int READ_TIMEOUT_MS = 1000;
+
+  PVRDemoLiveStream(std::shared_ptr<PVRDemoIOPool> pool, PVRDemoStreamSource* source, size_t iBufferSize, PVRDemoTimeshiftBuffer* timeshift = NULL);
+  ~PVRDemoLiveStream(void) override;
+
+  bool Open(void);
+  void Close(void);
+  int Read(unsigned char* pBuffer, unsigned int iBufferSize);
+
+  bool IsTimeshifting(void) const { return m_timeshift != nullptr; }
+  bool IsRealTime(void) const;
+  void Pause(bool bPaused);
+  long long Seek(long long iPosition, int iWhence);
+  long long Length(void) const;
+  bool SeekTime(double fTimeMs, bool bBackwards, double* fStartPts);
+  bool GetTimes(PVR_STREAM_TIMES* times) const;
+
+  uint64_t BytesProduced(void) const { return m_iBytesProduced; }
+  uint64_t BytesConsumed(void) const { return m_iBytesConsumed; }
+  unsigned int Underruns(void) const { return m_iUnderruns; }
+
+  StepResult RunStep(void) override;
+
+private:
+  int ReadTimeshift(unsigned char* pBuffer, unsigned int iBufferSize);
+  StepResult ProduceTimeshift(void);
+  StepResult EndOfStream(void);
+
+  std::shared_ptr<PVRDemoIOPool>       m_pool;
+  std::unique_ptr<PVRDemoStreamSource> m_source;
+  std::unique_ptr<PVRDemoTimeshiftBuffer> m_timeshift;
+  std::vector<uint8_t>                 m_chunk;
+  std::atomic<uint64_t>                m_iReadPosition;
+  bool                                 m_bPaused;
+  PVRDemoRingBuffer                    m_buffer;
+  P8PLATFORM::CEvent                   m_dataEvent;
+  bool                                 m_bOpen;
+  std::atomic<bool>                    m_bEndOfStream;
+
+  /* statistics, measured by pvrdemo-bench */
+  std::atomic<uint64_t>                m_iBytesProduced;
+  std::atomic<uint64_t>                m_iBytesConsumed;
+  std::atomic<unsigned int>            m_iUnderruns;
+};
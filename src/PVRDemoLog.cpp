@@ -0,0 +1,459 @@
+/*
+ *  Copyright (C) 2011-2020 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2011 Pulse-Eight (http://www.pulse-eight.com/)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "PVRDemoLog.h"
+#include "client.h"
+#include "p8-platform/threads/mutex.h"
+#include "p8-platform/threads/threads.h"
+#include "p8-platform/util/timeutils.h"
+
+#include <algorithm>
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <vector>
+
+using namespace ADDON;
+using namespace P8PLATFORM;
+
+std::atomic<int> PVRDemoLog::m_iLevel(LOG_INFO);
+
+namespace
+{
+
+/*!
+ * Single producer, single consumer byte ring. Positions only grow; the
+ * producer owns m_iHead, the background writer owns m_iTail.
+ */
+struct ThreadBuffer
+{
+  std::atomic<size_t>   iHead;
+  std::atomic<size_t>   iTail;
+  std::atomic<uint64_t> iDropped;
+  std::atomic<bool>     bDetached;
+  char                  data[PVRDemoLog::THREAD_BUFFER_SIZE];
+
+  ThreadBuffer(void) : iHead(0), iTail(0), iDropped(0), bDetached(false) {}
+
+  void CopyIn(size_t iPosition, const char* pData, size_t iSize)
+  {
+    const size_t iOffset = iPosition % sizeof(data);
+    const size_t iFirst = std::min(iSize, sizeof(data) - iOffset);
+    memcpy(data + iOffset, pData, iFirst);
+    memcpy(data, pData + iFirst, iSize - iFirst);
+  }
+
+  void CopyOut(size_t iPosition, char* pData, size_t iSize) const
+  {
+    const size_t iOffset = iPosition % sizeof(data);
+    const size_t iFirst = std::min(iSize, sizeof(data) - iOffset);
+    memcpy(pData, data + iOffset, iFirst);
+    memcpy(pData + iFirst, data, iSize - iFirst);
+  }
+};
+
+/* marks the calling thread's ring for removal when the thread exits */
+struct ThreadBufferOwner
+{
+  ThreadBuffer* buffer = nullptr;
+
+  ~ThreadBufferOwner(void)
+  {
+    if (buffer)
+      buffer->bDetached.store(true, std::memory_order_release);
+  }
+};
+
+void AppendFormatted(std::string& strResult, const char* strFormat, ...)
+{
+  char buffer[256];
+  va_list args;
+  va_start(args, strFormat);
+  int iSize = vsnprintf(buffer, sizeof(buffer), strFormat, args);
+  va_end(args);
+  if (iSize < 0)
+    return;
+
+  if ((size_t)iSize < sizeof(buffer))
+  {
+    strResult.append(buffer, iSize);
+    return;
+  }
+
+  std::vector<char> large(iSize + 1);
+  va_start(args, strFormat);
+  vsnprintf(large.data(), large.size(), strFormat, args);
+  va_end(args);
+  strResult.append(large.data(), iSize);
+}
+
+class Writer : public CThread
+{
+public:
+  Writer(void) : m_wakeEvent(true) {}
+
+  void Wake(void) { m_wakeEvent.Signal(); }
+
+  ThreadBuffer* Attach(void)
+  {
+    ThreadBuffer* buffer = new ThreadBuffer;
+    CLockObject lock(m_buffersMutex);
+    m_buffers.push_back(buffer);
+    return buffer;
+  }
+
+  void AddSite(PVRDemoLog::Site* site)
+  {
+    CLockObject lock(m_sitesMutex);
+    m_sites.push_back(site);
+  }
+
+  void Forward(const char* pEvent, size_t iSize)
+  {
+    PVRDemoLog::Event::Header header;
+    memcpy(&header, pEvent, sizeof(header));
+    if (XBMC)
+      XBMC->Log((addon_log)header.iLevel, "%s", PVRDemoLog::Format(pEvent, iSize).c_str());
+  }
+
+  void Drain(void)
+  {
+    std::vector<ThreadBuffer*> buffers;
+    {
+      CLockObject lock(m_buffersMutex);
+      buffers = m_buffers;
+    }
+
+    char event[PVRDemoLog::MAX_EVENT_SIZE];
+    for (ThreadBuffer* buffer : buffers)
+    {
+      /* read the detached flag first, so nothing written before it is missed */
+      const bool bDetached = buffer->bDetached.load(std::memory_order_acquire);
+      const size_t iHead = buffer->iHead.load(std::memory_order_acquire);
+      size_t iTail = buffer->iTail.load(std::memory_order_relaxed);
+      while (iTail != iHead)
+      {
+        uint32_t iSize;
+        buffer->CopyOut(iTail, (char*)&iSize, sizeof(iSize));
+        buffer->CopyOut(iTail, event, iSize);
+        iTail += iSize;
+        buffer->iTail.store(iTail, std::memory_order_release);
+        Forward(event, iSize);
+      }
+
+      const uint64_t iDropped = buffer->iDropped.exchange(0, std::memory_order_relaxed);
+      if (iDropped > 0 && XBMC)
+        XBMC->Log(LOG_NOTICE, "%s - dropped %llu log messages, the log could not keep up",
+                  __FUNCTION__, (unsigned long long)iDropped);
+
+      if (bDetached)
+      {
+        CLockObject lock(m_buffersMutex);
+        m_buffers.erase(std::find(m_buffers.begin(), m_buffers.end(), buffer));
+        delete buffer;
+      }
+    }
+
+    ReportSuppressed(false);
+  }
+
+  /* one line per call site that went over its rate limit */
+  void ReportSuppressed(bool bFinal)
+  {
+    CLockObject lock(m_sitesMutex);
+    const int64_t iNow = GetTimeMs();
+    for (PVRDemoLog::Site* site : m_sites)
+    {
+      const unsigned iSuppressed = site->TakeSuppressed(iNow, bFinal);
+      if (iSuppressed > 0 && XBMC)
+        XBMC->Log(site->m_level, "%u more messages like \"%s\" in one second", iSuppressed, site->m_strFormat);
+    }
+  }
+
+protected:
+  void* Process(void) override
+  {
+    while (!IsStopped())
+    {
+      m_wakeEvent.Wait(PVRDemoLog::FLUSH_INTERVAL_MS);
+      Drain();
+    }
+    return NULL;
+  }
+
+private:
+  CEvent                          m_wakeEvent;
+  CMutex                          m_buffersMutex;
+  std::vector<ThreadBuffer*>      m_buffers;
+  CMutex                          m_sitesMutex;
+  std::vector<PVRDemoLog::Site*>  m_sites;
+};
+
+/* never destroyed: threads may still log while the add-on unloads */
+Writer& GetWriter(void)
+{
+  static Writer* writer = new Writer;
+  return *writer;
+}
+
+std::atomic<bool> g_bAsync(false);
+thread_local ThreadBufferOwner t_buffer;
+
+}
+
+PVRDemoLog::Site::Site(addon_log level, const char* strFormat) :
+  m_level(level),
+  m_strFormat(strFormat),
+  m_iWindowStart(0),
+  m_iCount(0),
+  m_iSuppressed(0)
+{
+  GetWriter().AddSite(this);
+}
+
+bool PVRDemoLog::Site::Admit(void)
+{
+  const int64_t iNow = GetTimeMs();
+  int64_t iStart = m_iWindowStart.load(std::memory_order_relaxed);
+  if (iNow - iStart >= 1000 && m_iWindowStart.compare_exchange_strong(iStart, iNow))
+    m_iCount.store(0, std::memory_order_relaxed);
+
+  if (m_iCount.fetch_add(1, std::memory_order_relaxed) < RATE_LIMIT)
+    return true;
+
+  m_iSuppressed.fetch_add(1, std::memory_order_relaxed);
+  return false;
+}
+
+unsigned PVRDemoLog::Site::TakeSuppressed(int64_t iNow, bool bFinal)
+{
+  if (!bFinal && iNow - m_iWindowStart.load(std::memory_order_relaxed) < 1000)
+    return 0;
+  return m_iSuppressed.exchange(0, std::memory_order_relaxed);
+}
+
+PVRDemoLog::Event::Event(addon_log level, const char* strFormat) :
+  m_iSize(sizeof(Header))
+{
+  Header header = { (uint32_t)m_iSize, (int32_t)level, strFormat };
+  memcpy(m_data, &header, sizeof(header));
+}
+
+void PVRDemoLog::Event::Add(const char* strValue)
+{
+  if (!strValue)
+    strValue = "(null)";
+
+  const size_t iFree = sizeof(m_data) - m_iSize;
+  if (iFree <= 1 + sizeof(uint16_t))
+    return;
+
+  const uint16_t iLength = (uint16_t)std::min(strlen(strValue), iFree - 1 - sizeof(uint16_t));
+  m_data[m_iSize] = TAG_STRING;
+  memcpy(m_data + m_iSize + 1, &iLength, sizeof(iLength));
+  memcpy(m_data + m_iSize + 1 + sizeof(iLength), strValue, iLength);
+  m_iSize += 1 + sizeof(iLength) + iLength;
+  memcpy(m_data, &m_iSize, sizeof(uint32_t));
+}
+
+void PVRDemoLog::Event::Append(char tag, const void* pValue, size_t iSize)
+{
+  /* arguments that do not fit show up as missing */
+  if (m_iSize + 1 + iSize > sizeof(m_data))
+    return;
+
+  m_data[m_iSize] = tag;
+  memcpy(m_data + m_iSize + 1, pValue, iSize);
+  m_iSize += 1 + iSize;
+  const uint32_t iHeaderSize = (uint32_t)m_iSize;
+  memcpy(m_data, &iHeaderSize, sizeof(iHeaderSize));
+}
+
+void PVRDemoLog::SetLevel(addon_log level)
+{
+  m_iLevel.store((int)level, std::memory_order_relaxed);
+}
+
+void PVRDemoLog::Start(void)
+{
+  Writer& writer = GetWriter();
+  if (writer.IsRunning())
+    return;
+
+  writer.CreateThread(false);
+  g_bAsync.store(true, std::memory_order_release);
+}
+
+void PVRDemoLog::Stop(void)
+{
+  Writer& writer = GetWriter();
+  g_bAsync.store(false, std::memory_order_release);
+  writer.StopThread(-1);
+  writer.Wake();
+  writer.StopThread();
+  writer.Drain();
+  writer.ReportSuppressed(true);
+}
+
+void PVRDemoLog::Submit(const Event& event)
+{
+  if (!g_bAsync.load(std::memory_order_acquire))
+  {
+    GetWriter().Forward(event.Data(), event.Size());
+    return;
+  }
+
+  if (!t_buffer.buffer)
+    t_buffer.buffer = GetWriter().Attach();
+
+  ThreadBuffer& buffer = *t_buffer.buffer;
+  const size_t iHead = buffer.iHead.load(std::memory_order_relaxed);
+  const size_t iUsed = iHead - buffer.iTail.load(std::memory_order_acquire);
+  if (sizeof(buffer.data) - iUsed < event.Size())
+  {
+    buffer.iDropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  buffer.CopyIn(iHead, event.Data(), event.Size());
+  buffer.iHead.store(iHead + event.Size(), std::memory_order_release);
+
+  /* the writer polls; only hurry it along when the ring fills up */
+  if (iUsed + event.Size() > sizeof(buffer.data) / 2)
+    GetWriter().Wake();
+}
+
+std::string PVRDemoLog::Format(const char* pEvent, size_t iSize)
+{
+  Event::Header header;
+  memcpy(&header, pEvent, sizeof(header));
+  const char* pArg = pEvent + sizeof(header);
+  const char* pEnd = pEvent + std::min<size_t>(iSize, header.iSize);
+
+  std::string strResult;
+  const char* p = header.strFormat;
+  while (*p)
+  {
+    if (*p != '%')
+    {
+      const char* pNext = strchr(p, '%');
+      if (!pNext)
+        pNext = p + strlen(p);
+      strResult.append(p, pNext - p);
+      p = pNext;
+      continue;
+    }
+    if (p[1] == '%')
+    {
+      strResult += '%';
+      p += 2;
+      continue;
+    }
+
+    /* keep flags, width and precision; the length comes from the argument */
+    std::string strSpec = "%";
+    const char* q = p + 1;
+    while (*q && strchr("-+ #0", *q))
+      strSpec += *q++;
+    while (isdigit((unsigned char)*q))
+      strSpec += *q++;
+    if (*q == '.')
+    {
+      strSpec += *q++;
+      while (isdigit((unsigned char)*q))
+        strSpec += *q++;
+    }
+    while (*q && strchr("hljztLq", *q))
+      ++q;
+    const char conversion = *q;
+    if (!conversion)
+      break;
+    p = q + 1;
+
+    if (pArg >= pEnd)
+    {
+      strResult += "(missing)";
+      continue;
+    }
+
+    const char tag = *pArg++;
+    long long iValue = 0;
+    double fValue = 0.0;
+    const void* pValue = nullptr;
+    std::string strValue;
+    switch (tag)
+    {
+      case Event::TAG_SIGNED:
+      case Event::TAG_UNSIGNED:
+        memcpy(&iValue, pArg, sizeof(iValue));
+        pArg += sizeof(iValue);
+        break;
+      case Event::TAG_DOUBLE:
+        memcpy(&fValue, pArg, sizeof(fValue));
+        pArg += sizeof(fValue);
+        break;
+      case Event::TAG_POINTER:
+        memcpy(&pValue, pArg, sizeof(pValue));
+        pArg += sizeof(pValue);
+        break;
+      case Event::TAG_STRING:
+      {
+        uint16_t iLength;
+        memcpy(&iLength, pArg, sizeof(iLength));
+        strValue.assign(pArg + sizeof(iLength), iLength);
+        pArg += sizeof(iLength) + iLength;
+        break;
+      }
+      default:
+        pArg = pEnd;
+        strResult += "(?)";
+        continue;
+    }
+
+    const bool bInteger = tag == Event::TAG_SIGNED || tag == Event::TAG_UNSIGNED;
+    switch (conversion)
+    {
+      case 'd': case 'i': case 'o': case 'u': case 'x': case 'X':
+        if (bInteger)
+          AppendFormatted(strResult, (strSpec + "ll" + conversion).c_str(), iValue);
+        else
+          strResult += "(?)";
+        break;
+      case 'c':
+        if (bInteger)
+          AppendFormatted(strResult, (strSpec + 'c').c_str(), (int)iValue);
+        else
+          strResult += "(?)";
+        break;
+      case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+        if (tag == Event::TAG_DOUBLE)
+          AppendFormatted(strResult, (strSpec + conversion).c_str(), fValue);
+        else
+          strResult += "(?)";
+        break;
+      case 's':
+        if (tag != Event::TAG_STRING)
+          strResult += "(?)";
+        else if (strSpec.size() == 1)
+          strResult += strValue;
+        else
+          AppendFormatted(strResult, (strSpec + 's').c_str(), strValue.c_str());
+        break;
+      case 'p':
+        if (tag == Event::TAG_POINTER)
+          AppendFormatted(strResult, (strSpec + 'p').c_str(), pValue);
+        else
+          strResult += "(?)";
+        break;
+      default:
+        strResult += "(?)";
+        break;
+    }
+  }
+  return strResult;
+}
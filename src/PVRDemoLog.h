@@ -0,0 +1,185 @@
+/*
+ *  Copyright (C) 2011-2020 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2011 Pulse-Eight (http://www.pulse-eight.com/)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include "kodi/libXBMC_addon.h"
+
+#include <atomic>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+
+/*!
+ * Log a printf style message through the add-on log. Nothing, arguments
+ * included, is evaluated unless the level is enabled and the call site is
+ * within its rate limit.
+ */
+#define PVRDEMO_LOG(level, ...) \
+  do \
+  { \
+    if (PVRDemoLog::IsEnabled(level)) \
+    { \
+      static PVRDemoLog::Site logSite(level, PVRDemoLog::FormatOf(__VA_ARGS__)); \
+      if (logSite.Admit()) \
+        PVRDemoLog::Write(level, __VA_ARGS__); \
+    } \
+  } while (0)
+
+/*!
+ * Asynchronous add-on log. An enabled message is stored as its format
+ * pointer plus the arguments in binary form, in a ring owned by the calling
+ * thread; a background thread formats it and hands it to Kodi. Before
+ * Start() and after Stop() messages are formatted and written right away.
+ *
+ * Per call site at most RATE_LIMIT messages a second are accepted. The
+ * rest are only counted, and collapsed into a single line once the second
+ * is over; so are messages dropped because a thread's ring was full.
+ *
+ * Format strings must be literals: they are kept by pointer.
+ */
+class PVRDemoLog
+{
+public:
+  static const int    RATE_LIMIT         = 20;
+  static const int    FLUSH_INTERVAL_MS  = 100;
+  static const size_t THREAD_BUFFER_SIZE = 64 * 1024;
+  static const size_t MAX_EVENT_SIZE     = 1024;
+
+  static bool IsEnabled(ADDON::addon_log level)
+  {
+    return (int)level >= m_iLevel.load(std::memory_order_relaxed);
+  }
+
+  static void SetLevel(ADDON::addon_log level);
+
+  static void Start(void);
+
+  /* forward everything still queued and go back to writing synchronously */
+  static void Stop(void);
+
+  /*!
+   * State of one PVRDEMO_LOG call site. Sites register themselves on first
+   * use so the background thread can report what they suppressed.
+   */
+  class Site
+  {
+  public:
+    Site(ADDON::addon_log level, const char* strFormat);
+
+    /* whether a message may be logged now; counts it as suppressed if not */
+    bool Admit(void);
+
+    /* suppressed messages of a window that is over, resets the count */
+    unsigned TakeSuppressed(int64_t iNow, bool bFinal);
+
+    const ADDON::addon_log m_level;
+    const char* const      m_strFormat;
+
+  private:
+    std::atomic<int64_t>  m_iWindowStart;
+    std::atomic<int>      m_iCount;
+    std::atomic<unsigned> m_iSuppressed;
+  };
+
+  /*
+   * Arguments are taken by value: a reference would odr-use a static const
+   * member passed as one, which then needs a definition it may not have.
+   */
+  template<typename... Args>
+  static const char* FormatOf(const char* strFormat, Args...) { return strFormat; }
+
+  template<typename... Args>
+  static void Write(ADDON::addon_log level, const char* strFormat, Args... args)
+  {
+    Event event(level, strFormat);
+    Encode(event, args...);
+    Submit(event);
+  }
+
+  /*!
+   * One log message in binary form: a header followed by one tag byte and
+   * a payload per argument. Strings are copied, and truncated when the
+   * message would not fit.
+   */
+  class Event
+  {
+  public:
+    enum Tag
+    {
+      TAG_SIGNED   = 'i',
+      TAG_UNSIGNED = 'u',
+      TAG_DOUBLE   = 'd',
+      TAG_STRING   = 's',
+      TAG_POINTER  = 'p'
+    };
+
+    struct Header
+    {
+      uint32_t    iSize;
+      int32_t     iLevel;
+      const char* strFormat;
+    };
+
+    Event(ADDON::addon_log level, const char* strFormat);
+
+    void Add(long long iValue)          { Append(TAG_SIGNED, &iValue, sizeof(iValue)); }
+    void Add(unsigned long long iValue) { Append(TAG_UNSIGNED, &iValue, sizeof(iValue)); }
+    void Add(double fValue)             { Append(TAG_DOUBLE, &fValue, sizeof(fValue)); }
+    void Add(const void* pValue)        { Append(TAG_POINTER, &pValue, sizeof(pValue)); }
+    void Add(const char* strValue);
+
+    const char* Data(void) const { return m_data; }
+    size_t Size(void) const { return m_iSize; }
+
+  private:
+    void Append(char tag, const void* pValue, size_t iSize);
+
+    char   m_data[MAX_EVENT_SIZE];
+    size_t m_iSize;
+  };
+
+  /* format an event as printf would have */
+  static std::string Format(const char* pEvent, size_t iSize);
+
+private:
+  static void Encode(Event&) {}
+
+  template<typename T, typename... Args>
+  static void Encode(Event& event, const T& value, const Args&... args)
+  {
+    Add(event, value);
+    Encode(event, args...);
+  }
+
+  static void Add(Event& event, char value)                     { event.Add((long long)value); }
+  static void Add(Event& event, signed char value)              { event.Add((long long)value); }
+  static void Add(Event& event, unsigned char value)            { event.Add((unsigned long long)value); }
+  static void Add(Event& event, bool value)                     { event.Add((long long)value); }
+  static void Add(Event& event, short value)                    { event.Add((long long)value); }
+  static void Add(Event& event, unsigned short value)           { event.Add((unsigned long long)value); }
+  static void Add(Event& event, int value)                      { event.Add((long long)value); }
+  static void Add(Event& event, unsigned int value)             { event.Add((unsigned long long)value); }
+  static void Add(Event& event, long value)                     { event.Add((long long)value); }
+  static void Add(Event& event, unsigned long value)            { event.Add((unsigned long long)value); }
+  static void Add(Event& event, long long value)                { event.Add(value); }
+  static void Add(Event& event, unsigned long long value)       { event.Add(value); }
+  static void Add(Event& event, float value)                    { event.Add((double)value); }
+  static void Add(Event& event, double value)                   { event.Add(value); }
+  static void Add(Event& event, const char* value)              { event.Add(value); }
+  static void Add(Event& event, char* value)                    { event.Add((const char*)value); }
+  static void Add(Event& event, const std::string& value)       { event.Add(value.c_str()); }
+  template<size_t N>
+  static void Add(Event& event, const char (&value)[N])         { event.Add((const char*)value); }
+  template<typename T>
+  static void Add(Event& event, T* value)                       { event.Add((const void*)value); }
+
+  static void Submit(const Event& event);
+
+  static std::atomic<int> m_iLevel;
+};
@@ -0,0 +1,789 @@
+/*
+ *  Copyright (C) 2011-2020 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2011 Pulse-Eight (http://www.pulse-eight.com/)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "PVRDemoPng.h"
+
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+
+namespace
+{
+
+const uint8_t SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+enum ColourType
+{
+  COLOUR_GREY       = 0,
+  COLOUR_RGB        = 2,
+  COLOUR_PALETTE    = 3,
+  COLOUR_GREY_ALPHA = 4,
+  COLOUR_RGBA       = 6
+};
+
+/* deflate's length and distance codes, RFC 1951 3.2.5 */
+const uint16_t LENGTH_BASE[29]  = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+const uint8_t  LENGTH_EXTRA[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+const uint16_t DIST_BASE[30]    = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+                                    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+const uint8_t  DIST_EXTRA[30]   = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+                                    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+const size_t WINDOW     = 32768;
+const size_t MIN_MATCH  = 3;
+const size_t MAX_MATCH  = 258;
+const int    MAX_CHAIN  = 64;
+const int    HASH_BITS  = 15;
+
+uint32_t GetU32(const uint8_t* p)
+{
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+void PutU32(std::vector<uint8_t>& out, uint32_t iValue)
+{
+  out.push_back((uint8_t)(iValue >> 24));
+  out.push_back((uint8_t)(iValue >> 16));
+  out.push_back((uint8_t)(iValue >> 8));
+  out.push_back((uint8_t)iValue);
+}
+
+uint32_t Crc32(const uint8_t* pData, size_t iSize, uint32_t iCrc = 0)
+{
+  static const struct Table
+  {
+    uint32_t entries[256];
+    Table(void)
+    {
+      for (uint32_t i = 0; i < 256; ++i)
+      {
+        uint32_t c = i;
+        for (int k = 0; k < 8; ++k)
+          c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+        entries[i] = c;
+      }
+    }
+  } table;
+
+  iCrc = ~iCrc;
+  for (size_t i = 0; i < iSize; ++i)
+    iCrc = table.entries[(iCrc ^ pData[i]) & 0xff] ^ (iCrc >> 8);
+  return ~iCrc;
+}
+
+uint32_t Adler32(const uint8_t* pData, size_t iSize)
+{
+  uint32_t a = 1, b = 0;
+  while (iSize > 0)
+  {
+    /* the most bytes before b can overflow */
+    const size_t iRun = std::min<size_t>(iSize, 5552);
+    for (size_t i = 0; i < iRun; ++i)
+    {
+      a += pData[i];
+      b += a;
+    }
+    a %= 65521;
+    b %= 65521;
+    pData += iRun;
+    iSize -= iRun;
+  }
+  return (b << 16) | a;
+}
+
+void PutChunk(std::vector<uint8_t>& out, const char* strType, const std::vector<uint8_t>& data)
+{
+  PutU32(out, (uint32_t)data.size());
+  const size_t iStart = out.size();
+  out.insert(out.end(), strType, strType + 4);
+  out.insert(out.end(), data.begin(), data.end());
+  PutU32(out, Crc32(out.data() + iStart, out.size() - iStart));
+}
+
+class BitReader
+{
+public:
+  BitReader(const uint8_t* pData, size_t iSize) : m_pData(pData), m_iSize(iSize) {}
+
+  bool Get(int iCount, uint32_t& iValue)
+  {
+    while (m_iCount < iCount)
+    {
+      if (m_iPos == m_iSize)
+        return false;
+      m_iBits |= (uint32_t)m_pData[m_iPos++] << m_iCount;
+      m_iCount += 8;
+    }
+    iValue = m_iBits & ((1u << iCount) - 1);
+    m_iBits >>= iCount;
+    m_iCount -= iCount;
+    return true;
+  }
+
+  void AlignToByte(void)
+  {
+    m_iBits >>= m_iCount & 7;
+    m_iCount -= m_iCount & 7;
+  }
+
+private:
+  const uint8_t* m_pData;
+  size_t         m_iSize;
+  size_t         m_iPos = 0;
+  uint32_t       m_iBits = 0;
+  int            m_iCount = 0;
+};
+
+/* a canonical Huffman code as the number of codes of each length and the symbols in code order */
+struct Huffman
+{
+  uint16_t counts[16];
+  uint16_t symbols[288];
+
+  bool Build(const uint8_t* pLengths, int iSymbols)
+  {
+    memset(counts, 0, sizeof(counts));
+    for (int i = 0; i < iSymbols; ++i)
+      counts[pLengths[i]]++;
+    counts[0] = 0;
+
+    int iLeft = 1;
+    uint16_t offsets[16] = {};
+    for (int iLength = 1; iLength < 16; ++iLength)
+    {
+      iLeft = (iLeft << 1) - counts[iLength];
+      if (iLeft < 0)
+        return false;
+      if (iLength < 15)
+        offsets[iLength + 1] = offsets[iLength] + counts[iLength];
+    }
+    for (int i = 0; i < iSymbols; ++i)
+      if (pLengths[i])
+        symbols[offsets[pLengths[i]]++] = (uint16_t)i;
+    return true;
+  }
+
+  /* one bit at a time, the codes of an icon are too few to need a table */
+  int Decode(BitReader& in) const
+  {
+    int iCode = 0, iFirst = 0, iIndex = 0;
+    for (int iLength = 1; iLength < 16; ++iLength)
+    {
+      uint32_t iBit;
+      if (!in.Get(1, iBit))
+        return -1;
+      iCode |= (int)iBit;
+      const int iCount = counts[iLength];
+      if (iCode - iCount < iFirst)
+        return symbols[iIndex + (iCode - iFirst)];
+      iIndex += iCount;
+      iFirst = (iFirst + iCount) << 1;
+      iCode <<= 1;
+    }
+    return -1;
+  }
+};
+
+bool InflateCodes(BitReader& in, const Huffman& literals, const Huffman& distances, std::vector<uint8_t>& out, size_t iLimit)
+{
+  for (;;)
+  {
+    const int iSymbol = literals.Decode(in);
+    if (iSymbol < 0)
+      return false;
+    if (iSymbol < 256)
+    {
+      if (out.size() == iLimit)
+        return false;
+      out.push_back((uint8_t)iSymbol);
+      continue;
+    }
+    if (iSymbol == 256)
+      return true;
+
+    const int iLengthCode = iSymbol - 257;
+    uint32_t iExtra;
+    if (iLengthCode >= 29 || !in.Get(LENGTH_EXTRA[iLengthCode], iExtra))
+      return false;
+    const size_t iLength = LENGTH_BASE[iLengthCode] + iExtra;
+
+    const int iDistCode = distances.Decode(in);
+    if (iDistCode < 0 || iDistCode >= 30 || !in.Get(DIST_EXTRA[iDistCode], iExtra))
+      return false;
+    const size_t iDistance = DIST_BASE[iDistCode] + iExtra;
+    if (iDistance > out.size() || out.size() + iLength > iLimit)
+      return false;
+
+    /* byte by byte, a match may overlap what it copies */
+    for (size_t i = 0; i < iLength; ++i)
+      out.push_back(out[out.size() - iDistance]);
+  }
+}
+
+/* a raw deflate stream into out, which may not grow beyond iLimit bytes */
+bool Inflate(const uint8_t* pData, size_t iSize, std::vector<uint8_t>& out, size_t iLimit)
+{
+  static const struct FixedCodes
+  {
+    Huffman literals;
+    Huffman distances;
+    FixedCodes(void)
+    {
+      uint8_t lengths[288];
+      memset(lengths, 8, 144);
+      memset(lengths + 144, 9, 112);
+      memset(lengths + 256, 7, 24);
+      memset(lengths + 280, 8, 8);
+      literals.Build(lengths, 288);
+      memset(lengths, 5, 30);
+      distances.Build(lengths, 30);
+    }
+  } fixed;
+
+  static const uint8_t ORDER[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+  BitReader in(pData, iSize);
+  uint32_t iLast = 0;
+  do
+  {
+    uint32_t iType;
+    if (!in.Get(1, iLast) || !in.Get(2, iType))
+      return false;
+
+    if (iType == 0)
+    {
+      uint32_t iLength, iComplement;
+      in.AlignToByte();
+      if (!in.Get(16, iLength) || !in.Get(16, iComplement) || iLength != (~iComplement & 0xffff) ||
+          out.size() + iLength > iLimit)
+        return false;
+      for (uint32_t i = 0; i < iLength; ++i)
+      {
+        uint32_t iByte;
+        if (!in.Get(8, iByte))
+          return false;
+        out.push_back((uint8_t)iByte);
+      }
+    }
+    else if (iType == 1)
+    {
+      if (!InflateCodes(in, fixed.literals, fixed.distances, out, iLimit))
+        return false;
+    }
+    else if (iType == 2)
+    {
+      uint32_t iLiterals, iDistances, iCodeLengths;
+      if (!in.Get(5, iLiterals) || !in.Get(5, iDistances) || !in.Get(4, iCodeLengths))
+        return false;
+      iLiterals += 257;
+      iDistances += 1;
+      iCodeLengths += 4;
+
+      uint8_t lengths[320] = {};
+      for (uint32_t i = 0; i < iCodeLengths; ++i)
+      {
+        uint32_t iLength;
+        if (!in.Get(3, iLength))
+          return false;
+        lengths[ORDER[i]] = (uint8_t)iLength;
+      }
+      Huffman codeLengths;
+      if (!codeLengths.Build(lengths, 19))
+        return false;
+
+      memset(lengths, 0, sizeof(lengths));
+      for (uint32_t i = 0; i < iLiterals + iDistances;)
+      {
+        const int iSymbol = codeLengths.Decode(in);
+        if (iSymbol < 0)
+          return false;
+        if (iSymbol < 16)
+        {
+          lengths[i++] = (uint8_t)iSymbol;
+          continue;
+        }
+
+        uint32_t iRepeat;
+        uint8_t iLength = 0;
+        if (iSymbol == 16)
+        {
+          if (i == 0 || !in.Get(2, iRepeat))
+            return false;
+          iLength = lengths[i - 1];
+          iRepeat += 3;
+        }
+        else if (iSymbol == 17)
+        {
+          if (!in.Get(3, iRepeat))
+            return false;
+          iRepeat += 3;
+        }
+        else
+        {
+          if (!in.Get(7, iRepeat))
+            return false;
+          iRepeat += 11;
+        }
+        if (i + iRepeat > iLiterals + iDistances)
+          return false;
+        while (iRepeat--)
+          lengths[i++] = iLength;
+      }
+
+      Huffman literals, distances;
+      if (!literals.Build(lengths, (int)iLiterals) || !distances.Build(lengths + iLiterals, (int)iDistances) ||
+          !InflateCodes(in, literals, distances, out, iLimit))
+        return false;
+    }
+    else
+    {
+      return false;
+    }
+  } while (!iLast);
+
+  return true;
+}
+
+class BitWriter
+{
+public:
+  explicit BitWriter(std::vector<uint8_t>& out) : m_out(out) {}
+
+  void Put(uint32_t iValue, int iCount)
+  {
+    m_iBits |= (uint64_t)iValue << m_iCount;
+    m_iCount += iCount;
+    while (m_iCount >= 8)
+    {
+      m_out.push_back((uint8_t)m_iBits);
+      m_iBits >>= 8;
+      m_iCount -= 8;
+    }
+  }
+
+  /* Huffman codes are sent from their most significant bit */
+  void PutCode(uint32_t iCode, int iLength)
+  {
+    uint32_t iReversed = 0;
+    for (int i = 0; i < iLength; ++i)
+      iReversed |= ((iCode >> i) & 1) << (iLength - 1 - i);
+    Put(iReversed, iLength);
+  }
+
+  void Flush(void)
+  {
+    if (m_iCount > 0)
+      m_out.push_back((uint8_t)m_iBits);
+    m_iBits = 0;
+    m_iCount = 0;
+  }
+
+private:
+  std::vector<uint8_t>& m_out;
+  uint64_t              m_iBits = 0;
+  int                   m_iCount = 0;
+};
+
+void PutLiteral(BitWriter& out, int iSymbol)
+{
+  if (iSymbol < 144)
+    out.PutCode(0x30 + iSymbol, 8);
+  else if (iSymbol < 256)
+    out.PutCode(0x190 + iSymbol - 144, 9);
+  else if (iSymbol < 280)
+    out.PutCode(iSymbol - 256, 7);
+  else
+    out.PutCode(0xc0 + iSymbol - 280, 8);
+}
+
+void PutMatch(BitWriter& out, size_t iLength, size_t iDistance)
+{
+  int iCode = 28;
+  while (LENGTH_BASE[iCode] > iLength)
+    --iCode;
+  PutLiteral(out, 257 + iCode);
+  out.Put((uint32_t)(iLength - LENGTH_BASE[iCode]), LENGTH_EXTRA[iCode]);
+
+  iCode = 29;
+  while (DIST_BASE[iCode] > iDistance)
+    --iCode;
+  out.PutCode(iCode, 5);
+  out.Put((uint32_t)(iDistance - DIST_BASE[iCode]), DIST_EXTRA[iCode]);
+}
+
+/* one final block with the fixed codes and greedy matches along hash chains */
+void Deflate(const uint8_t* pData, size_t iSize, std::vector<uint8_t>& out)
+{
+  std::vector<int32_t> head(1 << HASH_BITS, -1);
+  std::vector<int32_t> chain(std::min(iSize, WINDOW), -1);
+  auto hash = [pData](size_t i) {
+    return (((uint32_t)pData[i] << 16 | (uint32_t)pData[i + 1] << 8 | pData[i + 2]) * 2654435761u) >> (32 - HASH_BITS);
+  };
+  auto insert = [&](size_t i) {
+    const uint32_t iSlot = hash(i);
+    chain[i % WINDOW] = head[iSlot];
+    head[iSlot] = (int32_t)i;
+  };
+
+  BitWriter bits(out);
+  bits.Put(1, 1); // final block
+  bits.Put(1, 2); // fixed codes
+
+  size_t i = 0;
+  while (i < iSize)
+  {
+    size_t iBestLength = 0, iBestDistance = 0;
+    if (i + MIN_MATCH <= iSize)
+    {
+      const size_t iMaxLength = std::min(MAX_MATCH, iSize - i);
+      int32_t iCandidate = head[hash(i)];
+      for (int iChain = 0; iCandidate >= 0 && i - iCandidate <= WINDOW && iChain < MAX_CHAIN; ++iChain)
+      {
+        size_t iLength = 0;
+        while (iLength < iMaxLength && pData[iCandidate + iLength] == pData[i + iLength])
+          ++iLength;
+        if (iLength > iBestLength)
+        {
+          iBestLength = iLength;
+          iBestDistance = i - iCandidate;
+          if (iLength == iMaxLength)
+            break;
+        }
+        const int32_t iNext = chain[iCandidate % WINDOW];
+        if (iNext >= iCandidate)
+          break;
+        iCandidate = iNext;
+      }
+    }
+
+    if (iBestLength >= MIN_MATCH)
+    {
+      PutMatch(bits, iBestLength, iBestDistance);
+      for (size_t iEnd = i + iBestLength; i < iEnd; ++i)
+        if (i + MIN_MATCH <= iSize)
+          insert(i);
+    }
+    else
+    {
+      PutLiteral(bits, pData[i]);
+      if (i + MIN_MATCH <= iSize)
+        insert(i);
+      ++i;
+    }
+  }
+
+  PutLiteral(bits, 256);
+  bits.Flush();
+}
+
+uint8_t Paeth(int a, int b, int c)
+{
+  const int p = a + b - c;
+  const int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+  if (pa <= pb && pa <= pc)
+    return (uint8_t)a;
+  return (uint8_t)(pb <= pc ? b : c);
+}
+
+/* the byte filter iFilter writes for x, given the byte left of it, above it and above left */
+uint8_t Predict(int iFilter, int iLeft, int iUp, int iUpLeft)
+{
+  switch (iFilter)
+  {
+  case 1: return (uint8_t)iLeft;
+  case 2: return (uint8_t)iUp;
+  case 3: return (uint8_t)((iLeft + iUp) / 2);
+  case 4: return Paeth(iLeft, iUp, iUpLeft);
+  default: return 0;
+  }
+}
+
+}
+
+bool PVRDemoPng::Size(const uint8_t* pData, size_t iSize, int& iWidth, int& iHeight)
+{
+  if (iSize < 33 || memcmp(pData, SIGNATURE, sizeof(SIGNATURE)) != 0 || memcmp(pData + 12, "IHDR", 4) != 0)
+    return false;
+  iWidth = (int)std::min<uint32_t>(GetU32(pData + 16), 0x7fffffff);
+  iHeight = (int)std::min<uint32_t>(GetU32(pData + 20), 0x7fffffff);
+  return true;
+}
+
+bool PVRDemoPng::Decode(const uint8_t* pData, size_t iSize, PVRDemoImage& image)
+{
+  int iWidth, iHeight;
+  if (!Size(pData, iSize, iWidth, iHeight) || iWidth < 1 || iHeight < 1 || iWidth > MAX_SIDE || iHeight > MAX_SIDE)
+    return false;
+
+  const uint8_t iDepth = pData[24], iColour = pData[25], iInterlace = pData[28];
+  int iChannels;
+  switch (iColour)
+  {
+  case COLOUR_GREY:       iChannels = 1; break;
+  case COLOUR_RGB:        iChannels = 3; break;
+  case COLOUR_PALETTE:    iChannels = 1; break;
+  case COLOUR_GREY_ALPHA: iChannels = 2; break;
+  case COLOUR_RGBA:       iChannels = 4; break;
+  default: return false;
+  }
+  if (iDepth != 8 || iInterlace != 0)
+    return false;
+
+  uint8_t palette[256][4];
+  memset(palette, 0xff, sizeof(palette));
+  int iTransparent[3] = { -1, -1, -1 };
+  std::vector<uint8_t> compressed;
+
+  for (size_t iPos = 8; iPos + 12 <= iSize;)
+  {
+    const uint32_t iLength = GetU32(pData + iPos);
+    const uint8_t* pType = pData + iPos + 4;
+    const uint8_t* pChunk = pData + iPos + 8;
+    if (iLength > iSize - iPos - 12)
+      return false;
+
+    if (memcmp(pType, "PLTE", 4) == 0)
+    {
+      for (uint32_t i = 0; i < iLength / 3 && i < 256; ++i)
+        memcpy(palette[i], pChunk + i * 3, 3);
+    }
+    else if (memcmp(pType, "tRNS", 4) == 0)
+    {
+      if (iColour == COLOUR_PALETTE)
+      {
+        for (uint32_t i = 0; i < iLength && i < 256; ++i)
+          palette[i][3] = pChunk[i];
+      }
+      else if (iColour == COLOUR_GREY && iLength >= 2)
+      {
+        iTransparent[0] = iTransparent[1] = iTransparent[2] = pChunk[1];
+      }
+      else if (iColour == COLOUR_RGB && iLength >= 6)
+      {
+        for (int c = 0; c < 3; ++c)
+          iTransparent[c] = pChunk[c * 2 + 1];
+      }
+    }
+    else if (memcmp(pType, "IDAT", 4) == 0)
+    {
+      compressed.insert(compressed.end(), pChunk, pChunk + iLength);
+    }
+    else if (memcmp(pType, "IEND", 4) == 0)
+    {
+      break;
+    }
+    iPos += 12 + iLength;
+  }
+
+  /* a zlib stream: deflate, no preset dictionary */
+  if (compressed.size() < 6 || (compressed[0] & 0x0f) != 8 || ((compressed[0] << 8) | compressed[1]) % 31 != 0 ||
+      (compressed[1] & 0x20))
+    return false;
+
+  const size_t iStride = (size_t)iWidth * iChannels;
+  std::vector<uint8_t> raw;
+  raw.reserve((iStride + 1) * iHeight);
+  if (!Inflate(compressed.data() + 2, compressed.size() - 2, raw, (iStride + 1) * iHeight) ||
+      raw.size() != (iStride + 1) * iHeight)
+    return false;
+
+  /* undo the filters in place, each row leaves its filter byte in front */
+  for (int y = 0; y < iHeight; ++y)
+  {
+    uint8_t* pRow = raw.data() + y * (iStride + 1);
+    const uint8_t* pUp = y > 0 ? pRow - iStride : nullptr;
+    const int iFilter = pRow[0];
+    if (iFilter > 4)
+      return false;
+    ++pRow;
+    for (size_t x = 0; x < iStride; ++x)
+    {
+      const int iLeft = x >= (size_t)iChannels ? pRow[x - iChannels] : 0;
+      const int iUp = pUp ? pUp[x] : 0;
+      const int iUpLeft = pUp && x >= (size_t)iChannels ? pUp[x - iChannels] : 0;
+      pRow[x] = (uint8_t)(pRow[x] + Predict(iFilter, iLeft, iUp, iUpLeft));
+    }
+  }
+
+  image.iWidth = iWidth;
+  image.iHeight = iHeight;
+  image.pixels.resize((size_t)iWidth * iHeight * 4);
+  uint8_t* pOut = image.pixels.data();
+  for (int y = 0; y < iHeight; ++y)
+  {
+    const uint8_t* pRow = raw.data() + y * (iStride + 1) + 1;
+    for (int x = 0; x < iWidth; ++x, pOut += 4)
+    {
+      const uint8_t* p = pRow + x * iChannels;
+      switch (iColour)
+      {
+      case COLOUR_GREY:
+        pOut[0] = pOut[1] = pOut[2] = p[0];
+        pOut[3] = p[0] == iTransparent[0] ? 0 : 255;
+        break;
+      case COLOUR_RGB:
+        memcpy(pOut, p, 3);
+        pOut[3] = p[0] == iTransparent[0] && p[1] == iTransparent[1] && p[2] == iTransparent[2] ? 0 : 255;
+        break;
+      case COLOUR_PALETTE:
+        memcpy(pOut, palette[p[0]], 4);
+        break;
+      case COLOUR_GREY_ALPHA:
+        pOut[0] = pOut[1] = pOut[2] = p[0];
+        pOut[3] = p[1];
+        break;
+      default:
+        memcpy(pOut, p, 4);
+        break;
+      }
+    }
+  }
+  return true;
+}
+
+void PVRDemoPng::Encode(const PVRDemoImage& image, std::vector<uint8_t>& out)
+{
+  bool bAlpha = false;
+  for (size_t i = 3; i < image.pixels.size() && !bAlpha; i += 4)
+    bAlpha = image.pixels[i] != 255;
+  const int iChannels = bAlpha ? 4 : 3;
+  const size_t iStride = (size_t)image.iWidth * iChannels;
+
+  std::vector<uint8_t> rows((size_t)image.iHeight * iStride);
+  for (size_t i = 0, j = 0; i < image.pixels.size(); i += 4, j += iChannels)
+    memcpy(rows.data() + j, image.pixels.data() + i, iChannels);
+
+  /* per row the filter whose output sums to the least, taken as signed bytes */
+  std::vector<uint8_t> filtered;
+  filtered.reserve((iStride + 1) * image.iHeight);
+  std::vector<uint8_t> candidate(iStride);
+  std::vector<uint8_t> best(iStride);
+  for (int y = 0; y < image.iHeight; ++y)
+  {
+    const uint8_t* pRow = rows.data() + y * iStride;
+    const uint8_t* pUp = y > 0 ? pRow - iStride : nullptr;
+    int iBestFilter = 0;
+    long iBestCost = -1;
+    for (int iFilter = 0; iFilter <= 4; ++iFilter)
+    {
+      long iCost = 0;
+      for (size_t x = 0; x < iStride; ++x)
+      {
+        const int iLeft = x >= (size_t)iChannels ? pRow[x - iChannels] : 0;
+        const int iUp = pUp ? pUp[x] : 0;
+        const int iUpLeft = pUp && x >= (size_t)iChannels ? pUp[x - iChannels] : 0;
+        candidate[x] = (uint8_t)(pRow[x] - Predict(iFilter, iLeft, iUp, iUpLeft));
+        iCost += abs((int)(int8_t)candidate[x]);
+      }
+      if (iBestCost < 0 || iCost < iBestCost)
+      {
+        iBestCost = iCost;
+        iBestFilter = iFilter;
+        best.swap(candidate);
+      }
+    }
+    filtered.push_back((uint8_t)iBestFilter);
+    filtered.insert(filtered.end(), best.begin(), best.end());
+  }
+
+  std::vector<uint8_t> chunk;
+  out.assign(SIGNATURE, SIGNATURE + sizeof(SIGNATURE));
+  PutU32(chunk, (uint32_t)image.iWidth);
+  PutU32(chunk, (uint32_t)image.iHeight);
+  chunk.push_back(8);
+  chunk.push_back(bAlpha ? COLOUR_RGBA : COLOUR_RGB);
+  chunk.push_back(0); // deflate
+  chunk.push_back(0); // adaptive filters
+  chunk.push_back(0); // not interlaced
+  PutChunk(out, "IHDR", chunk);
+
+  chunk.assign({ 0x78, 0x01 });
+  Deflate(filtered.data(), filtered.size(), chunk);
+  PutU32(chunk, Adler32(filtered.data(), filtered.size()));
+  PutChunk(out, "IDAT", chunk);
+
+  chunk.clear();
+  PutChunk(out, "IEND", chunk);
+}
+
+void PVRDemoPng::Scale(const PVRDemoImage& image, int iMaxSide, PVRDemoImage& scaled)
+{
+  const int iLongest = std::max(image.iWidth, image.iHeight);
+  if (iLongest <= iMaxSide)
+  {
+    scaled = image;
+    return;
+  }
+  scaled.iWidth = std::max(1, (int)((int64_t)image.iWidth * iMaxSide / iLongest));
+  scaled.iHeight = std::max(1, (int)((int64_t)image.iHeight * iMaxSide / iLongest));
+
+  /* each output pixel averages the source area it covers, weighting partly covered pixels by the part */
+  struct Tap
+  {
+    int   iSource;
+    float fWeight;
+  };
+  auto taps = [](int iFrom, int iTo) {
+    std::vector<std::vector<Tap>> result(iTo);
+    const double fStep = (double)iFrom / iTo;
+    for (int i = 0; i < iTo; ++i)
+    {
+      const double fStart = i * fStep, fEnd = (i + 1) * fStep;
+      for (int s = (int)fStart; s < iFrom && s < fEnd; ++s)
+      {
+        const double fCovered = std::min<double>(s + 1, fEnd) - std::max<double>(s, fStart);
+        if (fCovered > 0)
+          result[i].push_back({ s, (float)(fCovered / fStep) });
+      }
+    }
+    return result;
+  };
+  const std::vector<std::vector<Tap>> columns = taps(image.iWidth, scaled.iWidth);
+  const std::vector<std::vector<Tap>> rows = taps(image.iHeight, scaled.iHeight);
+
+  /* colour is weighted by alpha so transparent pixels do not darken the edges */
+  std::vector<float> horizontal((size_t)image.iHeight * scaled.iWidth * 4);
+  for (int y = 0; y < image.iHeight; ++y)
+  {
+    const uint8_t* pRow = image.pixels.data() + (size_t)y * image.iWidth * 4;
+    float* pOut = horizontal.data() + (size_t)y * scaled.iWidth * 4;
+    for (int x = 0; x < scaled.iWidth; ++x, pOut += 4)
+    {
+      for (const Tap& tap : columns[x])
+      {
+        const uint8_t* p = pRow + tap.iSource * 4;
+        const float fAlpha = p[3] * tap.fWeight;
+        pOut[0] += p[0] * fAlpha;
+        pOut[1] += p[1] * fAlpha;
+        pOut[2] += p[2] * fAlpha;
+        pOut[3] += fAlpha;
+      }
+    }
+  }
+
+  scaled.pixels.resize((size_t)scaled.iWidth * scaled.iHeight * 4);
+  uint8_t* pOut = scaled.pixels.data();
+  for (int y = 0; y < scaled.iHeight; ++y)
+  {
+    for (int x = 0; x < scaled.iWidth; ++x, pOut += 4)
+    {
+      float sum[4] = {};
+      for (const Tap& tap : rows[y])
+      {
+        const float* p = horizontal.data() + ((size_t)tap.iSource * scaled.iWidth + x) * 4;
+        for (int c = 0; c < 4; ++c)
+          sum[c] += p[c] * tap.fWeight;
+      }
+      for (int c = 0; c < 3; ++c)
+        pOut[c] = sum[3] > 0 ? (uint8_t)std::min(255.0f, sum[c] / sum[3] + 0.5f) : 0;
+      pOut[3] = (uint8_t)std::min(255.0f, sum[3] + 0.5f);
+    }
+  }
+}
@@ -0,0 +1,44 @@
+/*
+ *  Copyright (C) 2011-2020 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2011 Pulse-Eight (http://www.pulse-eight.com/)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+/* 8 bits per channel RGBA pixels, rows top down */
+struct PVRDemoImage
+{
+  int                  iWidth  = 0;
+  int                  iHeight = 0;
+  std::vector<uint8_t> pixels;
+};
+
+/*!
+ * As much PNG as icon thumbnails need, without an image library. Decode()
+ * reads non-interlaced images of 8 bits per channel in every colour type;
+ * Encode() writes RGB, or RGBA when a pixel is not opaque, as one deflate
+ * block with the fixed codes.
+ */
+class PVRDemoPng
+{
+public:
+  static const int MAX_SIDE = 8192; // larger images are not decoded
+
+  /* the dimensions from the header, false if pData does not start like a PNG */
+  static bool Size(const uint8_t* pData, size_t iSize, int& iWidth, int& iHeight);
+
+  /* false if pData is not a PNG Decode() can read, image is undefined then */
+  static bool Decode(const uint8_t* pData, size_t iSize, PVRDemoImage& image);
+
+  static void Encode(const PVRDemoImage& image, std::vector<uint8_t>& out);
+
+  /* image averaged down until neither side is longer than iMaxSide, keeping its aspect ratio */
+  static void Scale(const PVRDemoImage& image, int iMaxSide, PVRDemoImage& scaled);
+};
@@ -0,0 +1,80 @@
+/*
+ *  Copyright (C) 2011-2020 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2011 Pulse-Eight (http://www.pulse-eight.com/)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "PVRDemoPublished.h"
+
+namespace
+{
+/* every record ever made; records are reused, never freed */
+std::atomic<PVRDemoHazard::Record*> g_records(nullptr);
+
+PVRDemoHazard::Record* TakeRecord(void)
+{
+  for (PVRDemoHazard::Record* record = g_records.load(std::memory_order_acquire); record; record = record->next)
+  {
+    bool bActive = false;
+    if (!record->bActive.load(std::memory_order_relaxed) && record->bActive.compare_exchange_strong(bActive, true))
+      return record;
+  }
+
+  PVRDemoHazard::Record* record = new PVRDemoHazard::Record();
+  record->next = g_records.load(std::memory_order_relaxed);
+  while (!g_records.compare_exchange_weak(record->next, record, std::memory_order_release, std::memory_order_relaxed))
+    ;
+  return record;
+}
+
+/* the records a thread is not using right now, handed back when it exits */
+struct ThreadRecords
+{
+  std::vector<PVRDemoHazard::Record*> records;
+  bool                                bExited = false;
+
+  ~ThreadRecords(void)
+  {
+    bExited = true;
+    for (PVRDemoHazard::Record* record : records)
+      record->bActive.store(false, std::memory_order_release);
+    records.clear();
+  }
+};
+
+thread_local ThreadRecords t_records;
+}
+
+PVRDemoHazard::PVRDemoHazard(void)
+{
+  if (t_records.records.empty() || t_records.bExited)
+  {
+    m_record = TakeRecord();
+    return;
+  }
+  m_record = t_records.records.back();
+  t_records.records.pop_back();
+}
+
+PVRDemoHazard::~PVRDemoHazard(void)
+{
+  m_record->pointer.store(nullptr, std::memory_order_release);
+  if (t_records.bExited)
+    m_record->bActive.store(false, std::memory_order_release);
+  else
+    t_records.records.push_back(m_record);
+}
+
+void PVRDemoHazard::Collect(std::vector<const void*>& pointers)
+{
+  pointers.clear();
+  for (Record* record = g_records.load(std::memory_order_acquire); record; record = record->next)
+  {
+    const void* pointer = record->pointer.load(std::memory_order_seq_cst);
+    if (pointer)
+      pointers.push_back(pointer);
+  }
+  std::sort(pointers.begin(), pointers.end());
+}
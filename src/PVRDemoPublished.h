@@ -0,0 +1,193 @@
+/*
+ *  Copyright (C) 2011-2020 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2011 Pulse-Eight (http://www.pulse-eight.com/)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "p8-platform/threads/mutex.h"
+
+/*!
+ * A hazard pointer: the thread announces the object it is about to read,
+ * and whoever retires that object frees it only once no thread announces
+ * it any more. A thread keeps the records it used for its next hazards, so
+ * announcing is a store to a cache line of the thread's own and a load of
+ * the source; a record is only taken from the shared list the first time a
+ * thread nests hazards that deep.
+ */
+class PVRDemoHazard
+{
+public:
+  PVRDemoHazard(void);
+  ~PVRDemoHazard(void);
+
+  PVRDemoHazard(const PVRDemoHazard&) = delete;
+  PVRDemoHazard& operator=(const PVRDemoHazard&) = delete;
+
+  /* the current value of source, announced for as long as the hazard lives */
+  template<typename P>
+  P* Protect(const std::atomic<P*>& source)
+  {
+    P* pValue = source.load(std::memory_order_seq_cst);
+    for (;;)
+    {
+      m_record->pointer.store(pValue, std::memory_order_seq_cst);
+      P* pCurrent = source.load(std::memory_order_seq_cst);
+      if (pCurrent == pValue)
+        return pValue;
+      pValue = pCurrent;
+    }
+  }
+
+  /* stop announcing before the hazard goes */
+  void Clear(void) { m_record->pointer.store(nullptr, std::memory_order_release); }
+
+  /* the pointers announced by all threads right now, sorted */
+  static void Collect(std::vector<const void*>& pointers);
+
+  struct Record
+  {
+    char                     before[64];  // the pointer has a cache line to itself
+    std::atomic<const void*> pointer;
+    char                     after[64];
+    std::atomic<bool>        bActive;     // taken by a thread
+    Record*                  next;
+
+    Record(void) : pointer(nullptr), bActive(true), next(nullptr) {}
+  };
+
+private:
+  Record* m_record;
+};
+
+/*!
+ * A shared_ptr that one side publishes and any number of threads read
+ * without a lock. std::atomic_load() of a shared_ptr takes a mutex in
+ * libstdc++, and every reader would increment the one reference count.
+ *
+ * A Reader pins the current value with a PVRDemoHazard and touches
+ * nothing shared but the published pointer, so readers on any number of
+ * cores do not contend; Load() also takes a reference, for keeping the
+ * value beyond the reader. A value replaced while it is pinned is let go
+ * of by the last reader to unpin it, as the last reference would.
+ */
+template<typename T>
+class PVRDemoPublished
+{
+private:
+  struct Holder
+  {
+    explicit Holder(std::shared_ptr<T> value) : value(std::move(value)) {}
+    const std::shared_ptr<T> value;
+  };
+
+public:
+  class Reader
+  {
+  public:
+    explicit Reader(const PVRDemoPublished& published) :
+      m_published(published),
+      m_holder(m_hazard.Protect(published.m_current))
+    {
+    }
+
+    ~Reader(void)
+    {
+      m_hazard.Clear();
+      if (m_published.m_iRetired.load(std::memory_order_acquire) > 0)
+        m_published.Reclaim();
+    }
+
+    Reader(const Reader&) = delete;
+    Reader& operator=(const Reader&) = delete;
+
+    T* get(void) const { return m_holder ? m_holder->value.get() : nullptr; }
+    T& operator*(void) const { return *m_holder->value; }
+    T* operator->(void) const { return m_holder->value.get(); }
+    explicit operator bool(void) const { return m_holder != nullptr; }
+
+    /* a reference of its own to the value */
+    std::shared_ptr<T> Share(void) const { return m_holder ? m_holder->value : std::shared_ptr<T>(); }
+
+  private:
+    const PVRDemoPublished& m_published;
+    PVRDemoHazard           m_hazard;
+    Holder*                 m_holder;
+  };
+
+  PVRDemoPublished(void) : m_current(nullptr), m_iRetired(0) {}
+  explicit PVRDemoPublished(std::shared_ptr<T> value) : m_current(value ? new Holder(std::move(value)) : nullptr), m_iRetired(0) {}
+
+  ~PVRDemoPublished(void)
+  {
+    delete m_current.load();
+
+    /* there are no readers left, but one may still be letting go of its hazard */
+    while (!Reclaim())
+      std::this_thread::yield();
+  }
+
+  PVRDemoPublished(const PVRDemoPublished&) = delete;
+  PVRDemoPublished& operator=(const PVRDemoPublished&) = delete;
+
+  std::shared_ptr<T> Load(void) const { return Reader(*this).Share(); }
+
+  void Store(std::shared_ptr<T> value) { Exchange(std::move(value)); }
+
+  std::shared_ptr<T> Exchange(std::shared_ptr<T> value)
+  {
+    Holder* previous = m_current.exchange(value ? new Holder(std::move(value)) : nullptr, std::memory_order_seq_cst);
+    if (!previous)
+      return std::shared_ptr<T>();
+
+    std::shared_ptr<T> result = previous->value;
+    {
+      P8PLATFORM::CLockObject lock(m_retiredMutex);
+      m_retired.push_back(previous);
+      m_iRetired.store(m_retired.size(), std::memory_order_release);
+    }
+    Reclaim();
+    return result;
+  }
+
+private:
+  /* free the retired values nobody pins, true if none is left */
+  bool Reclaim(void) const
+  {
+    std::vector<Holder*> unpinned;
+    bool bEmpty;
+    {
+      P8PLATFORM::CLockObject lock(m_retiredMutex);
+      if (m_retired.empty())
+        return true;
+
+      std::vector<const void*> hazards;
+      PVRDemoHazard::Collect(hazards);
+      auto firstUnpinned = std::partition(m_retired.begin(), m_retired.end(), [&hazards](const Holder* holder) {
+        return std::binary_search(hazards.begin(), hazards.end(), static_cast<const void*>(holder));
+      });
+      unpinned.assign(firstUnpinned, m_retired.end());
+      m_retired.erase(firstUnpinned, m_retired.end());
+      m_iRetired.store(m_retired.size(), std::memory_order_release);
+      bEmpty = m_retired.empty();
+    }
+
+    /* outside the lock, a value may publish or retire others as it goes */
+    for (Holder* holder : unpinned)
+      delete holder;
+    return bEmpty;
+  }
+
+  std::atomic<Holder*>         m_current;
+  mutable P8PLATFORM::CMutex   m_retiredMutex;
+  mutable std::vector<Holder*> m_retired;   // replaced, still pinned when last looked
+  mutable std::atomic<size_t>  m_iRetired;  // their number, for readers to look at without the lock
+};
@@ -0,0 +1,526 @@
+/*
+ *  Copyright (C) 2011-2020 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2011 Pulse-Eight (http://www.pulse-eight.com/)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "PVRDemoRecorder.h"
+#include "PVRDemoStreamSource.h"
+#include "PVRDemoTextStore.h"
+#include "p8-platform/util/timeutils.h"
+
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+using namespace ADDON;
+using namespace P8PLATFORM;
+
+namespace
+{
+
+/* how long a recorded timer is remembered after its end */
+const time_t DONE_KEPT = 2 * 24 * 60 * 60;
+
+int64_t ThreadCpuUs(void)
+{
+#ifdef CLOCK_THREAD_CPUTIME_ID
+  struct timespec cpu;
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu) == 0)
+    return (int64_t)cpu.tv_sec * 1000000 + cpu.tv_nsec / 1000;
+#endif
+  return -1;
+}
+
+/* pwrite() until all of it is written */
+bool WriteAll(int fd, const uint8_t* pData, size_t iSize, uint64_t iOffset)
+{
+  while (iSize > 0)
+  {
+    ssize_t iWritten = pwrite(fd, pData, iSize, (off_t)iOffset);
+    if (iWritten < 0)
+    {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    pData   += iWritten;
+    iSize   -= (size_t)iWritten;
+    iOffset += (uint64_t)iWritten;
+  }
+  return true;
+}
+
+/* the add-on's profile directory may not exist before settings are saved */
+void CreateDirectories(const std::string& strFile)
+{
+  for (size_t iPos = strFile.find('/', 1); iPos != std::string::npos; iPos = strFile.find('/', iPos + 1))
+    mkdir(strFile.substr(0, iPos).c_str(), 0755);
+}
+
+std::string Escape(const std::string& strText)
+{
+  std::string strEscaped;
+  strEscaped.reserve(strText.size());
+  for (char c : strText)
+  {
+    switch (c)
+    {
+      case '&': strEscaped += "&amp;"; break;
+      case '<': strEscaped += "&lt;"; break;
+      case '>': strEscaped += "&gt;"; break;
+      default:  strEscaped += c; break;
+    }
+  }
+  return strEscaped;
+}
+
+}
+
+PVRDemoCapture::PVRDemoCapture(std::shared_ptr<PVRDemoSession> session, const std::string& strFile, time_t endTime) :
+  m_session(std::move(session)),
+  m_strFile(strFile),
+  m_endTime(endTime),
+  m_startTime(0),
+  m_fd(-1),
+  m_pBuffer(NULL),
+  m_bDirect(false),
+  m_iOffset(0),
+  m_iEvicted(0),
+  m_bDone(false),
+  m_bFailed(false),
+  m_statistics()
+{
+}
+
+PVRDemoCapture::~PVRDemoCapture(void)
+{
+  Finish();
+  if (m_fd >= 0)
+    close(m_fd);
+  free(m_pBuffer);
+}
+
+bool PVRDemoCapture::Start(void)
+{
+  if (posix_memalign(reinterpret_cast<void**>(&m_pBuffer), ALIGNMENT, BATCH_SIZE) != 0)
+  {
+    m_pBuffer = NULL;
+    return false;
+  }
+
+#ifdef O_DIRECT
+  /* tmpfs and some network file systems refuse it */
+  m_fd = open(m_strFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+  m_bDirect = m_fd >= 0;
+#endif
+  if (m_fd < 0)
+    m_fd = open(m_strFile.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (m_fd < 0)
+  {
+    PVRDEMO_LOG(LOG_ERROR, "%s - cannot create '%s': %s", __FUNCTION__, m_strFile.c_str(), strerror(errno));
+    return false;
+  }
+
+  m_statistics.bDirect = m_bDirect;
+  m_startTime = time(nullptr);
+  return CreateThread(false);
+}
+
+void PVRDemoCapture::Finish(void)
+{
+  StopThread();
+}
+
+PVRDemoCapture::Statistics PVRDemoCapture::GetStatistics(void) const
+{
+  return m_statistics;
+}
+
+bool PVRDemoCapture::SetDirect(bool bDirect)
+{
+#ifdef O_DIRECT
+  const int iFlags = fcntl(m_fd, F_GETFL);
+  if (iFlags < 0 || fcntl(m_fd, F_SETFL, bDirect ? iFlags | O_DIRECT : iFlags & ~O_DIRECT) != 0)
+    return false;
+#endif
+  m_bDirect = bDirect;
+  return true;
+}
+
+void PVRDemoCapture::Evict(uint64_t iOffset, size_t iSize)
+{
+#if defined(SYNC_FILE_RANGE_WRITE) && defined(POSIX_FADV_DONTNEED)
+  /* dirty pages cannot be dropped, so the previous batch is waited for first */
+  sync_file_range(m_fd, (off_t)iOffset, (off_t)iSize, SYNC_FILE_RANGE_WRITE);
+  if (iOffset > m_iEvicted)
+  {
+    sync_file_range(m_fd, (off_t)m_iEvicted, (off_t)(iOffset - m_iEvicted),
+                    SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+    posix_fadvise(m_fd, (off_t)m_iEvicted, (off_t)(iOffset - m_iEvicted), POSIX_FADV_DONTNEED);
+    m_iEvicted = iOffset;
+  }
+#endif
+}
+
+bool PVRDemoCapture::Write(size_t iSize)
+{
+  const uint8_t* pData = m_pBuffer;
+  size_t iDirect = m_bDirect ? iSize - iSize % ALIGNMENT : 0;
+  if (iDirect > 0 && !WriteAll(m_fd, pData, iDirect, m_iOffset))
+  {
+    if (errno != EINVAL)
+      return false;
+    PVRDEMO_LOG(LOG_DEBUG, "%s - '%s' takes no direct writes, writing through the page cache", __FUNCTION__, m_strFile.c_str());
+    iDirect = 0;
+  }
+  pData    += iDirect;
+  iSize    -= iDirect;
+  m_iOffset += iDirect;
+
+  /* a batch is whole blocks, only the end of the file is not */
+  if (iSize > 0)
+  {
+    if (m_bDirect && !SetDirect(false))
+      return false;
+    if (!WriteAll(m_fd, pData, iSize, m_iOffset))
+      return false;
+    Evict(m_iOffset, iSize);
+    m_iOffset += iSize;
+  }
+
+  ++m_statistics.iBatches;
+  return true;
+}
+
+void* PVRDemoCapture::Process(void)
+{
+  const int64_t iStartMs = GetTimeMs();
+  const int64_t iStartCpuUs = ThreadCpuUs();
+
+  size_t iFilled = 0;
+  while (!IsStopped() && time(nullptr) < m_endTime)
+  {
+    /* waits for the source at most PVRDemoLiveStream::READ_TIMEOUT_MS */
+    const int iRead = m_session->Read(m_pBuffer + iFilled, (unsigned int)(BATCH_SIZE - iFilled));
+    if (iRead < 0)
+      break;
+
+    iFilled += (size_t)iRead;
+    if (iFilled == BATCH_SIZE)
+    {
+      if (!Write(iFilled))
+      {
+        m_bFailed = true;
+        break;
+      }
+      iFilled = 0;
+    }
+  }
+
+  if (!m_bFailed && iFilled > 0 && !Write(iFilled))
+    m_bFailed = true;
+  if (!m_bFailed && fdatasync(m_fd) != 0)
+    m_bFailed = true;
+  if (m_bFailed)
+    PVRDEMO_LOG(LOG_ERROR, "%s - cannot write '%s': %s", __FUNCTION__, m_strFile.c_str(), strerror(errno));
+
+  close(m_fd);
+  m_fd = -1;
+
+  const int64_t iEndCpuUs = ThreadCpuUs();
+  m_statistics.iBytes     = m_iOffset;
+  m_statistics.iElapsedMs = GetTimeMs() - iStartMs;
+  m_statistics.iCpuUs     = iStartCpuUs >= 0 && iEndCpuUs >= 0 ? iEndCpuUs - iStartCpuUs : -1;
+  m_bDone = true;
+  return NULL;
+}
+
+PVRDemoRecorder::PVRDemoRecorder(PVRDemoData& data, PVRDemoSessionManager& sessions, const std::string& strDirectory) :
+  m_data(data),
+  m_sessions(sessions),
+  m_strDirectory(strDirectory),
+  m_iCheckedVersion(0),
+  m_iNextStart(0)
+{
+  CreateThread(false);
+}
+
+PVRDemoRecorder::~PVRDemoRecorder(void)
+{
+  StopThread(-1);
+  m_changedEvent.Signal();
+  StopThread();
+}
+
+void PVRDemoRecorder::SetDirectory(const std::string& strDirectory)
+{
+  CLockObject lock(m_mutex);
+  m_strDirectory = strDirectory;
+}
+
+void* PVRDemoRecorder::Process(void)
+{
+  while (!IsStopped())
+  {
+    Schedule();
+    m_changedEvent.Wait(CHECK_INTERVAL_MS);
+  }
+
+  /* what was recorded so far is kept, the next start lists it */
+  for (auto& job : m_jobs)
+  {
+    job->capture->Finish();
+    Complete(*job, false);
+  }
+  m_jobs.clear();
+  return NULL;
+}
+
+void PVRDemoRecorder::Schedule(void)
+{
+  const time_t now = time(nullptr);
+
+  /* captures end by themselves when their timer does */
+  bool bCompleted = false;
+  for (auto it = m_jobs.begin(); it != m_jobs.end();)
+  {
+    if ((*it)->capture->IsDone())
+    {
+      (*it)->capture->Finish();
+      Complete(**it, true);
+      it = m_jobs.erase(it);
+      bCompleted = true;
+    }
+    else
+      ++it;
+  }
+
+  /* nothing starts before the next timer unless the data changed */
+  std::shared_ptr<const PVRDemoDataSet> data = m_data.Snapshot();
+  if (!bCompleted && data->iVersion == m_iCheckedVersion && (m_iNextStart == 0 || now < m_iNextStart))
+    return;
+  m_iCheckedVersion = data->iVersion;
+  m_iNextStart = 0;
+
+  /* a backend records its own timers */
+  if (data->backend)
+    return;
+
+  bool bChanged = false;
+  for (const auto& timer : m_data.GetTimerList())
+  {
+    const TimerKey key(timer.iChannelId, timer.startTime, timer.endTime);
+
+    /* a reload reads the states from the data file again */
+    auto done = m_done.find(key);
+    if (done != m_done.end())
+    {
+      if (timer.state != done->second)
+        bChanged |= m_data.SetTimerState(timer.iChannelId, timer.startTime, timer.endTime, done->second);
+      continue;
+    }
+    auto active = std::find_if(m_jobs.begin(), m_jobs.end(), [&key](const std::unique_ptr<Job>& job) {
+      return TimerKey(job->timer.iChannelId, job->timer.startTime, job->timer.endTime) == key;
+    });
+    if (active != m_jobs.end())
+    {
+      if (timer.state != PVR_TIMER_STATE_RECORDING)
+        bChanged |= m_data.SetTimerState(timer.iChannelId, timer.startTime, timer.endTime, PVR_TIMER_STATE_RECORDING);
+      continue;
+    }
+
+    /* a timer recording when the data was written was cut short by a restart and goes on */
+    if ((timer.state != PVR_TIMER_STATE_NEW && timer.state != PVR_TIMER_STATE_SCHEDULED &&
+         timer.state != PVR_TIMER_STATE_RECORDING) || timer.endTime <= now)
+      continue;
+
+    PVR_CHANNEL xbmcChannel = {};
+    xbmcChannel.iUniqueId = (unsigned int)timer.iChannelId;
+    PVRDemoChannel channel;
+    if (!m_data.GetChannel(xbmcChannel, channel) || !PVRDemoStreamSource::IsAddonServed(channel.strStreamURL))
+      continue;
+
+    if (timer.startTime > now)
+    {
+      m_iNextStart = m_iNextStart == 0 ? timer.startTime : std::min(m_iNextStart, timer.startTime);
+      continue;
+    }
+
+    PVR_TIMER_STATE state = PVR_TIMER_STATE_RECORDING;
+    if (!Start(timer, channel))
+    {
+      state = PVR_TIMER_STATE_ERROR;
+      m_done[key] = state;
+    }
+    bChanged |= m_data.SetTimerState(timer.iChannelId, timer.startTime, timer.endTime, state);
+  }
+
+  for (auto it = m_done.begin(); it != m_done.end();)
+  {
+    if (std::get<2>(it->first) + DONE_KEPT < now)
+      it = m_done.erase(it);
+    else
+      ++it;
+  }
+
+  if (bChanged)
+    PVR->TriggerTimerUpdate();
+}
+
+std::string PVRDemoRecorder::FileName(const std::string& strDirectory, const PVRDemoTimer& timer)
+{
+  struct tm start = {};
+  PVRDemoTimeResolver::LocalTm(timer.startTime, start);
+  char strStart[32];
+  strftime(strStart, sizeof(strStart), "%Y%m%d-%H%M", &start);
+
+  std::string strName = std::string(strStart) + " " + timer.strTitle;
+  for (char& c : strName)
+  {
+    if (c == '/' || c == '\\' || c == ':' || c == '*' || c == '?' || c == '"' || c == '<' || c == '>' || c == '|' ||
+        (unsigned char)c < 0x20)
+      c = '_';
+  }
+
+  std::string strFile = strDirectory + strName + ".ts";
+  struct stat info;
+  for (int i = 2; stat(strFile.c_str(), &info) == 0; ++i)
+    strFile = strDirectory + strName + "-" + std::to_string(i) + ".ts";
+  return strFile;
+}
+
+bool PVRDemoRecorder::Start(const PVRDemoTimer& timer, const PVRDemoChannel& channel)
+{
+  std::string strDirectory;
+  {
+    CLockObject lock(m_mutex);
+    strDirectory = m_strDirectory;
+  }
+  if (strDirectory.empty())
+  {
+    PVRDEMO_LOG(LOG_ERROR, "%s - no directory to record '%s' to", __FUNCTION__, timer.strTitle.c_str());
+    return false;
+  }
+  CreateDirectories(strDirectory);
+
+  std::shared_ptr<PVRDemoSession> session = m_sessions.OpenLive(channel.strStreamURL, false, PVRDEMO_SESSION_BACKGROUND);
+  if (!session)
+  {
+    PVRDEMO_LOG(LOG_ERROR, "%s - no session to record '%s' with", __FUNCTION__, timer.strTitle.c_str());
+    return false;
+  }
+
+  std::unique_ptr<Job> job(new Job);
+  job->timer      = timer;
+  job->channel    = channel;
+  job->iSessionId = session->Id();
+  job->capture.reset(new PVRDemoCapture(session, FileName(strDirectory, timer), timer.endTime));
+  if (!job->capture->Start())
+  {
+    job->capture.reset();
+    m_sessions.Close(job->iSessionId);
+    return false;
+  }
+
+  PVRDEMO_LOG(LOG_INFO, "%s - recording '%s' from '%s' to '%s' for %lld s", __FUNCTION__, timer.strTitle.c_str(),
+              channel.strChannelName.c_str(), job->capture->File().c_str(), (long long)(timer.endTime - time(nullptr)));
+  m_jobs.push_back(std::move(job));
+  return true;
+}
+
+bool PVRDemoRecorder::WriteSidecar(const std::string& strFile, const PVRDemoRecording& recording, const std::string& strPlot)
+{
+  /* with its offset, so it means the same moment in any time zone */
+  struct tm start = {};
+  PVRDemoTimeResolver::LocalTm(recording.recordingTime, start);
+  char strTime[32];
+  strftime(strTime, sizeof(strTime), "%Y-%m-%dT%H:%M:%S%z", &start);
+
+  const std::string strSidecar = PVRDemoData::SidecarFile(strFile);
+  const std::string strTemporary = strSidecar + ".tmp";
+  FILE* file = fopen(strTemporary.c_str(), "w");
+  if (!file)
+    return false;
+
+  fprintf(file, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                "<recording>\n"
+                "  <title>%s</title>\n"
+                "  <channelname>%s</channelname>\n"
+                "  <plot>%s</plot>\n"
+                "  <genretype>%d</genretype>\n"
+                "  <genresubtype>%d</genresubtype>\n"
+                "  <time>%s</time>\n"
+                "  <duration>%d</duration>\n"
+                "  <radio>%d</radio>\n"
+                "</recording>\n",
+          Escape(recording.strTitle).c_str(), Escape(recording.strChannelName).c_str(), Escape(strPlot).c_str(),
+          recording.iGenreType, recording.iGenreSubType, strTime, recording.iDuration, recording.bRadio ? 1 : 0);
+
+  if (fclose(file) != 0 || rename(strTemporary.c_str(), strSidecar.c_str()) != 0)
+  {
+    remove(strTemporary.c_str());
+    return false;
+  }
+  return true;
+}
+
+void PVRDemoRecorder::Complete(Job& job, bool bNotify)
+{
+  m_sessions.Close(job.iSessionId);
+
+  const PVRDemoCapture::Statistics statistics = job.capture->GetStatistics();
+  const double fSeconds = (double)std::max<int64_t>(statistics.iElapsedMs, 1) / 1000.0;
+  PVRDEMO_LOG(LOG_INFO, "%s - recorded '%s': %llu bytes in %.1f s, %.2f MB/s in %llu batches%s, %.2f%% of a core",
+              __FUNCTION__, job.timer.strTitle.c_str(), (unsigned long long)statistics.iBytes, fSeconds,
+              (double)statistics.iBytes / 1048576.0 / fSeconds, (unsigned long long)statistics.iBatches,
+              statistics.bDirect ? " (direct)" : "", statistics.iCpuUs >= 0 ? (double)statistics.iCpuUs / 10000.0 / fSeconds : 0.0);
+
+  const std::string& strFile = job.capture->File();
+  PVR_TIMER_STATE state = job.capture->Failed() || statistics.iBytes == 0 ? PVR_TIMER_STATE_ERROR : PVR_TIMER_STATE_COMPLETED;
+  if (state == PVR_TIMER_STATE_COMPLETED)
+  {
+    std::shared_ptr<PVRDemoTextStore> texts = PVRDemoTextStore::Create(PVRDemoTextStore::MODE_PLAIN, "");
+
+    PVRDemoRecording recording;
+    recording.bRadio         = job.channel.bRadio;
+    recording.iDuration      = (int)(statistics.iElapsedMs / 1000);
+    recording.iGenreType     = 0;
+    recording.iGenreSubType  = 0;
+    recording.iSeriesNumber  = 0;
+    recording.iEpisodeNumber = 0;
+    recording.strChannelName = job.channel.strChannelName;
+    recording.strPlot        = texts->Add(job.timer.strSummary);
+    recording.strRecordingId = strFile;
+    recording.strStreamURL   = strFile;
+    recording.strTitle       = job.timer.strTitle;
+    recording.recordingTime  = job.capture->StartTime();
+    texts->Seal();
+
+    if (!WriteSidecar(strFile, recording, job.timer.strSummary))
+    {
+      PVRDEMO_LOG(LOG_ERROR, "%s - cannot describe '%s': %s", __FUNCTION__, strFile.c_str(), strerror(errno));
+      state = PVR_TIMER_STATE_ERROR;
+    }
+    else
+      m_data.AddRecording(recording);
+  }
+  if (statistics.iBytes == 0)
+    remove(strFile.c_str());
+
+  m_done[TimerKey(job.timer.iChannelId, job.timer.startTime, job.timer.endTime)] = state;
+  m_data.SetTimerState(job.timer.iChannelId, job.timer.startTime, job.timer.endTime, state);
+  if (bNotify)
+  {
+    PVR->TriggerTimerUpdate();
+    PVR->TriggerRecordingUpdate();
+  }
+}
@@ -0,0 +1,152 @@
+/*
+ *  Copyright (C) 2011-2020 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2011 Pulse-Eight (http://www.pulse-eight.com/)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "p8-platform/threads/mutex.h"
+#include "p8-platform/threads/threads.h"
+#include "PVRDemoData.h"
+#include "PVRDemoSession.h"
+
+/*!
+ * Copies one background session into a file until an end time, on a
+ * thread of its own. The session's ring buffer takes up the source while
+ * a batch is on its way to disk, so the thread only ever reads into one
+ * aligned buffer of BATCH_SIZE and writes it with one pwrite().
+ *
+ * The file is opened with O_DIRECT where the file system takes it, which
+ * keeps hours of recording out of the page cache. Elsewhere each batch is
+ * written back as soon as it is written and dropped from the cache once
+ * the next one is, to the same effect.
+ */
+class PVRDemoCapture : public P8PLATFORM::CThread
+{
+public:
+  static const size_t BATCH_SIZE = 1024 * 1024;
+  static const size_t ALIGNMENT  = 4096;  // of the buffer, the file offsets and the sizes of direct writes
+
+  struct Statistics
+  {
+    uint64_t iBytes;
+    uint64_t iBatches;
+    int64_t  iElapsedMs;
+    int64_t  iCpuUs;   // of the capture thread, -1 where it cannot be measured
+    bool     bDirect;  // the file took direct writes
+  };
+
+  PVRDemoCapture(std::shared_ptr<PVRDemoSession> session, const std::string& strFile, time_t endTime);
+  ~PVRDemoCapture(void) override;
+
+  /* create the file and start copying, false if the file cannot be written */
+  bool Start(void);
+
+  /* stop before the end time, waiting for the last batch to be written */
+  void Finish(void);
+
+  /* the end time passed, the source ended or a write failed */
+  bool IsDone(void) const { return m_bDone; }
+  bool Failed(void) const { return m_bFailed; }
+
+  const std::string& File(void) const { return m_strFile; }
+  time_t StartTime(void) const { return m_startTime; }
+
+  /* complete once IsDone() */
+  Statistics GetStatistics(void) const;
+
+protected:
+  void* Process(void) override;
+
+private:
+  /* write iSize bytes of the buffer at the end of the file */
+  bool Write(size_t iSize);
+  bool SetDirect(bool bDirect);
+  void Evict(uint64_t iOffset, size_t iSize);
+
+  std::shared_ptr<PVRDemoSession> m_session;
+  const std::string               m_strFile;
+  const time_t                    m_endTime;
+  time_t                          m_startTime;
+  int                             m_fd;
+  uint8_t*                        m_pBuffer;
+  bool                            m_bDirect;
+  uint64_t                        m_iOffset;
+  uint64_t                        m_iEvicted;  // the page cache holds nothing of the file below this
+  std::atomic<bool>               m_bDone;
+  std::atomic<bool>               m_bFailed;
+  Statistics                      m_statistics;
+};
+
+/*!
+ * Records the timers of the data. Once a second, or as soon as the data
+ * changes, a scheduler thread looks for scheduled timers whose time has
+ * come on channels the add-on serves itself. Each of them gets a
+ * background session on its channel and a PVRDemoCapture into the
+ * recordings directory, so any number of timers record at once as long as
+ * there are sessions left.
+ *
+ * When a capture ends its recording is described by a sidecar next to the
+ * file, see PVRDemoData::SidecarFile(), and added to the data, which also
+ * finds it there on every later load. The timer goes to RECORDING while it
+ * records and COMPLETED or ERROR after; the recorder keeps these states
+ * over a reload of the data file. Timers of data from a backend are left
+ * to the backend.
+ */
+class PVRDemoRecorder : public P8PLATFORM::CThread
+{
+public:
+  static const int CHECK_INTERVAL_MS = 1000;
+
+  PVRDemoRecorder(PVRDemoData& data, PVRDemoSessionManager& sessions, const std::string& strDirectory);
+  ~PVRDemoRecorder(void) override;
+
+  /* where the next recordings go; those in progress stay where they are */
+  void SetDirectory(const std::string& strDirectory);
+
+  /* a new version of the data was published */
+  void Changed(void) { m_changedEvent.Signal(); }
+
+protected:
+  void* Process(void) override;
+
+private:
+  typedef std::tuple<int, time_t, time_t> TimerKey;  // channel, start and end time
+
+  struct Job
+  {
+    PVRDemoTimer                    timer;
+    PVRDemoChannel                  channel;
+    int                             iSessionId;
+    std::unique_ptr<PVRDemoCapture> capture;
+  };
+
+  void Schedule(void);
+  bool Start(const PVRDemoTimer& timer, const PVRDemoChannel& channel);
+  void Complete(Job& job, bool bNotify);
+
+  /* a file name in strDirectory no other recording has */
+  static std::string FileName(const std::string& strDirectory, const PVRDemoTimer& timer);
+  static bool WriteSidecar(const std::string& strFile, const PVRDemoRecording& recording, const std::string& strPlot);
+
+  PVRDemoData&                      m_data;
+  PVRDemoSessionManager&            m_sessions;
+  P8PLATFORM::CMutex                m_mutex;          // guards m_strDirectory
+  std::string                       m_strDirectory;
+  P8PLATFORM::CEvent                m_changedEvent;
+
+  /* only touched by the scheduler thread */
+  std::vector<std::unique_ptr<Job>> m_jobs;
+  std::map<TimerKey, PVR_TIMER_STATE> m_done;         // timers recorded, with the state they ended in
+  uint64_t                          m_iCheckedVersion;
+  time_t                            m_iNextStart;     // of the first timer still to come when last checked
+};
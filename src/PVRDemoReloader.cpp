@@ -0,0 +1,49 @@
+/*
+ *  Copyright (C) 2011-2020 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2011 Pulse-Eight (http://www.pulse-eight.com/)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "PVRDemoReloader.h"
+#include "PVRDemoLog.h"
+
+#include <utility>
+
+using namespace ADDON;
+using namespace P8PLATFORM;
+
+PVRDemoReloader::PVRDemoReloader(std::function<bool(void)> reload) :
+  m_reload(std::move(reload)),
+  m_requestEvent(true)
+{
+  CreateThread(false);
+}
+
+PVRDemoReloader::~PVRDemoReloader(void)
+{
+  /* a reload under way is finished, one only requested is not */
+  StopThread(-1);
+  m_requestEvent.Signal();
+  StopThread();
+}
+
+void PVRDemoReloader::Request(void)
+{
+  m_requestEvent.Signal();
+}
+
+void* PVRDemoReloader::Process(void)
+{
+  while (!IsStopped())
+  {
+    m_requestEvent.Wait();
+    if (IsStopped())
+      break;
+
+    if (!m_reload())
+      PVRDEMO_LOG(LOG_ERROR, "%s - cannot reload the data, the current version stays", __FUNCTION__);
+  }
+  return NULL;
+}
@@ -0,0 +1,36 @@
+/*
+ *  Copyright (C) 2011-2020 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2011 Pulse-Eight (http://www.pulse-eight.com/)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <functional>
+#include "p8-platform/threads/mutex.h"
+#include "p8-platform/threads/threads.h"
+
+/*!
+ * Reloads the data on a thread of its own for the settings that need it,
+ * as Kodi's settings thread is not to wait on a data file or a backend.
+ * Requests made while a reload runs are served by one more reload once
+ * it is done, so the setting changed last always takes effect.
+ */
+class PVRDemoReloader : public P8PLATFORM::CThread
+{
+public:
+  explicit PVRDemoReloader(std::function<bool(void)> reload);
+  ~PVRDemoReloader(void) override;
+
+  /* reload soon; returns at once */
+  void Request(void);
+
+protected:
+  void* Process(void) override;
+
+private:
+  const std::function<bool(void)> m_reload;
+  P8PLATFORM::CEvent              m_requestEvent;
+};
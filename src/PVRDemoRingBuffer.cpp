@@ -0,0 +1,80 @@
+/*
+ *  Copyright (C) 2011-2020 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2011 Pulse-Eight (http://www.pulse-eight.com/)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "PVRDemoRingBuffer.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+size_t RoundUpPow2(size_t iValue)
+{
+  size_t iResult = 4096;
+  while (iResult < iValue)
+    iResult <<= 1;
+  return iResult;
+}
+}
+
+PVRDemoRingBuffer::PVRDemoRingBuffer(size_t iCapacity) :
+  m_buffer(RoundUpPow2(iCapacity)),
+  m_iMask(m_buffer.size() - 1),
+  m_iHead(0),
+  m_iTail(0)
+{
+}
+
+size_t PVRDemoRingBuffer::ReadAvailable(void) const
+{
+  return m_iHead.load(std::memory_order_acquire) - m_iTail.load(std::memory_order_relaxed);
+}
+
+size_t PVRDemoRingBuffer::WriteAvailable(void) const
+{
+  return m_buffer.size() - (m_iHead.load(std::memory_order_relaxed) - m_iTail.load(std::memory_order_acquire));
+}
+
+size_t PVRDemoRingBuffer::GetWriteSpan(uint8_t*& pSpan)
+{
+  const size_t iHead = m_iHead.load(std::memory_order_relaxed);
+  const size_t iFree = m_buffer.size() - (iHead - m_iTail.load(std::memory_order_acquire));
+  const size_t iOffset = iHead & m_iMask;
+
+  pSpan = m_buffer.data() + iOffset;
+  return std::min(iFree, m_buffer.size() - iOffset);
+}
+
+void PVRDemoRingBuffer::CommitWrite(size_t iBytes)
+{
+  m_iHead.store(m_iHead.load(std::memory_order_relaxed) + iBytes, std::memory_order_release);
+}
+
+size_t PVRDemoRingBuffer::Read(uint8_t* pDest, size_t iSize)
+{
+  const size_t iTail = m_iTail.load(std::memory_order_relaxed);
+  const size_t iAvailable = m_iHead.load(std::memory_order_acquire) - iTail;
+  const size_t iBytes = std::min(iSize, iAvailable);
+  if (iBytes == 0)
+    return 0;
+
+  const size_t iOffset = iTail & m_iMask;
+  const size_t iFirst = std::min(iBytes, m_buffer.size() - iOffset);
+  memcpy(pDest, m_buffer.data() + iOffset, iFirst);
+  if (iBytes > iFirst)
+    memcpy(pDest + iFirst, m_buffer.data(), iBytes - iFirst);
+
+  m_iTail.store(iTail + iBytes, std::memory_order_release);
+  return iBytes;
+}
+
+void PVRDemoRingBuffer::Reset(void)
+{
+  m_iHead.store(0, std::memory_order_relaxed);
+  m_iTail.store(0, std::memory_order_relaxed);
+}
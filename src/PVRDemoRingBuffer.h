@@ -0,0 +1,51 @@
+/*
+ *  Copyright (C) 2011-2020 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2011 Pulse-Eight (http://www.pulse-eight.com/)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*!
+ * Fixed-size single-producer/single-consumer byte ring.
+ *
+ * The producer asks for a contiguous writable span with GetWriteSpan(), fills
+ * it in place (e.g. straight from read()) and publishes it with CommitWrite().
+ * The consumer copies out with Read(). Neither side takes a lock; the head and
+ * tail indices are free-running and masked on access.
+ */
+class PVRDemoRingBuffer
+{
+public:
+  explicit PVRDemoRingBuffer(size_t iCapacity);
+
+  size_t Capacity(void) const { return m_buffer.size(); }
+  size_t ReadAvailable(void) const;
+  size_t WriteAvailable(void) const;
+
+  /* producer side */
+  size_t GetWriteSpan(uint8_t*& pSpan);
+  void CommitWrite(size_t iBytes);
+
+  /* consumer side */
+  size_t Read(uint8_t* pDest, size_t iSize);
+
+  /* only valid while neither side is active */
+  void Reset(void);
+
+private:
+  std::vector<uint8_t> m_buffer;
+  size_t               m_iMask;
+
+  /* keep producer and consumer indices on separate cache lines */
+  std::atomic<size_t>  m_iHead; // next byte to write
+  char                 m_padding[64 - sizeof(std::atomic<size_t>)];
+  std::atomic<size_t>  m_iTail; // next byte to read
+};
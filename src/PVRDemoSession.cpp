@@ -0,0 +1,342 @@
+/*
+ *  Copyright (C) 2011-2020 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2011 Pulse-Eight (http://www.pulse-eight.com/)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "PVRDemoSession.h"
+#include "client.h"
+#include "p8-platform/util/StringUtils.h"
+#include "p8-platform/util/timeutils.h"
+
+#include <algorithm>
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifndef TARGET_WINDOWS
+#include <unistd.h>
+#endif
+
+using namespace ADDON;
+using namespace P8PLATFORM;
+
+PVRDemoSession::PVRDemoSession(int iId, PVRDemoSessionType type, const std::string& strURL) :
+  m_iId(iId),
+  m_type(type),
+  m_strURL(strURL),
+  m_iMemoryReserved(0),
+  m_fd(-1),
+  m_iPosition(0),
+  m_iBytesRead(0),
+  m_iReads(0),
+  m_iOpenTime(GetTimeMs())
+{
+}
+
+PVRDemoSession::~PVRDemoSession(void)
+{
+  /* the demuxer reads through the live stream, so it goes first */
+  m_demux.reset();
+  m_liveStream.reset();
+  m_readahead.reset();
+#ifndef TARGET_WINDOWS
+  if (m_fd >= 0)
+    close(m_fd);
+#endif
+  LogStatistics();
+
+  /* the buffers are gone, another session may have their share of the budget */
+  if (m_memoryUsed)
+    *m_memoryUsed -= m_iMemoryReserved;
+}
+
+bool PVRDemoSession::OpenLive(std::shared_ptr<PVRDemoIOPool> pool, size_t iBufferSize, const std::string& strTimeshiftDirectory)
+{
+  PVRDemoStreamSource* source = PVRDemoStreamSource::Create(m_strURL);
+  if (!source)
+    return false;
+
+  PVRDemoTimeshiftBuffer* timeshift = NULL;
+  if (!strTimeshiftDirectory.empty())
+    timeshift = new PVRDemoTimeshiftBuffer(strTimeshiftDirectory, (uint64_t)g_iTimeshiftMaxSize * 1024 * 1024, g_iTimeshiftMaxDuration * 60);
+
+  m_liveStream.reset(new PVRDemoLiveStream(std::move(pool), source, iBufferSize, timeshift));
+  if (!m_liveStream->Open())
+  {
+    m_liveStream.reset();
+    return false;
+  }
+  return true;
+}
+
+bool PVRDemoSession::OpenRecording(void)
+{
+#ifdef TARGET_WINDOWS
+  return false;
+#else
+  std::string strPath;
+  if (!PVRDemoStreamSource::LocalPath(m_strURL, strPath))
+    return false;
+
+  m_fd = open(strPath.c_str(), O_RDONLY);
+  if (m_fd < 0)
+  {
+    PVRDEMO_LOG(LOG_ERROR, "%s - cannot open recording '%s': %s", __FUNCTION__, strPath.c_str(), strerror(errno));
+    return false;
+  }
+  m_readahead.reset(new PVRDemoReadahead(PVRDemoIOEngine::Shared(), m_fd));
+  return true;
+#endif
+}
+
+void PVRDemoSession::EnableDemuxing(void)
+{
+  m_demux.reset(new PVRDemoDemux([this](unsigned char* pBuffer, unsigned int iBufferSize) {
+    return Read(pBuffer, iBufferSize);
+  }));
+}
+
+int PVRDemoSession::Read(unsigned char* pBuffer, unsigned int iBufferSize)
+{
+  int iRead = -1;
+  if (m_liveStream)
+    iRead = m_liveStream->Read(pBuffer, iBufferSize);
+#ifndef TARGET_WINDOWS
+  else if (m_readahead)
+  {
+    const int64_t iResult = m_readahead->Read(pBuffer, iBufferSize, m_iPosition);
+    if (iResult > 0)
+      m_iPosition += (uint64_t)iResult;
+    iRead = iResult < 0 ? -1 : (int)iResult;
+  }
+#endif
+
+  if (iRead > 0)
+  {
+    m_iBytesRead += iRead;
+    ++m_iReads;
+  }
+  return iRead;
+}
+
+long long PVRDemoSession::Seek(long long iPosition, int iWhence)
+{
+  if (m_liveStream)
+    return m_liveStream->Seek(iPosition, iWhence);
+  if (m_fd < 0)
+    return -1;
+
+  long long iTarget;
+  switch (iWhence)
+  {
+    case SEEK_SET:
+      iTarget = iPosition;
+      break;
+    case SEEK_CUR:
+      iTarget = (long long)m_iPosition + iPosition;
+      break;
+    case SEEK_END:
+      iTarget = Length() + iPosition;
+      break;
+    default:
+      return -1;
+  }
+  if (iTarget < 0)
+    return -1;
+
+  m_iPosition = (uint64_t)iTarget;
+  return iTarget;
+}
+
+long long PVRDemoSession::Length(void) const
+{
+  if (m_liveStream)
+    return m_liveStream->Length();
+#ifndef TARGET_WINDOWS
+  /* recordings may still be growing, so ask every time */
+  struct stat st;
+  if (m_fd >= 0 && fstat(m_fd, &st) == 0)
+    return (long long)st.st_size;
+#endif
+  return -1;
+}
+
+bool PVRDemoSession::CanSeek(void) const
+{
+  return m_liveStream ? m_liveStream->IsTimeshifting() : m_fd >= 0;
+}
+
+void PVRDemoSession::LogStatistics(void) const
+{
+  const int64_t iElapsedMs = GetTimeMs() - m_iOpenTime;
+  const double fMBps = iElapsedMs > 0 ? (double)m_iBytesRead.load() / 1048576.0 / ((double)iElapsedMs / 1000.0) : 0.0;
+  PVRDEMO_LOG(LOG_DEBUG, "%s - session %d (%s): %llu bytes in %llu reads over %lld ms (%.2f MB/s), buffer %u KiB",
+              __FUNCTION__, m_iId, m_strURL.c_str(), (unsigned long long)m_iBytesRead.load(),
+              (unsigned long long)m_iReads.load(), (long long)iElapsedMs, fMBps, (unsigned int)(m_iMemoryReserved / 1024));
+}
+
+const int PVRDemoSessionManager::MAX_SESSIONS;
+
+PVRDemoSessionManager::PVRDemoSessionManager(unsigned int iIOThreads, size_t iMemoryBudget) :
+  m_pool(std::make_shared<PVRDemoIOPool>(iIOThreads)),
+  m_iGeneration(0),
+  m_iMemoryBudget(iMemoryBudget),
+  m_memoryUsed(std::make_shared<std::atomic<size_t>>(0))
+{
+}
+
+PVRDemoSessionManager::~PVRDemoSessionManager(void)
+{
+  CloseAll();
+}
+
+std::string PVRDemoSessionManager::TimeshiftDirectory(int iSessionId) const
+{
+  std::string strDirectory = g_strUserPath;
+  if (!strDirectory.empty() && strDirectory[strDirectory.size() - 1] != '/' && strDirectory[strDirectory.size() - 1] != '\\')
+    strDirectory += '/';
+  return strDirectory + StringUtils::Format("timeshift-%d/", iSessionId % MAX_SESSIONS);
+}
+
+int PVRDemoSessionManager::ReserveSlot(void)
+{
+  /* ids carry a generation so a stale id never resolves to a reused slot */
+  for (int i = 0; i < MAX_SESSIONS; ++i)
+  {
+    if (!PVRDemoPublished<PVRDemoSession>::Reader(m_sessions[i]))
+    {
+      m_iGeneration = (m_iGeneration + 1) % (INT32_MAX / MAX_SESSIONS);
+      return m_iGeneration * MAX_SESSIONS + i;
+    }
+  }
+  return -1;
+}
+
+size_t PVRDemoSessionManager::ReserveMemory(size_t iWanted)
+{
+  std::atomic<size_t>& used = *m_memoryUsed;
+  size_t iUsed = used;
+  size_t iGranted;
+  do
+  {
+    const size_t iBudget = m_iMemoryBudget;
+    const size_t iFree = iBudget > iUsed ? iBudget - iUsed : 0;
+
+    /* the ring buffer rounds up to a power of two, so hand out one */
+    iGranted = MIN_SESSION_BUFFER;
+    while (iGranted * 2 <= std::min(iWanted, iFree))
+      iGranted *= 2;
+    if (iGranted > iFree)
+      return 0;
+  } while (!used.compare_exchange_weak(iUsed, iUsed + iGranted));
+
+  return iGranted;
+}
+
+std::shared_ptr<PVRDemoSession> PVRDemoSessionManager::OpenLive(const std::string& strURL, bool bTimeshift, PVRDemoSessionType type)
+{
+  CLockObject lock(m_mutex);
+
+  const int iId = ReserveSlot();
+  if (iId < 0)
+  {
+    PVRDEMO_LOG(LOG_ERROR, "%s - all %d sessions in use", __FUNCTION__, MAX_SESSIONS);
+    return nullptr;
+  }
+
+  const size_t iBuffer = ReserveMemory((size_t)g_iLiveBufferSize * 1024 * 1024);
+  if (iBuffer == 0)
+  {
+    PVRDEMO_LOG(LOG_ERROR, "%s - session memory budget of %u MiB exhausted", __FUNCTION__,
+                (unsigned int)(m_iMemoryBudget / 1024 / 1024));
+    return nullptr;
+  }
+
+  std::shared_ptr<PVRDemoSession> session = std::make_shared<PVRDemoSession>(iId, type, strURL);
+  session->SetMemoryReserved(m_memoryUsed, iBuffer);
+  if (!session->OpenLive(m_pool, iBuffer, bTimeshift ? TimeshiftDirectory(iId) : ""))
+  {
+    PVRDEMO_LOG(LOG_ERROR, "%s - failed to open live stream '%s'", __FUNCTION__, strURL.c_str());
+    return nullptr;
+  }
+
+  m_sessions[iId % MAX_SESSIONS].Store(session);
+  PVRDEMO_LOG(LOG_DEBUG, "%s - opened session %d for '%s'", __FUNCTION__, iId, strURL.c_str());
+  return session;
+}
+
+std::shared_ptr<PVRDemoSession> PVRDemoSessionManager::OpenRecording(const std::string& strURL)
+{
+  CLockObject lock(m_mutex);
+
+  const int iId = ReserveSlot();
+  if (iId < 0)
+  {
+    PVRDEMO_LOG(LOG_ERROR, "%s - all %d sessions in use", __FUNCTION__, MAX_SESSIONS);
+    return nullptr;
+  }
+
+  std::shared_ptr<PVRDemoSession> session = std::make_shared<PVRDemoSession>(iId, PVRDEMO_SESSION_RECORDING, strURL);
+  if (!session->OpenRecording())
+    return nullptr;
+
+  m_sessions[iId % MAX_SESSIONS].Store(session);
+  PVRDEMO_LOG(LOG_DEBUG, "%s - opened session %d for '%s'", __FUNCTION__, iId, strURL.c_str());
+  return session;
+}
+
+void PVRDemoSessionManager::Close(int iSessionId)
+{
+  std::shared_ptr<PVRDemoSession> session;
+  {
+    CLockObject lock(m_mutex);
+    if (iSessionId < 0)
+      return;
+
+    PVRDemoPublished<PVRDemoSession>& slot = m_sessions[iSessionId % MAX_SESSIONS];
+    {
+      PVRDemoPublished<PVRDemoSession>::Reader current(slot);
+      if (!current || current->Id() != iSessionId)
+        return;
+    }
+    session = slot.Exchange(nullptr);
+  }
+
+  /* readers still holding a reference keep the session alive; the last
+   * one to let go closes the streams and hands back its memory */
+}
+
+void PVRDemoSessionManager::CloseAll(void)
+{
+  for (int i = 0; i < MAX_SESSIONS; ++i)
+  {
+    std::shared_ptr<PVRDemoSession> session = m_sessions[i].Load();
+    if (session)
+      Close(session->Id());
+  }
+}
+
+std::shared_ptr<PVRDemoSession> PVRDemoSessionManager::Get(int iSessionId) const
+{
+  if (iSessionId < 0)
+    return nullptr;
+
+  PVRDemoPublished<PVRDemoSession>::Reader session(m_sessions[iSessionId % MAX_SESSIONS]);
+  if (session && session->Id() == iSessionId)
+    return session.Share();
+  return nullptr;
+}
+
+int PVRDemoSessionManager::SessionCount(void) const
+{
+  int iCount = 0;
+  for (int i = 0; i < MAX_SESSIONS; ++i)
+  {
+    if (PVRDemoPublished<PVRDemoSession>::Reader(m_sessions[i]))
+      ++iCount;
+  }
+  return iCount;
+}
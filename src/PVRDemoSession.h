@@ -0,0 +1,124 @@
+/*
+ *  Copyright (C) 2011-2020 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2011 Pulse-Eight (http://www.pulse-eight.com/)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include "p8-platform/threads/mutex.h"
+#include "PVRDemoDemux.h"
+#include "PVRDemoIOEngine.h"
+#include "PVRDemoIOPool.h"
+#include "PVRDemoLiveStream.h"
+#include "PVRDemoPublished.h"
+
+enum PVRDemoSessionType
+{
+  PVRDEMO_SESSION_LIVE,       // Kodi's player watching a channel
+  PVRDEMO_SESSION_RECORDING,  // Kodi's player watching a recording
+  PVRDEMO_SESSION_BACKGROUND  // add-on internal reader, e.g. a recorder
+};
+
+/*!
+ * One open stream with its own reader state, buffers and statistics.
+ * A session is only ever read by its owner, so none of the read path is
+ * shared with other sessions.
+ */
+class PVRDemoSession
+{
+public:
+  PVRDemoSession(int iId, PVRDemoSessionType type, const std::string& strURL);
+  ~PVRDemoSession(void);
+
+  bool OpenLive(std::shared_ptr<PVRDemoIOPool> pool, size_t iBufferSize, const std::string& strTimeshiftDirectory);
+  bool OpenRecording(void);
+  void EnableDemuxing(void);
+
+  int Read(unsigned char* pBuffer, unsigned int iBufferSize);
+  long long Seek(long long iPosition, int iWhence);
+  long long Length(void) const;
+  bool CanSeek(void) const;
+
+  int Id(void) const { return m_iId; }
+  PVRDemoSessionType Type(void) const { return m_type; }
+  const std::string& URL(void) const { return m_strURL; }
+  PVRDemoLiveStream* LiveStream(void) const { return m_liveStream.get(); }
+  PVRDemoDemux* Demux(void) const { return m_demux.get(); }
+
+  /* iBytes of the budget whose use is counted in used, handed back when the session is freed */
+  size_t MemoryReserved(void) const { return m_iMemoryReserved; }
+  void SetMemoryReserved(std::shared_ptr<std::atomic<size_t>> used, size_t iBytes)
+  {
+    m_memoryUsed = std::move(used);
+    m_iMemoryReserved = iBytes;
+  }
+
+  void LogStatistics(void) const;
+
+private:
+  const int                            m_iId;
+  const PVRDemoSessionType             m_type;
+  const std::string                    m_strURL;
+  std::unique_ptr<PVRDemoLiveStream>   m_liveStream;
+  std::unique_ptr<PVRDemoDemux>        m_demux;
+  std::shared_ptr<std::atomic<size_t>> m_memoryUsed;
+  size_t                               m_iMemoryReserved;
+
+  /* recordings are read from the file at the reader's position, with the shared I/O engine reading ahead */
+  int                                  m_fd;
+  uint64_t                             m_iPosition;
+  std::unique_ptr<PVRDemoReadahead>    m_readahead;
+
+  std::atomic<uint64_t>                m_iBytesRead;
+  std::atomic<uint64_t>                m_iReads;
+  int64_t                              m_iOpenTime;
+};
+
+/*!
+ * Table of open sessions. Lookups and reads are lock-free, see
+ * PVRDemoPublished; only opening and closing a session serialise on the
+ * manager's mutex. All sessions share one I/O pool and draw their buffers
+ * from a common memory budget. A closed session holds on to its share of
+ * the budget, and to the pool, until its last reader lets go of it, which
+ * may be after the manager is gone.
+ */
+class PVRDemoSessionManager
+{
+public:
+  static const int MAX_SESSIONS = 16;
+  static const size_t MIN_SESSION_BUFFER = 256 * 1024;
+
+  PVRDemoSessionManager(unsigned int iIOThreads, size_t iMemoryBudget);
+  ~PVRDemoSessionManager(void);
+
+  std::shared_ptr<PVRDemoSession> OpenLive(const std::string& strURL, bool bTimeshift, PVRDemoSessionType type = PVRDEMO_SESSION_LIVE);
+  std::shared_ptr<PVRDemoSession> OpenRecording(const std::string& strURL);
+  void Close(int iSessionId);
+  void CloseAll(void);
+
+  std::shared_ptr<PVRDemoSession> Get(int iSessionId) const;
+  int SessionCount(void) const;
+
+  void SetMemoryBudget(size_t iBytes) { m_iMemoryBudget = iBytes; }
+  size_t MemoryUsed(void) const { return *m_memoryUsed; }
+
+  PVRDemoIOPool& Pool(void) { return *m_pool; }
+
+private:
+  int ReserveSlot(void);
+  size_t ReserveMemory(size_t iWanted);
+  std::string TimeshiftDirectory(int iSessionId) const;
+
+  std::shared_ptr<PVRDemoIOPool>       m_pool;  // shared with the live streams, which may outlive the manager
+  P8PLATFORM::CMutex                   m_mutex;
+  PVRDemoPublished<PVRDemoSession>     m_sessions[MAX_SESSIONS];
+  int                                  m_iGeneration;
+  std::atomic<size_t>                  m_iMemoryBudget;
+  std::shared_ptr<std::atomic<size_t>> m_memoryUsed;  // shared with the sessions, which may outlive the manager
+};
@@ -0,0 +1,470 @@
+/*
+ *  Copyright (C) 2011-2020 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2011 Pulse-Eight (http://www.pulse-eight.com/)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "PVRDemoSnapshot.h"
+#include "PVRDemoBackendProtocol.h"
+#include "PVRDemoLog.h"
+#include "PVRDemoStats.h"
+#include "p8-platform/util/timeutils.h"
+
+#include <stdio.h>
+#include <sys/stat.h>
+
+using namespace ADDON;
+
+namespace
+{
+/* a count of records, which cannot be more than the bytes left */
+bool GetCount(PVRDemoBackendMessage& message, uint32_t& iCount)
+{
+  return message.GetU32(iCount) && iCount <= message.Data().size();
+}
+
+void PutEntry(PVRDemoBackendMessage& message, const PVRDemoEpgEntry& entry)
+{
+  message.PutI32(entry.iBroadcastId);
+  message.PutString(entry.strTitle);
+  message.PutI32(entry.iChannelId);
+  message.PutI64(entry.startTime);
+  message.PutI64(entry.endTime);
+  message.PutString(entry.strPlotOutline.c_str());
+  message.PutString(entry.strPlot.c_str());
+  message.PutString(entry.strIconPath);
+  message.PutI32(entry.iGenreType);
+  message.PutI32(entry.iGenreSubType);
+  message.PutI32(entry.iSeriesNumber);
+  message.PutI32(entry.iEpisodeNumber);
+  message.PutString(entry.strEpisodeName);
+}
+
+bool GetEntry(PVRDemoBackendMessage& message, PVRDemoTextStore& texts, PVRDemoEpgEntry& entry)
+{
+  std::string strPlotOutline, strPlot;
+  message.GetI32(entry.iBroadcastId);
+  message.GetString(entry.strTitle);
+  message.GetI32(entry.iChannelId);
+  message.GetTime(entry.startTime);
+  message.GetTime(entry.endTime);
+  message.GetString(strPlotOutline);
+  message.GetString(strPlot);
+  message.GetString(entry.strIconPath);
+  message.GetI32(entry.iGenreType);
+  message.GetI32(entry.iGenreSubType);
+  message.GetI32(entry.iSeriesNumber);
+  message.GetI32(entry.iEpisodeNumber);
+  if (!message.GetString(entry.strEpisodeName))
+    return false;
+
+  entry.strPlotOutline = texts.Add(strPlotOutline);
+  entry.strPlot = texts.Add(strPlot);
+  return true;
+}
+
+void PutEntries(PVRDemoBackendMessage& message, const std::vector<PVRDemoEpgEntry>& entries)
+{
+  message.PutU32((uint32_t)entries.size());
+  for (const auto& entry : entries)
+    PutEntry(message, entry);
+}
+
+bool GetEntries(PVRDemoBackendMessage& message, PVRDemoTextStore& texts, std::vector<PVRDemoEpgEntry>& entries)
+{
+  uint32_t iCount = 0;
+  if (!GetCount(message, iCount))
+    return false;
+  entries.resize(iCount);
+  for (auto& entry : entries)
+  {
+    if (!GetEntry(message, texts, entry))
+      return false;
+  }
+  return true;
+}
+
+void PutChannels(PVRDemoBackendMessage& message, const std::vector<PVRDemoChannel>& channels)
+{
+  message.PutU32((uint32_t)channels.size());
+  for (const auto& channel : channels)
+  {
+    message.PutU8(channel.bRadio ? 1 : 0);
+    message.PutI32(channel.iUniqueId);
+    message.PutI32(channel.iChannelNumber);
+    message.PutI32(channel.iSubChannelNumber);
+    message.PutI32(channel.iEncryptionSystem);
+    message.PutString(channel.strChannelName);
+    message.PutString(channel.strIconPath);
+    message.PutString(channel.strStreamURL);
+    PutEntries(message, channel.epg);
+  }
+}
+
+bool GetChannels(PVRDemoBackendMessage& message, PVRDemoTextStore& texts, std::vector<PVRDemoChannel>& channels)
+{
+  uint32_t iCount = 0;
+  if (!GetCount(message, iCount))
+    return false;
+  channels.resize(iCount);
+  for (auto& channel : channels)
+  {
+    uint8_t bRadio = 0;
+    message.GetU8(bRadio);
+    channel.bRadio = bRadio != 0;
+    message.GetI32(channel.iUniqueId);
+    message.GetI32(channel.iChannelNumber);
+    message.GetI32(channel.iSubChannelNumber);
+    message.GetI32(channel.iEncryptionSystem);
+    message.GetString(channel.strChannelName);
+    message.GetString(channel.strIconPath);
+    message.GetString(channel.strStreamURL);
+    if (!GetEntries(message, texts, channel.epg))
+      return false;
+  }
+  return true;
+}
+
+void PutGroups(PVRDemoBackendMessage& message, const std::vector<PVRDemoChannelGroup>& groups)
+{
+  message.PutU32((uint32_t)groups.size());
+  for (const auto& group : groups)
+  {
+    message.PutU8(group.bRadio ? 1 : 0);
+    message.PutI32(group.iGroupId);
+    message.PutString(group.strGroupName);
+    message.PutI32(group.iPosition);
+    message.PutU32((uint32_t)group.members.size());
+    for (int iMember : group.members)
+      message.PutI32(iMember);
+  }
+}
+
+bool GetGroups(PVRDemoBackendMessage& message, std::vector<PVRDemoChannelGroup>& groups)
+{
+  uint32_t iCount = 0;
+  if (!GetCount(message, iCount))
+    return false;
+  groups.resize(iCount);
+  for (auto& group : groups)
+  {
+    uint8_t bRadio = 0;
+    uint32_t iMembers = 0;
+    message.GetU8(bRadio);
+    group.bRadio = bRadio != 0;
+    message.GetI32(group.iGroupId);
+    message.GetString(group.strGroupName);
+    message.GetI32(group.iPosition);
+    if (!GetCount(message, iMembers))
+      return false;
+    group.members.resize(iMembers);
+    for (int& iMember : group.members)
+      message.GetI32(iMember);
+  }
+  return !message.Failed();
+}
+
+void PutRecordings(PVRDemoBackendMessage& message, const std::vector<PVRDemoRecording>& recordings)
+{
+  message.PutU32((uint32_t)recordings.size());
+  for (const auto& recording : recordings)
+  {
+    message.PutU8(recording.bRadio ? 1 : 0);
+    message.PutI32(recording.iDuration);
+    message.PutI32(recording.iGenreType);
+    message.PutI32(recording.iGenreSubType);
+    message.PutI32(recording.iSeriesNumber);
+    message.PutI32(recording.iEpisodeNumber);
+    message.PutString(recording.strChannelName);
+    message.PutString(recording.strPlotOutline.c_str());
+    message.PutString(recording.strPlot.c_str());
+    message.PutString(recording.strRecordingId);
+    message.PutString(recording.strStreamURL);
+    message.PutString(recording.strTitle);
+    message.PutString(recording.strEpisodeName);
+    message.PutString(recording.strDirectory);
+    message.PutI64(recording.recordingTime);
+    message.PutString(recording.strRecordingTime);
+  }
+}
+
+bool GetRecordings(PVRDemoBackendMessage& message, const PVRDemoTimeResolver& times, PVRDemoTextStore& texts,
+                   std::vector<PVRDemoRecording>& recordings)
+{
+  uint32_t iCount = 0;
+  if (!GetCount(message, iCount))
+    return false;
+  recordings.resize(iCount);
+  for (auto& recording : recordings)
+  {
+    uint8_t bRadio = 0;
+    std::string strPlotOutline, strPlot;
+    message.GetU8(bRadio);
+    recording.bRadio = bRadio != 0;
+    message.GetI32(recording.iDuration);
+    message.GetI32(recording.iGenreType);
+    message.GetI32(recording.iGenreSubType);
+    message.GetI32(recording.iSeriesNumber);
+    message.GetI32(recording.iEpisodeNumber);
+    message.GetString(recording.strChannelName);
+    message.GetString(strPlotOutline);
+    message.GetString(strPlot);
+    message.GetString(recording.strRecordingId);
+    message.GetString(recording.strStreamURL);
+    message.GetString(recording.strTitle);
+    message.GetString(recording.strEpisodeName);
+    message.GetString(recording.strDirectory);
+    message.GetTime(recording.recordingTime);
+    if (!message.GetString(recording.strRecordingTime))
+      return false;
+
+    recording.strPlotOutline = texts.Add(strPlotOutline);
+    recording.strPlot = texts.Add(strPlot);
+    if (!recording.strRecordingTime.empty())
+      times.Resolve(recording.strRecordingTime.c_str(), -1, recording.recordingTime);
+  }
+  return true;
+}
+
+void PutTimers(PVRDemoBackendMessage& message, const std::vector<PVRDemoTimer>& timers)
+{
+  message.PutU32((uint32_t)timers.size());
+  for (const auto& timer : timers)
+  {
+    message.PutI32(timer.iChannelId);
+    message.PutI64(timer.startTime);
+    message.PutI64(timer.endTime);
+    message.PutI32(timer.state);
+    message.PutString(timer.strTitle);
+    message.PutString(timer.strSummary);
+    message.PutString(timer.strStartTime);
+    message.PutString(timer.strEndTime);
+  }
+}
+
+bool GetTimers(PVRDemoBackendMessage& message, const PVRDemoTimeResolver& times, std::vector<PVRDemoTimer>& timers)
+{
+  uint32_t iCount = 0;
+  if (!GetCount(message, iCount))
+    return false;
+  timers.resize(iCount);
+  for (auto& timer : timers)
+  {
+    int iState = 0;
+    message.GetI32(timer.iChannelId);
+    message.GetTime(timer.startTime);
+    message.GetTime(timer.endTime);
+    message.GetI32(iState);
+    timer.state = (PVR_TIMER_STATE)iState;
+    message.GetString(timer.strTitle);
+    message.GetString(timer.strSummary);
+    message.GetString(timer.strStartTime);
+    if (!message.GetString(timer.strEndTime))
+      return false;
+
+    if (!timer.strStartTime.empty())
+      times.Resolve(timer.strStartTime.c_str(), 0, timer.startTime);
+    if (!timer.strEndTime.empty())
+      times.Resolve(timer.strEndTime.c_str(), 0, timer.endTime);
+  }
+  return true;
+}
+
+/* the add-on's profile directory may not exist before settings are saved */
+void CreateDirectories(const std::string& strFile)
+{
+  for (size_t iPos = strFile.find('/', 1); iPos != std::string::npos; iPos = strFile.find('/', iPos + 1))
+    mkdir(strFile.substr(0, iPos).c_str(), 0755);
+}
+}
+
+bool PVRDemoSnapshot::Stat(const std::string& strPath, PVRDemoSourceFile& file)
+{
+  struct stat info;
+  if (stat(strPath.c_str(), &info) != 0)
+    return false;
+
+  file.strPath   = strPath;
+  file.iSize     = (int64_t)info.st_size;
+  file.iModified = (int64_t)info.st_mtime;
+  return true;
+}
+
+bool PVRDemoSnapshot::Save(const PVRDemoDataSet& data, const std::string& strFile)
+{
+  PVRDEMO_STATS_SCOPE();
+  if (!data.sources || !data.channels || !data.groups || !data.recordings || !data.recordingsDeleted || !data.timers)
+    return false;
+
+  const int64_t iStartMs = P8PLATFORM::GetTimeMs();
+
+  PVRDemoBackendMessage message;
+  message.PutU32(MAGIC);
+  message.PutU32(VERSION);
+  message.PutU32((uint32_t)data.sources->size());
+  for (const auto& source : *data.sources)
+  {
+    message.PutString(source.strPath);
+    message.PutI64(source.iSize);
+    message.PutI64(source.iModified);
+  }
+  message.PutString(StringSetting(g_strXmltvFile));
+  message.PutI32(g_iIconSize);
+  message.PutString(PVRDemoData::RecordingDirectory());
+
+  PutChannels(message, *data.channels);
+  PutGroups(message, *data.groups);
+  PutRecordings(message, *data.recordings);
+  PutRecordings(message, *data.recordingsDeleted);
+  PutTimers(message, *data.timers);
+
+  message.PutU32(data.guide ? (uint32_t)data.guide->size() : 0);
+  if (data.guide)
+  {
+    for (const auto& channel : *data.guide)
+    {
+      message.PutI32(channel.first);
+      PutEntries(message, channel.second);
+    }
+  }
+
+  CreateDirectories(strFile);
+  const std::string strTemporary = strFile + ".tmp";
+  FILE* file = fopen(strTemporary.c_str(), "wb");
+  if (!file)
+  {
+    PVRDEMO_LOG(LOG_ERROR, "%s - cannot write '%s'", __FUNCTION__, strTemporary.c_str());
+    return false;
+  }
+
+  const std::vector<uint8_t>& bytes = message.Data();
+  const bool bWritten = fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+  if (fclose(file) != 0 || !bWritten || rename(strTemporary.c_str(), strFile.c_str()) != 0)
+  {
+    PVRDEMO_LOG(LOG_ERROR, "%s - cannot write '%s'", __FUNCTION__, strFile.c_str());
+    remove(strTemporary.c_str());
+    return false;
+  }
+
+  PVRDEMO_STATS_COUNT(PVRDEMO_COUNTER_SNAPSHOT_BYTES, bytes.size());
+  PVRDEMO_LOG(LOG_INFO, "%s - wrote %zu bytes to '%s' in %lld ms", __FUNCTION__, bytes.size(), strFile.c_str(),
+              (long long)(P8PLATFORM::GetTimeMs() - iStartMs));
+  return true;
+}
+
+bool PVRDemoSnapshot::Load(const std::string& strFile, const PVRDemoTimeResolver& times, PVRDemoTextStore& texts, PVRDemoDataSet& data)
+{
+  PVRDEMO_STATS_SCOPE();
+  const int64_t iStartMs = P8PLATFORM::GetTimeMs();
+
+  FILE* file = fopen(strFile.c_str(), "rb");
+  if (!file)
+    return false;
+
+  PVRDemoBackendMessage message;
+  bool bRead = fseek(file, 0, SEEK_END) == 0;
+  const long iSize = bRead ? ftell(file) : -1;
+  if (iSize > 0 && fseek(file, 0, SEEK_SET) == 0)
+  {
+    message.Data().resize((size_t)iSize);
+    bRead = fread(message.Data().data(), 1, (size_t)iSize, file) == (size_t)iSize;
+  }
+  fclose(file);
+  if (!bRead || iSize <= 0)
+    return false;
+
+  uint32_t iMagic = 0, iVersion = 0, iSources = 0;
+  if (!message.GetU32(iMagic) || iMagic != MAGIC || !message.GetU32(iVersion) || iVersion != VERSION ||
+      !GetCount(message, iSources))
+  {
+    PVRDEMO_LOG(LOG_INFO, "%s - '%s' is not a snapshot of this version", __FUNCTION__, strFile.c_str());
+    return false;
+  }
+
+  /* every file the version came from must be as it was */
+  std::shared_ptr<std::vector<PVRDemoSourceFile>> sources = std::make_shared<std::vector<PVRDemoSourceFile>>(iSources);
+  for (auto& source : *sources)
+  {
+    PVRDemoSourceFile current;
+    message.GetString(source.strPath);
+    message.GetI64(source.iSize);
+    if (!message.GetI64(source.iModified) || !Stat(source.strPath, current) ||
+        current.iSize != source.iSize || current.iModified != source.iModified)
+    {
+      PVRDEMO_LOG(LOG_INFO, "%s - '%s' changed since the snapshot", __FUNCTION__, source.strPath.c_str());
+      return false;
+    }
+  }
+
+  std::string strXmltvFile;
+  if (!message.GetString(strXmltvFile) || strXmltvFile != StringSetting(g_strXmltvFile))
+  {
+    PVRDEMO_LOG(LOG_INFO, "%s - the XMLTV guide changed since the snapshot", __FUNCTION__);
+    return false;
+  }
+
+  /* icons point at thumbnails of one size */
+  int32_t iIconSize = 0;
+  if (!message.GetI32(iIconSize) || iIconSize != g_iIconSize)
+  {
+    PVRDEMO_LOG(LOG_INFO, "%s - the icon size changed since the snapshot", __FUNCTION__);
+    return false;
+  }
+
+  /* the recordings directory itself is a source, but not which one it is */
+  std::string strRecordingDirectory;
+  if (!message.GetString(strRecordingDirectory) || strRecordingDirectory != PVRDemoData::RecordingDirectory())
+  {
+    PVRDEMO_LOG(LOG_INFO, "%s - the recordings directory changed since the snapshot", __FUNCTION__);
+    return false;
+  }
+
+  std::vector<PVRDemoChannel>      channels;
+  std::vector<PVRDemoChannelGroup> groups;
+  std::vector<PVRDemoRecording>    recordings;
+  std::vector<PVRDemoRecording>    recordingsDeleted;
+  std::vector<PVRDemoTimer>        timers;
+  std::shared_ptr<PVRDemoGuide>    guide;
+  uint32_t                         iGuideChannels = 0;
+
+  if (!GetChannels(message, texts, channels) || !GetGroups(message, groups) ||
+      !GetRecordings(message, times, texts, recordings) || !GetRecordings(message, times, texts, recordingsDeleted) ||
+      !GetTimers(message, times, timers) || !GetCount(message, iGuideChannels))
+  {
+    PVRDEMO_LOG(LOG_ERROR, "%s - '%s' is damaged", __FUNCTION__, strFile.c_str());
+    return false;
+  }
+
+  if (iGuideChannels > 0)
+    guide = std::make_shared<PVRDemoGuide>();
+  for (uint32_t i = 0; i < iGuideChannels; ++i)
+  {
+    int iChannelUid = 0;
+    if (!message.GetI32(iChannelUid) || !GetEntries(message, texts, (*guide)[iChannelUid]))
+    {
+      PVRDEMO_LOG(LOG_ERROR, "%s - '%s' is damaged", __FUNCTION__, strFile.c_str());
+      return false;
+    }
+  }
+
+  if (!message.AtEnd())
+  {
+    PVRDEMO_LOG(LOG_ERROR, "%s - '%s' is damaged", __FUNCTION__, strFile.c_str());
+    return false;
+  }
+
+  PVRDEMO_STATS_COUNT(PVRDEMO_COUNTER_SNAPSHOT_BYTES, iSize);
+  PVRDEMO_LOG(LOG_INFO, "%s - read %zu channels, %zu recordings, %zu timers from '%s' in %lld ms", __FUNCTION__,
+              channels.size(), recordings.size(), timers.size(), strFile.c_str(), (long long)(P8PLATFORM::GetTimeMs() - iStartMs));
+
+  data.channels          = std::make_shared<const std::vector<PVRDemoChannel>>(std::move(channels));
+  data.groups            = std::make_shared<const std::vector<PVRDemoChannelGroup>>(std::move(groups));
+  data.recordings        = std::make_shared<const std::vector<PVRDemoRecording>>(std::move(recordings));
+  data.recordingsDeleted = std::make_shared<const std::vector<PVRDemoRecording>>(std::move(recordingsDeleted));
+  data.timers            = std::make_shared<const std::vector<PVRDemoTimer>>(std::move(timers));
+  data.guide             = guide;
+  data.sources           = sources;
+  return true;
+}
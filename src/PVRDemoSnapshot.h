@@ -0,0 +1,43 @@
+/*
+ *  Copyright (C) 2011-2020 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2011 Pulse-Eight (http://www.pulse-eight.com/)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <string>
+#include "PVRDemoData.h"
+
+/*!
+ * A version of the data written to one file, for a start after standby to
+ * pick up instead of reading the data file and the XMLTV guide again. The
+ * file records the size and modification time of every file the version
+ * was read from and is only taken back while all of them are unchanged.
+ *
+ * Sections are written as the add-on holds them, the channels' schedule
+ * and the imported guide included, with plots as plain text. Recording and
+ * timer times keep their expression and are resolved again on load, so
+ * "yesterday at 20:15" is yesterday of the day the snapshot is read.
+ */
+class PVRDemoSnapshot
+{
+public:
+  static const uint32_t MAGIC   = 0x4e534450; // "PDSN"
+  static const uint32_t VERSION = 3;
+
+  /* write the sections of data to strFile through a temporary file; false if data has no sources */
+  static bool Save(const PVRDemoDataSet& data, const std::string& strFile);
+
+  /*!
+   * Read the sections of strFile into data if it is still current, with
+   * plots added to texts and times resolved by times. data is left alone
+   * otherwise.
+   */
+  static bool Load(const std::string& strFile, const PVRDemoTimeResolver& times, PVRDemoTextStore& texts, PVRDemoDataSet& data);
+
+  /* the size and modification time of a file, false if it cannot be read */
+  static bool Stat(const std::string& strPath, PVRDemoSourceFile& file);
+};
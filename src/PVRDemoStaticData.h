@@ -0,0 +1,142 @@
+/*
+ *  Copyright (C) 2011-2020 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2011 Pulse-Eight (http://www.pulse-eight.com/)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <string.h>
+#include <string>
+#include "client.h"
+
+/*
+ * Literal types for the data tables tools/pvrdemo-codegen.py generates from
+ * PVRDemoAddonSettings.xml. They mirror the structs in PVRDemoData.h closely
+ * enough for the read paths there to be written once, as templates, for
+ * both. Nothing here owns memory; all of it points into the tables.
+ */
+
+/* string literal with the part of the std::string interface the read paths use */
+class PVRDemoStaticString
+{
+public:
+  constexpr PVRDemoStaticString(const char* str) : m_str(str) {}
+
+  const char* c_str(void) const { return m_str; }
+  bool empty(void) const { return *m_str == '\0'; }
+  bool operator==(const char* str) const { return strcmp(m_str, str) == 0; }
+  operator std::string(void) const { return m_str; }
+
+private:
+  const char* m_str;
+};
+
+/* view of a generated array, iterable like the std::vector it replaces */
+template<typename T>
+class PVRDemoStaticArray
+{
+public:
+  typedef T value_type;
+
+  constexpr PVRDemoStaticArray(void) : m_data(nullptr), m_size(0) {}
+  constexpr PVRDemoStaticArray(const T* data, size_t size) : m_data(data), m_size(size) {}
+
+  const T* begin(void) const { return m_data; }
+  const T* end(void) const { return m_data + m_size; }
+  size_t size(void) const { return m_size; }
+  bool empty(void) const { return m_size == 0; }
+  const T& at(size_t i) const { return m_data[i]; }
+  const T& operator[](size_t i) const { return m_data[i]; }
+
+private:
+  const T* m_data;
+  size_t   m_size;
+};
+
+struct PVRDemoStaticEpgEntry
+{
+  int                 iBroadcastId;
+  PVRDemoStaticString strTitle;
+  int                 iChannelId;
+  time_t              startTime;
+  time_t              endTime;
+  PVRDemoStaticString strPlotOutline;
+  PVRDemoStaticString strPlot;
+  PVRDemoStaticString strIconPath;
+  int                 iGenreType;
+  int                 iGenreSubType;
+  int                 iSeriesNumber;
+  int                 iEpisodeNumber;
+  PVRDemoStaticString strEpisodeName;
+};
+
+struct PVRDemoStaticChannel
+{
+  bool                bRadio;
+  int                 iUniqueId;
+  int                 iChannelNumber;
+  int                 iSubChannelNumber;
+  int                 iEncryptionSystem;
+  PVRDemoStaticString strChannelName;
+  PVRDemoStaticString strIconPath;
+  bool                bIconInAddon;   // strIconPath is relative to g_strClientPath
+  PVRDemoStaticString strStreamURL;
+  PVRDemoStaticArray<PVRDemoStaticEpgEntry> epg;
+};
+
+/* recording and timer times are kept as written, see PVRDemoTime.h */
+struct PVRDemoStaticRecording
+{
+  bool                bRadio;
+  int                 iDuration;
+  int                 iGenreType;
+  int                 iGenreSubType;
+  int                 iSeriesNumber;
+  int                 iEpisodeNumber;
+  PVRDemoStaticString strChannelName;
+  PVRDemoStaticString strPlotOutline;
+  PVRDemoStaticString strPlot;
+  PVRDemoStaticString strRecordingId;
+  PVRDemoStaticString strStreamURL;
+  PVRDemoStaticString strTitle;
+  PVRDemoStaticString strEpisodeName;
+  PVRDemoStaticString strDirectory;
+  PVRDemoStaticString strRecordingTime;  // yesterday unless it names a day
+};
+
+struct PVRDemoStaticTimer
+{
+  int                 iChannelId;
+  PVRDemoStaticString strStartTime;     // today unless it names a day
+  PVRDemoStaticString strEndTime;
+  PVR_TIMER_STATE     state;
+  PVRDemoStaticString strTitle;
+  PVRDemoStaticString strSummary;
+};
+
+struct PVRDemoStaticChannelGroup
+{
+  bool                    bRadio;
+  int                     iGroupId;
+  PVRDemoStaticString     strGroupName;
+  int                     iPosition;
+  PVRDemoStaticArray<int> members;
+};
+
+struct PVRDemoStaticDataSet
+{
+  PVRDemoStaticArray<PVRDemoStaticChannel>      channels;
+  PVRDemoStaticArray<PVRDemoStaticChannelGroup> groups;
+  PVRDemoStaticArray<PVRDemoStaticRecording>    recordings;
+  PVRDemoStaticArray<PVRDemoStaticRecording>    recordingsDeleted;
+  PVRDemoStaticArray<PVRDemoStaticTimer>        timers;
+};
+
+#ifdef PVRDEMO_STATIC_DATA
+/* defined in the generated PVRDemoStaticData.cpp */
+extern const PVRDemoStaticDataSet g_staticDemoData;
+#endif
@@ -0,0 +1,448 @@
+/*
+ *  Copyright (C) 2011-2020 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2011 Pulse-Eight (http://www.pulse-eight.com/)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "PVRDemoStats.h"
+
+#ifdef PVRDEMO_ENABLE_STATS
+
+#include "client.h"
+#include "p8-platform/threads/mutex.h"
+#include "p8-platform/threads/threads.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define PVRDEMO_STATS_TSC 1
+#elif defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#define PVRDEMO_STATS_TSC 1
+#endif
+
+using namespace ADDON;
+using namespace P8PLATFORM;
+
+namespace
+{
+
+const int SUB_BUCKET_BITS = 4;
+const int SUB_BUCKETS     = 1 << SUB_BUCKET_BITS;
+const int MAX_MAGNITUDE   = 44; // 2^44 ticks, over an hour on any clock
+const int BUCKETS         = (MAX_MAGNITUDE - SUB_BUCKET_BITS + 2) * SUB_BUCKETS;
+
+/* counters only a few entry points record, added to their summary line when set */
+const int         FIRST_OTHER_COUNTER = PVRDEMO_COUNTER_CACHE_MISSES + 1;
+const char* const OTHER_COUNTER_NAMES[PVRDEMO_COUNTER_COUNT - FIRST_OTHER_COUNTER] =
+{
+  "icon bytes hashed",
+  "snapshot bytes",
+};
+
+/* one entry point as seen by one thread; only that thread writes to it,
+ * so plain relaxed stores are enough */
+struct Block
+{
+  std::atomic<uint64_t> iCalls;
+  std::atomic<uint64_t> iTicks;
+  std::atomic<uint64_t> iMaxTicks;
+  std::atomic<uint64_t> counters[PVRDEMO_COUNTER_COUNT];
+  std::atomic<uint64_t> buckets[BUCKETS];
+};
+
+struct ThreadStats
+{
+  std::atomic<Block*> blocks[PVRDemoStats::MAX_ENTRY_POINTS];
+  int                 iCurrent;
+};
+
+/* sum of the blocks of all threads */
+struct Merged
+{
+  uint64_t iCalls = 0;
+  uint64_t iTicks = 0;
+  uint64_t iMaxTicks = 0;
+  uint64_t counters[PVRDEMO_COUNTER_COUNT] = {};
+  std::vector<uint64_t> buckets = std::vector<uint64_t>(BUCKETS);
+};
+
+struct Registry
+{
+  CMutex                    mutex;
+  std::atomic<int>          iEntryPoints;
+  const char*               names[PVRDemoStats::MAX_ENTRY_POINTS];
+  std::vector<ThreadStats*> threads;
+  std::vector<Merged>       retired;    // what threads that have exited recorded
+  uint64_t                  iStartTicks;
+  int64_t                   iStartNs;
+};
+
+int64_t WallNs(void)
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+Registry& GetRegistry(void)
+{
+  /* never destroyed: threads may still record while the add-on unloads */
+  static Registry* registry = [] {
+    Registry* r = new Registry;
+    r->iEntryPoints = 1;
+    r->names[0] = "(background)";
+    r->iStartTicks = PVRDemoStats::Now();
+    r->iStartNs = WallNs();
+    return r;
+  }();
+  return *registry;
+}
+
+void MergeBlock(Merged& entry, const Block& block)
+{
+  entry.iCalls += block.iCalls.load(std::memory_order_relaxed);
+  entry.iTicks += block.iTicks.load(std::memory_order_relaxed);
+  entry.iMaxTicks = std::max(entry.iMaxTicks, block.iMaxTicks.load(std::memory_order_relaxed));
+  for (int c = 0; c < PVRDEMO_COUNTER_COUNT; ++c)
+    entry.counters[c] += block.counters[c].load(std::memory_order_relaxed);
+  for (int b = 0; b < BUCKETS; ++b)
+    entry.buckets[b] += block.buckets[b].load(std::memory_order_relaxed);
+}
+
+/* folds the calling thread's blocks into the retired totals when the thread exits */
+struct ThreadStatsOwner
+{
+  ThreadStats* stats = nullptr;
+
+  ~ThreadStatsOwner(void)
+  {
+    if (!stats)
+      return;
+
+    Registry& registry = GetRegistry();
+    {
+      CLockObject lock(registry.mutex);
+      registry.threads.erase(std::find(registry.threads.begin(), registry.threads.end(), stats));
+      const int iEntryPoints = registry.iEntryPoints.load(std::memory_order_relaxed);
+      if (registry.retired.size() < (size_t)iEntryPoints)
+        registry.retired.resize(iEntryPoints);
+      for (int i = 0; i < iEntryPoints; ++i)
+      {
+        const Block* block = stats->blocks[i].load(std::memory_order_relaxed);
+        if (block)
+          MergeBlock(registry.retired[i], *block);
+      }
+    }
+
+    for (auto& block : stats->blocks)
+      delete block.load(std::memory_order_relaxed);
+    delete stats;
+    stats = nullptr;
+  }
+};
+
+thread_local ThreadStatsOwner t_stats;
+
+ThreadStats& CurrentThread(void)
+{
+  if (!t_stats.stats)
+  {
+    ThreadStats* stats = new ThreadStats();
+    Registry& registry = GetRegistry();
+    CLockObject lock(registry.mutex);
+    registry.threads.push_back(stats);
+    t_stats.stats = stats;
+  }
+  return *t_stats.stats;
+}
+
+Block& GetBlock(ThreadStats& stats, int iEntryPoint)
+{
+  Block* block = stats.blocks[iEntryPoint].load(std::memory_order_relaxed);
+  if (!block)
+  {
+    block = new Block();
+    stats.blocks[iEntryPoint].store(block, std::memory_order_release);
+  }
+  return *block;
+}
+
+inline void Add(std::atomic<uint64_t>& value, uint64_t iAmount)
+{
+  value.store(value.load(std::memory_order_relaxed) + iAmount, std::memory_order_relaxed);
+}
+
+inline int Magnitude(uint64_t iValue)
+{
+#if defined(__GNUC__)
+  return 63 - __builtin_clzll(iValue);
+#else
+  int iMagnitude = 0;
+  while (iValue >>= 1)
+    ++iMagnitude;
+  return iMagnitude;
+#endif
+}
+
+inline int BucketIndex(uint64_t iTicks)
+{
+  if (iTicks < (uint64_t)SUB_BUCKETS)
+    return (int)iTicks;
+
+  int iMagnitude = Magnitude(iTicks);
+  if (iMagnitude > MAX_MAGNITUDE)
+    return BUCKETS - 1;
+
+  const int iSub = (int)(iTicks >> (iMagnitude - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+  return ((iMagnitude - SUB_BUCKET_BITS + 1) << SUB_BUCKET_BITS) | iSub;
+}
+
+/* middle of the range a bucket covers */
+double BucketValue(int iIndex)
+{
+  if (iIndex < SUB_BUCKETS)
+    return (double)iIndex;
+
+  const int iMagnitude = (iIndex >> SUB_BUCKET_BITS) + SUB_BUCKET_BITS - 1;
+  const double fWidth = (double)((uint64_t)1 << (iMagnitude - SUB_BUCKET_BITS));
+  return (double)(SUB_BUCKETS | (iIndex & (SUB_BUCKETS - 1))) * fWidth + fWidth / 2;
+}
+
+double Percentile(const Merged& merged, double fFraction)
+{
+  const uint64_t iTarget = std::max<uint64_t>(1, (uint64_t)(fFraction * (double)merged.iCalls + 0.5));
+  uint64_t iSeen = 0;
+  for (int i = 0; i < BUCKETS; ++i)
+  {
+    iSeen += merged.buckets[i];
+    if (iSeen >= iTarget)
+      return std::min(BucketValue(i), (double)merged.iMaxTicks);
+  }
+  return (double)merged.iMaxTicks;
+}
+
+double TicksPerUs(void)
+{
+#ifdef PVRDEMO_STATS_TSC
+  const Registry& registry = GetRegistry();
+  const int64_t iElapsedNs = WallNs() - registry.iStartNs;
+  if (iElapsedNs < 1000000)
+    return 1000.0;
+  return (double)(PVRDemoStats::Now() - registry.iStartTicks) * 1000.0 / (double)iElapsedNs;
+#else
+  return 1000.0;
+#endif
+}
+
+std::vector<Merged> MergeAll(int& iEntryPoints)
+{
+  Registry& registry = GetRegistry();
+  iEntryPoints = registry.iEntryPoints.load(std::memory_order_acquire);
+
+  /* a thread that exits meanwhile waits to retire its blocks; the lock is
+   * otherwise only taken by a thread's first call and by registration */
+  CLockObject lock(registry.mutex);
+  std::vector<Merged> merged(iEntryPoints);
+  std::copy(registry.retired.begin(), registry.retired.begin() + std::min<size_t>(registry.retired.size(), iEntryPoints), merged.begin());
+  for (ThreadStats* stats : registry.threads)
+  {
+    for (int i = 0; i < iEntryPoints; ++i)
+    {
+      const Block* block = stats->blocks[i].load(std::memory_order_acquire);
+      if (block)
+        MergeBlock(merged[i], *block);
+    }
+  }
+  return merged;
+}
+
+std::string OtherCounters(const Merged& entry)
+{
+  std::string strCounters;
+  for (int c = FIRST_OTHER_COUNTER; c < PVRDEMO_COUNTER_COUNT; ++c)
+  {
+    if (entry.counters[c] == 0)
+      continue;
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), ", %llu %s", (unsigned long long)entry.counters[c], OTHER_COUNTER_NAMES[c - FIRST_OTHER_COUNTER]);
+    strCounters += buffer;
+  }
+  return strCounters;
+}
+
+void LogPeriodic(void)
+{
+  int iEntryPoints;
+  std::vector<Merged> merged = MergeAll(iEntryPoints);
+  const double fTicksPerUs = TicksPerUs();
+
+  Merged total;
+  int iSlowest = -1;
+  double fSlowestP99 = 0.0;
+  for (int i = 0; i < iEntryPoints; ++i)
+  {
+    total.iCalls += merged[i].iCalls;
+    for (int c = 0; c < PVRDEMO_COUNTER_COUNT; ++c)
+      total.counters[c] += merged[i].counters[c];
+
+    if (merged[i].iCalls == 0)
+      continue;
+    const double fP99 = Percentile(merged[i], 0.99);
+    if (fP99 > fSlowestP99)
+    {
+      fSlowestP99 = fP99;
+      iSlowest = i;
+    }
+  }
+
+  PVRDEMO_LOG(LOG_INFO, "%s - %llu calls, %llu entries, %llu bytes, cache %llu hits %llu misses, slowest p99 %s %.1f us",
+              __FUNCTION__, (unsigned long long)total.iCalls,
+              (unsigned long long)total.counters[PVRDEMO_COUNTER_ENTRIES],
+              (unsigned long long)total.counters[PVRDEMO_COUNTER_BYTES],
+              (unsigned long long)total.counters[PVRDEMO_COUNTER_CACHE_HITS],
+              (unsigned long long)total.counters[PVRDEMO_COUNTER_CACHE_MISSES],
+              iSlowest >= 0 ? GetRegistry().names[iSlowest] : "-", fSlowestP99 / fTicksPerUs);
+}
+
+/* writes the periodic summary, so no entry point ever pays for a merge */
+class SummaryWriter : public CThread
+{
+public:
+  SummaryWriter(void) : m_wakeEvent(true) {}
+
+  void Wake(void) { m_wakeEvent.Signal(); }
+
+protected:
+  void* Process(void) override
+  {
+    while (!IsStopped())
+    {
+      m_wakeEvent.Wait(PVRDemoStats::SUMMARY_INTERVAL_S * 1000);
+      if (!IsStopped())
+        LogPeriodic();
+    }
+    return NULL;
+  }
+
+private:
+  CEvent m_wakeEvent;
+};
+
+/* never destroyed, like the registry */
+SummaryWriter& GetSummaryWriter(void)
+{
+  static SummaryWriter* writer = new SummaryWriter;
+  return *writer;
+}
+
+}
+
+uint64_t PVRDemoStats::Now(void)
+{
+#ifdef PVRDEMO_STATS_TSC
+  return __rdtsc();
+#else
+  return (uint64_t)WallNs();
+#endif
+}
+
+int PVRDemoStats::Register(const char* strName)
+{
+  Registry& registry = GetRegistry();
+  CLockObject lock(registry.mutex);
+
+  const int iEntryPoints = registry.iEntryPoints.load(std::memory_order_relaxed);
+  for (int i = 1; i < iEntryPoints; ++i)
+  {
+    if (strcmp(registry.names[i], strName) == 0)
+      return i;
+  }
+  if (iEntryPoints == MAX_ENTRY_POINTS)
+    return 0;
+
+  registry.names[iEntryPoints] = strName;
+  registry.iEntryPoints.store(iEntryPoints + 1, std::memory_order_release);
+  return iEntryPoints;
+}
+
+int PVRDemoStats::Enter(int iEntryPoint)
+{
+  ThreadStats& stats = CurrentThread();
+  const int iPrevious = stats.iCurrent;
+  stats.iCurrent = iEntryPoint;
+  return iPrevious;
+}
+
+void PVRDemoStats::Leave(int iEntryPoint, int iPrevious, uint64_t iStart)
+{
+  const uint64_t iTicks = Now() - iStart;
+
+  ThreadStats& stats = *t_stats.stats;
+  stats.iCurrent = iPrevious;
+
+  Block& block = GetBlock(stats, iEntryPoint);
+  Add(block.iCalls, 1);
+  Add(block.iTicks, iTicks);
+  if (iTicks > block.iMaxTicks.load(std::memory_order_relaxed))
+    block.iMaxTicks.store(iTicks, std::memory_order_relaxed);
+  Add(block.buckets[BucketIndex(iTicks)], 1);
+}
+
+void PVRDemoStats::Start(void)
+{
+  SummaryWriter& writer = GetSummaryWriter();
+  if (!writer.IsRunning())
+    writer.CreateThread(false);
+}
+
+void PVRDemoStats::Stop(void)
+{
+  SummaryWriter& writer = GetSummaryWriter();
+  writer.StopThread(-1);
+  writer.Wake();
+  writer.StopThread();
+}
+
+void PVRDemoStats::Count(PVRDemoStatsCounter counter, uint64_t iValue)
+{
+  ThreadStats& stats = CurrentThread();
+  Add(GetBlock(stats, stats.iCurrent).counters[counter], iValue);
+}
+
+void PVRDemoStats::LogSummary(void)
+{
+  int iEntryPoints;
+  std::vector<Merged> merged = MergeAll(iEntryPoints);
+  const double fTicksPerUs = TicksPerUs();
+  const Registry& registry = GetRegistry();
+
+  for (int i = 0; i < iEntryPoints; ++i)
+  {
+    const Merged& entry = merged[i];
+    if (entry.iCalls == 0 && std::all_of(entry.counters, entry.counters + PVRDEMO_COUNTER_COUNT, [](uint64_t iValue) { return iValue == 0; }))
+      continue;
+
+    XBMC->Log(LOG_INFO, "%s - %s: %llu calls, mean %.1f us, p50 %.1f us, p90 %.1f us, p99 %.1f us, max %.1f us, "
+                        "%llu entries, %llu bytes, cache %llu hits %llu misses%s",
+              __FUNCTION__, registry.names[i], (unsigned long long)entry.iCalls,
+              entry.iCalls ? (double)entry.iTicks / (double)entry.iCalls / fTicksPerUs : 0.0,
+              entry.iCalls ? Percentile(entry, 0.50) / fTicksPerUs : 0.0,
+              entry.iCalls ? Percentile(entry, 0.90) / fTicksPerUs : 0.0,
+              entry.iCalls ? Percentile(entry, 0.99) / fTicksPerUs : 0.0,
+              (double)entry.iMaxTicks / fTicksPerUs,
+              (unsigned long long)entry.counters[PVRDEMO_COUNTER_ENTRIES],
+              (unsigned long long)entry.counters[PVRDEMO_COUNTER_BYTES],
+              (unsigned long long)entry.counters[PVRDEMO_COUNTER_CACHE_HITS],
+              (unsigned long long)entry.counters[PVRDEMO_COUNTER_CACHE_MISSES],
+              OtherCounters(entry).c_str());
+  }
+}
+
+#endif
@@ -0,0 +1,96 @@
+/*
+ *  Copyright (C) 2011-2020 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2011 Pulse-Eight (http://www.pulse-eight.com/)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+enum PVRDemoStatsCounter
+{
+  PVRDEMO_COUNTER_ENTRIES,        // entries handed to Kodi through Transfer*()
+  PVRDEMO_COUNTER_BYTES,          // stream and packet bytes handed to Kodi
+  PVRDEMO_COUNTER_CACHE_HITS,     // reads served from data that was already there
+  PVRDEMO_COUNTER_CACHE_MISSES,   // reads that had to wait or go to the source
+  PVRDEMO_COUNTER_ICON_BYTES,     // channel icon bytes read and hashed by the icon cache
+  PVRDEMO_COUNTER_SNAPSHOT_BYTES, // bytes of the data snapshot written or read
+  PVRDEMO_COUNTER_COUNT
+};
+
+#ifdef PVRDEMO_ENABLE_STATS
+
+/*!
+ * Latency histograms and counters per entry point. Every thread records
+ * into its own blocks with plain relaxed stores, so recording never
+ * contends; a dump sums the blocks of all threads while they keep going.
+ * The blocks of a thread that exits are added to totals kept for all such
+ * threads and freed.
+ *
+ * Latencies are kept in CPU timestamp ticks and only converted to time
+ * when reported. Histograms are log-linear with 16 sub-buckets per power
+ * of two, which bounds the error of a reported percentile to about 6%.
+ */
+class PVRDemoStats
+{
+public:
+  static const int MAX_ENTRY_POINTS = 128;
+  static const int SUMMARY_INTERVAL_S = 600;
+
+  /*!
+   * Assign an id to an entry point name; the name must outlive the process.
+   * Id 0 collects counters recorded outside any entry point.
+   */
+  static int Register(const char* strName);
+
+  static uint64_t Now(void);
+  static int Enter(int iEntryPoint);
+  static void Leave(int iEntryPoint, int iPrevious, uint64_t iStart);
+  static void Count(PVRDemoStatsCounter counter, uint64_t iValue);
+
+  /* start and stop the thread logging a one-line summary every SUMMARY_INTERVAL_S */
+  static void Start(void);
+  static void Stop(void);
+
+  /* one log line per entry point that has been called */
+  static void LogSummary(void);
+};
+
+class PVRDemoStatsScope
+{
+public:
+  explicit PVRDemoStatsScope(int iEntryPoint) :
+    m_iEntryPoint(iEntryPoint),
+    m_iPrevious(PVRDemoStats::Enter(iEntryPoint)),
+    m_iStart(PVRDemoStats::Now())
+  {
+  }
+
+  ~PVRDemoStatsScope(void)
+  {
+    PVRDemoStats::Leave(m_iEntryPoint, m_iPrevious, m_iStart);
+  }
+
+private:
+  PVRDemoStatsScope(const PVRDemoStatsScope&) = delete;
+  PVRDemoStatsScope& operator=(const PVRDemoStatsScope&) = delete;
+
+  const int      m_iEntryPoint;
+  const int      m_iPrevious;
+  const uint64_t m_iStart;
+};
+
+#define PVRDEMO_STATS_SCOPE() \
+  static const int iStatsEntryPoint = PVRDemoStats::Register(__FUNCTION__); \
+  PVRDemoStatsScope statsScope(iStatsEntryPoint)
+#define PVRDEMO_STATS_COUNT(counter, value) PVRDemoStats::Count(counter, value)
+
+#else
+
+#define PVRDEMO_STATS_SCOPE()
+#define PVRDEMO_STATS_COUNT(counter, value) ((void)0)
+
+#endif
@@ -0,0 +1,243 @@
+/*
+ *  Copyright (C) 2011-2020 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2011 Pulse-Eight (http://www.pulse-eight.com/)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "PVRDemoStreamSource.h"
+#include "PVRDemoSyntheticSource.h"
+#include "client.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifndef TARGET_WINDOWS
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+using namespace ADDON;
+
+namespace
+{
+bool HasPrefix(const std::string& strValue, const char* strPrefix)
+{
+  return strValue.compare(0, strlen(strPrefix), strPrefix) == 0;
+}
+
+#ifndef TARGET_WINDOWS
+const char* const FILE_SCHEME = "file://";
+const char* const UNIX_SCHEME = "unix://";
+
+std::string ResolveClientPath(const std::string& strPath)
+{
+  if (strPath.empty() || strPath[0] == '/')
+    return strPath;
+
+  std::string strResolved = g_strClientPath;
+  if (!strResolved.empty() && strResolved[strResolved.size() - 1] != '/' && strResolved[strResolved.size() - 1] != '\\')
+    strResolved += '/';
+  return strResolved + strPath;
+}
+
+/* Local files are looped so that a recorded clip behaves like a live channel.
+ * FIFOs are read as they come and end when the writer goes away. */
+class PVRDemoFileSource : public PVRDemoStreamSource
+{
+public:
+  explicit PVRDemoFileSource(const std::string& strPath) :
+    m_strPath(strPath), m_fd(-1), m_bFifo(false), m_bSeenData(false) {}
+  ~PVRDemoFileSource(void) override { Close(); }
+
+  bool Open(void) override
+  {
+    struct stat st;
+    if (stat(m_strPath.c_str(), &st) != 0)
+    {
+      PVRDEMO_LOG(LOG_ERROR, "%s - cannot stat '%s': %s", __FUNCTION__, m_strPath.c_str(), strerror(errno));
+      return false;
+    }
+
+    m_bFifo = S_ISFIFO(st.st_mode);
+    m_fd = open(m_strPath.c_str(), O_RDONLY | (m_bFifo ? O_NONBLOCK : 0));
+    if (m_fd < 0)
+    {
+      PVRDEMO_LOG(LOG_ERROR, "%s - cannot open '%s': %s", __FUNCTION__, m_strPath.c_str(), strerror(errno));
+      return false;
+    }
+
+#ifdef POSIX_FADV_SEQUENTIAL
+    if (!m_bFifo)
+      posix_fadvise(m_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    return true;
+  }
+
+  void Close(void) override
+  {
+    if (m_fd >= 0)
+      close(m_fd);
+    m_fd = -1;
+  }
+
+  ssize_t Read(uint8_t* pBuffer, size_t iSize, int iTimeoutMs) override
+  {
+    if (m_fd < 0)
+      return -1;
+
+    if (!m_bFifo)
+    {
+      ssize_t iRead = read(m_fd, pBuffer, iSize);
+      if (iRead == 0 && lseek(m_fd, 0, SEEK_SET) == 0)
+        iRead = read(m_fd, pBuffer, iSize);
+      return iRead > 0 ? iRead : -1;
+    }
+
+    struct pollfd pfd = { m_fd, POLLIN, 0 };
+    int iReady = poll(&pfd, 1, iTimeoutMs);
+    if (iReady < 0)
+      return errno == EINTR ? 0 : -1;
+    if (iReady == 0)
+      return 0;
+
+    ssize_t iRead = read(m_fd, pBuffer, iSize);
+    if (iRead > 0)
+    {
+      m_bSeenData = true;
+      return iRead;
+    }
+    if (iRead < 0 && (errno == EAGAIN || errno == EINTR))
+      return 0;
+
+    /* no writer attached yet: POLLHUP fires immediately, so back off */
+    if (!m_bSeenData)
+    {
+      poll(NULL, 0, iTimeoutMs);
+      return 0;
+    }
+    return -1;
+  }
+
+  bool IsPaced(void) const override { return m_bFifo; }
+
+private:
+  std::string m_strPath;
+  int         m_fd;
+  bool        m_bFifo;
+  bool        m_bSeenData;
+};
+
+class PVRDemoSocketSource : public PVRDemoStreamSource
+{
+public:
+  explicit PVRDemoSocketSource(const std::string& strPath) : m_strPath(strPath), m_fd(-1) {}
+  ~PVRDemoSocketSource(void) override { Close(); }
+
+  bool Open(void) override
+  {
+    struct sockaddr_un addr = {};
+    if (m_strPath.size() >= sizeof(addr.sun_path))
+    {
+      PVRDEMO_LOG(LOG_ERROR, "%s - socket path too long '%s'", __FUNCTION__, m_strPath.c_str());
+      return false;
+    }
+
+    m_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (m_fd < 0)
+      return false;
+
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, m_strPath.c_str(), sizeof(addr.sun_path) - 1);
+    if (connect(m_fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0)
+    {
+      PVRDEMO_LOG(LOG_ERROR, "%s - cannot connect to '%s': %s", __FUNCTION__, m_strPath.c_str(), strerror(errno));
+      Close();
+      return false;
+    }
+    return true;
+  }
+
+  void Close(void) override
+  {
+    if (m_fd >= 0)
+      close(m_fd);
+    m_fd = -1;
+  }
+
+  ssize_t Read(uint8_t* pBuffer, size_t iSize, int iTimeoutMs) override
+  {
+    if (m_fd < 0)
+      return -1;
+
+    struct pollfd pfd = { m_fd, POLLIN, 0 };
+    int iReady = poll(&pfd, 1, iTimeoutMs);
+    if (iReady < 0)
+      return errno == EINTR ? 0 : -1;
+    if (iReady == 0)
+      return 0;
+
+    ssize_t iRead = recv(m_fd, pBuffer, iSize, 0);
+    if (iRead < 0 && (errno == EAGAIN || errno == EINTR))
+      return 0;
+    return iRead > 0 ? iRead : -1;
+  }
+
+private:
+  std::string m_strPath;
+  int         m_fd;
+};
+#endif
+}
+
+bool PVRDemoStreamSource::IsAddonServed(const std::string& strURL)
+{
+  if (HasPrefix(strURL, PVRDemoSyntheticSource::SCHEME))
+    return true;
+#ifdef TARGET_WINDOWS
+  return false;
+#else
+  if (strURL.empty())
+    return false;
+  if (HasPrefix(strURL, FILE_SCHEME) || HasPrefix(strURL, UNIX_SCHEME))
+    return true;
+  return strURL.find("://") == std::string::npos;
+#endif
+}
+
+PVRDemoStreamSource* PVRDemoStreamSource::Create(const std::string& strURL)
+{
+  if (!IsAddonServed(strURL))
+    return NULL;
+
+  if (HasPrefix(strURL, PVRDemoSyntheticSource::SCHEME))
+    return new PVRDemoSyntheticSource(strURL.substr(strlen(PVRDemoSyntheticSource::SCHEME)));
+#ifndef TARGET_WINDOWS
+  if (HasPrefix(strURL, UNIX_SCHEME))
+    return new PVRDemoSocketSource(strURL.substr(strlen(UNIX_SCHEME)));
+  if (HasPrefix(strURL, FILE_SCHEME))
+    return new PVRDemoFileSource(strURL.substr(strlen(FILE_SCHEME)));
+  return new PVRDemoFileSource(ResolveClientPath(strURL));
+#else
+  return NULL;
+#endif
+}
+
+bool PVRDemoStreamSource::LocalPath(const std::string& strURL, std::string& strPath)
+{
+#ifndef TARGET_WINDOWS
+  if (HasPrefix(strURL, FILE_SCHEME))
+  {
+    strPath = strURL.substr(strlen(FILE_SCHEME));
+    return true;
+  }
+  if (!strURL.empty() && strURL.find("://") == std::string::npos)
+  {
+    strPath = ResolveClientPath(strURL);
+    return true;
+  }
+#endif
+  return false;
+}
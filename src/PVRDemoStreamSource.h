@@ -0,0 +1,48 @@
+/*
+ *  Copyright (C) 2011-2020 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2011 Pulse-Eight (http://www.pulse-eight.com/)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <string>
+#include "p8-platform/os.h"
+
+/*!
+ * Byte source for streams the add-on serves itself. Remote URLs are still
+ * handed to Kodi through the stream properties; only sources that Create()
+ * recognises are read by the add-on.
+ */
+class PVRDemoStreamSource
+{
+public:
+  virtual ~PVRDemoStreamSource(void) {}
+
+  virtual bool Open(void) = 0;
+  virtual void Close(void) = 0;
+
+  /*!
+   * Read up to iSize bytes, waiting at most iTimeoutMs for data.
+   * @return bytes read, 0 on timeout, -1 on end of stream or error.
+   */
+  virtual ssize_t Read(uint8_t* pBuffer, size_t iSize, int iTimeoutMs) = 0;
+
+  /*!
+   * True if the source delivers data at its real-time rate (FIFOs, sockets).
+   * Unpaced sources such as looped files are read as fast as they are
+   * consumed.
+   */
+  virtual bool IsPaced(void) const { return true; }
+
+  static bool IsAddonServed(const std::string& strURL);
+  static PVRDemoStreamSource* Create(const std::string& strURL);
+
+  /*!
+   * Resolve a file:// URL or plain path to a local file path.
+   * @return false if the URL does not refer to a local file.
+   */
+  static bool LocalPath(const std::string& strURL, std::string& strPath);
+};
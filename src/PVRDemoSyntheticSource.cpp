@@ -0,0 +1,450 @@
+/*
+ *  Copyright (C) 2011-2020 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2011 Pulse-Eight (http://www.pulse-eight.com/)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "PVRDemoSyntheticSource.h"
+#include "client.h"
+#include "p8-platform/util/StringUtils.h"
+#include "p8-platform/util/timeutils.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+using namespace ADDON;
+using namespace P8PLATFORM;
+
+const char* const PVRDemoSyntheticSource::SCHEME = "synthetic://";
+
+namespace
+{
+const int      TS_SIZE          = 188;
+const int64_t  CLOCK_HZ         = 27000000;
+const int64_t  PSI_INTERVAL     = CLOCK_HZ / 10;     // 100 ms
+const int64_t  PCR_INTERVAL     = CLOCK_HZ * 35 / 1000; // DVB allows at most 40 ms
+const int64_t  PTS_DELAY        = CLOCK_HZ / 2;      // decoder buffering
+const uint16_t PMT_PID          = 0x1000;
+const uint16_t VIDEO_PID        = 0x0100;
+const uint16_t NULL_PID         = 0x1FFF;
+const int      AUDIO_BITRATE    = 128000;
+const size_t   AUDIO_FRAME_SIZE = 384;               // 48 kHz, 128 kbit/s layer II
+const int      MAX_STREAMS      = 15;                // the PMT has to fit one packet
+
+/* PMT: 12 bytes of header, 5 for the video stream, 11 per audio stream, 4 of CRC */
+static_assert(12 + 5 + 11 * (MAX_STREAMS - 1) + 4 <= TS_SIZE - 5, "the PMT does not fit one packet");
+
+uint32_t Crc32(const uint8_t* pData, size_t iSize)
+{
+  uint32_t iCrc = 0xFFFFFFFF;
+  for (size_t i = 0; i < iSize; ++i)
+  {
+    iCrc ^= (uint32_t)pData[i] << 24;
+    for (int iBit = 0; iBit < 8; ++iBit)
+      iCrc = (iCrc & 0x80000000) ? (iCrc << 1) ^ 0x04C11DB7 : iCrc << 1;
+  }
+  return iCrc;
+}
+
+void FinishSection(std::vector<uint8_t>& section)
+{
+  /* section_length counts everything after the length field, CRC included */
+  const size_t iLength = section.size() - 3 + 4;
+  section[1] = 0xB0 | ((iLength >> 8) & 0x0F);
+  section[2] = iLength & 0xFF;
+
+  const uint32_t iCrc = Crc32(section.data(), section.size());
+  section.push_back(iCrc >> 24);
+  section.push_back(iCrc >> 16);
+  section.push_back(iCrc >> 8);
+  section.push_back(iCrc);
+}
+
+void WriteTimestamp(uint8_t* p, uint8_t iPrefix, int64_t iTs)
+{
+  iTs &= ((int64_t)1 << 33) - 1;
+  p[0] = (iPrefix << 4) | (((iTs >> 30) & 0x07) << 1) | 0x01;
+  p[1] = (iTs >> 22) & 0xFF;
+  p[2] = (((iTs >> 15) & 0x7F) << 1) | 0x01;
+  p[3] = (iTs >> 7) & 0xFF;
+  p[4] = ((iTs & 0x7F) << 1) | 0x01;
+}
+
+uint64_t ParseBitrate(const std::string& strValue)
+{
+  char* pEnd = NULL;
+  double fValue = strtod(strValue.c_str(), &pEnd);
+  if (pEnd && (*pEnd == 'k' || *pEnd == 'K'))
+    fValue *= 1e3;
+  else if (pEnd && (*pEnd == 'm' || *pEnd == 'M'))
+    fValue *= 1e6;
+  else if (pEnd && (*pEnd == 'g' || *pEnd == 'G'))
+    fValue *= 1e9;
+  return fValue > 0 ? (uint64_t)fValue : 0;
+}
+}
+
+PVRDemoSyntheticSource::PVRDemoSyntheticSource(const std::string& strOptions) :
+  m_iBitrate(8000000),
+  m_iStreams(2),
+  m_bPaced(true),
+  m_iPatContinuity(0),
+  m_iPmtContinuity(0),
+  m_iPsiPending(0),
+  m_iNextPsi(0),
+  m_iLastPcr(-PCR_INTERVAL),
+  m_iClock(0),
+  m_iClockStep(0),
+  m_iClockRemainderStep(0),
+  m_iClockRemainder(0),
+  m_iPackets(0),
+  m_iOpenTimeMs(0),
+  m_iPartialOffset(TS_SIZE)
+{
+  ParseOptions(strOptions);
+}
+
+void PVRDemoSyntheticSource::ParseOptions(const std::string& strOptions)
+{
+  std::vector<std::string> options = StringUtils::Split(strOptions, "&");
+  for (const auto& strOption : options)
+  {
+    const size_t iDelim = strOption.find('=');
+    if (iDelim == std::string::npos)
+      continue;
+
+    const std::string strKey = strOption.substr(0, iDelim);
+    const std::string strValue = strOption.substr(iDelim + 1);
+    if (strKey == "bitrate")
+    {
+      uint64_t iBitrate = ParseBitrate(strValue);
+      if (iBitrate > 0)
+        m_iBitrate = iBitrate;
+    }
+    else if (strKey == "pids")
+      m_iStreams = std::max(1, std::min(MAX_STREAMS, atoi(strValue.c_str())));
+    else if (strKey == "pace")
+      m_bPaced = atoi(strValue.c_str()) != 0;
+    else
+      PVRDEMO_LOG(LOG_NOTICE, "%s - ignoring unknown synthetic stream option '%s'", __FUNCTION__, strKey.c_str());
+  }
+
+  /* every stream but the video one is a 128 kbit/s audio stream */
+  const uint64_t iMinimum = (uint64_t)(m_iStreams - 1) * AUDIO_BITRATE * 2 + 500000;
+  if (m_iBitrate < iMinimum)
+  {
+    PVRDEMO_LOG(LOG_NOTICE, "%s - bitrate %llu too low for %d streams, using %llu",
+                __FUNCTION__, (unsigned long long)m_iBitrate, m_iStreams, (unsigned long long)iMinimum);
+    m_iBitrate = iMinimum;
+  }
+}
+
+bool PVRDemoSyntheticSource::Open(void)
+{
+  const uint64_t iPacketClock = (uint64_t)TS_SIZE * 8 * CLOCK_HZ;
+  m_iClockStep = (int64_t)(iPacketClock / m_iBitrate);
+  m_iClockRemainderStep = iPacketClock % m_iBitrate;
+  m_iClockRemainder = 0;
+  m_iClock = 0;
+  m_iPackets = 0;
+  m_iNextPsi = 0;
+  m_iPsiPending = 0;
+  m_iLastPcr = -PCR_INTERVAL;
+  m_iPartialOffset = TS_SIZE;
+
+  /* keep ~10% headroom for TS/PES overhead and PSI, the rest is null packets */
+  const int64_t iAudioBitrate = (int64_t)(m_iStreams - 1) * AUDIO_BITRATE;
+  const int64_t iVideoBitrate = (int64_t)m_iBitrate * 9 / 10 - iAudioBitrate * 11 / 10;
+
+  m_streams.clear();
+  for (int i = 0; i < m_iStreams; ++i)
+  {
+    Elementary stream;
+    stream.bVideo      = (i == 0);
+    stream.iPid        = VIDEO_PID + i;
+    stream.iStreamType = stream.bVideo ? 0x1B : 0x03;
+    stream.iStreamId   = stream.bVideo ? 0xE0 : 0xC0 + (i - 1);
+    stream.iContinuity = 0;
+    stream.iNextDue    = 0;
+    stream.iInterval   = stream.bVideo ? CLOCK_HZ / 25 : CLOCK_HZ * 1152 / 48000;
+    stream.iPesDue     = 0;
+    stream.iPesOffset  = 0;
+    stream.iFrameSize  = stream.bVideo ? (size_t)(iVideoBitrate / 8 / 25) : AUDIO_FRAME_SIZE;
+    m_streams.push_back(stream);
+    m_streams.back().pes.reserve(m_streams.back().iFrameSize + 32);
+  }
+
+  BuildPsi();
+  m_iOpenTimeMs = GetTimeMs();
+
+  PVRDEMO_LOG(LOG_DEBUG, "%s - synthetic stream: %llu bit/s, %d streams, %s", __FUNCTION__,
+              (unsigned long long)m_iBitrate, m_iStreams, m_bPaced ? "paced" : "unpaced");
+  return true;
+}
+
+void PVRDemoSyntheticSource::Close(void)
+{
+  m_streams.clear();
+}
+
+void PVRDemoSyntheticSource::BuildPsi(void)
+{
+  m_pat.assign({ 0x00, 0x00, 0x00,   // table id, length placeholder
+                 0x00, 0x01,         // transport stream id
+                 0xC1, 0x00, 0x00,   // version 0, current, section 0/0
+                 0x00, 0x01,         // program 1
+                 (uint8_t)(0xE0 | (PMT_PID >> 8)), (uint8_t)(PMT_PID & 0xFF) });
+  FinishSection(m_pat);
+
+  m_pmt.assign({ 0x02, 0x00, 0x00,
+                 0x00, 0x01,         // program 1
+                 0xC1, 0x00, 0x00,
+                 (uint8_t)(0xE0 | (VIDEO_PID >> 8)), (uint8_t)(VIDEO_PID & 0xFF), // PCR PID
+                 0xF0, 0x00 });      // no program info
+  for (const auto& stream : m_streams)
+  {
+    m_pmt.push_back(stream.iStreamType);
+    m_pmt.push_back(0xE0 | (stream.iPid >> 8));
+    m_pmt.push_back(stream.iPid & 0xFF);
+    if (stream.bVideo)
+    {
+      m_pmt.push_back(0xF0);
+      m_pmt.push_back(0x00);
+    }
+    else
+    {
+      /* ISO 639 language descriptor */
+      const uint8_t descriptor[] = { 0x0A, 0x04, 'e', 'n', 'g', 0x00 };
+      m_pmt.push_back(0xF0);
+      m_pmt.push_back(sizeof(descriptor));
+      m_pmt.insert(m_pmt.end(), descriptor, descriptor + sizeof(descriptor));
+    }
+  }
+  FinishSection(m_pmt);
+}
+
+void PVRDemoSyntheticSource::BuildPes(Elementary& stream)
+{
+  const int64_t iPts = (stream.iNextDue + PTS_DELAY) / 300;
+  std::vector<uint8_t>& pes = stream.pes;
+  pes.clear();
+
+  if (stream.bVideo)
+  {
+    const uint8_t header[] = { 0x00, 0x00, 0x01, stream.iStreamId, 0x00, 0x00, 0x80, 0x80, 0x05 };
+    pes.insert(pes.end(), header, header + sizeof(header));
+    pes.resize(pes.size() + 5);
+    WriteTimestamp(&pes[pes.size() - 5], 0x2, iPts);
+
+    /* access unit delimiter followed by one filler NAL padding the frame */
+    const uint8_t aud[] = { 0x00, 0x00, 0x00, 0x01, 0x09, 0xF0, 0x00, 0x00, 0x00, 0x01, 0x0C };
+    pes.insert(pes.end(), aud, aud + sizeof(aud));
+    pes.resize(pes.size() + stream.iFrameSize - sizeof(aud) - 1, 0xFF);
+    pes.push_back(0x80);
+  }
+  else
+  {
+    const size_t iPesLength = 3 + 5 + AUDIO_FRAME_SIZE;
+    const uint8_t header[] = { 0x00, 0x00, 0x01, stream.iStreamId,
+                               (uint8_t)(iPesLength >> 8), (uint8_t)(iPesLength & 0xFF), 0x80, 0x80, 0x05 };
+    pes.insert(pes.end(), header, header + sizeof(header));
+    pes.resize(pes.size() + 5);
+    WriteTimestamp(&pes[pes.size() - 5], 0x2, iPts);
+
+    /* layer II frame with all bit allocations zero decodes as silence */
+    const uint8_t frameHeader[] = { 0xFF, 0xFD, 0x84, 0x00 };
+    pes.insert(pes.end(), frameHeader, frameHeader + sizeof(frameHeader));
+    pes.resize(pes.size() + stream.iFrameSize - sizeof(frameHeader), 0x00);
+  }
+
+  stream.iPesDue = stream.iNextDue;
+  stream.iPesOffset = 0;
+  stream.iNextDue += stream.iInterval;
+}
+
+void PVRDemoSyntheticSource::WritePayloadPacket(uint8_t* pPacket, uint16_t iPid, uint8_t& iContinuity, bool bUnitStart,
+                                                const uint8_t* pData, size_t& iSize, bool bPcr)
+{
+  pPacket[0] = 0x47;
+  pPacket[1] = (bUnitStart ? 0x40 : 0x00) | (iPid >> 8);
+  pPacket[2] = iPid & 0xFF;
+
+  size_t iAdaptation = bPcr ? 8 : 0;
+  const size_t iUsed = std::min(iSize, (size_t)(TS_SIZE - 4) - iAdaptation);
+  iAdaptation = TS_SIZE - 4 - iUsed;
+
+  uint8_t* pOut = pPacket + 4;
+  if (iAdaptation > 0)
+  {
+    pPacket[3] = 0x30 | iContinuity;
+    pOut[0] = (uint8_t)(iAdaptation - 1);
+    if (iAdaptation >= 2)
+    {
+      size_t iPos = 2;
+      pOut[1] = bPcr ? 0x10 : 0x00;
+      if (bPcr)
+      {
+        const int64_t iBase = (m_iClock / 300) & (((int64_t)1 << 33) - 1);
+        const int iExtension = (int)(m_iClock % 300);
+        pOut[2] = (uint8_t)(iBase >> 25);
+        pOut[3] = (uint8_t)(iBase >> 17);
+        pOut[4] = (uint8_t)(iBase >> 9);
+        pOut[5] = (uint8_t)(iBase >> 1);
+        pOut[6] = (uint8_t)(((iBase & 0x01) << 7) | 0x7E | (iExtension >> 8));
+        pOut[7] = (uint8_t)(iExtension & 0xFF);
+        iPos = 8;
+        m_iLastPcr = m_iClock;
+      }
+      memset(pOut + iPos, 0xFF, iAdaptation - iPos);
+    }
+    pOut += iAdaptation;
+  }
+  else
+    pPacket[3] = 0x10 | iContinuity;
+
+  memcpy(pOut, pData, iUsed);
+  iContinuity = (iContinuity + 1) & 0x0F;
+  iSize = iUsed;
+}
+
+void PVRDemoSyntheticSource::WriteSectionPacket(uint8_t* pPacket, uint16_t iPid, uint8_t& iContinuity, const std::vector<uint8_t>& section)
+{
+  pPacket[0] = 0x47;
+  pPacket[1] = 0x40 | (iPid >> 8);
+  pPacket[2] = iPid & 0xFF;
+  pPacket[3] = 0x10 | iContinuity;
+  pPacket[4] = 0x00; // pointer field
+  assert(section.size() <= (size_t)(TS_SIZE - 5));
+  memcpy(pPacket + 5, section.data(), section.size());
+  memset(pPacket + 5 + section.size(), 0xFF, TS_SIZE - 5 - section.size());
+  iContinuity = (iContinuity + 1) & 0x0F;
+}
+
+void PVRDemoSyntheticSource::GeneratePacket(uint8_t* pPacket)
+{
+  if (m_iPsiPending == 0 && m_iClock >= m_iNextPsi)
+  {
+    m_iPsiPending = 2;
+    m_iNextPsi += PSI_INTERVAL;
+  }
+
+  if (m_iPsiPending == 2)
+    WriteSectionPacket(pPacket, 0x0000, m_iPatContinuity, m_pat);
+  else if (m_iPsiPending == 1)
+    WriteSectionPacket(pPacket, PMT_PID, m_iPmtContinuity, m_pmt);
+
+  if (m_iPsiPending > 0)
+  {
+    --m_iPsiPending;
+  }
+  else
+  {
+    /* start every PES that is due, then send from the most urgent one */
+    Elementary* next = NULL;
+    for (auto& stream : m_streams)
+    {
+      if (stream.iPesOffset >= stream.pes.size() && stream.iNextDue <= m_iClock)
+        BuildPes(stream);
+      if (stream.iPesOffset < stream.pes.size() && (!next || stream.iPesDue < next->iPesDue))
+        next = &stream;
+    }
+
+    if (next)
+    {
+      const bool bUnitStart = next->iPesOffset == 0;
+      const bool bPcr = next->bVideo && (bUnitStart || m_iClock - m_iLastPcr >= PCR_INTERVAL);
+      size_t iSize = next->pes.size() - next->iPesOffset;
+      WritePayloadPacket(pPacket, next->iPid, next->iContinuity, bUnitStart,
+                         next->pes.data() + next->iPesOffset, iSize, bPcr);
+      next->iPesOffset += iSize;
+    }
+    else if (m_iClock - m_iLastPcr >= PCR_INTERVAL)
+    {
+      /* PCR-only packet on the video PID keeps the clock going while idle */
+      pPacket[0] = 0x47;
+      pPacket[1] = VIDEO_PID >> 8;
+      pPacket[2] = VIDEO_PID & 0xFF;
+      size_t iSize = 0;
+      uint8_t iContinuity = m_streams[0].iContinuity;
+      WritePayloadPacket(pPacket, VIDEO_PID, iContinuity, false, NULL, iSize, true);
+      /* no payload: adaptation only, continuity counter must not advance */
+      pPacket[3] = 0x20 | m_streams[0].iContinuity;
+    }
+    else
+    {
+      pPacket[0] = 0x47;
+      pPacket[1] = NULL_PID >> 8;
+      pPacket[2] = NULL_PID & 0xFF;
+      pPacket[3] = 0x10;
+      memset(pPacket + 4, 0xFF, TS_SIZE - 4);
+    }
+  }
+
+  ++m_iPackets;
+  m_iClock += m_iClockStep;
+  m_iClockRemainder += m_iClockRemainderStep;
+  if (m_iClockRemainder >= m_iBitrate)
+  {
+    m_iClockRemainder -= m_iBitrate;
+    ++m_iClock;
+  }
+}
+
+ssize_t PVRDemoSyntheticSource::Read(uint8_t* pBuffer, size_t iSize, int iTimeoutMs)
+{
+  if (m_streams.empty())
+    return -1;
+
+  size_t iWritten = 0;
+
+  /* finish a packet that was split over the previous call */
+  if (m_iPartialOffset < (size_t)TS_SIZE)
+  {
+    const size_t iCopy = std::min(iSize, TS_SIZE - m_iPartialOffset);
+    memcpy(pBuffer, m_partial + m_iPartialOffset, iCopy);
+    m_iPartialOffset += iCopy;
+    iWritten += iCopy;
+    if (iWritten == iSize)
+      return (ssize_t)iWritten;
+  }
+
+  uint64_t iAvailable = (iSize - iWritten + TS_SIZE - 1) / TS_SIZE;
+  if (m_bPaced)
+  {
+    int64_t iElapsed = GetTimeMs() - m_iOpenTimeMs;
+    uint64_t iDue = (uint64_t)iElapsed * m_iBitrate / (TS_SIZE * 8 * 1000);
+    if (iDue <= m_iPackets && iWritten == 0)
+    {
+      const int64_t iWaitMs = std::min<int64_t>(iTimeoutMs, (int64_t)((m_iPackets + 1) * TS_SIZE * 8 * 1000 / m_iBitrate) - iElapsed + 1);
+      if (iWaitMs > 0)
+        std::this_thread::sleep_for(std::chrono::milliseconds(iWaitMs));
+      iElapsed = GetTimeMs() - m_iOpenTimeMs;
+      iDue = (uint64_t)iElapsed * m_iBitrate / (TS_SIZE * 8 * 1000);
+    }
+    iAvailable = std::min<uint64_t>(iAvailable, iDue > m_iPackets ? iDue - m_iPackets : 0);
+  }
+
+  while (iAvailable-- > 0)
+  {
+    if (iSize - iWritten >= (size_t)TS_SIZE)
+    {
+      GeneratePacket(pBuffer + iWritten);
+      iWritten += TS_SIZE;
+    }
+    else
+    {
+      GeneratePacket(m_partial);
+      m_iPartialOffset = iSize - iWritten;
+      memcpy(pBuffer + iWritten, m_partial, m_iPartialOffset);
+      iWritten = iSize;
+    }
+  }
+
+  return (ssize_t)iWritten;
+}
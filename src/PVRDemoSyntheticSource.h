@@ -0,0 +1,87 @@
+/*
+ *  Copyright (C) 2011-2020 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2011 Pulse-Eight (http://www.pulse-eight.com/)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <vector>
+#include "PVRDemoStreamSource.h"
+
+/*!
+ * Deterministic constant-bitrate MPEG-TS generator for offline testing.
+ *
+ * Selected with a <stream> of the form
+ *   synthetic://bitrate=20M&pids=3&pace=1
+ * where pids is the number of elementary streams, at most 15 (one H.264
+ * video stream carrying access unit delimiters and filler NALs, the rest
+ * silent MPEG-1 Layer II audio) and pace=0 produces packets as fast as they
+ * are read.
+ * PAT/PMT are repeated every 100 ms, PCR every 35 ms on the video PID and
+ * unused capacity is filled with null packets, so the output has exact
+ * CBR timing and valid continuity counters.
+ */
+class PVRDemoSyntheticSource : public PVRDemoStreamSource
+{
+public:
+  static const char* const SCHEME;
+
+  explicit PVRDemoSyntheticSource(const std::string& strOptions);
+
+  bool Open(void) override;
+  void Close(void) override;
+  ssize_t Read(uint8_t* pBuffer, size_t iSize, int iTimeoutMs) override;
+  bool IsPaced(void) const override { return m_bPaced; }
+
+private:
+  struct Elementary
+  {
+    uint16_t             iPid;
+    uint8_t              iStreamType;
+    uint8_t              iStreamId;
+    uint8_t              iContinuity;
+    bool                 bVideo;
+    int64_t              iNextDue;    // 27 MHz mux clock
+    int64_t              iInterval;
+    int64_t              iPesDue;
+    size_t               iFrameSize;  // elementary payload per PES
+    std::vector<uint8_t> pes;
+    size_t               iPesOffset;
+  };
+
+  void ParseOptions(const std::string& strOptions);
+  void GeneratePacket(uint8_t* pPacket);
+  void BuildPsi(void);
+  void BuildPes(Elementary& stream);
+  void WritePayloadPacket(uint8_t* pPacket, uint16_t iPid, uint8_t& iContinuity, bool bUnitStart,
+                          const uint8_t* pData, size_t& iSize, bool bPcr);
+  void WriteSectionPacket(uint8_t* pPacket, uint16_t iPid, uint8_t& iContinuity, const std::vector<uint8_t>& section);
+
+  uint64_t                m_iBitrate;
+  int                     m_iStreams;
+  bool                    m_bPaced;
+
+  std::vector<Elementary> m_streams;
+  std::vector<uint8_t>    m_pat;
+  std::vector<uint8_t>    m_pmt;
+  uint8_t                 m_iPatContinuity;
+  uint8_t                 m_iPmtContinuity;
+  int                     m_iPsiPending;
+  int64_t                 m_iNextPsi;
+  int64_t                 m_iLastPcr;
+
+  /* mux clock of the next packet, advanced by m_iClockStep + remainder */
+  int64_t                 m_iClock;
+  int64_t                 m_iClockStep;
+  uint64_t                m_iClockRemainderStep;
+  uint64_t                m_iClockRemainder;
+  uint64_t                m_iPackets;
+  int64_t                 m_iOpenTimeMs;
+
+  /* packet partially handed out when the caller's buffer was too small */
+  uint8_t                 m_partial[188];
+  size_t                  m_iPartialOffset;
+};
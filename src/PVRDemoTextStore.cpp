@@ -0,0 +1,516 @@
+/*
+ *  Copyright (C) 2011-2020 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2011 Pulse-Eight (http://www.pulse-eight.com/)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "PVRDemoTextStore.h"
+#include "PVRDemoLog.h"
+#include "PVRDemoStats.h"
+
+#include <algorithm>
+#include <errno.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#ifndef TARGET_WINDOWS
+#include <unistd.h>
+#endif
+
+using namespace ADDON;
+using namespace P8PLATFORM;
+
+namespace
+{
+
+/*
+ * Block format: sequences of a token byte, literals and a match. The
+ * token's high nibble is the literal count and its low nibble the match
+ * length less MIN_MATCH; 15 in either means more length bytes follow,
+ * each adding up to 255. The match is a 16 bit little endian distance back
+ * into the output. The last sequence of a block has literals only.
+ */
+const size_t MIN_MATCH  = 4;
+const size_t MAX_OFFSET = 65535;
+const int    HASH_BITS  = 12;
+
+void PutLength(std::vector<uint8_t>& out, size_t iLength)
+{
+  for (; iLength >= 255; iLength -= 255)
+    out.push_back(255);
+  out.push_back((uint8_t)iLength);
+}
+
+bool GetLength(const uint8_t*& p, const uint8_t* pEnd, size_t& iLength)
+{
+  uint8_t iByte;
+  do
+  {
+    if (p == pEnd)
+      return false;
+    iByte = *p++;
+    iLength += iByte;
+  } while (iByte == 255);
+  return true;
+}
+
+void PutSequence(std::vector<uint8_t>& out, const char* pLiterals, size_t iLiterals, size_t iOffset, size_t iMatch)
+{
+  const size_t iMatchCode = iMatch ? iMatch - MIN_MATCH : 0;
+  out.push_back((uint8_t)((std::min<size_t>(iLiterals, 15) << 4) | std::min<size_t>(iMatchCode, 15)));
+  if (iLiterals >= 15)
+    PutLength(out, iLiterals - 15);
+  out.insert(out.end(), pLiterals, pLiterals + iLiterals);
+  if (!iMatch)
+    return;
+
+  out.push_back((uint8_t)(iOffset & 0xff));
+  out.push_back((uint8_t)(iOffset >> 8));
+  if (iMatchCode >= 15)
+    PutLength(out, iMatchCode - 15);
+}
+
+/* blocks the calling thread read last, and those it keeps for its pins */
+struct PinnedBlock
+{
+  uint64_t iStore;
+  uint32_t iBlock;
+  std::shared_ptr<const std::vector<char>> data;
+};
+
+struct ThreadPins
+{
+  PinnedBlock blocks[PVRDemoTextStore::PINNED_BLOCKS];
+  int iNext = 0;
+  std::vector<std::shared_ptr<const std::vector<char>>>* scope = nullptr;
+};
+
+thread_local ThreadPins t_pins;
+
+}
+
+std::atomic<uint64_t> PVRDemoTextStore::s_iNextSerial(1);
+std::atomic<size_t>   PVRDemoTextStore::s_iCacheBudget(4 * 1024 * 1024);
+CMutex                PVRDemoTextStore::s_storesMutex;
+std::vector<std::weak_ptr<const PVRDemoTextStore>> PVRDemoTextStore::s_stores;
+
+std::shared_ptr<PVRDemoTextStore> PVRDemoTextStore::Create(Mode mode, const std::string& strDirectory)
+{
+  std::shared_ptr<PVRDemoTextStore> store(new PVRDemoTextStore(mode));
+  if (mode == MODE_DISK && !store->OpenFile(strDirectory))
+  {
+    PVRDEMO_LOG(LOG_ERROR, "%s - keeping texts in memory instead", __FUNCTION__);
+    store->m_mode = MODE_MEMORY;
+  }
+
+  /* known to DropCaches(); stores that are gone are pruned on the way */
+  CLockObject lock(s_storesMutex);
+  s_stores.erase(std::remove_if(s_stores.begin(), s_stores.end(),
+                                [](const std::weak_ptr<const PVRDemoTextStore>& other) { return other.expired(); }),
+                 s_stores.end());
+  s_stores.push_back(store);
+  return store;
+}
+
+PVRDemoTextStore::PVRDemoTextStore(Mode mode) :
+  m_mode(mode),
+  m_iSerial(s_iNextSerial++),
+  m_fd(-1),
+  m_bSealed(false),
+  m_iTexts(0),
+  m_iRawBytes(0),
+  m_iStoredBytes(0),
+  m_iCachedBytes(0)
+{
+  m_current.reserve(BLOCK_SIZE);
+}
+
+PVRDemoTextStore::~PVRDemoTextStore(void)
+{
+#ifndef TARGET_WINDOWS
+  if (m_fd >= 0)
+    close(m_fd);
+#endif
+}
+
+bool PVRDemoTextStore::OpenFile(const std::string& strDirectory)
+{
+#ifdef TARGET_WINDOWS
+  PVRDEMO_LOG(LOG_ERROR, "%s - texts on disk are not supported on this platform", __FUNCTION__);
+  return false;
+#else
+  std::string strPath = strDirectory;
+  if (!strPath.empty() && strPath[strPath.size() - 1] != '/' && strPath[strPath.size() - 1] != '\\')
+    strPath += '/';
+
+  /* the add-on's profile directory may not exist before settings are saved */
+  for (size_t iPos = strPath.find('/', 1); iPos != std::string::npos; iPos = strPath.find('/', iPos + 1))
+    mkdir(strPath.substr(0, iPos).c_str(), 0755);
+
+  /* unlinked right away, so the file goes with the store even after a crash */
+  strPath += "coldtext-XXXXXX";
+  m_fd = mkstemp(&strPath[0]);
+  if (m_fd < 0)
+  {
+    PVRDEMO_LOG(LOG_ERROR, "%s - cannot create '%s': %s", __FUNCTION__, strPath.c_str(), strerror(errno));
+    return false;
+  }
+  unlink(strPath.c_str());
+  return true;
+#endif
+}
+
+PVRDemoText PVRDemoTextStore::Add(const std::string& strText)
+{
+  if (strText.empty())
+    return PVRDemoText();
+
+  const size_t iHash = std::hash<std::string>()(strText);
+  auto seen = m_seen.find(iHash);
+  if (seen != m_seen.end() && SameText(seen->second, strText))
+    return PVRDemoText(shared_from_this(), seen->second);
+
+  /* a text longer than a block gets one of its own */
+  if (!m_current.empty() && m_current.size() + strText.size() + 1 > BLOCK_SIZE)
+    CloseBlock();
+
+  const uint64_t iId = ((uint64_t)m_blocks.size() << 32) | m_current.size();
+  m_current.insert(m_current.end(), strText.begin(), strText.end());
+  m_current.push_back('\0');
+  if (seen == m_seen.end())
+    m_seen.emplace(iHash, iId);
+  ++m_iTexts;
+  m_iRawBytes += strText.size() + 1;
+
+  if (m_current.size() >= BLOCK_SIZE)
+    CloseBlock();
+  return PVRDemoText(shared_from_this(), iId);
+}
+
+void PVRDemoTextStore::Seal(void)
+{
+  if (m_bSealed)
+    return;
+
+  if (!m_current.empty())
+    CloseBlock();
+  m_bSealed = true;
+  std::unordered_map<size_t, uint64_t>().swap(m_seen);
+  std::vector<char>().swap(m_current);
+  m_stored.shrink_to_fit();
+
+  PVRDEMO_LOG(LOG_DEBUG, "%s - %zu texts, %llu KiB in %zu blocks, %llu KiB stored %s", __FUNCTION__,
+              m_iTexts, (unsigned long long)(m_iRawBytes / 1024), m_blocks.size(),
+              (unsigned long long)(m_iStoredBytes / 1024), m_mode == MODE_DISK ? "on disk" : "in memory");
+}
+
+void PVRDemoTextStore::CloseBlock(void)
+{
+  Block block;
+  block.iRawSize = (uint32_t)m_current.size();
+
+  std::vector<uint8_t> compressed;
+  const uint8_t* pData = (const uint8_t*)m_current.data();
+  size_t iSize = m_current.size();
+  if (m_mode != MODE_PLAIN)
+  {
+    Compress(m_current.data(), m_current.size(), compressed);
+    pData = compressed.data();
+    iSize = compressed.size();
+  }
+  block.iStoredSize = (uint32_t)iSize;
+
+#ifndef TARGET_WINDOWS
+  if (m_mode == MODE_DISK)
+  {
+    block.iOffset = m_iStoredBytes;
+    size_t iWritten = 0;
+    while (iWritten < iSize)
+    {
+      ssize_t iResult = pwrite(m_fd, pData + iWritten, iSize - iWritten, (off_t)(block.iOffset + iWritten));
+      if (iResult <= 0)
+      {
+        /* keep this block and the ones after it in memory */
+        PVRDEMO_LOG(LOG_ERROR, "%s - cannot write texts to disk: %s", __FUNCTION__, strerror(errno));
+        close(m_fd);
+        m_fd = -1;
+        m_mode = MODE_MEMORY;
+        break;
+      }
+      iWritten += iResult;
+    }
+  }
+#endif
+  if (m_mode != MODE_DISK)
+  {
+    block.iOffset = m_stored.size();
+    m_stored.insert(m_stored.end(), pData, pData + iSize);
+  }
+
+  m_blocks.push_back(block);
+  m_iStoredBytes += iSize;
+  m_current.clear();
+}
+
+bool PVRDemoTextStore::SameText(uint64_t iId, const std::string& strText) const
+{
+  const uint32_t iBlock = (uint32_t)(iId >> 32);
+  const uint32_t iOffset = (uint32_t)iId;
+  if (iBlock == m_blocks.size())
+    return strText.compare(m_current.data() + iOffset) == 0;
+  if (m_mode == MODE_PLAIN)
+    return strText.compare((const char*)m_stored.data() + m_blocks[iBlock].iOffset + iOffset) == 0;
+
+  BlockData data = Fetch(iBlock);
+  return data && strText.compare(data->data() + iOffset) == 0;
+}
+
+const char* PVRDemoTextStore::Lookup(uint64_t iId) const
+{
+  const uint32_t iBlock = (uint32_t)(iId >> 32);
+  const uint32_t iOffset = (uint32_t)iId;
+  if (m_mode == MODE_PLAIN)
+    return (const char*)m_stored.data() + m_blocks[iBlock].iOffset + iOffset;
+
+  ThreadPins& pins = t_pins;
+  for (const auto& pinned : pins.blocks)
+  {
+    if (pinned.iStore == m_iSerial && pinned.iBlock == iBlock)
+    {
+      if (pins.scope && (pins.scope->empty() || pins.scope->back() != pinned.data))
+        pins.scope->push_back(pinned.data);
+      return pinned.data->data() + iOffset;
+    }
+  }
+
+  BlockData data = Fetch(iBlock);
+  if (!data)
+    return "";
+
+  PinnedBlock& pinned = pins.blocks[pins.iNext];
+  pins.iNext = (pins.iNext + 1) % PINNED_BLOCKS;
+  pinned.iStore = m_iSerial;
+  pinned.iBlock = iBlock;
+  pinned.data = data;
+  if (pins.scope)
+    pins.scope->push_back(data);
+  return data->data() + iOffset;
+}
+
+PVRDemoTextStore::BlockData PVRDemoTextStore::Fetch(uint32_t iBlock) const
+{
+  {
+    CLockObject lock(m_cacheMutex);
+    auto it = m_cached.find(iBlock);
+    if (it != m_cached.end())
+    {
+      m_lru.splice(m_lru.begin(), m_lru, it->second);
+      PVRDEMO_STATS_COUNT(PVRDEMO_COUNTER_CACHE_HITS, 1);
+      return it->second->data;
+    }
+  }
+
+  /* decompress without the lock; a block two threads miss at once is read twice */
+  PVRDEMO_STATS_COUNT(PVRDEMO_COUNTER_CACHE_MISSES, 1);
+  BlockData data = ReadBlock(iBlock);
+  if (!data)
+    return data;
+
+  CLockObject lock(m_cacheMutex);
+  auto it = m_cached.find(iBlock);
+  if (it != m_cached.end())
+    return it->second->data;
+
+  m_lru.push_front({ iBlock, data });
+  m_cached[iBlock] = m_lru.begin();
+  m_iCachedBytes += data->size();
+
+  const size_t iBudget = s_iCacheBudget.load(std::memory_order_relaxed);
+  while (m_iCachedBytes > iBudget && m_lru.size() > 1)
+  {
+    m_iCachedBytes -= m_lru.back().data->size();
+    m_cached.erase(m_lru.back().iBlock);
+    m_lru.pop_back();
+  }
+  return data;
+}
+
+PVRDemoTextStore::BlockData PVRDemoTextStore::ReadBlock(uint32_t iBlock) const
+{
+  const Block& block = m_blocks[iBlock];
+  const uint8_t* pStored = m_stored.data() + block.iOffset;
+
+#ifndef TARGET_WINDOWS
+  static thread_local std::vector<uint8_t> buffer;
+  if (m_mode == MODE_DISK)
+  {
+    buffer.resize(block.iStoredSize);
+    size_t iRead = 0;
+    while (iRead < block.iStoredSize)
+    {
+      ssize_t iResult = pread(m_fd, buffer.data() + iRead, block.iStoredSize - iRead, (off_t)(block.iOffset + iRead));
+      if (iResult <= 0)
+      {
+        PVRDEMO_LOG(LOG_ERROR, "%s - cannot read text block %u: %s", __FUNCTION__, iBlock,
+                    iResult < 0 ? strerror(errno) : "end of file");
+        return BlockData();
+      }
+      iRead += iResult;
+    }
+    pStored = buffer.data();
+  }
+#endif
+
+  std::shared_ptr<std::vector<char>> data = std::make_shared<std::vector<char>>(block.iRawSize);
+  if (!Decompress(pStored, block.iStoredSize, data->data(), data->size()))
+  {
+    PVRDEMO_LOG(LOG_ERROR, "%s - text block %u is corrupt", __FUNCTION__, iBlock);
+    return BlockData();
+  }
+  return data;
+}
+
+void PVRDemoTextStore::SetCacheBudget(size_t iBytes)
+{
+  if (s_iCacheBudget.exchange(iBytes, std::memory_order_relaxed) > iBytes)
+    TrimCaches(iBytes);
+}
+
+void PVRDemoTextStore::TrimCaches(size_t iBytes)
+{
+  std::vector<std::shared_ptr<const PVRDemoTextStore>> stores;
+  {
+    CLockObject lock(s_storesMutex);
+    for (const auto& store : s_stores)
+    {
+      if (std::shared_ptr<const PVRDemoTextStore> live = store.lock())
+        stores.push_back(std::move(live));
+    }
+  }
+
+  size_t iDropped = 0;
+  for (const auto& store : stores)
+  {
+    CLockObject lock(store->m_cacheMutex);
+    while (store->m_iCachedBytes > iBytes)
+    {
+      const size_t iSize = store->m_lru.back().data->size();
+      store->m_cached.erase(store->m_lru.back().iBlock);
+      store->m_lru.pop_back();
+      store->m_iCachedBytes -= iSize;
+      iDropped += iSize;
+    }
+  }
+  PVRDEMO_LOG(LOG_DEBUG, "%s - dropped %zu bytes of %zu stores", __FUNCTION__, iDropped, stores.size());
+}
+
+size_t PVRDemoTextStore::CachedBytes(void) const
+{
+  CLockObject lock(m_cacheMutex);
+  return m_iCachedBytes;
+}
+
+void PVRDemoTextStore::Compress(const char* pData, size_t iSize, std::vector<uint8_t>& out)
+{
+  /* positions + 1 of the last four bytes that hashed to a slot */
+  uint32_t table[1 << HASH_BITS] = {};
+
+  out.clear();
+  out.reserve(iSize / 2 + 16);
+
+  size_t iAnchor = 0;
+  size_t i = 0;
+  while (i + MIN_MATCH <= iSize)
+  {
+    uint32_t iSequence;
+    memcpy(&iSequence, pData + i, sizeof(iSequence));
+    const size_t iSlot = (iSequence * 2654435761u) >> (32 - HASH_BITS);
+    const size_t iCandidate = table[iSlot];
+    table[iSlot] = (uint32_t)(i + 1);
+
+    if (iCandidate == 0 || i + 1 - iCandidate > MAX_OFFSET || memcmp(pData + iCandidate - 1, pData + i, MIN_MATCH) != 0)
+    {
+      ++i;
+      continue;
+    }
+
+    const size_t iMatchStart = iCandidate - 1;
+    size_t iMatch = MIN_MATCH;
+    while (i + iMatch < iSize && pData[iMatchStart + iMatch] == pData[i + iMatch])
+      ++iMatch;
+
+    PutSequence(out, pData + iAnchor, i - iAnchor, i - iMatchStart, iMatch);
+    i += iMatch;
+    iAnchor = i;
+  }
+
+  PutSequence(out, pData + iAnchor, iSize - iAnchor, 0, 0);
+}
+
+bool PVRDemoTextStore::Decompress(const uint8_t* pData, size_t iSize, char* pOut, size_t iOutSize)
+{
+  const uint8_t* p = pData;
+  const uint8_t* pEnd = pData + iSize;
+  char* o = pOut;
+  char* const pOutEnd = pOut + iOutSize;
+
+  while (p < pEnd)
+  {
+    const uint8_t iToken = *p++;
+
+    size_t iLiterals = iToken >> 4;
+    if (iLiterals == 15 && !GetLength(p, pEnd, iLiterals))
+      return false;
+    if (iLiterals > (size_t)(pEnd - p) || iLiterals > (size_t)(pOutEnd - o))
+      return false;
+    memcpy(o, p, iLiterals);
+    o += iLiterals;
+    p += iLiterals;
+
+    /* the last sequence */
+    if (o == pOutEnd)
+      return p == pEnd;
+
+    if (pEnd - p < 2)
+      return false;
+    const size_t iOffset = p[0] | (p[1] << 8);
+    p += 2;
+    size_t iMatch = iToken & 15;
+    if (iMatch == 15 && !GetLength(p, pEnd, iMatch))
+      return false;
+    iMatch += MIN_MATCH;
+    if (iOffset == 0 || iOffset > (size_t)(o - pOut) || iMatch > (size_t)(pOutEnd - o))
+      return false;
+
+    const char* pMatch = o - iOffset;
+    if (iOffset >= iMatch)
+    {
+      memcpy(o, pMatch, iMatch);
+      o += iMatch;
+    }
+    else
+    {
+      /* overlapping, repeats the last iOffset bytes */
+      while (iMatch--)
+        *o++ = *pMatch++;
+    }
+  }
+
+  return o == pOutEnd;
+}
+
+PVRDemoTextPin::PVRDemoTextPin(void) :
+  m_previous(t_pins.scope)
+{
+  t_pins.scope = &m_blocks;
+}
+
+PVRDemoTextPin::~PVRDemoTextPin(void)
+{
+  /* an enclosing pin keeps what this one saw */
+  if (m_previous)
+    m_previous->insert(m_previous->end(), m_blocks.begin(), m_blocks.end());
+  t_pins.scope = m_previous;
+}
@@ -0,0 +1,187 @@
+/*
+ *  Copyright (C) 2011-2020 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2011 Pulse-Eight (http://www.pulse-eight.com/)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "p8-platform/threads/mutex.h"
+
+class PVRDemoTextStore;
+
+/*!
+ * A long text of the data, plots and plot outlines, kept in a
+ * PVRDemoTextStore. Copies share the store; an empty text has none.
+ */
+class PVRDemoText
+{
+public:
+  PVRDemoText(void) : m_str("") {}
+
+  /* a string that outlives every version of the data, like the generated tables */
+  explicit PVRDemoText(const char* strStatic) : m_str(strStatic) {}
+
+  /*!
+   * The text, valid until the calling thread has looked up
+   * PVRDemoTextStore::PINNED_BLOCKS more texts or, while it holds a
+   * PVRDemoTextPin, until the pin is released.
+   */
+  const char* c_str(void) const;
+  bool empty(void) const { return !m_store && *m_str == '\0'; }
+
+private:
+  friend class PVRDemoTextStore;
+
+  PVRDemoText(std::shared_ptr<const PVRDemoTextStore> store, uint64_t iId) : m_store(std::move(store)), m_iId(iId) {}
+
+  std::shared_ptr<const PVRDemoTextStore> m_store;
+  union
+  {
+    const char* m_str;  // without a store
+    uint64_t    m_iId;  // block index << 32 | offset in the block
+  };
+};
+
+/*!
+ * Keeps long texts block compressed. Each distinct text is stored once,
+ * packed back to back into blocks of BLOCK_SIZE. A closed block
+ * is compressed with a small LZ77 codec and kept in memory or written to an
+ * unlinked file under the user path, so only the blocks being read are
+ * ever decompressed.
+ *
+ * Decompressed blocks go into an LRU cache whose size is shared by all
+ * stores, see SetCacheBudget(). Every thread also holds on to the last
+ * PINNED_BLOCKS blocks it read, which is what keeps c_str() pointers valid
+ * after their block left the cache and lets runs of lookups into one block
+ * skip the cache lock.
+ *
+ * The loader fills a store with Add() and calls Seal() before the data is
+ * published; from then on it is read only and safe to share.
+ */
+class PVRDemoTextStore : public std::enable_shared_from_this<PVRDemoTextStore>
+{
+public:
+  static const size_t BLOCK_SIZE = 32 * 1024;
+  static const int    PINNED_BLOCKS = 4;
+
+  /* values of the coldtext setting */
+  enum Mode
+  {
+    MODE_PLAIN,   // uncompressed in memory
+    MODE_MEMORY,  // compressed in memory
+    MODE_DISK     // compressed in a file under strDirectory
+  };
+
+  static std::shared_ptr<PVRDemoTextStore> Create(Mode mode, const std::string& strDirectory);
+  ~PVRDemoTextStore(void);
+
+  /* store strText, or find it among the texts stored before */
+  PVRDemoText Add(const std::string& strText);
+
+  /* close the last block; nothing is added after this */
+  void Seal(void);
+
+  const char* Lookup(uint64_t iId) const;
+
+  /* bytes of decompressed blocks each store may cache; a smaller budget evicts right away */
+  static void SetCacheBudget(size_t iBytes);
+
+  /* empty the caches of every store; blocks the threads hold on to stay */
+  static void DropCaches(void) { TrimCaches(0); }
+
+  Mode GetMode(void) const { return m_mode; }
+  size_t Texts(void) const { return m_iTexts; }
+  uint64_t RawBytes(void) const { return m_iRawBytes; }
+  uint64_t StoredBytes(void) const { return m_iStoredBytes; }
+  size_t CachedBytes(void) const;
+
+  /* the block codec; Decompress fails unless pData holds exactly iOutSize bytes */
+  static void Compress(const char* pData, size_t iSize, std::vector<uint8_t>& out);
+  static bool Decompress(const uint8_t* pData, size_t iSize, char* pOut, size_t iOutSize);
+
+private:
+  typedef std::shared_ptr<const std::vector<char>> BlockData;
+
+  struct Block
+  {
+    uint64_t iOffset;      // in m_stored or the file
+    uint32_t iStoredSize;
+    uint32_t iRawSize;
+  };
+
+  struct CachedBlock
+  {
+    uint32_t  iBlock;
+    BlockData data;
+  };
+
+  PVRDemoTextStore(Mode mode);
+
+  bool OpenFile(const std::string& strDirectory);
+  void CloseBlock(void);
+  bool SameText(uint64_t iId, const std::string& strText) const;
+  BlockData Fetch(uint32_t iBlock) const;
+  BlockData ReadBlock(uint32_t iBlock) const;
+
+  /* evict the least recently used blocks of every store until it caches at most iBytes */
+  static void TrimCaches(size_t iBytes);
+
+  static std::atomic<uint64_t> s_iNextSerial;
+  static std::atomic<size_t>   s_iCacheBudget;
+  static P8PLATFORM::CMutex    s_storesMutex;  // guards s_stores
+  static std::vector<std::weak_ptr<const PVRDemoTextStore>> s_stores;
+
+  Mode                                    m_mode;
+  const uint64_t                          m_iSerial;  // tells the stores apart in the threads' pins
+  int                                     m_fd;
+  bool                                    m_bSealed;
+
+  /* filled while loading */
+  std::vector<char>                       m_current;
+  std::unordered_map<size_t, uint64_t>    m_seen;     // hash of a text, its first id
+
+  std::vector<Block>                      m_blocks;
+  std::vector<uint8_t>                    m_stored;   // blocks kept in memory
+  size_t                                  m_iTexts;
+  uint64_t                                m_iRawBytes;
+  uint64_t                                m_iStoredBytes;
+
+  mutable P8PLATFORM::CMutex              m_cacheMutex;
+  mutable std::list<CachedBlock>          m_lru;      // most recently used first
+  mutable std::unordered_map<uint32_t, std::list<CachedBlock>::iterator> m_cached;
+  mutable size_t                          m_iCachedBytes;
+};
+
+/*!
+ * Keeps the texts the calling thread looks up valid until it goes out of
+ * scope, for callers that hold on to more of them at a time than the
+ * pinned blocks cover. Pins nest.
+ */
+class PVRDemoTextPin
+{
+public:
+  PVRDemoTextPin(void);
+  ~PVRDemoTextPin(void);
+
+private:
+  PVRDemoTextPin(const PVRDemoTextPin&) = delete;
+  PVRDemoTextPin& operator=(const PVRDemoTextPin&) = delete;
+
+  std::vector<std::shared_ptr<const std::vector<char>>>* m_previous;
+  std::vector<std::shared_ptr<const std::vector<char>>>  m_blocks;
+};
+
+inline const char* PVRDemoText::c_str(void) const
+{
+  return m_store ? m_store->Lookup(m_iId) : m_str;
+}
@@ -0,0 +1,253 @@
+/*
+ *  Copyright (C) 2011-2020 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2011 Pulse-Eight (http://www.pulse-eight.com/)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "PVRDemoTime.h"
+
+namespace
+{
+
+const int64_t SECONDS_PER_DAY = 86400;
+const int64_t SEARCH_MARGIN   = 6 * 3600;
+
+bool IsDigit(char c)
+{
+  return c >= '0' && c <= '9';
+}
+
+void SkipBlanks(const char*& p)
+{
+  while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+    ++p;
+}
+
+/* between iMinDigits and iMaxDigits decimal digits */
+bool ParseNumber(const char*& p, int iMinDigits, int iMaxDigits, int& iValue)
+{
+  int iDigits = 0;
+  iValue = 0;
+  while (iDigits < iMaxDigits && IsDigit(*p))
+  {
+    iValue = iValue * 10 + (*p++ - '0');
+    ++iDigits;
+  }
+  return iDigits >= iMinDigits;
+}
+
+/* H[H]:MM[:SS] as seconds; hours past 23 run into the next day */
+bool ParseClock(const char*& p, int64_t& iSeconds)
+{
+  int iHour, iMinute, iSecond = 0;
+  if (!ParseNumber(p, 1, 2, iHour) || *p != ':')
+    return false;
+  ++p;
+  if (!ParseNumber(p, 2, 2, iMinute) || iMinute > 59)
+    return false;
+  if (*p == ':')
+  {
+    ++p;
+    if (!ParseNumber(p, 2, 2, iSecond) || iSecond > 60)
+      return false;
+  }
+  iSeconds = iHour * 3600 + iMinute * 60 + iSecond;
+  return true;
+}
+
+int64_t FloorDiv(int64_t a, int64_t b)
+{
+  return a / b - (a % b != 0 && (a < 0) != (b < 0));
+}
+
+}
+
+PVRDemoTimeResolver::PVRDemoTimeResolver(time_t iNow) :
+  m_iNow(iNow),
+  m_iToday(0),
+  m_iOffsetNow(0)
+{
+  struct tm now;
+  if (LocalTm(iNow, now))
+    m_iToday = DaysFromCivil(now.tm_year + 1900, now.tm_mon + 1, now.tm_mday);
+  m_iOffsetNow = Offset(iNow);
+
+  for (int i = 0; i < 2 * DAYS_CACHED + 1; ++i)
+    m_days[i] = ComputeDay(m_iToday - DAYS_CACHED + i);
+}
+
+int64_t PVRDemoTimeResolver::DaysFromCivil(int iYear, int iMonth, int iDay)
+{
+  iYear -= iMonth <= 2;
+  const int64_t iEra = (iYear >= 0 ? iYear : iYear - 399) / 400;
+  const int64_t iYearOfEra = iYear - iEra * 400;
+  const int64_t iDayOfYear = (153 * (iMonth + (iMonth > 2 ? -3 : 9)) + 2) / 5 + iDay - 1;
+  const int64_t iDayOfEra = iYearOfEra * 365 + iYearOfEra / 4 - iYearOfEra / 100 + iDayOfYear;
+  return iEra * 146097 + iDayOfEra - 719468;
+}
+
+bool PVRDemoTimeResolver::LocalTm(time_t iTime, struct tm& tm)
+{
+#ifdef TARGET_WINDOWS
+  return localtime_s(&tm, &iTime) == 0;
+#else
+  return localtime_r(&iTime, &tm) != nullptr;
+#endif
+}
+
+bool PVRDemoTimeResolver::Resolve(const char* strExpression, int iDefaultDay, time_t& iTime) const
+{
+  const char* p = strExpression;
+  SkipBlanks(p);
+
+  /* ISO-8601 */
+  if (IsDigit(p[0]) && IsDigit(p[1]) && IsDigit(p[2]) && IsDigit(p[3]) && p[4] == '-')
+  {
+    int iYear, iMonth, iDay;
+    ParseNumber(p, 4, 4, iYear);
+    ++p;
+    if (!ParseNumber(p, 2, 2, iMonth) || *p++ != '-' || !ParseNumber(p, 2, 2, iDay) ||
+        iMonth < 1 || iMonth > 12 || iDay < 1 || iDay > 31)
+      return false;
+
+    int64_t iSecond = 0;
+    if (*p == 'T' || (*p == ' ' && IsDigit(p[1])))
+    {
+      ++p;
+      if (!ParseClock(p, iSecond))
+        return false;
+    }
+
+    bool bZone = false;
+    int iZone = 0;
+    if (*p == 'Z')
+    {
+      ++p;
+      bZone = true;
+    }
+    else if (*p == '+' || *p == '-')
+    {
+      const int iSign = *p++ == '-' ? -1 : 1;
+      int iZoneHours, iZoneMinutes;
+      if (!ParseNumber(p, 2, 2, iZoneHours))
+        return false;
+      if (*p == ':')
+        ++p;
+      if (!ParseNumber(p, 2, 2, iZoneMinutes))
+        return false;
+      bZone = true;
+      iZone = iSign * (iZoneHours * 3600 + iZoneMinutes * 60);
+    }
+
+    SkipBlanks(p);
+    if (*p != '\0')
+      return false;
+
+    const int64_t iCivilDay = DaysFromCivil(iYear, iMonth, iDay);
+    iTime = bZone ? (time_t)(iCivilDay * SECONDS_PER_DAY + iSecond - iZone) : LocalTime(iCivilDay, iSecond);
+    return true;
+  }
+
+  /* relative day */
+  int64_t iCivilDay = m_iToday + iDefaultDay;
+  bool bDay = false;
+  {
+    const char* q = p;
+    const int iSign = *q == '-' ? -1 : 1;
+    if (*q == '+' || *q == '-')
+      ++q;
+    int iDays;
+    if (ParseNumber(q, 1, 5, iDays) && *q == 'd')
+    {
+      iCivilDay = m_iToday + iSign * iDays;
+      bDay = true;
+      p = q + 1;
+    }
+  }
+
+  /* time of day */
+  int64_t iSecond = 0;
+  bool bClock = false;
+  if (*p != '\0' && *p != ' ')
+  {
+    const int iSign = *p == '-' ? -1 : 1;
+    if (*p == '+' || *p == '-')
+      ++p;
+    if (!ParseClock(p, iSecond))
+      return false;
+    iSecond *= iSign;
+    bClock = true;
+  }
+
+  SkipBlanks(p);
+  if (*p != '\0' || (!bDay && !bClock))
+    return false;
+
+  iTime = LocalTime(iCivilDay, iSecond);
+  return true;
+}
+
+time_t PVRDemoTimeResolver::LocalTime(int64_t iCivilDay, int64_t iSecond) const
+{
+  const int64_t iDays = FloorDiv(iSecond, SECONDS_PER_DAY);
+  iCivilDay += iDays;
+  iSecond -= iDays * SECONDS_PER_DAY;
+
+  const int64_t iIndex = iCivilDay - m_iToday + DAYS_CACHED;
+  const Day day = iIndex >= 0 && iIndex < 2 * DAYS_CACHED + 1 ? m_days[iIndex] : ComputeDay(iCivilDay);
+
+  /* wall clock seconds since the epoch, turned into UTC with the offset in force */
+  const int64_t iLocal = iCivilDay * SECONDS_PER_DAY + iSecond;
+  const time_t iBefore = (time_t)(iLocal - day.iOffsetStart);
+  if (day.iOffsetStart == day.iOffsetEnd || iBefore < day.iTransition)
+    return iBefore;
+
+  const time_t iAfter = (time_t)(iLocal - day.iOffsetEnd);
+  return iAfter >= day.iTransition ? iAfter : iBefore;
+}
+
+int PVRDemoTimeResolver::Offset(time_t iTime) const
+{
+  struct tm local;
+  if (!LocalTm(iTime, local))
+    return m_iOffsetNow;
+
+  const int64_t iLocal = DaysFromCivil(local.tm_year + 1900, local.tm_mon + 1, local.tm_mday) * SECONDS_PER_DAY +
+                         local.tm_hour * 3600 + local.tm_min * 60 + local.tm_sec;
+  return (int)(iLocal - iTime);
+}
+
+PVRDemoTimeResolver::Day PVRDemoTimeResolver::ComputeDay(int64_t iCivilDay) const
+{
+  /*
+   * Look from well before the day's first wall clock second to well after
+   * its last, so a change at midnight itself is found too. Offsets change
+   * by less than the margin, and never twice in that window.
+   */
+  const time_t iStart = (time_t)(iCivilDay * SECONDS_PER_DAY - m_iOffsetNow - SEARCH_MARGIN);
+  const time_t iEnd = (time_t)((iCivilDay + 1) * SECONDS_PER_DAY - m_iOffsetNow + SEARCH_MARGIN);
+
+  Day day;
+  day.iOffsetStart = Offset(iStart);
+  day.iOffsetEnd = Offset(iEnd);
+  day.iTransition = iEnd;
+
+  if (day.iOffsetStart != day.iOffsetEnd)
+  {
+    time_t iLow = iStart;
+    time_t iHigh = iEnd;
+    while (iHigh - iLow > 1)
+    {
+      const time_t iMid = iLow + (iHigh - iLow) / 2;
+      if (Offset(iMid) == day.iOffsetStart)
+        iLow = iMid;
+      else
+        iHigh = iMid;
+    }
+    day.iTransition = iHigh;
+  }
+
+  return day;
+}
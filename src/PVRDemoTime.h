@@ -0,0 +1,71 @@
+/*
+ *  Copyright (C) 2011-2020 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2011 Pulse-Eight (http://www.pulse-eight.com/)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+
+/*!
+ * Resolves the time expressions of the demo data against the moment a load
+ * started. The UTC offsets of the days around that moment, and where a day
+ * changes offset, are worked out once in the constructor. Resolve() only
+ * parses and adds, allocates nothing and is safe to call from any thread.
+ *
+ * Accepted expressions, with optional surrounding blanks:
+ *
+ *   HH:MM[:SS]                        wall clock time on the default day
+ *   [+-]Nd[(+|-)HH:MM[:SS]]           N days from today, at midnight or at
+ *                                     that time; "-1d+20:15" is yesterday
+ *                                     at 20:15, "-1d-01:00" 23:00 the day
+ *                                     before
+ *   YYYY-MM-DD[(T| )HH:MM[:SS]][Z|(+|-)HH[:]MM]
+ *                                     ISO-8601, local time without a zone
+ *
+ * A wall clock time that a DST change skips is taken in the offset before
+ * the change, as mktime() does; one that occurs twice resolves to the first.
+ */
+class PVRDemoTimeResolver
+{
+public:
+  static const int DAYS_CACHED = 2; // days either side of today with precomputed offsets
+
+  explicit PVRDemoTimeResolver(time_t iNow);
+
+  bool Resolve(const char* strExpression, int iDefaultDay, time_t& iTime) const;
+
+  /* the moment iSecond seconds of wall clock time after midnight of a day */
+  time_t LocalTime(int64_t iCivilDay, int64_t iSecond) const;
+
+  time_t Now(void) const { return m_iNow; }
+
+  /* the civil day, days since 1970-01-01, of the resolver's today */
+  int64_t Today(void) const { return m_iToday; }
+
+  /* days since 1970-01-01 in the proleptic Gregorian calendar */
+  static int64_t DaysFromCivil(int iYear, int iMonth, int iDay);
+
+  /* thread-safe localtime() */
+  static bool LocalTm(time_t iTime, struct tm& tm);
+
+private:
+  struct Day
+  {
+    int    iOffsetStart;  // seconds east of UTC as the day starts
+    int    iOffsetEnd;    // and as it ends
+    time_t iTransition;   // first moment with iOffsetEnd, if they differ
+  };
+
+  Day ComputeDay(int64_t iCivilDay) const;
+  int Offset(time_t iTime) const;
+
+  time_t  m_iNow;
+  int64_t m_iToday;
+  int     m_iOffsetNow;
+  Day     m_days[2 * DAYS_CACHED + 1];
+};
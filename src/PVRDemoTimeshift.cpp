@@ -0,0 +1,269 @@
+/*
+ *  Copyright (C) 2011-2020 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2011 Pulse-Eight (http://www.pulse-eight.com/)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "PVRDemoTimeshift.h"
+#include "client.h"
+#include "p8-platform/util/StringUtils.h"
+#include "p8-platform/util/timeutils.h"
+
+#include <algorithm>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+using namespace ADDON;
+using namespace P8PLATFORM;
+
+PVRDemoTimeshiftBuffer::Segment::~Segment(void)
+{
+  if (fd >= 0)
+    close(fd);
+}
+
+PVRDemoTimeshiftBuffer::PVRDemoTimeshiftBuffer(const std::string& strDirectory, uint64_t iMaxBytes, int iMaxSeconds) :
+  m_strDirectory(strDirectory),
+  m_iMaxBytes(std::max(iMaxBytes, 2 * SEGMENT_SIZE)),
+  m_iMaxDurationMs((int64_t)iMaxSeconds * 1000),
+  m_openTime(0),
+  m_iOpenTimeMs(0),
+  m_iSegmentCounter(0),
+  m_bWriteFailed(false),
+  m_iStartPosition(0),
+  m_iEndPosition(0)
+{
+}
+
+PVRDemoTimeshiftBuffer::~PVRDemoTimeshiftBuffer(void)
+{
+  Close();
+}
+
+bool PVRDemoTimeshiftBuffer::Open(void)
+{
+#ifdef TARGET_WINDOWS
+  return false;
+#else
+  /* the add-on's profile directory may not exist before settings are saved */
+  for (size_t iPos = m_strDirectory.find('/', 1); iPos != std::string::npos; iPos = m_strDirectory.find('/', iPos + 1))
+    mkdir(m_strDirectory.substr(0, iPos).c_str(), 0755);
+
+  if (mkdir(m_strDirectory.c_str(), 0755) != 0 && errno != EEXIST)
+  {
+    PVRDEMO_LOG(LOG_ERROR, "%s - cannot create timeshift directory '%s': %s", __FUNCTION__, m_strDirectory.c_str(), strerror(errno));
+    return false;
+  }
+
+  /* remove segments left behind by an unclean shutdown */
+  DIR* dir = opendir(m_strDirectory.c_str());
+  if (dir)
+  {
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL)
+    {
+      if (strncmp(entry->d_name, "segment-", 8) == 0)
+        unlink((m_strDirectory + entry->d_name).c_str());
+    }
+    closedir(dir);
+  }
+
+  m_openTime = time(NULL);
+  m_iOpenTimeMs = GetTimeMs();
+  m_iStartPosition = 0;
+  m_iEndPosition = 0;
+  m_bWriteFailed = false;
+
+  CLockObject lock(m_mutex);
+  return AddSegment();
+#endif
+}
+
+void PVRDemoTimeshiftBuffer::Close(void)
+{
+  CLockObject lock(m_mutex);
+  for (const auto& segment : m_segments)
+    unlink(segment->strPath.c_str());
+  m_segments.clear();
+  m_index.clear();
+}
+
+int64_t PVRDemoTimeshiftBuffer::Now(void) const
+{
+  return GetTimeMs() - m_iOpenTimeMs;
+}
+
+bool PVRDemoTimeshiftBuffer::AddSegment(void)
+{
+  SegmentPtr segment(new Segment);
+  segment->iStart = m_iEndPosition.load(std::memory_order_relaxed);
+  segment->iStartTime = Now();
+  segment->strPath = m_strDirectory + StringUtils::Format("segment-%08u.ts", m_iSegmentCounter++);
+  segment->fd = open(segment->strPath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (segment->fd < 0)
+  {
+    PVRDEMO_LOG(LOG_ERROR, "%s - cannot create timeshift segment '%s': %s", __FUNCTION__, segment->strPath.c_str(), strerror(errno));
+    return false;
+  }
+
+  m_segments.push_back(segment);
+  return true;
+}
+
+void PVRDemoTimeshiftBuffer::EnforceLimits(int64_t iNow)
+{
+  /* always keep the segment being written plus one to read from */
+  while (m_segments.size() > 2)
+  {
+    const uint64_t iRetained = m_iEndPosition.load(std::memory_order_relaxed) - m_segments.front()->iStart;
+    const int64_t iOldestEnd = m_segments[1]->iStartTime;
+    if (iRetained <= m_iMaxBytes && (m_iMaxDurationMs <= 0 || iNow - iOldestEnd <= m_iMaxDurationMs))
+      break;
+
+    /* readers holding the segment keep its descriptor alive until they are done */
+    unlink(m_segments.front()->strPath.c_str());
+    m_segments.pop_front();
+  }
+
+  const uint64_t iStart = m_segments.front()->iStart;
+  m_iStartPosition.store(iStart, std::memory_order_release);
+  while (!m_index.empty() && m_index.front().iPosition < iStart)
+    m_index.pop_front();
+}
+
+bool PVRDemoTimeshiftBuffer::Write(const uint8_t* pData, size_t iSize)
+{
+  if (m_bWriteFailed)
+    return false;
+
+  const int64_t iNow = Now();
+  while (iSize > 0)
+  {
+    SegmentPtr segment;
+    {
+      CLockObject lock(m_mutex);
+      const uint64_t iEnd = m_iEndPosition.load(std::memory_order_relaxed);
+      if (iEnd - m_segments.back()->iStart >= SEGMENT_SIZE)
+      {
+        if (!AddSegment())
+        {
+          m_bWriteFailed = true;
+          return false;
+        }
+      }
+
+      if (m_index.empty() || iNow - m_index.back().iTime >= INDEX_INTERVAL_MS)
+      {
+        IndexEntry entry = { iNow, iEnd };
+        m_index.push_back(entry);
+      }
+
+      EnforceLimits(iNow);
+      segment = m_segments.back();
+    }
+
+    const uint64_t iEnd = m_iEndPosition.load(std::memory_order_relaxed);
+    const uint64_t iOffset = iEnd - segment->iStart;
+    const size_t iChunk = (size_t)std::min<uint64_t>(iSize, SEGMENT_SIZE - iOffset);
+    ssize_t iWritten = pwrite(segment->fd, pData, iChunk, (off_t)iOffset);
+    if (iWritten <= 0)
+    {
+      PVRDEMO_LOG(LOG_ERROR, "%s - timeshift write failed: %s", __FUNCTION__, strerror(errno));
+      m_bWriteFailed = true;
+      return false;
+    }
+
+    m_iEndPosition.store(iEnd + iWritten, std::memory_order_release);
+    pData += iWritten;
+    iSize -= iWritten;
+  }
+
+  m_dataEvent.Signal();
+  return true;
+}
+
+PVRDemoTimeshiftBuffer::SegmentPtr PVRDemoTimeshiftBuffer::FindSegment(uint64_t iPosition) const
+{
+  CLockObject lock(m_mutex);
+  auto it = std::upper_bound(m_segments.begin(), m_segments.end(), iPosition,
+                             [](uint64_t iPos, const SegmentPtr& segment) { return iPos < segment->iStart; });
+  if (it == m_segments.begin())
+    return SegmentPtr();
+  return *(--it);
+}
+
+ssize_t PVRDemoTimeshiftBuffer::Read(uint64_t iPosition, uint8_t* pBuffer, size_t iSize) const
+{
+  const uint64_t iEnd = EndPosition();
+  if (iPosition >= iEnd || iPosition < StartPosition())
+    return 0;
+
+  SegmentPtr segment = FindSegment(iPosition);
+  if (!segment)
+    return 0;
+
+  const uint64_t iOffset = iPosition - segment->iStart;
+  const uint64_t iSegmentLeft = std::min(SEGMENT_SIZE - iOffset, iEnd - iPosition);
+  const size_t iChunk = (size_t)std::min<uint64_t>(iSize, iSegmentLeft);
+  ssize_t iRead = pread(segment->fd, pBuffer, iChunk, (off_t)iOffset);
+  return iRead > 0 ? iRead : 0;
+}
+
+bool PVRDemoTimeshiftBuffer::WaitForData(uint64_t iPosition, int iTimeoutMs) const
+{
+  if (iPosition < EndPosition())
+    return true;
+
+  m_dataEvent.Wait(iTimeoutMs);
+  return iPosition < EndPosition();
+}
+
+int64_t PVRDemoTimeshiftBuffer::StartTime(void) const
+{
+  CLockObject lock(m_mutex);
+  return m_index.empty() ? 0 : m_index.front().iTime;
+}
+
+int64_t PVRDemoTimeshiftBuffer::EndTime(void) const
+{
+  CLockObject lock(m_mutex);
+  return m_index.empty() ? 0 : Now();
+}
+
+uint64_t PVRDemoTimeshiftBuffer::PositionForTime(int64_t iTimeMs, bool bBackwards) const
+{
+  CLockObject lock(m_mutex);
+  if (m_index.empty())
+    return EndPosition();
+
+  if (!bBackwards)
+  {
+    /* past the last index point the next place to start from is the live end */
+    auto it = std::lower_bound(m_index.begin(), m_index.end(), iTimeMs,
+                               [](const IndexEntry& entry, int64_t iTime) { return entry.iTime < iTime; });
+    return it == m_index.end() ? EndPosition() : it->iPosition;
+  }
+
+  auto it = std::upper_bound(m_index.begin(), m_index.end(), iTimeMs,
+                             [](int64_t iTime, const IndexEntry& entry) { return iTime < entry.iTime; });
+  if (it == m_index.begin())
+    return m_index.front().iPosition;
+  return (--it)->iPosition;
+}
+
+int64_t PVRDemoTimeshiftBuffer::TimeForPosition(uint64_t iPosition) const
+{
+  CLockObject lock(m_mutex);
+  if (m_index.empty())
+    return 0;
+
+  auto it = std::upper_bound(m_index.begin(), m_index.end(), iPosition,
+                             [](uint64_t iPos, const IndexEntry& entry) { return iPos < entry.iPosition; });
+  if (it == m_index.begin())
+    return m_index.front().iTime;
+  return (--it)->iTime;
+}
@@ -0,0 +1,101 @@
+/*
+ *  Copyright (C) 2011-2020 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2011 Pulse-Eight (http://www.pulse-eight.com/)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <string>
+#include "p8-platform/os.h"
+#include "p8-platform/threads/mutex.h"
+
+/*!
+ * Disk-backed timeshift store for one live stream.
+ *
+ * Bytes are appended to fixed-size segment files under a directory in the
+ * user path. Positions are logical offsets since the stream was opened; the
+ * oldest segments are dropped once the size or duration cap is exceeded, so
+ * the readable range is [StartPosition(), EndPosition()). A sparse
+ * time->offset index is kept alongside for O(log n) time seeks.
+ *
+ * There is one writer. It never waits for readers: a reader that falls
+ * behind the retained range is moved forward on its next read.
+ */
+class PVRDemoTimeshiftBuffer
+{
+public:
+  static const uint64_t SEGMENT_SIZE = 16 * 1024 * 1024;
+  static const int64_t  INDEX_INTERVAL_MS = 500;
+
+  PVRDemoTimeshiftBuffer(const std::string& strDirectory, uint64_t iMaxBytes, int iMaxSeconds);
+  ~PVRDemoTimeshiftBuffer(void);
+
+  bool Open(void);
+  void Close(void);
+
+  /* writer side */
+  bool Write(const uint8_t* pData, size_t iSize);
+
+  /* reader side */
+  ssize_t Read(uint64_t iPosition, uint8_t* pBuffer, size_t iSize) const;
+  bool WaitForData(uint64_t iPosition, int iTimeoutMs) const;
+
+  uint64_t StartPosition(void) const { return m_iStartPosition.load(std::memory_order_acquire); }
+  uint64_t EndPosition(void) const { return m_iEndPosition.load(std::memory_order_acquire); }
+
+  /* times are milliseconds since Open() */
+  int64_t StartTime(void) const;
+  int64_t EndTime(void) const;
+
+  /* the index point at or before a time when going backwards, at or after it when going forwards */
+  uint64_t PositionForTime(int64_t iTimeMs, bool bBackwards) const;
+  int64_t TimeForPosition(uint64_t iPosition) const;
+  time_t OpenTime(void) const { return m_openTime; }
+
+private:
+  struct Segment
+  {
+    Segment(void) : iStart(0), iStartTime(0), fd(-1) {}
+    ~Segment(void);
+
+    uint64_t    iStart;
+    int64_t     iStartTime;
+    int         fd;
+    std::string strPath;
+  };
+  typedef std::shared_ptr<Segment> SegmentPtr;
+
+  struct IndexEntry
+  {
+    int64_t  iTime;
+    uint64_t iPosition;
+  };
+
+  int64_t Now(void) const;
+  bool AddSegment(void);
+  void EnforceLimits(int64_t iNow);
+  SegmentPtr FindSegment(uint64_t iPosition) const;
+
+  std::string              m_strDirectory;
+  uint64_t                 m_iMaxBytes;
+  int64_t                  m_iMaxDurationMs;
+  time_t                   m_openTime;
+  int64_t                  m_iOpenTimeMs;
+  unsigned int             m_iSegmentCounter;
+  bool                     m_bWriteFailed;
+
+  /* guards the segment list and the index; never held across file I/O */
+  mutable P8PLATFORM::CMutex m_mutex;
+  std::deque<SegmentPtr>   m_segments;
+  std::deque<IndexEntry>   m_index;
+
+  std::atomic<uint64_t>    m_iStartPosition;
+  std::atomic<uint64_t>    m_iEndPosition;
+  mutable P8PLATFORM::CEvent m_dataEvent;
+};
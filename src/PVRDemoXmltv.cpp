@@ -0,0 +1,687 @@
+/*
+ *  Copyright (C) 2011-2020 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2011 Pulse-Eight (http://www.pulse-eight.com/)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "PVRDemoXmltv.h"
+#include "PVRDemoTime.h"
+#include "p8-platform/util/timeutils.h"
+
+#include <algorithm>
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unordered_set>
+
+using namespace ADDON;
+using namespace P8PLATFORM;
+
+namespace
+{
+
+typedef std::vector<std::pair<std::string, std::string>> Attributes;
+
+std::string Normalise(const std::string& strName)
+{
+  size_t iBegin = 0;
+  size_t iEnd = strName.size();
+  while (iBegin < iEnd && isspace((unsigned char)strName[iBegin]))
+    ++iBegin;
+  while (iEnd > iBegin && isspace((unsigned char)strName[iEnd - 1]))
+    --iEnd;
+
+  std::string strResult(strName, iBegin, iEnd - iBegin);
+  for (char& c : strResult)
+  {
+    if (c >= 'A' && c <= 'Z')
+      c += 'a' - 'A';
+  }
+  return strResult;
+}
+
+void AppendUtf8(std::string& strOut, unsigned long iCodePoint)
+{
+  if (iCodePoint < 0x80)
+    strOut += (char)iCodePoint;
+  else if (iCodePoint < 0x800)
+  {
+    strOut += (char)(0xC0 | (iCodePoint >> 6));
+    strOut += (char)(0x80 | (iCodePoint & 0x3F));
+  }
+  else if (iCodePoint < 0x10000)
+  {
+    strOut += (char)(0xE0 | (iCodePoint >> 12));
+    strOut += (char)(0x80 | ((iCodePoint >> 6) & 0x3F));
+    strOut += (char)(0x80 | (iCodePoint & 0x3F));
+  }
+  else if (iCodePoint < 0x110000)
+  {
+    strOut += (char)(0xF0 | (iCodePoint >> 18));
+    strOut += (char)(0x80 | ((iCodePoint >> 12) & 0x3F));
+    strOut += (char)(0x80 | ((iCodePoint >> 6) & 0x3F));
+    strOut += (char)(0x80 | (iCodePoint & 0x3F));
+  }
+}
+
+/* append p..pEnd to strOut, resolving the predefined and numeric entities */
+void AppendDecoded(std::string& strOut, const char* p, const char* pEnd)
+{
+  while (p < pEnd)
+  {
+    const char* pAmp = (const char*)memchr(p, '&', pEnd - p);
+    if (!pAmp)
+    {
+      strOut.append(p, pEnd - p);
+      return;
+    }
+    strOut.append(p, pAmp - p);
+
+    const char* pSemicolon = (const char*)memchr(pAmp, ';', std::min<size_t>(pEnd - pAmp, 12));
+    if (!pSemicolon)
+    {
+      strOut += '&';
+      p = pAmp + 1;
+      continue;
+    }
+
+    const std::string strEntity(pAmp + 1, pSemicolon - pAmp - 1);
+    if (strEntity == "amp")
+      strOut += '&';
+    else if (strEntity == "lt")
+      strOut += '<';
+    else if (strEntity == "gt")
+      strOut += '>';
+    else if (strEntity == "quot")
+      strOut += '"';
+    else if (strEntity == "apos")
+      strOut += '\'';
+    else if (strEntity.size() > 1 && strEntity[0] == '#')
+    {
+      const bool bHex = strEntity[1] == 'x' || strEntity[1] == 'X';
+      AppendUtf8(strOut, strtoul(strEntity.c_str() + (bHex ? 2 : 1), NULL, bHex ? 16 : 10));
+    }
+    else
+      strOut.append(pAmp, pSemicolon + 1 - pAmp);
+    p = pSemicolon + 1;
+  }
+}
+
+/*!
+ * Pull parser for the subset of XML that XMLTV files use. Only a window of
+ * the file is buffered: at most MAX_TOKEN_SIZE plus one read chunk.
+ */
+class XmlReader
+{
+public:
+  enum Token
+  {
+    TOKEN_START,
+    TOKEN_END,
+    TOKEN_TEXT,
+    TOKEN_EOF,
+    TOKEN_ERROR
+  };
+
+  explicit XmlReader(FILE* file) :
+    m_file(file),
+    m_iPos(0),
+    m_iEnd(0),
+    m_iBytesRead(0),
+    m_bEof(false),
+    m_bEmpty(false)
+  {
+    m_buffer.resize(PVRDemoXmltvImporter::READ_CHUNK_SIZE);
+  }
+
+  Token Next(void)
+  {
+    while (true)
+    {
+      if (m_iPos == m_iEnd && !Fill())
+        return m_bEof ? TOKEN_EOF : TOKEN_ERROR;
+
+      if (m_buffer[m_iPos] != '<')
+        return ReadText();
+
+      const char* p = &m_buffer[m_iPos];
+      const size_t iAvailable = m_iEnd - m_iPos;
+      if (iAvailable < 9 && !m_bEof)
+      {
+        if (!Fill() && !m_bEof)
+          return TOKEN_ERROR;
+        continue;
+      }
+
+      if (iAvailable >= 4 && memcmp(p, "<!--", 4) == 0)
+      {
+        if (!Skip("-->"))
+          return TOKEN_ERROR;
+        continue;
+      }
+      if (iAvailable >= 9 && memcmp(p, "<![CDATA[", 9) == 0)
+        return ReadCData();
+      if (p[1] == '?' || p[1] == '!')
+      {
+        /* declarations and processing instructions carry nothing we need */
+        if (!Skip(">"))
+          return TOKEN_ERROR;
+        continue;
+      }
+
+      return ReadTag();
+    }
+  }
+
+  const std::string& Name(void) const { return m_strName; }
+  const Attributes& GetAttributes(void) const { return m_attributes; }
+  const std::string& Text(void) const { return m_strText; }
+  bool IsEmptyElement(void) const { return m_bEmpty; }
+  uint64_t BytesRead(void) const { return m_iBytesRead; }
+
+private:
+  /* move the unread part to the front and read another chunk after it */
+  bool Fill(void)
+  {
+    if (m_bEof)
+      return false;
+
+    if (m_iPos > 0)
+    {
+      memmove(m_buffer.data(), m_buffer.data() + m_iPos, m_iEnd - m_iPos);
+      m_iEnd -= m_iPos;
+      m_iPos = 0;
+    }
+    if (m_buffer.size() - m_iEnd < PVRDemoXmltvImporter::READ_CHUNK_SIZE)
+    {
+      if (m_buffer.size() >= PVRDemoXmltvImporter::MAX_TOKEN_SIZE + PVRDemoXmltvImporter::READ_CHUNK_SIZE)
+        return false;
+      m_buffer.resize(m_buffer.size() + PVRDemoXmltvImporter::READ_CHUNK_SIZE);
+    }
+
+    const size_t iRead = fread(m_buffer.data() + m_iEnd, 1, m_buffer.size() - m_iEnd, m_file);
+    m_iEnd += iRead;
+    m_iBytesRead += iRead;
+    if (iRead == 0)
+      m_bEof = true;
+    return iRead > 0;
+  }
+
+  /* offset of strEnd after the current position, reading more as needed */
+  bool Find(const char* strEnd, size_t& iFound)
+  {
+    const size_t iLength = strlen(strEnd);
+    size_t iFrom = 0;
+    while (true)
+    {
+      const char* pBegin = m_buffer.data() + m_iPos + iFrom;
+      const char* pEnd = m_buffer.data() + m_iEnd;
+      const char* pFound = std::search(pBegin, pEnd, strEnd, strEnd + iLength);
+      if (pFound != pEnd)
+      {
+        iFound = pFound - (m_buffer.data() + m_iPos);
+        return true;
+      }
+
+      /* the terminator may straddle the chunk boundary */
+      const size_t iScanned = m_iEnd - m_iPos;
+      iFrom = iScanned >= iLength ? iScanned - iLength + 1 : 0;
+      if (!Fill())
+        return false;
+    }
+  }
+
+  bool Skip(const char* strEnd)
+  {
+    size_t iFound;
+    if (!Find(strEnd, iFound))
+      return false;
+    m_iPos += iFound + strlen(strEnd);
+    return true;
+  }
+
+  Token ReadText(void)
+  {
+    const char* p = m_buffer.data() + m_iPos;
+    const char* pEnd = m_buffer.data() + m_iEnd;
+    const char* pLt = (const char*)memchr(p, '<', pEnd - p);
+    if (!pLt)
+    {
+      /* hand out what we have, but never split an entity */
+      pLt = pEnd;
+      const char* pAmp = pEnd;
+      while (pAmp > p && pAmp[-1] != '&' && pAmp[-1] != ';')
+        --pAmp;
+      if (pAmp > p && pAmp[-1] == '&' && !m_bEof)
+        pLt = pAmp - 1;
+      if (pLt == p)
+      {
+        if (!Fill())
+          return m_bEof ? TOKEN_EOF : TOKEN_ERROR;
+        return ReadText();
+      }
+    }
+
+    m_strText.clear();
+    AppendDecoded(m_strText, p, pLt);
+    m_iPos += pLt - p;
+    return TOKEN_TEXT;
+  }
+
+  Token ReadCData(void)
+  {
+    size_t iFound;
+    if (!Find("]]>", iFound))
+      return TOKEN_ERROR;
+
+    m_strText.assign(m_buffer.data() + m_iPos + 9, iFound - 9);
+    m_iPos += iFound + 3;
+    return TOKEN_TEXT;
+  }
+
+  Token ReadTag(void)
+  {
+    size_t iFound;
+    if (!Find(">", iFound))
+      return TOKEN_ERROR;
+
+    const char* p = m_buffer.data() + m_iPos + 1;
+    const char* pEnd = m_buffer.data() + m_iPos + iFound;
+    m_iPos += iFound + 1;
+
+    const bool bEndTag = *p == '/';
+    if (bEndTag)
+      ++p;
+
+    m_bEmpty = pEnd > p && pEnd[-1] == '/';
+    if (m_bEmpty)
+      --pEnd;
+
+    const char* pName = p;
+    while (p < pEnd && !isspace((unsigned char)*p))
+      ++p;
+    m_strName.assign(pName, p - pName);
+
+    m_attributes.clear();
+    while (!bEndTag && p < pEnd)
+    {
+      while (p < pEnd && isspace((unsigned char)*p))
+        ++p;
+      const char* pAttribute = p;
+      while (p < pEnd && *p != '=' && !isspace((unsigned char)*p))
+        ++p;
+      if (p == pAttribute)
+        break;
+      std::string strAttribute(pAttribute, p - pAttribute);
+
+      while (p < pEnd && (isspace((unsigned char)*p) || *p == '='))
+        ++p;
+      if (p == pEnd || (*p != '"' && *p != '\''))
+        break;
+      const char quote = *p++;
+      const char* pValue = p;
+      while (p < pEnd && *p != quote)
+        ++p;
+
+      std::string strValue;
+      AppendDecoded(strValue, pValue, p);
+      m_attributes.emplace_back(std::move(strAttribute), std::move(strValue));
+      if (p < pEnd)
+        ++p;
+    }
+
+    return bEndTag ? TOKEN_END : TOKEN_START;
+  }
+
+  FILE*             m_file;
+  std::vector<char> m_buffer;
+  size_t            m_iPos;
+  size_t            m_iEnd;
+  uint64_t          m_iBytesRead;
+  bool              m_bEof;
+  bool              m_bEmpty;
+  std::string       m_strName;
+  Attributes        m_attributes;
+  std::string       m_strText;
+};
+
+const std::string* FindAttribute(const Attributes& attributes, const char* strName)
+{
+  for (const auto& attribute : attributes)
+  {
+    if (attribute.first == strName)
+      return &attribute.second;
+  }
+  return NULL;
+}
+
+bool ParseDigits(const char*& p, int iDigits, int& iValue)
+{
+  iValue = 0;
+  for (int i = 0; i < iDigits; ++i)
+  {
+    if (p[i] < '0' || p[i] > '9')
+      return false;
+    iValue = iValue * 10 + (p[i] - '0');
+  }
+  p += iDigits;
+  return true;
+}
+
+}
+
+PVRDemoXmltvImporter::PVRDemoXmltvImporter(std::shared_ptr<PVRDemoTextStore> texts) :
+  m_texts(std::move(texts)),
+  m_bInProgramme(false),
+  m_bProgrammeValid(false),
+  m_iProgrammeChannel(-1),
+  m_field(FIELD_NONE),
+  m_iLastChannel(-1),
+  m_guide(NULL),
+  m_iBytesRead(0),
+  m_iProgrammes(0),
+  m_iSkipped(0)
+{
+}
+
+void PVRDemoXmltvImporter::AddChannel(const std::string& strChannelName, int iUniqueId)
+{
+  m_channelsByName.emplace(Normalise(strChannelName), iUniqueId);
+}
+
+bool PVRDemoXmltvImporter::ParseTime(const char* strTime, time_t& iTime)
+{
+  const char* p = strTime;
+  int iYear, iMonth, iDay;
+  if (!ParseDigits(p, 4, iYear) || !ParseDigits(p, 2, iMonth) || !ParseDigits(p, 2, iDay))
+    return false;
+
+  int iHour, iMinute = 0, iSecond = 0;
+  if (!ParseDigits(p, 2, iHour))
+    iHour = 0;
+  else if (!ParseDigits(p, 2, iMinute))
+    iMinute = 0;
+  else if (!ParseDigits(p, 2, iSecond))
+    iSecond = 0;
+
+  if (iMonth < 1 || iMonth > 12 || iDay < 1 || iDay > 31 || iHour > 23 || iMinute > 59 || iSecond > 60)
+    return false;
+
+  while (*p == ' ')
+    ++p;
+
+  int iOffset = 0;
+  if (*p == '+' || *p == '-')
+  {
+    const int iSign = *p++ == '-' ? -1 : 1;
+    int iOffsetHours, iOffsetMinutes;
+    if (!ParseDigits(p, 2, iOffsetHours) || !ParseDigits(p, 2, iOffsetMinutes))
+      return false;
+    iOffset = iSign * (iOffsetHours * 3600 + iOffsetMinutes * 60);
+  }
+
+  iTime = (time_t)(PVRDemoTimeResolver::DaysFromCivil(iYear, iMonth, iDay) * 86400 + iHour * 3600 + iMinute * 60 + iSecond - iOffset);
+  return true;
+}
+
+bool PVRDemoXmltvImporter::Import(const std::string& strPath, PVRDemoGuide& guide)
+{
+  FILE* file = fopen(strPath.c_str(), "rb");
+  if (!file)
+  {
+    PVRDEMO_LOG(LOG_ERROR, "%s - cannot open XMLTV file '%s'", __FUNCTION__, strPath.c_str());
+    return false;
+  }
+
+  const int64_t iStartMs = GetTimeMs();
+  m_guide = &guide;
+  XmlReader reader(file);
+  XmlReader::Token token;
+  while ((token = reader.Next()) != XmlReader::TOKEN_EOF && token != XmlReader::TOKEN_ERROR)
+  {
+    switch (token)
+    {
+      case XmlReader::TOKEN_START:
+        OnStart(reader.Name(), reader.GetAttributes());
+        if (reader.IsEmptyElement())
+          OnEnd(reader.Name());
+        break;
+      case XmlReader::TOKEN_END:
+        OnEnd(reader.Name());
+        break;
+      case XmlReader::TOKEN_TEXT:
+        OnText(reader.Text());
+        break;
+      default:
+        break;
+    }
+  }
+  fclose(file);
+  m_iBytesRead = reader.BytesRead();
+  m_guide = NULL;
+
+  if (token == XmlReader::TOKEN_ERROR)
+  {
+    PVRDEMO_LOG(LOG_ERROR, "%s - malformed XMLTV file '%s' after %llu bytes", __FUNCTION__,
+                strPath.c_str(), (unsigned long long)m_iBytesRead);
+    return false;
+  }
+
+  /* feeds are usually in order already; close gaps left by missing stop times */
+  std::vector<unsigned int> ids;
+  for (auto& channel : guide)
+  {
+    std::vector<PVRDemoEpgEntry>& entries = channel.second;
+    if (!std::is_sorted(entries.begin(), entries.end(),
+                        [](const PVRDemoEpgEntry& a, const PVRDemoEpgEntry& b) { return a.startTime < b.startTime; }))
+      std::stable_sort(entries.begin(), entries.end(),
+                       [](const PVRDemoEpgEntry& a, const PVRDemoEpgEntry& b) { return a.startTime < b.startTime; });
+
+    for (size_t i = 0; i + 1 < entries.size(); ++i)
+    {
+      if (entries[i].endTime == 0)
+        entries[i].endTime = entries[i + 1].startTime;
+    }
+    if (!entries.empty() && entries.back().endTime == 0)
+    {
+      entries.pop_back();
+      ++m_iSkipped;
+      --m_iProgrammes;
+    }
+
+    /* an airing is identified by its channel and start, as in the demo schedule */
+    for (auto& entry : entries)
+    {
+      entry.iBroadcastId = (int)PVRDemoData::BroadcastId(channel.first, 0, entry.startTime);
+      ids.push_back((unsigned int)entry.iBroadcastId);
+    }
+  }
+
+  /* unique across the whole guide, not only within a channel */
+  std::sort(ids.begin(), ids.end());
+  if (std::adjacent_find(ids.begin(), ids.end()) != ids.end())
+    ResolveBroadcastIds(guide);
+
+  const int64_t iElapsedMs = std::max<int64_t>(1, GetTimeMs() - iStartMs);
+  PVRDEMO_LOG(LOG_INFO, "%s - imported %u programmes for %zu channels from %.1f MB in %lld ms (%.1f MB/s), %u skipped",
+              __FUNCTION__, m_iProgrammes, guide.size(), (double)m_iBytesRead / 1e6, (long long)iElapsedMs,
+              (double)m_iBytesRead / 1e3 / iElapsedMs, m_iSkipped);
+  return true;
+}
+
+int PVRDemoXmltvImporter::FindChannel(const std::string& strXmltvId)
+{
+  if (strXmltvId == m_strLastChannelId)
+    return m_iLastChannel;
+
+  int iChannel = -1;
+  auto it = m_channelsById.find(strXmltvId);
+  if (it != m_channelsById.end())
+    iChannel = it->second;
+  else
+  {
+    auto byName = m_channelsByName.find(Normalise(strXmltvId));
+    if (byName != m_channelsByName.end())
+      iChannel = byName->second;
+  }
+
+  m_strLastChannelId = strXmltvId;
+  m_iLastChannel = iChannel;
+  return iChannel;
+}
+
+void PVRDemoXmltvImporter::OnStart(const std::string& strName, const Attributes& attributes)
+{
+  m_field = FIELD_NONE;
+  m_strText.clear();
+
+  if (strName == "programme")
+  {
+    m_bInProgramme = true;
+    m_entry = PVRDemoEpgEntry();
+    m_strPlot.clear();
+    m_entry.iGenreType = 0;
+    m_entry.iGenreSubType = 0;
+    m_entry.iSeriesNumber = EPG_TAG_INVALID_SERIES_EPISODE;
+    m_entry.iEpisodeNumber = EPG_TAG_INVALID_SERIES_EPISODE;
+    m_entry.startTime = 0;
+    m_entry.endTime = 0;
+
+    const std::string* strChannel = FindAttribute(attributes, "channel");
+    const std::string* strStart = FindAttribute(attributes, "start");
+    const std::string* strStop = FindAttribute(attributes, "stop");
+    m_iProgrammeChannel = strChannel ? FindChannel(*strChannel) : -1;
+    m_bProgrammeValid = m_iProgrammeChannel >= 0 && strStart && ParseTime(strStart->c_str(), m_entry.startTime);
+    if (m_bProgrammeValid && strStop && (!ParseTime(strStop->c_str(), m_entry.endTime) || m_entry.endTime <= m_entry.startTime))
+      m_entry.endTime = 0;
+  }
+  else if (strName == "channel" && !m_bInProgramme)
+  {
+    const std::string* strId = FindAttribute(attributes, "id");
+    m_strChannelId = strId ? *strId : "";
+  }
+  else if (strName == "display-name" && !m_strChannelId.empty())
+    m_field = FIELD_DISPLAY_NAME;
+  else if (m_bInProgramme && m_bProgrammeValid)
+  {
+    /* the first title or description wins when there are several languages */
+    if (strName == "title" && m_entry.strTitle.empty())
+      m_field = FIELD_TITLE;
+    else if (strName == "sub-title" && m_entry.strEpisodeName.empty())
+      m_field = FIELD_SUB_TITLE;
+    else if (strName == "desc" && m_strPlot.empty())
+      m_field = FIELD_DESC;
+    else if (strName == "episode-num")
+    {
+      const std::string* strSystem = FindAttribute(attributes, "system");
+      m_strEpisodeSystem = strSystem ? *strSystem : "";
+      m_field = FIELD_EPISODE_NUM;
+    }
+    else if (strName == "icon" && m_entry.strIconPath.empty())
+    {
+      const std::string* strSrc = FindAttribute(attributes, "src");
+      if (strSrc)
+        m_entry.strIconPath = *strSrc;
+    }
+  }
+}
+
+void PVRDemoXmltvImporter::OnText(const std::string& strText)
+{
+  if (m_field != FIELD_NONE)
+    m_strText += strText;
+}
+
+void PVRDemoXmltvImporter::OnEnd(const std::string& strName)
+{
+  switch (m_field)
+  {
+    case FIELD_DISPLAY_NAME:
+    {
+      auto it = m_channelsByName.find(Normalise(m_strText));
+      if (it != m_channelsByName.end())
+        m_channelsById.emplace(m_strChannelId, it->second);
+      break;
+    }
+    case FIELD_TITLE:
+      m_entry.strTitle = m_strText;
+      break;
+    case FIELD_SUB_TITLE:
+      m_entry.strEpisodeName = m_strText;
+      break;
+    case FIELD_DESC:
+      m_strPlot = m_strText;
+      break;
+    case FIELD_EPISODE_NUM:
+      /* xmltv_ns is "season.episode.part", zero based, each maybe "n/total" */
+      if (m_strEpisodeSystem == "xmltv_ns")
+      {
+        const char* p = m_strText.c_str();
+        while (*p == ' ')
+          ++p;
+        if (*p >= '0' && *p <= '9')
+          m_entry.iSeriesNumber = atoi(p) + 1;
+        const char* pDot = strchr(p, '.');
+        if (pDot)
+        {
+          p = pDot + 1;
+          while (*p == ' ')
+            ++p;
+          if (*p >= '0' && *p <= '9')
+            m_entry.iEpisodeNumber = atoi(p) + 1;
+        }
+      }
+      break;
+    default:
+      break;
+  }
+  m_field = FIELD_NONE;
+  m_strText.clear();
+
+  if (strName == "channel" && !m_bInProgramme)
+    m_strChannelId.clear();
+  else if (strName == "programme")
+  {
+    FinishProgramme();
+    m_bInProgramme = false;
+  }
+}
+
+void PVRDemoXmltvImporter::ResolveBroadcastIds(PVRDemoGuide& guide)
+{
+  /* channels in the order of their ids, so every import settles on the same ids */
+  std::vector<int> channelUids;
+  for (const auto& channel : guide)
+    channelUids.push_back(channel.first);
+  std::sort(channelUids.begin(), channelUids.end());
+
+  std::unordered_set<unsigned int> ids;
+  for (int iChannelUid : channelUids)
+  {
+    for (auto& entry : guide[iChannelUid])
+    {
+      unsigned int iId = PVRDemoData::BroadcastId(iChannelUid, 0, entry.startTime);
+      for (unsigned int iAttempt = 1; !ids.insert(iId).second; ++iAttempt)
+        iId = PVRDemoData::BroadcastId(iChannelUid, 0, entry.startTime, iAttempt);
+      entry.iBroadcastId = (int)iId;
+    }
+  }
+  PVRDEMO_LOG(LOG_DEBUG, "%s - broadcast ids of the guide collided, rehashed", __FUNCTION__);
+}
+
+void PVRDemoXmltvImporter::FinishProgramme(void)
+{
+  if (!m_bProgrammeValid || m_entry.strTitle.empty())
+  {
+    ++m_iSkipped;
+    return;
+  }
+
+  m_entry.iChannelId = m_iProgrammeChannel;
+  m_entry.strPlot = m_texts->Add(m_strPlot);
+  (*m_guide)[m_iProgrammeChannel].push_back(std::move(m_entry));
+  ++m_iProgrammes;
+}
@@ -0,0 +1,97 @@
+/*
+ *  Copyright (C) 2011-2020 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2011 Pulse-Eight (http://www.pulse-eight.com/)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "PVRDemoData.h"
+
+/*!
+ * Streaming importer for XMLTV guide files. The file is read in fixed size
+ * chunks and never held in memory as a whole; programmes are turned into
+ * absolute time EPG entries as soon as their element is closed.
+ *
+ * XMLTV channels are matched to add-on channels when their id or one of
+ * their display names equals a channel name, ignoring case. Descriptions go
+ * into the text store the importer was given.
+ */
+class PVRDemoXmltvImporter
+{
+public:
+  static const size_t READ_CHUNK_SIZE = 256 * 1024;
+  static const size_t MAX_TOKEN_SIZE  = 1024 * 1024; // longest tag or text run kept in memory
+
+  explicit PVRDemoXmltvImporter(std::shared_ptr<PVRDemoTextStore> texts);
+
+  /* make a channel known under its name */
+  void AddChannel(const std::string& strChannelName, int iUniqueId);
+
+  /*!
+   * Import strPath into guide, one entry list per channel unique id, sorted
+   * by start time. Programmes for unknown channels are skipped.
+   */
+  bool Import(const std::string& strPath, PVRDemoGuide& guide);
+
+  /*!
+   * Parse an XMLTV timestamp, "YYYYmmddHHMMSS +zzzz". Time fields after
+   * the date may be left out; without an offset the time is taken as UTC.
+   */
+  static bool ParseTime(const char* strTime, time_t& iTime);
+
+  uint64_t BytesRead(void) const { return m_iBytesRead; }
+  unsigned int Programmes(void) const { return m_iProgrammes; }
+  unsigned int Skipped(void) const { return m_iSkipped; }
+
+private:
+  enum Field
+  {
+    FIELD_NONE,
+    FIELD_DISPLAY_NAME,
+    FIELD_TITLE,
+    FIELD_SUB_TITLE,
+    FIELD_DESC,
+    FIELD_EPISODE_NUM
+  };
+
+  void OnStart(const std::string& strName, const std::vector<std::pair<std::string, std::string>>& attributes);
+  void OnEnd(const std::string& strName);
+  void OnText(const std::string& strText);
+
+  int FindChannel(const std::string& strXmltvId);
+  void FinishProgramme(void);
+
+  /* ids for a guide in which airings hash to the same id, by channel id and start */
+  static void ResolveBroadcastIds(PVRDemoGuide& guide);
+
+  std::shared_ptr<PVRDemoTextStore>    m_texts;
+  std::unordered_map<std::string, int> m_channelsByName;
+  std::unordered_map<std::string, int> m_channelsById;
+
+  /* element being read */
+  std::string     m_strChannelId;
+  bool            m_bInProgramme;
+  bool            m_bProgrammeValid;
+  int             m_iProgrammeChannel;
+  PVRDemoEpgEntry m_entry;
+  std::string     m_strPlot;
+  Field           m_field;
+  std::string     m_strText;
+  std::string     m_strEpisodeSystem;
+
+  /* programmes are often grouped by channel, skip the lookup for a run */
+  std::string     m_strLastChannelId;
+  int             m_iLastChannel;
+
+  PVRDemoGuide*   m_guide;
+  uint64_t        m_iBytesRead;
+  unsigned int    m_iProgrammes;
+  unsigned int    m_iSkipped;
+};
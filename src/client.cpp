@@ -8,20 +8,43 @@
 
 #include "client.h"
 #include "kodi/xbmc_pvr_dll.h"
+#include "PVRDemoBackendClient.h"
 #include "PVRDemoData.h"
+#include "PVRDemoEpgTracker.h"
+#include "PVRDemoRecorder.h"
+#include "PVRDemoReloader.h"
+#include "PVRDemoSession.h"
+#include "PVRDemoStats.h"
+#include "PVRDemoTextStore.h"
 #include <p8-platform/util/util.h>
+#include <sys/stat.h>
 
 using namespace std;
 using namespace ADDON;
+using namespace P8PLATFORM;
 
 #ifdef TARGET_WINDOWS
 #define snprintf _snprintf
 #endif
 
+#ifndef SEEK_POSSIBLE
+#define SEEK_POSSIBLE 0x10000
+#endif
+
 bool           m_bCreated       = false;
 ADDON_STATUS   m_CurStatus      = ADDON_STATUS_UNKNOWN;
 PVRDemoData   *m_data           = NULL;
-PVRDemoChannel m_currentChannel;
+PVRDemoSessionManager *m_sessions = NULL;
+PVRDemoEpgTracker *m_epgTracker   = NULL;
+PVRDemoRecorder *m_recorder     = NULL;
+PVRDemoReloader *m_reloader     = NULL;
+CMutex         m_reloadMutex;   // one reload at a time, from a setting or the menu
+bool           m_bPowerSaving   = false;
+
+/* the session Kodi's player reads from, live or recorded; read through a
+ * PlayerSession, which takes no lock, as status calls come from other threads */
+PVRDemoPublished<PVRDemoSession> m_playerSession;
+typedef PVRDemoPublished<PVRDemoSession>::Reader PlayerSession;
 
 /* User adjustable settings are saved here.
  * Default values are defined inside client.h
@@ -29,19 +52,200 @@ PVRDemoChannel m_currentChannel;
  */
 std::string g_strUserPath             = "";
 std::string g_strClientPath           = "";
+int         g_iLiveBufferSize         = DEFAULT_LIVE_BUFFER_SIZE;
+bool        g_bTimeshiftEnabled       = DEFAULT_TIMESHIFT_ENABLED;
+int         g_iTimeshiftMaxSize       = DEFAULT_TIMESHIFT_MAX_SIZE;
+int         g_iTimeshiftMaxDuration   = DEFAULT_TIMESHIFT_MAX_DURATION;
+bool        g_bAddonDemuxing          = DEFAULT_ADDON_DEMUXING;
+int         g_iIOThreads              = DEFAULT_IO_THREADS;
+int         g_iSessionMemory          = DEFAULT_SESSION_MEMORY;
+int         g_iLogLevel               = DEFAULT_LOG_LEVEL;
+std::string g_strXmltvFile            = DEFAULT_XMLTV_FILE;
+int         g_iColdText               = DEFAULT_COLD_TEXT;
+int         g_iColdTextCache          = DEFAULT_COLD_TEXT_CACHE;
+int         g_iIconSize               = DEFAULT_ICON_SIZE;
+std::string g_strBackendAddress       = DEFAULT_BACKEND_ADDRESS;
+int         g_iBackendConnections     = DEFAULT_BACKEND_CONNECTIONS;
+int         g_iBackendEpgChannels     = DEFAULT_BACKEND_EPG_CHANNELS;
+int         g_iBackendEpgDepth        = DEFAULT_BACKEND_EPG_DEPTH;
+std::string g_strRecordingDirectory   = DEFAULT_RECORDING_DIRECTORY;
+CMutex      g_settingsMutex;
 
 CHelper_libXBMC_addon *XBMC           = NULL;
 CHelper_libXBMC_pvr   *PVR            = NULL;
 
+/* the live and recorded stream entry points share these, so each entry
+ * point is accounted under its own name */
+void ClosePlayerSession(void)
+{
+  std::shared_ptr<PVRDemoSession> session = m_playerSession.Exchange(nullptr);
+  if (session && m_sessions)
+    m_sessions->Close(session->Id());
+}
+
+int ReadPlayerSession(unsigned char *pBuffer, unsigned int iBufferSize)
+{
+  const PlayerSession session(m_playerSession);
+  if (!session)
+    return -1;
+
+  int iRead = session->Read(pBuffer, iBufferSize);
+  if (iRead > 0)
+    PVRDEMO_STATS_COUNT(PVRDEMO_COUNTER_BYTES, iRead);
+  return iRead;
+}
+
+long long SeekPlayerSession(long long iPosition, int iWhence)
+{
+  const PlayerSession session(m_playerSession);
+  if (!session)
+    return -1;
+
+  if (iWhence == SEEK_POSSIBLE)
+    return session->CanSeek() ? 1 : 0;
+
+  return session->Seek(iPosition, iWhence);
+}
+
+/* let Kodi pick up a new version of the data */
+void NotifyDataChanged(void)
+{
+  /* readers pick up the new version on their next call */
+  PVR->TriggerChannelUpdate();
+  PVR->TriggerChannelGroupsUpdate();
+  PVR->TriggerRecordingUpdate();
+  PVR->TriggerTimerUpdate();
+  /* the guide changes go out as per-broadcast events where they can */
+  if (m_epgTracker)
+    m_epgTracker->Changed();
+  if (m_recorder)
+    m_recorder->Changed();
+}
+
+/* publish a freshly loaded version and let Kodi pick it up */
+bool ReloadData(void)
+{
+  CLockObject lock(m_reloadMutex);
+  if (!m_data || !m_data->Reload())
+    return false;
+
+  NotifyDataChanged();
+  return true;
+}
+
+/* the data is loaded on another thread, which takes its copy with StringSetting() */
+void SetStringSetting(std::string& strSetting, const std::string& strValue)
+{
+  CLockObject lock(g_settingsMutex);
+  strSetting = strValue;
+}
+
+/* reload for a changed setting without holding up Kodi's settings thread */
+void RequestReload(void)
+{
+  if (m_reloader)
+    m_reloader->Request();
+}
+
+/* where OnSystemSleep() leaves the data for the next start */
+std::string SnapshotFile(void)
+{
+  std::string strFile = g_strUserPath;
+  if (!strFile.empty() && strFile[strFile.size() - 1] != '/' && strFile[strFile.size() - 1] != '\\')
+    strFile += '/';
+  return strFile + "snapshot.bin";
+}
+
+/* loglevel setting values, least severe first */
+void ApplyLogLevel(void)
+{
+  static const addon_log levels[] = { LOG_DEBUG, LOG_INFO, LOG_NOTICE, LOG_ERROR };
+  if (g_iLogLevel < 0 || g_iLogLevel >= (int)(sizeof(levels) / sizeof(levels[0])))
+    g_iLogLevel = DEFAULT_LOG_LEVEL;
+  PVRDemoLog::SetLevel(levels[g_iLogLevel]);
+}
+
+long long LengthPlayerSession(void)
+{
+  const PlayerSession session(m_playerSession);
+  return session ? session->Length() : -1;
+}
+
+/* the backend the current data came from, null for local data */
+std::shared_ptr<PVRDemoBackendClient> CurrentBackend(void)
+{
+  return m_data ? m_data->Snapshot()->backend : nullptr;
+}
+
 extern "C" {
 
 void ADDON_ReadSettings(void)
 {
-  //STUB
+  if (!XBMC->GetSetting("livebuffersize", &g_iLiveBufferSize) || g_iLiveBufferSize < 1)
+    g_iLiveBufferSize = DEFAULT_LIVE_BUFFER_SIZE;
+
+  if (!XBMC->GetSetting("timeshift", &g_bTimeshiftEnabled))
+    g_bTimeshiftEnabled = DEFAULT_TIMESHIFT_ENABLED;
+
+  if (!XBMC->GetSetting("timeshiftmaxsize", &g_iTimeshiftMaxSize) || g_iTimeshiftMaxSize < 1)
+    g_iTimeshiftMaxSize = DEFAULT_TIMESHIFT_MAX_SIZE;
+
+  if (!XBMC->GetSetting("timeshiftmaxduration", &g_iTimeshiftMaxDuration) || g_iTimeshiftMaxDuration < 0)
+    g_iTimeshiftMaxDuration = DEFAULT_TIMESHIFT_MAX_DURATION;
+
+  if (!XBMC->GetSetting("addondemuxing", &g_bAddonDemuxing))
+    g_bAddonDemuxing = DEFAULT_ADDON_DEMUXING;
+
+  if (!XBMC->GetSetting("iothreads", &g_iIOThreads) || g_iIOThreads < 0)
+    g_iIOThreads = DEFAULT_IO_THREADS;
+
+  if (!XBMC->GetSetting("sessionmemory", &g_iSessionMemory) || g_iSessionMemory < 1)
+    g_iSessionMemory = DEFAULT_SESSION_MEMORY;
+
+  if (!XBMC->GetSetting("loglevel", &g_iLogLevel))
+    g_iLogLevel = DEFAULT_LOG_LEVEL;
+  ApplyLogLevel();
+
+  char buffer[1024];
+  if (XBMC->GetSetting("xmltvfile", buffer))
+    SetStringSetting(g_strXmltvFile, buffer);
+  else
+    SetStringSetting(g_strXmltvFile, DEFAULT_XMLTV_FILE);
+
+  if (!XBMC->GetSetting("coldtext", &g_iColdText) || g_iColdText < PVRDemoTextStore::MODE_PLAIN || g_iColdText > PVRDemoTextStore::MODE_DISK)
+    g_iColdText = DEFAULT_COLD_TEXT;
+
+  if (!XBMC->GetSetting("coldtextcache", &g_iColdTextCache) || g_iColdTextCache < 1)
+    g_iColdTextCache = DEFAULT_COLD_TEXT_CACHE;
+  PVRDemoTextStore::SetCacheBudget((size_t)g_iColdTextCache * 1024 * 1024);
+
+  if (!XBMC->GetSetting("iconsize", &g_iIconSize) || g_iIconSize < 0)
+    g_iIconSize = DEFAULT_ICON_SIZE;
+
+  if (XBMC->GetSetting("backend", buffer))
+    SetStringSetting(g_strBackendAddress, buffer);
+  else
+    SetStringSetting(g_strBackendAddress, DEFAULT_BACKEND_ADDRESS);
+
+  if (!XBMC->GetSetting("backendconnections", &g_iBackendConnections) || g_iBackendConnections < 1)
+    g_iBackendConnections = DEFAULT_BACKEND_CONNECTIONS;
+
+  if (!XBMC->GetSetting("backendepgchannels", &g_iBackendEpgChannels) || g_iBackendEpgChannels < 1)
+    g_iBackendEpgChannels = DEFAULT_BACKEND_EPG_CHANNELS;
+
+  if (!XBMC->GetSetting("backendepgdepth", &g_iBackendEpgDepth) || g_iBackendEpgDepth < 1)
+    g_iBackendEpgDepth = DEFAULT_BACKEND_EPG_DEPTH;
+  PVRDemoBackendGuide::SetPrefetch(g_iBackendEpgChannels, g_iBackendEpgDepth);
+
+  if (XBMC->GetSetting("recordingdirectory", buffer))
+    SetStringSetting(g_strRecordingDirectory, buffer);
+  else
+    SetStringSetting(g_strRecordingDirectory, DEFAULT_RECORDING_DIRECTORY);
 }
 
 ADDON_STATUS ADDON_Create(void* hdl, void* props)
 {
+  PVRDEMO_STATS_SCOPE();
   if (!hdl || !props)
     return ADDON_STATUS_UNKNOWN;
 
@@ -62,15 +266,23 @@ ADDON_STATUS ADDON_Create(void* hdl, void* props)
     return ADDON_STATUS_PERMANENT_FAILURE;
   }
 
-  XBMC->Log(LOG_DEBUG, "%s - Creating the PVR demo add-on", __FUNCTION__);
-
   m_CurStatus     = ADDON_STATUS_UNKNOWN;
   g_strUserPath   = pvrprops->strUserPath;
   g_strClientPath = pvrprops->strClientPath;
 
   ADDON_ReadSettings();
+  PVRDemoLog::Start();
+#ifdef PVRDEMO_ENABLE_STATS
+  PVRDemoStats::Start();
+#endif
 
-  m_data = new PVRDemoData;
+  PVRDEMO_LOG(LOG_DEBUG, "%s - Creating the PVR demo add-on", __FUNCTION__);
+
+  m_data = new PVRDemoData(SnapshotFile());
+  m_sessions = new PVRDemoSessionManager((unsigned int)g_iIOThreads, (size_t)g_iSessionMemory * 1024 * 1024);
+  m_epgTracker = new PVRDemoEpgTracker(*m_data);
+  m_recorder = new PVRDemoRecorder(*m_data, *m_sessions, PVRDemoData::RecordingDirectory());
+  m_reloader = new PVRDemoReloader(ReloadData);
 
   PVR_MENUHOOK hook;
   hook.iHookId = 1;
@@ -88,6 +300,18 @@ ADDON_STATUS ADDON_Create(void* hdl, void* props)
   hook.iLocalizedStringId = 30002;
   PVR->AddMenuHook(&hook);
 
+  hook.iHookId = 4;
+  hook.category = PVR_MENUHOOK_SETTING;
+  hook.iLocalizedStringId = 30003;
+  PVR->AddMenuHook(&hook);
+
+#ifdef PVRDEMO_ENABLE_STATS
+  hook.iHookId = 5;
+  hook.category = PVR_MENUHOOK_SETTING;
+  hook.iLocalizedStringId = 30004;
+  PVR->AddMenuHook(&hook);
+#endif
+
   m_CurStatus = ADDON_STATUS_OK;
   m_bCreated = true;
   return m_CurStatus;
@@ -95,18 +319,152 @@ ADDON_STATUS ADDON_Create(void* hdl, void* props)
 
 ADDON_STATUS ADDON_GetStatus()
 {
+  PVRDEMO_STATS_SCOPE();
   return m_CurStatus;
 }
 
 void ADDON_Destroy()
 {
+  PVRDEMO_STATS_SCOPE();
+  m_playerSession.Store(nullptr);
+  SAFE_DELETE(m_reloader);
+  /* recordings in progress are finished with what they have and listed on the next start */
+  SAFE_DELETE(m_recorder);
+  SAFE_DELETE(m_sessions);
+  SAFE_DELETE(m_epgTracker);
   delete m_data;
   m_bCreated = false;
   m_CurStatus = ADDON_STATUS_UNKNOWN;
+#ifdef PVRDEMO_ENABLE_STATS
+  PVRDemoStats::Stop();
+#endif
+  PVRDemoLog::Stop();
 }
 
 ADDON_STATUS ADDON_SetSetting(const char *settingName, const void *settingValue)
 {
+  PVRDEMO_STATS_SCOPE();
+  /* takes effect with the next live stream that is opened */
+  if (strcmp(settingName, "livebuffersize") == 0)
+  {
+    int iValue = *static_cast<const int*>(settingValue);
+    g_iLiveBufferSize = iValue > 0 ? iValue : DEFAULT_LIVE_BUFFER_SIZE;
+  }
+  else if (strcmp(settingName, "timeshift") == 0)
+    g_bTimeshiftEnabled = *static_cast<const bool*>(settingValue);
+  else if (strcmp(settingName, "timeshiftmaxsize") == 0)
+  {
+    int iValue = *static_cast<const int*>(settingValue);
+    g_iTimeshiftMaxSize = iValue > 0 ? iValue : DEFAULT_TIMESHIFT_MAX_SIZE;
+  }
+  else if (strcmp(settingName, "timeshiftmaxduration") == 0)
+  {
+    int iValue = *static_cast<const int*>(settingValue);
+    g_iTimeshiftMaxDuration = iValue >= 0 ? iValue : DEFAULT_TIMESHIFT_MAX_DURATION;
+  }
+  else if (strcmp(settingName, "addondemuxing") == 0)
+  {
+    /* capabilities are only queried once, after ADDON_Create() */
+    if (g_bAddonDemuxing != *static_cast<const bool*>(settingValue))
+      return ADDON_STATUS_NEED_RESTART;
+  }
+  else if (strcmp(settingName, "iothreads") == 0)
+  {
+    /* sessions keep their queues, the threads only take from them */
+    int iValue = *static_cast<const int*>(settingValue);
+    g_iIOThreads = iValue >= 0 ? iValue : DEFAULT_IO_THREADS;
+    if (m_sessions)
+      m_sessions->Pool().Resize((unsigned int)g_iIOThreads);
+  }
+  else if (strcmp(settingName, "sessionmemory") == 0)
+  {
+    int iValue = *static_cast<const int*>(settingValue);
+    g_iSessionMemory = iValue > 0 ? iValue : DEFAULT_SESSION_MEMORY;
+    if (m_sessions)
+      m_sessions->SetMemoryBudget((size_t)g_iSessionMemory * 1024 * 1024);
+  }
+  else if (strcmp(settingName, "loglevel") == 0)
+  {
+    g_iLogLevel = *static_cast<const int*>(settingValue);
+    ApplyLogLevel();
+  }
+  else if (strcmp(settingName, "xmltvfile") == 0)
+  {
+    const std::string strFile = static_cast<const char*>(settingValue);
+    if (strFile != g_strXmltvFile)
+    {
+      SetStringSetting(g_strXmltvFile, strFile);
+      RequestReload();
+    }
+  }
+  else if (strcmp(settingName, "coldtext") == 0)
+  {
+    const int iValue = *static_cast<const int*>(settingValue);
+    if (iValue != g_iColdText && iValue >= PVRDemoTextStore::MODE_PLAIN && iValue <= PVRDemoTextStore::MODE_DISK)
+    {
+      g_iColdText = iValue;
+      RequestReload();
+    }
+  }
+  else if (strcmp(settingName, "coldtextcache") == 0)
+  {
+    int iValue = *static_cast<const int*>(settingValue);
+    g_iColdTextCache = iValue > 0 ? iValue : DEFAULT_COLD_TEXT_CACHE;
+    if (!m_bPowerSaving)
+      PVRDemoTextStore::SetCacheBudget((size_t)g_iColdTextCache * 1024 * 1024);
+  }
+  else if (strcmp(settingName, "iconsize") == 0)
+  {
+    const int iValue = *static_cast<const int*>(settingValue);
+    if (iValue != g_iIconSize && iValue >= 0)
+    {
+      g_iIconSize = iValue;
+      RequestReload();
+    }
+  }
+  else if (strcmp(settingName, "backend") == 0)
+  {
+    const std::string strAddress = static_cast<const char*>(settingValue);
+    if (strAddress != g_strBackendAddress)
+    {
+      SetStringSetting(g_strBackendAddress, strAddress);
+      RequestReload();
+    }
+  }
+  else if (strcmp(settingName, "backendconnections") == 0)
+  {
+    /* connections in use close when they are handed back */
+    int iValue = *static_cast<const int*>(settingValue);
+    g_iBackendConnections = iValue > 0 ? iValue : DEFAULT_BACKEND_CONNECTIONS;
+    std::shared_ptr<PVRDemoBackendClient> backend = CurrentBackend();
+    if (backend)
+      backend->SetMaxConnections(g_iBackendConnections);
+  }
+  else if (strcmp(settingName, "backendepgchannels") == 0)
+  {
+    int iValue = *static_cast<const int*>(settingValue);
+    g_iBackendEpgChannels = iValue > 0 ? iValue : DEFAULT_BACKEND_EPG_CHANNELS;
+    PVRDemoBackendGuide::SetPrefetch(g_iBackendEpgChannels, g_iBackendEpgDepth);
+  }
+  else if (strcmp(settingName, "backendepgdepth") == 0)
+  {
+    int iValue = *static_cast<const int*>(settingValue);
+    g_iBackendEpgDepth = iValue > 0 ? iValue : DEFAULT_BACKEND_EPG_DEPTH;
+    PVRDemoBackendGuide::SetPrefetch(g_iBackendEpgChannels, g_iBackendEpgDepth);
+  }
+  else if (strcmp(settingName, "recordingdirectory") == 0)
+  {
+    /* recordings in progress stay where they are, the reload lists those of the new directory */
+    const std::string strDirectory = static_cast<const char*>(settingValue);
+    if (strDirectory != g_strRecordingDirectory)
+    {
+      SetStringSetting(g_strRecordingDirectory, strDirectory);
+      if (m_recorder)
+        m_recorder->SetDirectory(PVRDemoData::RecordingDirectory());
+      RequestReload();
+    }
+  }
+
   return ADDON_STATUS_OK;
 }
 
@@ -116,61 +474,111 @@ ADDON_STATUS ADDON_SetSetting(const char *settingName, const void *settingValue)
 
 void OnSystemSleep()
 {
+  PVRDEMO_STATS_SCOPE();
+  if (!m_data)
+    return;
+
+  /* a box that restarts Kodi on wake starts from the snapshot instead of the data file */
+  m_data->SaveSnapshot(SnapshotFile());
+  m_data->DropCaches();
 }
 
 void OnSystemWake()
 {
+  PVRDEMO_STATS_SCOPE();
+  /* the data is all still there, only times given relative to today may be a day off */
+  if (m_data && m_data->RefreshTimes())
+    NotifyDataChanged();
 }
 
 void OnPowerSavingActivated()
 {
+  PVRDEMO_STATS_SCOPE();
+  /* nothing is shown, so keep no more plots decompressed than the reads in flight need */
+  m_bPowerSaving = true;
+  PVRDemoTextStore::SetCacheBudget(0);
+  if (m_data)
+    m_data->DropCaches();
 }
 
 void OnPowerSavingDeactivated()
 {
+  PVRDEMO_STATS_SCOPE();
+  m_bPowerSaving = false;
+  PVRDemoTextStore::SetCacheBudget((size_t)g_iColdTextCache * 1024 * 1024);
 }
 
 PVR_ERROR GetAddonCapabilities(PVR_ADDON_CAPABILITIES* pCapabilities)
 {
+  PVRDEMO_STATS_SCOPE();
   pCapabilities->bSupportsEPG             = true;
   pCapabilities->bSupportsTV              = true;
   pCapabilities->bSupportsRadio           = true;
   pCapabilities->bSupportsChannelGroups   = true;
   pCapabilities->bSupportsRecordings      = true;
   pCapabilities->bSupportsRecordingsUndelete = true;
+  pCapabilities->bSupportsRecordingSize   = true;
   pCapabilities->bSupportsTimers          = true;
   pCapabilities->bSupportsRecordingsRename = false;
   pCapabilities->bSupportsRecordingsLifetimeChange = false;
   pCapabilities->bSupportsDescrambleInfo = false;
+  pCapabilities->bHandlesInputStream      = true;
+  pCapabilities->bHandlesDemuxing         = g_bAddonDemuxing;
 
   return PVR_ERROR_NO_ERROR;
 }
 
+/* the strings of a backend are copied by Kodi right away; kept per thread, as a reload may replace the backend meanwhile */
 const char *GetBackendName(void)
 {
+  PVRDEMO_STATS_SCOPE();
   static const char *strBackendName = "pulse-eight demo pvr add-on";
-  return strBackendName;
+  static thread_local string strRemoteName;
+  std::shared_ptr<PVRDemoBackendClient> backend = CurrentBackend();
+  if (!backend)
+    return strBackendName;
+  strRemoteName = backend->BackendName();
+  return strRemoteName.empty() ? strBackendName : strRemoteName.c_str();
 }
 
 const char *GetBackendVersion(void)
 {
+  PVRDEMO_STATS_SCOPE();
   static string strBackendVersion = "0.1";
-  return strBackendVersion.c_str();
+  static thread_local string strRemoteVersion;
+  std::shared_ptr<PVRDemoBackendClient> backend = CurrentBackend();
+  if (!backend)
+    return strBackendVersion.c_str();
+  strRemoteVersion = backend->BackendVersion();
+  return strRemoteVersion.empty() ? strBackendVersion.c_str() : strRemoteVersion.c_str();
 }
 
 const char *GetConnectionString(void)
 {
+  PVRDEMO_STATS_SCOPE();
   static string strConnectionString = "connected";
-  return strConnectionString.c_str();
+  static thread_local string strRemoteConnection;
+  std::shared_ptr<PVRDemoBackendClient> backend = CurrentBackend();
+  if (!backend)
+    return strConnectionString.c_str();
+  strRemoteConnection = backend->Address() + (backend->IsConnected() ? "" : " (not connected)");
+  return strRemoteConnection.c_str();
 }
 
 const char *GetBackendHostname(void)
 {
-  return "";
+  PVRDEMO_STATS_SCOPE();
+  static thread_local string strRemoteHostname;
+  std::shared_ptr<PVRDemoBackendClient> backend = CurrentBackend();
+  if (!backend)
+    return "";
+  strRemoteHostname = backend->Hostname();
+  return strRemoteHostname.c_str();
 }
 
 PVR_ERROR GetDriveSpace(long long *iTotal, long long *iUsed)
 {
+  PVRDEMO_STATS_SCOPE();
   *iTotal = 1024 * 1024 * 1024;
   *iUsed  = 0;
   return PVR_ERROR_NO_ERROR;
@@ -178,6 +586,9 @@ PVR_ERROR GetDriveSpace(long long *iTotal, long long *iUsed)
 
 PVR_ERROR GetEPGForChannel(ADDON_HANDLE handle, int iChannelUid, time_t iStart, time_t iEnd)
 {
+  PVRDEMO_STATS_SCOPE();
+  if (m_epgTracker)
+    m_epgTracker->Fetched(iChannelUid, iStart, iEnd);
   if (m_data)
     return m_data->GetEPGForChannel(handle, iChannelUid, iStart, iEnd);
 
@@ -186,12 +597,14 @@ PVR_ERROR GetEPGForChannel(ADDON_HANDLE handle, int iChannelUid, time_t iStart,
 
 PVR_ERROR IsEPGTagPlayable(const EPG_TAG*, bool* bIsPlayable)
 {
+  PVRDEMO_STATS_SCOPE();
   *bIsPlayable = true;
   return PVR_ERROR_NO_ERROR;
 }
 
 PVR_ERROR GetEPGTagStreamProperties(const EPG_TAG* tag, PVR_NAMED_VALUE* properties, unsigned int* iPropertiesCount)
 {
+  PVRDEMO_STATS_SCOPE();
   if (!tag || !properties || !iPropertiesCount)
     return PVR_ERROR_SERVER_ERROR;
 
@@ -206,6 +619,7 @@ PVR_ERROR GetEPGTagStreamProperties(const EPG_TAG* tag, PVR_NAMED_VALUE* propert
 
 int GetChannelsAmount(void)
 {
+  PVRDEMO_STATS_SCOPE();
   if (m_data)
     return m_data->GetChannelsAmount();
 
@@ -214,6 +628,7 @@ int GetChannelsAmount(void)
 
 PVR_ERROR GetChannels(ADDON_HANDLE handle, bool bRadio)
 {
+  PVRDEMO_STATS_SCOPE();
   if (m_data)
     return m_data->GetChannels(handle, bRadio);
 
@@ -222,6 +637,7 @@ PVR_ERROR GetChannels(ADDON_HANDLE handle, bool bRadio)
 
 PVR_ERROR GetChannelStreamProperties(const PVR_CHANNEL* channel, PVR_NAMED_VALUE* properties, unsigned int* iPropertiesCount)
 {
+  PVRDEMO_STATS_SCOPE();
   if (!channel || !properties || !iPropertiesCount)
     return PVR_ERROR_SERVER_ERROR;
 
@@ -233,6 +649,15 @@ PVR_ERROR GetChannelStreamProperties(const PVR_CHANNEL* channel, PVR_NAMED_VALUE
     PVRDemoChannel addonChannel;
     m_data->GetChannel(*channel, addonChannel);
 
+    /* local sources are served through OpenLiveStream()/ReadLiveStream() */
+    if (PVRDemoStreamSource::IsAddonServed(addonChannel.strStreamURL))
+    {
+      strncpy(properties[0].strName, PVR_STREAM_PROPERTY_ISREALTIMESTREAM, sizeof(properties[0].strName) - 1);
+      strncpy(properties[0].strValue, "true", sizeof(properties[0].strValue) - 1);
+      *iPropertiesCount = 1;
+      return PVR_ERROR_NO_ERROR;
+    }
+
     strncpy(properties[0].strName, PVR_STREAM_PROPERTY_STREAMURL, sizeof(properties[0].strName) - 1);
     strncpy(properties[0].strValue, addonChannel.strStreamURL.c_str(), sizeof(properties[0].strValue) - 1);
     strncpy(properties[1].strName, PVR_STREAM_PROPERTY_ISREALTIMESTREAM, sizeof(properties[1].strName) - 1);
@@ -246,6 +671,7 @@ PVR_ERROR GetChannelStreamProperties(const PVR_CHANNEL* channel, PVR_NAMED_VALUE
 
 int GetChannelGroupsAmount(void)
 {
+  PVRDEMO_STATS_SCOPE();
   if (m_data)
     return m_data->GetChannelGroupsAmount();
 
@@ -254,6 +680,7 @@ int GetChannelGroupsAmount(void)
 
 PVR_ERROR GetChannelGroups(ADDON_HANDLE handle, bool bRadio)
 {
+  PVRDEMO_STATS_SCOPE();
   if (m_data)
     return m_data->GetChannelGroups(handle, bRadio);
 
@@ -262,6 +689,7 @@ PVR_ERROR GetChannelGroups(ADDON_HANDLE handle, bool bRadio)
 
 PVR_ERROR GetChannelGroupMembers(ADDON_HANDLE handle, const PVR_CHANNEL_GROUP &group)
 {
+  PVRDEMO_STATS_SCOPE();
   if (m_data)
     return m_data->GetChannelGroupMembers(handle, group);
 
@@ -270,6 +698,7 @@ PVR_ERROR GetChannelGroupMembers(ADDON_HANDLE handle, const PVR_CHANNEL_GROUP &g
 
 PVR_ERROR SignalStatus(PVR_SIGNAL_STATUS &signalStatus)
 {
+  PVRDEMO_STATS_SCOPE();
   snprintf(signalStatus.strAdapterName, sizeof(signalStatus.strAdapterName), "pvr demo adapter 1");
   snprintf(signalStatus.strAdapterStatus, sizeof(signalStatus.strAdapterStatus), "OK");
 
@@ -278,6 +707,7 @@ PVR_ERROR SignalStatus(PVR_SIGNAL_STATUS &signalStatus)
 
 int GetRecordingsAmount(bool deleted)
 {
+  PVRDEMO_STATS_SCOPE();
   if (m_data)
     return m_data->GetRecordingsAmount(deleted);
 
@@ -286,6 +716,7 @@ int GetRecordingsAmount(bool deleted)
 
 PVR_ERROR GetRecordings(ADDON_HANDLE handle, bool deleted)
 {
+  PVRDEMO_STATS_SCOPE();
   if (m_data)
     return m_data->GetRecordings(handle, deleted);
 
@@ -294,6 +725,7 @@ PVR_ERROR GetRecordings(ADDON_HANDLE handle, bool deleted)
 
 PVR_ERROR GetRecordingStreamProperties(const PVR_RECORDING* recording, PVR_NAMED_VALUE* properties, unsigned int* iPropertiesCount)
 {
+  PVRDEMO_STATS_SCOPE();
   if (!recording || !properties || !iPropertiesCount)
     return PVR_ERROR_SERVER_ERROR;
 
@@ -305,6 +737,14 @@ PVR_ERROR GetRecordingStreamProperties(const PVR_RECORDING* recording, PVR_NAMED
     PVRDemoRecording addonRecording;
     std::string streamURL = m_data->GetRecordingURL(*recording);
 
+    /* local recordings are served through OpenRecordedStream()/ReadRecordedStream() */
+    std::string strPath;
+    if (PVRDemoStreamSource::LocalPath(streamURL, strPath))
+    {
+      *iPropertiesCount = 0;
+      return PVR_ERROR_NO_ERROR;
+    }
+
     strncpy(properties[0].strName, PVR_STREAM_PROPERTY_STREAMURL, sizeof(properties[0].strName) - 1);
     strncpy(properties[0].strValue, streamURL.c_str(), sizeof(properties[0].strValue) - 1);
     *iPropertiesCount = 1;
@@ -314,14 +754,31 @@ PVR_ERROR GetRecordingStreamProperties(const PVR_RECORDING* recording, PVR_NAMED
   return PVR_ERROR_SERVER_ERROR;
 }
 
+PVR_ERROR GetRecordingSize(const PVR_RECORDING* recording, int64_t* sizeInBytes)
+{
+  PVRDEMO_STATS_SCOPE();
+  if (!recording || !sizeInBytes || !m_data)
+    return PVR_ERROR_SERVER_ERROR;
+
+  /* recordings that are still growing are not listed yet, so the file is complete */
+  *sizeInBytes = 0;
+  std::string strPath;
+  struct stat info;
+  if (PVRDemoStreamSource::LocalPath(m_data->GetRecordingURL(*recording), strPath) && stat(strPath.c_str(), &info) == 0)
+    *sizeInBytes = (int64_t)info.st_size;
+  return PVR_ERROR_NO_ERROR;
+}
+
 PVR_ERROR GetTimerTypes(PVR_TIMER_TYPE types[], int *size)
 {
+  PVRDEMO_STATS_SCOPE();
   /* TODO: Implement this to get support for the timer features introduced with PVR API 1.9.7 */
   return PVR_ERROR_NOT_IMPLEMENTED;
 }
 
 int GetTimersAmount(void)
 {
+  PVRDEMO_STATS_SCOPE();
   if (m_data)
     return m_data->GetTimersAmount();
 
@@ -330,6 +787,7 @@ int GetTimersAmount(void)
 
 PVR_ERROR GetTimers(ADDON_HANDLE handle)
 {
+  PVRDEMO_STATS_SCOPE();
   if (m_data)
     return m_data->GetTimers(handle);
 
@@ -337,8 +795,212 @@ PVR_ERROR GetTimers(ADDON_HANDLE handle)
   return PVR_ERROR_NOT_IMPLEMENTED;
 }
 
+bool OpenLiveStream(const PVR_CHANNEL& channel)
+{
+  PVRDEMO_STATS_SCOPE();
+  ClosePlayerSession();
+
+  PVRDemoChannel addonChannel;
+  if (!m_data || !m_sessions || !m_data->GetChannel(channel, addonChannel))
+    return false;
+
+  std::shared_ptr<PVRDemoSession> session = m_sessions->OpenLive(addonChannel.strStreamURL, g_bTimeshiftEnabled);
+  if (!session)
+    return false;
+
+  if (g_bAddonDemuxing)
+    session->EnableDemuxing();
+
+  m_playerSession.Store(session);
+  return true;
+}
+
+void CloseLiveStream(void)
+{
+  PVRDEMO_STATS_SCOPE();
+  ClosePlayerSession();
+}
+
+int ReadLiveStream(unsigned char *pBuffer, unsigned int iBufferSize)
+{
+  PVRDEMO_STATS_SCOPE();
+  return ReadPlayerSession(pBuffer, iBufferSize);
+}
+
+long long SeekLiveStream(long long iPosition, int iWhence /* = SEEK_SET */)
+{
+  PVRDEMO_STATS_SCOPE();
+  return SeekPlayerSession(iPosition, iWhence);
+}
+
+long long LengthLiveStream(void)
+{
+  PVRDEMO_STATS_SCOPE();
+  return LengthPlayerSession();
+}
+
+bool CanPauseStream(void)
+{
+  PVRDEMO_STATS_SCOPE();
+  const PlayerSession session(m_playerSession);
+  return session && session->CanSeek();
+}
+
+bool CanSeekStream(void)
+{
+  PVRDEMO_STATS_SCOPE();
+  const PlayerSession session(m_playerSession);
+  return session && session->CanSeek();
+}
+
+void PauseStream(bool bPaused)
+{
+  PVRDEMO_STATS_SCOPE();
+  const PlayerSession session(m_playerSession);
+  if (session && session->LiveStream())
+    session->LiveStream()->Pause(bPaused);
+}
+
+bool SeekTime(double time, bool backwards, double *startpts)
+{
+  PVRDEMO_STATS_SCOPE();
+  const PlayerSession session(m_playerSession);
+  if (!session || !session->LiveStream() || !session->LiveStream()->SeekTime(time, backwards, startpts))
+    return false;
+
+  if (session->Demux())
+    session->Demux()->Flush();
+  return true;
+}
+
+bool IsRealTimeStream(void)
+{
+  PVRDEMO_STATS_SCOPE();
+  const PlayerSession session(m_playerSession);
+  if (!session)
+    return true;
+  return session->LiveStream() ? session->LiveStream()->IsRealTime() : false;
+}
+
+PVR_ERROR GetStreamTimes(PVR_STREAM_TIMES *times)
+{
+  PVRDEMO_STATS_SCOPE();
+  if (!times)
+    return PVR_ERROR_INVALID_PARAMETERS;
+
+  const PlayerSession session(m_playerSession);
+  if (!session || !session->LiveStream() || !session->LiveStream()->GetTimes(times))
+    return PVR_ERROR_NOT_IMPLEMENTED;
+
+  return PVR_ERROR_NO_ERROR;
+}
+
+PVR_ERROR GetStreamProperties(PVR_STREAM_PROPERTIES* props)
+{
+  PVRDEMO_STATS_SCOPE();
+  if (!props)
+    return PVR_ERROR_INVALID_PARAMETERS;
+
+  const PlayerSession session(m_playerSession);
+  if (!session || !session->Demux() || !session->Demux()->GetStreamProperties(props))
+    return PVR_ERROR_NOT_IMPLEMENTED;
+
+  return PVR_ERROR_NO_ERROR;
+}
+
+DemuxPacket* DemuxRead(void)
+{
+  PVRDEMO_STATS_SCOPE();
+  const PlayerSession session(m_playerSession);
+  if (!session || !session->Demux())
+    return NULL;
+
+  DemuxPacket* pPacket = session->Demux()->Read();
+  if (pPacket && pPacket->iSize > 0)
+    PVRDEMO_STATS_COUNT(PVRDEMO_COUNTER_BYTES, pPacket->iSize);
+  return pPacket;
+}
+
+void DemuxReset(void)
+{
+  PVRDEMO_STATS_SCOPE();
+  const PlayerSession session(m_playerSession);
+  if (session && session->Demux())
+    session->Demux()->Reset();
+}
+
+void DemuxFlush(void)
+{
+  PVRDEMO_STATS_SCOPE();
+  const PlayerSession session(m_playerSession);
+  if (session && session->Demux())
+    session->Demux()->Flush();
+}
+
+void DemuxAbort(void)
+{
+  PVRDEMO_STATS_SCOPE();
+  const PlayerSession session(m_playerSession);
+  if (session && session->Demux())
+    session->Demux()->Abort();
+}
+
+bool OpenRecordedStream(const PVR_RECORDING &recording)
+{
+  PVRDEMO_STATS_SCOPE();
+  ClosePlayerSession();
+
+  if (!m_data || !m_sessions)
+    return false;
+
+  std::shared_ptr<PVRDemoSession> session = m_sessions->OpenRecording(m_data->GetRecordingURL(recording));
+  if (!session)
+    return false;
+
+  if (g_bAddonDemuxing)
+    session->EnableDemuxing();
+
+  m_playerSession.Store(session);
+  return true;
+}
+
+void CloseRecordedStream(void)
+{
+  PVRDEMO_STATS_SCOPE();
+  ClosePlayerSession();
+}
+
+int ReadRecordedStream(unsigned char *pBuffer, unsigned int iBufferSize)
+{
+  PVRDEMO_STATS_SCOPE();
+  return ReadPlayerSession(pBuffer, iBufferSize);
+}
+
+long long SeekRecordedStream(long long iPosition, int iWhence /* = SEEK_SET */)
+{
+  PVRDEMO_STATS_SCOPE();
+  return SeekPlayerSession(iPosition, iWhence);
+}
+
+long long LengthRecordedStream(void)
+{
+  PVRDEMO_STATS_SCOPE();
+  return LengthPlayerSession();
+}
+
+PVR_ERROR GetStreamReadChunkSize(int* chunksize)
+{
+  PVRDEMO_STATS_SCOPE();
+  if (!chunksize)
+    return PVR_ERROR_INVALID_PARAMETERS;
+
+  *chunksize = PVRDemoLiveStream::CHUNK_SIZE;
+  return PVR_ERROR_NO_ERROR;
+}
+
 PVR_ERROR CallMenuHook(const PVR_MENUHOOK& menuhook, const PVR_MENUHOOK_DATA&)
 {
+  PVRDEMO_STATS_SCOPE();
   int iMsg;
   switch (menuhook.iHookId)
   {
@@ -351,6 +1013,15 @@ PVR_ERROR CallMenuHook(const PVR_MENUHOOK& menuhook, const PVR_MENUHOOK_DATA&)
     case 3:
       iMsg = 30012;
       break;
+    case 4:
+      iMsg = ReloadData() ? 30013 : 30014;
+      break;
+#ifdef PVRDEMO_ENABLE_STATS
+    case 5:
+      PVRDemoStats::LogSummary();
+      iMsg = 30015;
+      break;
+#endif
     default:
       return PVR_ERROR_INVALID_PARAMETERS;
   }
@@ -361,52 +1032,44 @@ PVR_ERROR CallMenuHook(const PVR_MENUHOOK& menuhook, const PVR_MENUHOOK_DATA&)
   return PVR_ERROR_NO_ERROR;
 }
 
+PVR_ERROR DeleteRecording(const PVR_RECORDING &recording)
+{
+  PVRDEMO_STATS_SCOPE();
+  return m_data ? m_data->DeleteRecording(recording) : PVR_ERROR_SERVER_ERROR;
+}
+
+PVR_ERROR UndeleteRecording(const PVR_RECORDING& recording)
+{
+  PVRDEMO_STATS_SCOPE();
+  return m_data ? m_data->UndeleteRecording(recording) : PVR_ERROR_SERVER_ERROR;
+}
+
+PVR_ERROR DeleteAllRecordingsFromTrash()
+{
+  PVRDEMO_STATS_SCOPE();
+  return m_data ? m_data->DeleteAllRecordingsFromTrash() : PVR_ERROR_SERVER_ERROR;
+}
+
 /** UNUSED API FUNCTIONS */
 PVR_ERROR OpenDialogChannelScan(void) { return PVR_ERROR_NOT_IMPLEMENTED; }
 PVR_ERROR DeleteChannel(const PVR_CHANNEL &channel) { return PVR_ERROR_NOT_IMPLEMENTED; }
 PVR_ERROR RenameChannel(const PVR_CHANNEL &channel) { return PVR_ERROR_NOT_IMPLEMENTED; }
 PVR_ERROR OpenDialogChannelSettings(const PVR_CHANNEL &channel) { return PVR_ERROR_NOT_IMPLEMENTED; }
 PVR_ERROR OpenDialogChannelAdd(const PVR_CHANNEL &channel) { return PVR_ERROR_NOT_IMPLEMENTED; }
-bool OpenRecordedStream(const PVR_RECORDING &recording) { return false; }
-void CloseRecordedStream(void) {}
-int ReadRecordedStream(unsigned char *pBuffer, unsigned int iBufferSize) { return 0; }
-long long SeekRecordedStream(long long iPosition, int iWhence /* = SEEK_SET */) { return 0; }
-long long LengthRecordedStream(void) { return 0; }
-void DemuxReset(void) {}
-void DemuxFlush(void) {}
-bool OpenLiveStream(const PVR_CHANNEL&) { return false; }
-void CloseLiveStream(void) {}
-int ReadLiveStream(unsigned char *pBuffer, unsigned int iBufferSize) { return 0; }
-long long SeekLiveStream(long long iPosition, int iWhence /* = SEEK_SET */) { return -1; }
-long long LengthLiveStream(void) { return -1; }
-PVR_ERROR DeleteRecording(const PVR_RECORDING &recording) { return PVR_ERROR_NOT_IMPLEMENTED; }
 PVR_ERROR RenameRecording(const PVR_RECORDING &recording) { return PVR_ERROR_NOT_IMPLEMENTED; }
 PVR_ERROR SetRecordingPlayCount(const PVR_RECORDING &recording, int count) { return PVR_ERROR_NOT_IMPLEMENTED; }
 PVR_ERROR SetRecordingLastPlayedPosition(const PVR_RECORDING &recording, int lastplayedposition) { return PVR_ERROR_NOT_IMPLEMENTED; }
 int GetRecordingLastPlayedPosition(const PVR_RECORDING &recording) { return -1; }
 PVR_ERROR GetRecordingEdl(const PVR_RECORDING&, PVR_EDL_ENTRY[], int*) { return PVR_ERROR_NOT_IMPLEMENTED; };
-PVR_ERROR GetRecordingSize(const PVR_RECORDING* recording, int64_t* sizeInBytes) { return PVR_ERROR_NOT_IMPLEMENTED; }
 PVR_ERROR AddTimer(const PVR_TIMER &timer) { return PVR_ERROR_NOT_IMPLEMENTED; }
 PVR_ERROR DeleteTimer(const PVR_TIMER &timer, bool bForceDelete) { return PVR_ERROR_NOT_IMPLEMENTED; }
 PVR_ERROR UpdateTimer(const PVR_TIMER &timer) { return PVR_ERROR_NOT_IMPLEMENTED; }
-void DemuxAbort(void) {}
-DemuxPacket* DemuxRead(void) { return NULL; }
 void FillBuffer(bool mode) {}
-void PauseStream(bool bPaused) {}
-bool CanPauseStream(void) { return false; }
-bool CanSeekStream(void) { return false; }
-bool SeekTime(double,bool,double*) { return false; }
 void SetSpeed(int) {};
-bool IsRealTimeStream(void) { return true; }
-PVR_ERROR UndeleteRecording(const PVR_RECORDING& recording) { return PVR_ERROR_NOT_IMPLEMENTED; }
-PVR_ERROR DeleteAllRecordingsFromTrash() { return PVR_ERROR_NOT_IMPLEMENTED; }
 PVR_ERROR SetEPGTimeFrame(int) { return PVR_ERROR_NOT_IMPLEMENTED; }
 PVR_ERROR GetDescrambleInfo(PVR_DESCRAMBLE_INFO*) { return PVR_ERROR_NOT_IMPLEMENTED; }
 PVR_ERROR SetRecordingLifetime(const PVR_RECORDING*) { return PVR_ERROR_NOT_IMPLEMENTED; }
-PVR_ERROR GetStreamProperties(PVR_STREAM_PROPERTIES*) { return PVR_ERROR_NOT_IMPLEMENTED; }
-PVR_ERROR GetStreamTimes(PVR_STREAM_TIMES*) { return PVR_ERROR_NOT_IMPLEMENTED; }
 PVR_ERROR IsEPGTagRecordable(const EPG_TAG*, bool*) { return PVR_ERROR_NOT_IMPLEMENTED; }
 PVR_ERROR GetEPGTagEdl(const EPG_TAG* epgTag, PVR_EDL_ENTRY edl[], int *size) { return PVR_ERROR_NOT_IMPLEMENTED; }
-PVR_ERROR GetStreamReadChunkSize(int* chunksize) { return PVR_ERROR_NOT_IMPLEMENTED; }
   
 } // extern "C"
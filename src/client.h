@@ -10,9 +10,54 @@
 
 #include "kodi/libXBMC_addon.h"
 #include "kodi/libXBMC_pvr.h"
+#include "p8-platform/threads/mutex.h"
+#include "PVRDemoLog.h"
+
+#define DEFAULT_LIVE_BUFFER_SIZE       4    // MiB
+#define DEFAULT_TIMESHIFT_ENABLED      false
+#define DEFAULT_TIMESHIFT_MAX_SIZE     1024 // MiB
+#define DEFAULT_TIMESHIFT_MAX_DURATION 60   // minutes
+#define DEFAULT_ADDON_DEMUXING         false
+#define DEFAULT_IO_THREADS             0    // 0 = one per core, at most 4
+#define DEFAULT_SESSION_MEMORY         64   // MiB shared by all stream sessions
+#define DEFAULT_LOG_LEVEL              1    // index into the loglevel setting, 1 = info
+#define DEFAULT_XMLTV_FILE             ""   // no XMLTV guide, demo schedule only
+#define DEFAULT_COLD_TEXT              1    // plots compressed in memory, see PVRDemoTextStore
+#define DEFAULT_COLD_TEXT_CACHE        4    // MiB of decompressed plots
+#define DEFAULT_ICON_SIZE              128  // pixels, longest side of icon thumbnails, 0 = icons as they are
+#define DEFAULT_BACKEND_ADDRESS        ""   // no backend, the data file is read by the add-on
+#define DEFAULT_BACKEND_CONNECTIONS    4
+#define DEFAULT_BACKEND_EPG_CHANNELS   32   // channels to a guide request
+#define DEFAULT_BACKEND_EPG_DEPTH      4    // guide requests to a round trip
+#define DEFAULT_RECORDING_DIRECTORY    ""   // recordings/ in the add-on's profile
 
 extern bool                          m_bCreated;
 extern std::string                   g_strUserPath;
 extern std::string                   g_strClientPath;
+extern int                           g_iLiveBufferSize;
+extern bool                          g_bTimeshiftEnabled;
+extern int                           g_iTimeshiftMaxSize;
+extern int                           g_iTimeshiftMaxDuration;
+extern bool                          g_bAddonDemuxing;
+extern int                           g_iIOThreads;
+extern int                           g_iSessionMemory;
+extern int                           g_iLogLevel;
+extern std::string                   g_strXmltvFile;
+extern int                           g_iColdText;
+extern int                           g_iColdTextCache;
+extern int                           g_iIconSize;
+extern std::string                   g_strBackendAddress;
+extern int                           g_iBackendConnections;
+extern int                           g_iBackendEpgChannels;
+extern int                           g_iBackendEpgDepth;
+extern std::string                   g_strRecordingDirectory;
+extern P8PLATFORM::CMutex            g_settingsMutex;  // held to replace or copy a string setting
 extern ADDON::CHelper_libXBMC_addon *XBMC;
 extern CHelper_libXBMC_pvr          *PVR;
+
+/* a copy of a string setting; ADDON_SetSetting() may replace it on Kodi's settings thread meanwhile */
+inline std::string StringSetting(const std::string& strSetting)
+{
+  P8PLATFORM::CLockObject lock(g_settingsMutex);
+  return strSetting;
+}
@@ -0,0 +1,607 @@
+/*
+ *  Copyright (C) 2011-2020 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2011 Pulse-Eight (http://www.pulse-eight.com/)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+/*
+ * Stand-in for a PVR backend. Loads the demo data the way the add-on does
+ * and serves it over the protocol of src/PVRDemoBackendProtocol.h, on TCP
+ * or a UNIX socket, so the add-on's backend mode can be measured without
+ * any outside service.
+ *
+ *   pvrdemo-backend --client-path <dir with PVRDemoAddonSettings.xml>
+ *                   [--listen host:port|unix:/path] [--user-path <dir>]
+ *                   [--xmltv <file>] [--latency ms] [--jitter ms]
+ *                   [--bandwidth MiB/s] [--verbose]
+ *
+ * Every response is held back by the latency plus up to the jitter from
+ * the moment its request came in, and by the time its bytes take at the
+ * bandwidth, as a network in between would. Requests that arrive together
+ * are delayed together, so pipelining pays off as it does on a real link.
+ */
+
+#include "PVRDemoBackendProtocol.h"
+#include "PVRDemoData.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace ADDON;
+
+/* what PVRDemoData.cpp links against besides the data file */
+std::string g_strUserPath = "/tmp/pvrdemo-backend/";
+std::string g_strClientPath;
+std::string g_strXmltvFile;
+int         g_iColdText = DEFAULT_COLD_TEXT;
+int         g_iIconSize = DEFAULT_ICON_SIZE;
+std::string g_strBackendAddress;
+int         g_iBackendConnections = DEFAULT_BACKEND_CONNECTIONS;
+std::string g_strRecordingDirectory;
+P8PLATFORM::CMutex g_settingsMutex;
+CHelper_libXBMC_addon *XBMC = NULL;
+CHelper_libXBMC_pvr   *PVR  = NULL;
+
+namespace
+{
+
+typedef std::chrono::steady_clock Clock;
+
+struct Options
+{
+  PVRDemoBackendProtocol::Address address;
+  double fLatencyMs = 0.0;
+  double fJitterMs = 0.0;
+  double fBandwidth = 0.0;  // bytes per second, 0 for no limit
+  bool   bVerbose = false;
+};
+
+/*
+ * Host side of the add-on callbacks. The data layer hands entries to Kodi
+ * through Transfer*(); here they are written into the response of the
+ * request that asked for them, which the handle points to.
+ */
+struct Sink
+{
+  PVRDemoData*                   data;
+  PVRDemoBackendMessage*         message;
+  uint32_t                       iEntries = 0;
+  std::vector<PVR_CHANNEL_GROUP> groups;
+  std::vector<int>               memberUids;
+};
+
+Sink& SinkOf(const ADDON_HANDLE handle)
+{
+  return *static_cast<Sink*>(handle->dataAddress);
+}
+
+void CbLog(void*, const addon_log_t level, const char* strMessage)
+{
+  static const char* const levels[] = { "DEBUG", "INFO", "NOTICE", "ERROR" };
+  fprintf(stderr, "%s: %s\n", (int)level >= 0 && (int)level < 4 ? levels[level] : "?", strMessage);
+}
+
+void CbQueueNotification(void*, const queue_msg_t, const char*) {}
+bool CbGetSetting(void*, const char*, void*) { return false; }
+char* CbGetLocalizedString(const void*, long) { return strdup(""); }
+void CbFreeString(const void*, char* str) { free(str); }
+
+void CbTransferChannelEntry(void*, const ADDON_HANDLE handle, const PVR_CHANNEL* channel)
+{
+  Sink& sink = SinkOf(handle);
+  PVRDemoChannel myChannel;
+  sink.data->GetChannel(*channel, myChannel);
+  PVRDemoBackendProtocol::PutChannel(*sink.message, *channel, myChannel.strStreamURL);
+  ++sink.iEntries;
+}
+
+void CbTransferChannelGroup(void*, const ADDON_HANDLE handle, const PVR_CHANNEL_GROUP* group)
+{
+  SinkOf(handle).groups.push_back(*group);
+}
+
+void CbTransferChannelGroupMember(void*, const ADDON_HANDLE handle, const PVR_CHANNEL_GROUP_MEMBER* member)
+{
+  SinkOf(handle).memberUids.push_back((int)member->iChannelUniqueId);
+}
+
+void CbTransferRecordingEntry(void*, const ADDON_HANDLE handle, const PVR_RECORDING* recording)
+{
+  Sink& sink = SinkOf(handle);
+  PVRDemoBackendProtocol::PutRecording(*sink.message, *recording, sink.data->GetRecordingURL(*recording));
+  ++sink.iEntries;
+}
+
+void CbTransferTimerEntry(void*, const ADDON_HANDLE handle, const PVR_TIMER* timer)
+{
+  Sink& sink = SinkOf(handle);
+  PVRDemoBackendProtocol::PutTimer(*sink.message, *timer);
+  ++sink.iEntries;
+}
+
+void CbTransferEpgEntry(void*, const ADDON_HANDLE handle, const EPG_TAG* tag)
+{
+  Sink& sink = SinkOf(handle);
+  PVRDemoBackendProtocol::PutEpgTag(*sink.message, *tag);
+  ++sink.iEntries;
+}
+
+void CbTrigger(void*) {}
+void CbTriggerEpgUpdate(void*, unsigned int) {}
+
+CB_AddOnLib       g_addonCallbacks;
+AddonInstance_PVR g_pvrCallbacks;
+AddonCB           g_cb;
+
+void* RegisterAddOnLib(void*) { return &g_addonCallbacks; }
+void* RegisterPVRLib(void*) { return &g_pvrCallbacks; }
+void UnRegister(void*, void*) {}
+
+bool InitHelpers(void)
+{
+  memset(&g_addonCallbacks, 0, sizeof(g_addonCallbacks));
+  g_addonCallbacks.Log                = CbLog;
+  g_addonCallbacks.QueueNotification  = CbQueueNotification;
+  g_addonCallbacks.GetSetting         = CbGetSetting;
+  g_addonCallbacks.GetLocalizedString = CbGetLocalizedString;
+  g_addonCallbacks.FreeString         = CbFreeString;
+
+  memset(&g_pvrCallbacks, 0, sizeof(g_pvrCallbacks));
+  AddonToKodiFuncTable_PVR& toKodi = g_pvrCallbacks.toKodi;
+  toKodi.TransferEpgEntry           = CbTransferEpgEntry;
+  toKodi.TransferChannelEntry       = CbTransferChannelEntry;
+  toKodi.TransferTimerEntry         = CbTransferTimerEntry;
+  toKodi.TransferRecordingEntry     = CbTransferRecordingEntry;
+  toKodi.TransferChannelGroup       = CbTransferChannelGroup;
+  toKodi.TransferChannelGroupMember = CbTransferChannelGroupMember;
+  toKodi.TriggerChannelUpdate       = CbTrigger;
+  toKodi.TriggerChannelGroupsUpdate = CbTrigger;
+  toKodi.TriggerEpgUpdate           = CbTriggerEpgUpdate;
+  toKodi.TriggerRecordingUpdate     = CbTrigger;
+  toKodi.TriggerTimerUpdate         = CbTrigger;
+
+  memset(&g_cb, 0, sizeof(g_cb));
+  g_cb.AddOnLib_RegisterMe   = RegisterAddOnLib;
+  g_cb.AddOnLib_UnRegisterMe = UnRegister;
+  g_cb.PVRLib_RegisterMe     = RegisterPVRLib;
+  g_cb.PVRLib_UnRegisterMe   = UnRegister;
+
+  XBMC = new CHelper_libXBMC_addon;
+  PVR = new CHelper_libXBMC_pvr;
+  return XBMC->RegisterMe(&g_cb) && PVR->RegisterMe(&g_cb);
+}
+
+/* the response to one request, a status of PVRDemoBackendProtocol */
+uint16_t Serve(PVRDemoData& data, uint16_t iOp, PVRDemoBackendMessage& request, PVRDemoBackendMessage& response)
+{
+  Sink sink;
+  sink.data = &data;
+  sink.message = &response;
+  ADDON_HANDLE_STRUCT handle = {};
+  handle.dataAddress = &sink;
+
+  switch (iOp)
+  {
+    case PVRDemoBackendProtocol::OP_HELLO:
+    {
+      uint32_t iVersion = 0;
+      if (!request.GetU32(iVersion))
+        return PVRDemoBackendProtocol::STATUS_BAD_REQUEST;
+      response.PutU32(PVRDemoBackendProtocol::VERSION);
+      response.PutString("pvrdemo-backend");
+      response.PutString("0.1");
+      break;
+    }
+
+    case PVRDemoBackendProtocol::OP_CHANNELS:
+    {
+      const size_t iCount = response.ReserveU32();
+      data.GetChannels(&handle, false);
+      data.GetChannels(&handle, true);
+      response.SetU32(iCount, sink.iEntries);
+      break;
+    }
+
+    case PVRDemoBackendProtocol::OP_GROUPS:
+    {
+      data.GetChannelGroups(&handle, false);
+      data.GetChannelGroups(&handle, true);
+      response.PutU32((uint32_t)sink.groups.size());
+      for (const auto& group : sink.groups)
+      {
+        sink.memberUids.clear();
+        data.GetChannelGroupMembers(&handle, group);
+        PVRDemoBackendProtocol::PutGroup(response, group, sink.memberUids);
+      }
+      break;
+    }
+
+    case PVRDemoBackendProtocol::OP_RECORDINGS:
+    {
+      uint8_t bDeleted = 0;
+      if (!request.GetU8(bDeleted))
+        return PVRDemoBackendProtocol::STATUS_BAD_REQUEST;
+      const size_t iCount = response.ReserveU32();
+      data.GetRecordings(&handle, bDeleted != 0);
+      response.SetU32(iCount, sink.iEntries);
+      break;
+    }
+
+    case PVRDemoBackendProtocol::OP_TIMERS:
+    {
+      const size_t iCount = response.ReserveU32();
+      data.GetTimers(&handle);
+      response.SetU32(iCount, sink.iEntries);
+      break;
+    }
+
+    case PVRDemoBackendProtocol::OP_EPG:
+    {
+      time_t iStart, iEnd;
+      uint32_t iChannels = 0;
+      if (!request.GetTime(iStart) || !request.GetTime(iEnd) || !request.GetU32(iChannels) ||
+          iChannels > request.Data().size() / 4)
+        return PVRDemoBackendProtocol::STATUS_BAD_REQUEST;
+
+      response.PutU32(iChannels);
+      for (uint32_t i = 0; i < iChannels; ++i)
+      {
+        int iChannelUid = 0;
+        if (!request.GetI32(iChannelUid))
+          return PVRDemoBackendProtocol::STATUS_BAD_REQUEST;
+        response.PutI32(iChannelUid);
+        const size_t iCount = response.ReserveU32();
+        sink.iEntries = 0;
+        data.GetEPGForChannel(&handle, iChannelUid, iStart, iEnd);
+        response.SetU32(iCount, sink.iEntries);
+      }
+      break;
+    }
+
+    case PVRDemoBackendProtocol::OP_DELETE_RECORDING:
+    case PVRDemoBackendProtocol::OP_UNDELETE_RECORDING:
+    {
+      std::string strRecordingId;
+      if (!request.GetString(strRecordingId))
+        return PVRDemoBackendProtocol::STATUS_BAD_REQUEST;
+      PVR_RECORDING recording = {};
+      strncpy(recording.strRecordingId, strRecordingId.c_str(), sizeof(recording.strRecordingId) - 1);
+      const PVR_ERROR error = iOp == PVRDemoBackendProtocol::OP_DELETE_RECORDING ? data.DeleteRecording(recording)
+                                                                                  : data.UndeleteRecording(recording);
+      if (error != PVR_ERROR_NO_ERROR)
+        return PVRDemoBackendProtocol::STATUS_FAILED;
+      break;
+    }
+
+    case PVRDemoBackendProtocol::OP_DELETE_TRASH:
+      if (data.DeleteAllRecordingsFromTrash() != PVR_ERROR_NO_ERROR)
+        return PVRDemoBackendProtocol::STATUS_FAILED;
+      break;
+
+    default:
+      return PVRDemoBackendProtocol::STATUS_BAD_REQUEST;
+  }
+
+  return request.AtEnd() ? PVRDemoBackendProtocol::STATUS_OK : PVRDemoBackendProtocol::STATUS_BAD_REQUEST;
+}
+
+bool ReadAll(int fd, uint8_t* pData, size_t iSize)
+{
+  while (iSize > 0)
+  {
+    const ssize_t iRead = recv(fd, pData, iSize, 0);
+    if (iRead < 0 && errno == EINTR)
+      continue;
+    if (iRead <= 0)
+      return false;
+    pData += iRead;
+    iSize -= (size_t)iRead;
+  }
+  return true;
+}
+
+bool WriteAll(int fd, const uint8_t* pData, size_t iSize)
+{
+  while (iSize > 0)
+  {
+    const ssize_t iSent = send(fd, pData, iSize, 0);
+    if (iSent < 0 && errno == EINTR)
+      continue;
+    if (iSent <= 0)
+      return false;
+    pData += iSent;
+    iSize -= (size_t)iSent;
+  }
+  return true;
+}
+
+/*
+ * One client connection. Requests are read and answered in order on one
+ * thread; the answers wait in a queue until their delay is over and are
+ * written by a second one, so the delays of pipelined requests overlap.
+ */
+class Connection
+{
+public:
+  Connection(int fd, int iId, PVRDemoData& data, const Options& options) :
+    m_fd(fd), m_iId(iId), m_data(data), m_options(options), m_rng((unsigned int)iId) {}
+
+  void Run(void)
+  {
+    std::thread writer(&Connection::Write, this);
+    Clock::time_point lastDue = Clock::now();
+
+    for (;;)
+    {
+      uint8_t headerData[PVRDemoBackendProtocol::HEADER_SIZE];
+      PVRDemoBackendProtocol::Header header;
+      if (!ReadAll(m_fd, headerData, sizeof(headerData)))
+        break;
+      const Clock::time_point arrival = Clock::now();
+      PVRDemoBackendProtocol::GetHeader(headerData, header);
+      if (header.iLength > PVRDemoBackendProtocol::MAX_PAYLOAD)
+      {
+        fprintf(stderr, "connection %d: request of %u bytes, closing\n", m_iId, header.iLength);
+        break;
+      }
+
+      PVRDemoBackendMessage request;
+      request.Data().resize(header.iLength);
+      if (header.iLength > 0 && !ReadAll(m_fd, request.Data().data(), header.iLength))
+        break;
+      m_iBytesIn += sizeof(headerData) + header.iLength;
+
+      /* the header goes in front once the payload's size is known */
+      PVRDemoBackendMessage response;
+      response.Data().resize(PVRDemoBackendProtocol::HEADER_SIZE);
+      PVRDemoBackendMessage payload;
+      header.iStatus = Serve(m_data, header.iOp, request, payload);
+      header.iLength = (uint32_t)payload.Data().size();
+      PVRDemoBackendProtocol::PutHeader(header, response.Data().data());
+      response.Data().insert(response.Data().end(), payload.Data().begin(), payload.Data().end());
+
+      const double fServeMs = std::chrono::duration<double, std::milli>(Clock::now() - arrival).count();
+      if (m_options.bVerbose)
+        fprintf(stderr, "connection %d: %s request %u, %u bytes out, status %u, %.2f ms\n", m_iId,
+                PVRDemoBackendProtocol::OpName(header.iOp), header.iRequestId, header.iLength, header.iStatus, fServeMs);
+
+      Clock::time_point due = std::max(arrival + Delay(), lastDue);
+      if (m_options.fBandwidth > 0)
+        due += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(response.Data().size() / m_options.fBandwidth));
+      lastDue = due;
+
+      ++m_iRequests;
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_queue.push_back({ due, std::move(response.Data()) });
+      m_queued.notify_one();
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_bClosed = true;
+      m_queued.notify_one();
+    }
+    writer.join();
+    close(m_fd);
+
+    fprintf(stderr, "connection %d closed: %llu requests, %llu bytes in, %llu bytes out\n", m_iId,
+            (unsigned long long)m_iRequests, (unsigned long long)m_iBytesIn, (unsigned long long)m_iBytesOut);
+  }
+
+private:
+  struct Pending
+  {
+    Clock::time_point    due;
+    std::vector<uint8_t> data;
+  };
+
+  Clock::duration Delay(void)
+  {
+    double fMs = m_options.fLatencyMs;
+    if (m_options.fJitterMs > 0)
+      fMs += std::uniform_real_distribution<double>(0.0, m_options.fJitterMs)(m_rng);
+    return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(fMs));
+  }
+
+  void Write(void)
+  {
+    for (;;)
+    {
+      Pending pending;
+      {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_queued.wait(lock, [this] { return m_bClosed || !m_queue.empty(); });
+        if (m_queue.empty())
+          return;
+        pending = std::move(m_queue.front());
+        m_queue.pop_front();
+      }
+
+      std::this_thread::sleep_until(pending.due);
+      if (!WriteAll(m_fd, pending.data.data(), pending.data.size()))
+      {
+        /* wakes the reader, which closes the connection */
+        shutdown(m_fd, SHUT_RDWR);
+        return;
+      }
+      m_iBytesOut += pending.data.size();
+    }
+  }
+
+  const int               m_fd;
+  const int               m_iId;
+  PVRDemoData&            m_data;
+  const Options&          m_options;
+  std::mt19937            m_rng;
+  uint64_t                m_iRequests = 0;
+  uint64_t                m_iBytesIn = 0;
+  uint64_t                m_iBytesOut = 0;
+
+  std::mutex              m_mutex;   // guards the queue
+  std::condition_variable m_queued;
+  std::deque<Pending>     m_queue;
+  bool                    m_bClosed = false;
+};
+
+int Listen(const PVRDemoBackendProtocol::Address& address)
+{
+  if (address.bUnix)
+  {
+    struct sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if (address.strPath.size() >= sizeof(addr.sun_path))
+      return -1;
+    strncpy(addr.sun_path, address.strPath.c_str(), sizeof(addr.sun_path) - 1);
+
+    /* a socket file left behind by an earlier run */
+    unlink(address.strPath.c_str());
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || bind(fd, (const struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 16) != 0)
+    {
+      if (fd >= 0)
+        close(fd);
+      return -1;
+    }
+    return fd;
+  }
+
+  struct addrinfo hints = {};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_PASSIVE;
+  struct addrinfo* pResult = NULL;
+  if (getaddrinfo(address.strHost.c_str(), std::to_string(address.iPort).c_str(), &hints, &pResult) != 0)
+    return -1;
+
+  int fd = -1;
+  for (struct addrinfo* pAddr = pResult; pAddr && fd < 0; pAddr = pAddr->ai_next)
+  {
+    fd = socket(pAddr->ai_family, pAddr->ai_socktype, pAddr->ai_protocol);
+    if (fd < 0)
+      continue;
+    int iReuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &iReuse, sizeof(iReuse));
+    if (bind(fd, pAddr->ai_addr, pAddr->ai_addrlen) != 0 || listen(fd, 16) != 0)
+    {
+      close(fd);
+      fd = -1;
+    }
+  }
+  freeaddrinfo(pResult);
+  return fd;
+}
+
+void Usage(const char* strName)
+{
+  fprintf(stderr, "usage: %s --client-path <dir> [--listen host:port|unix:/path] [--user-path <dir>]\n"
+                  "          [--xmltv <file>] [--latency ms] [--jitter ms] [--bandwidth MiB/s] [--verbose]\n", strName);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+  Options options;
+  std::string strListen = "127.0.0.1";
+
+  for (int i = 1; i < argc; ++i)
+  {
+    const std::string strArg = argv[i];
+    const bool bHasValue = i + 1 < argc;
+    if (strArg == "--client-path" && bHasValue)
+      g_strClientPath = argv[++i];
+    else if (strArg == "--user-path" && bHasValue)
+      g_strUserPath = argv[++i];
+    else if (strArg == "--listen" && bHasValue)
+      strListen = argv[++i];
+    else if (strArg == "--xmltv" && bHasValue)
+      g_strXmltvFile = argv[++i];
+    else if (strArg == "--latency" && bHasValue)
+      options.fLatencyMs = std::max(0.0, atof(argv[++i]));
+    else if (strArg == "--jitter" && bHasValue)
+      options.fJitterMs = std::max(0.0, atof(argv[++i]));
+    else if (strArg == "--bandwidth" && bHasValue)
+      options.fBandwidth = std::max(0.0, atof(argv[++i])) * 1024 * 1024;
+    else if (strArg == "--verbose")
+      options.bVerbose = true;
+    else
+    {
+      Usage(argv[0]);
+      return 2;
+    }
+  }
+
+  if (g_strClientPath.empty() || !PVRDemoBackendProtocol::ParseAddress(strListen, options.address))
+  {
+    Usage(argv[0]);
+    return 2;
+  }
+  if (g_strClientPath[g_strClientPath.size() - 1] != '/')
+    g_strClientPath += '/';
+  if (g_strUserPath[g_strUserPath.size() - 1] != '/')
+    g_strUserPath += '/';
+
+  signal(SIGPIPE, SIG_IGN);
+  if (!InitHelpers())
+    return 1;
+  PVRDemoLog::SetLevel(options.bVerbose ? LOG_DEBUG : LOG_INFO);
+
+  PVRDemoData data;
+  if (data.Snapshot()->iVersion == 0)
+  {
+    fprintf(stderr, "cannot load the demo data from '%s'\n", data.GetSettingsFile().c_str());
+    return 1;
+  }
+
+  const int fdListen = Listen(options.address);
+  if (fdListen < 0)
+  {
+    fprintf(stderr, "cannot listen on '%s': %s\n", strListen.c_str(), strerror(errno));
+    return 1;
+  }
+  fprintf(stderr, "serving %d channels on '%s', %.1f ms latency, %.1f ms jitter\n", data.GetChannelsAmount(),
+          strListen.c_str(), options.fLatencyMs, options.fJitterMs);
+
+  for (int iId = 1;; ++iId)
+  {
+    const int fd = accept(fdListen, NULL, NULL);
+    if (fd < 0)
+    {
+      if (errno == EINTR || errno == ECONNABORTED)
+        continue;
+      fprintf(stderr, "accept failed: %s\n", strerror(errno));
+      return 1;
+    }
+
+    if (!options.address.bUnix)
+    {
+      int iNoDelay = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &iNoDelay, sizeof(iNoDelay));
+    }
+
+    std::thread([fd, iId, &data, &options] {
+      Connection connection(fd, iId, data, options);
+      connection.Run();
+    }).detach();
+  }
+}
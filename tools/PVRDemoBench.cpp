@@ -0,0 +1,1711 @@
+/*
+ *  Copyright (C) 2011-2020 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2011 Pulse-Eight (http://www.pulse-eight.com/)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+/*
+ * Microbenchmarks for the PVRDemoData load and query paths. Each scale
+ * writes a generated data file from a fixed seed, so runs on different
+ * machines and commits measure the same input.
+ *
+ *   pvrdemo-bench [--scale small|medium|large]... [--seed N] [--min-time ms]
+ *                 [--filter substring] [--threads N] [--json out.json]
+ *
+ * Every case reports ns/op, allocations and bytes allocated per op, the
+ * heap high-water mark during the case and the process peak RSS after it.
+ * The Record cases instead report the disk throughput and the CPU time per
+ * stream of simultaneous recordings of synthetic channels into the workdir.
+ * ConcurrentReads and ConcurrentSessions report how the data read paths
+ * and the stream sessions scale with up to --threads readers, the number
+ * of cores by default.
+ * LiveStream reports the MB/s through the live ring buffer on its own and
+ * through PVRDemoLiveStream from an unpaced synthetic channel and a file.
+ * Demux reports how fast PVRDemoDemux takes a 20 Mbit/s channel apart.
+ * RecordedRead and ScanRecordings report the throughput and the system
+ * calls of reading a recording from a cold cache and of scanning a
+ * directory of recordings, blocking and on both kinds of PVRDemoIOEngine.
+ */
+
+#include "util/XMLUtils.h"
+#include "PVRDemoData.h"
+#include "PVRDemoDemux.h"
+#include "PVRDemoEpgShards.h"
+#include "PVRDemoEpgTracker.h"
+#include "PVRDemoIconCache.h"
+#include "PVRDemoIOEngine.h"
+#include "PVRDemoLiveStream.h"
+#include "PVRDemoPng.h"
+#include "PVRDemoRecorder.h"
+#include "PVRDemoRingBuffer.h"
+#include "PVRDemoSession.h"
+#include "PVRDemoStreamSource.h"
+#include "PVRDemoTextStore.h"
+#include "PVRDemoXmltv.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace ADDON;
+
+/* what PVRDemoData.cpp links against besides the data file */
+std::string g_strUserPath;
+std::string g_strClientPath;
+std::string g_strXmltvFile;
+int         g_iColdText = DEFAULT_COLD_TEXT;
+int         g_iIconSize = DEFAULT_ICON_SIZE;
+std::string g_strBackendAddress;
+int         g_iBackendConnections = DEFAULT_BACKEND_CONNECTIONS;
+std::string g_strRecordingDirectory;
+P8PLATFORM::CMutex g_settingsMutex;
+
+/* and what the stream sessions of the Record cases do */
+int         g_iLiveBufferSize = DEFAULT_LIVE_BUFFER_SIZE;
+int         g_iTimeshiftMaxSize = DEFAULT_TIMESHIFT_MAX_SIZE;
+int         g_iTimeshiftMaxDuration = DEFAULT_TIMESHIFT_MAX_DURATION;
+CHelper_libXBMC_addon *XBMC = NULL;
+CHelper_libXBMC_pvr   *PVR  = NULL;
+
+/* allocation accounting for every operator new in the process */
+namespace
+{
+std::atomic<uint64_t> g_iAllocations(0);
+std::atomic<uint64_t> g_iAllocatedBytes(0);
+std::atomic<int64_t>  g_iLiveBytes(0);
+std::atomic<int64_t>  g_iPeakLiveBytes(0);
+
+void* CountedAlloc(size_t iSize)
+{
+  void* p = malloc(iSize ? iSize : 1);
+  if (!p)
+    throw std::bad_alloc();
+
+  const int64_t iUsable = (int64_t)malloc_usable_size(p);
+  ++g_iAllocations;
+  g_iAllocatedBytes += iSize;
+  const int64_t iLive = g_iLiveBytes += iUsable;
+  int64_t iPeak = g_iPeakLiveBytes;
+  while (iLive > iPeak && !g_iPeakLiveBytes.compare_exchange_weak(iPeak, iLive))
+    ;
+  return p;
+}
+
+void CountedFree(void* p)
+{
+  if (!p)
+    return;
+  g_iLiveBytes -= (int64_t)malloc_usable_size(p);
+  free(p);
+}
+}
+
+void* operator new(size_t iSize) { return CountedAlloc(iSize); }
+void* operator new[](size_t iSize) { return CountedAlloc(iSize); }
+void operator delete(void* p) noexcept { CountedFree(p); }
+void operator delete[](void* p) noexcept { CountedFree(p); }
+void operator delete(void* p, size_t) noexcept { CountedFree(p); }
+void operator delete[](void* p, size_t) noexcept { CountedFree(p); }
+
+#ifndef PVRDEMO_BUILD_BENCHMARKS
+#error "pvrdemo-bench needs PVRDEMO_BUILD_BENCHMARKS defined, for PVRDemoData::BenchmarkAccess"
+#endif
+
+/*!
+ * Reaches the loader and XML scanners, which are not part of the public
+ * interface of PVRDemoData.
+ */
+class PVRDemoData::BenchmarkAccess
+{
+public:
+  static bool LoadDemoData(PVRDemoData& data) { return data.LoadDemoData(); }
+  static bool LoadSnapshot(PVRDemoData& data, const std::string& strFile) { return data.LoadSnapshot(strFile); }
+#ifdef PVRDEMO_STATIC_DATA
+  static bool LoadStaticData(PVRDemoData& data) { return data.LoadStaticData(g_staticDemoData); }
+#endif
+
+  static bool ScanChannel(PVRDemoData& data, const TiXmlNode* pNode, int iId, PVRDemoChannel& channel)
+  {
+    return data.ScanXMLChannelData(pNode, iId, channel);
+  }
+
+  static bool ScanChannelGroup(PVRDemoData& data, const TiXmlNode* pNode, int iId, PVRDemoChannelGroup& group)
+  {
+    return data.ScanXMLChannelGroupData(pNode, iId, group);
+  }
+
+  static bool ScanEpg(PVRDemoData& data, const TiXmlNode* pNode, std::vector<PVRDemoChannel>& channels, PVRDemoTextStore& texts)
+  {
+    return data.ScanXMLEpgData(pNode, channels, texts);
+  }
+
+  static bool ScanRecording(PVRDemoData& data, const TiXmlNode* pNode, int iId, const PVRDemoTimeResolver& times,
+                            PVRDemoTextStore& texts, PVRDemoRecording& recording)
+  {
+    return data.ScanXMLRecordingData(pNode, iId, times, texts, recording);
+  }
+
+  static bool ScanTimer(PVRDemoData& data, const TiXmlNode* pNode, const std::vector<PVRDemoChannel>& channels, const PVRDemoTimeResolver& times, PVRDemoTimer& timer)
+  {
+    return data.ScanXMLTimerData(pNode, channels, times, timer);
+  }
+
+  /* publish a new version that is a copy of the current one, as a writer that changed nothing would */
+  static bool Republish(PVRDemoData& data) { return data.Update([](PVRDemoDataSet&) { return true; }); }
+
+  static void ScanRecordedFiles(PVRDemoData& data, PVRDemoIOEngine& engine, const std::string& strDirectory,
+                                const PVRDemoTimeResolver& times, PVRDemoTextStore& texts, std::vector<PVRDemoRecording>& recordings)
+  {
+    std::vector<PVRDemoSourceFile> sources;
+    data.ScanRecordedFiles(engine, strDirectory, times, texts, recordings, sources);
+  }
+};
+
+namespace
+{
+
+/* host side of the add-on callbacks; transfers are only counted, per thread so concurrent readers do not share a counter */
+thread_local uint64_t g_iTransferred = 0;
+
+/* keeps the resolved times of the ResolveTime case alive */
+volatile uint64_t g_iResolved = 0;
+
+void CbLog(void*, const addon_log_t, const char*) {}
+void CbQueueNotification(void*, const queue_msg_t, const char*) {}
+bool CbGetSetting(void*, const char*, void*) { return false; }
+char* CbGetLocalizedString(const void*, long) { return strdup(""); }
+void CbFreeString(const void*, char* str) { free(str); }
+void CbTransferEpgEntry(void*, const ADDON_HANDLE, const EPG_TAG*) { ++g_iTransferred; }
+void CbTransferChannelEntry(void*, const ADDON_HANDLE, const PVR_CHANNEL*) { ++g_iTransferred; }
+void CbTransferTimerEntry(void*, const ADDON_HANDLE, const PVR_TIMER*) { ++g_iTransferred; }
+void CbTransferRecordingEntry(void*, const ADDON_HANDLE, const PVR_RECORDING*) { ++g_iTransferred; }
+void CbTransferChannelGroup(void*, const ADDON_HANDLE, const PVR_CHANNEL_GROUP*) { ++g_iTransferred; }
+void CbTransferChannelGroupMember(void*, const ADDON_HANDLE, const PVR_CHANNEL_GROUP_MEMBER*) { ++g_iTransferred; }
+void CbTrigger(void*) {}
+void CbTriggerEpgUpdate(void*, unsigned int) {}
+
+DemuxPacket* CbAllocateDemuxPacket(void*, int iDataSize)
+{
+  DemuxPacket* packet = static_cast<DemuxPacket*>(calloc(1, sizeof(DemuxPacket)));
+  if (packet && iDataSize > 0)
+  {
+    packet->pData = static_cast<uint8_t*>(malloc(iDataSize));
+    packet->iSize = iDataSize;
+  }
+  return packet;
+}
+
+void CbFreeDemuxPacket(void*, DemuxPacket* packet)
+{
+  if (packet)
+    free(packet->pData);
+  free(packet);
+}
+
+/* any codec the demuxer asks for is known, so it keeps every stream */
+xbmc_codec_t CbGetCodecByName(void*, const char* strCodec)
+{
+  const std::string strName = strCodec;
+  xbmc_codec_t codec;
+  if (strName == "h264" || strName == "hevc" || strName == "mpeg2video")
+    codec.codec_type = XBMC_CODEC_TYPE_VIDEO;
+  else if (strName == "dvbsub" || strName == "teletext")
+    codec.codec_type = XBMC_CODEC_TYPE_SUBTITLE;
+  else
+    codec.codec_type = XBMC_CODEC_TYPE_AUDIO;
+  codec.codec_id = 1;
+  return codec;
+}
+
+CB_AddOnLib       g_addonCallbacks;
+AddonInstance_PVR g_pvrCallbacks;
+AddonCB           g_cb;
+
+void* RegisterAddOnLib(void*) { return &g_addonCallbacks; }
+void* RegisterPVRLib(void*) { return &g_pvrCallbacks; }
+void UnRegister(void*, void*) {}
+
+bool InitHelpers(void)
+{
+  memset(&g_addonCallbacks, 0, sizeof(g_addonCallbacks));
+  g_addonCallbacks.Log                = CbLog;
+  g_addonCallbacks.QueueNotification  = CbQueueNotification;
+  g_addonCallbacks.GetSetting         = CbGetSetting;
+  g_addonCallbacks.GetLocalizedString = CbGetLocalizedString;
+  g_addonCallbacks.FreeString         = CbFreeString;
+
+  memset(&g_pvrCallbacks, 0, sizeof(g_pvrCallbacks));
+  AddonToKodiFuncTable_PVR& toKodi = g_pvrCallbacks.toKodi;
+  toKodi.TransferEpgEntry           = CbTransferEpgEntry;
+  toKodi.TransferChannelEntry       = CbTransferChannelEntry;
+  toKodi.TransferTimerEntry         = CbTransferTimerEntry;
+  toKodi.TransferRecordingEntry     = CbTransferRecordingEntry;
+  toKodi.TransferChannelGroup       = CbTransferChannelGroup;
+  toKodi.TransferChannelGroupMember = CbTransferChannelGroupMember;
+  toKodi.TriggerChannelUpdate       = CbTrigger;
+  toKodi.TriggerChannelGroupsUpdate = CbTrigger;
+  toKodi.TriggerEpgUpdate           = CbTriggerEpgUpdate;
+  toKodi.TriggerRecordingUpdate     = CbTrigger;
+  toKodi.TriggerTimerUpdate         = CbTrigger;
+  toKodi.AllocateDemuxPacket        = CbAllocateDemuxPacket;
+  toKodi.FreeDemuxPacket            = CbFreeDemuxPacket;
+  toKodi.GetCodecByName             = CbGetCodecByName;
+
+  memset(&g_cb, 0, sizeof(g_cb));
+  g_cb.AddOnLib_RegisterMe   = RegisterAddOnLib;
+  g_cb.AddOnLib_UnRegisterMe = UnRegister;
+  g_cb.PVRLib_RegisterMe     = RegisterPVRLib;
+  g_cb.PVRLib_UnRegisterMe   = UnRegister;
+
+  XBMC = new CHelper_libXBMC_addon;
+  PVR = new CHelper_libXBMC_pvr;
+  return XBMC->RegisterMe(&g_cb) && PVR->RegisterMe(&g_cb);
+}
+
+struct Scale
+{
+  const char* strName;
+  int         iChannels;
+  int         iEpgPerChannel;
+  int         iGroups;
+  int         iRecordings;
+  int         iTimers;
+};
+
+const Scale SCALES[] =
+{
+  { "small",    20,  24,   4,    20,   10 },
+  { "medium",  200,  48,  20,   200,   50 },
+  { "large",  2000,  96, 100,  2000,  200 },
+};
+
+const char* const LOREM =
+  "Lorem ipsum dolor sit amet, consectetur adipiscing elit. Nam cursus consectetur ipsum, eu tincidunt dui "
+  "aliquam ac. Sed scelerisque, augue eu lacinia ultrices, libero ante ullamcorper augue, vel malesuada justo "
+  "risus ac nulla. Quisque ac libero libero. Sed tincidunt, orci eu condimentum laoreet, felis odio mattis est.";
+
+/* the <channel> elements of the scale */
+void WriteChannels(FILE* out, const Scale& scale)
+{
+  const int iTvChannels = scale.iChannels - scale.iChannels / 5;
+  for (int i = 1; i <= scale.iChannels; ++i)
+  {
+    const bool bRadio = i > iTvChannels;
+    fprintf(out, "    <channel>\n      <name>Bench %s Channel %d</name>\n      <radio>%d</radio>\n"
+                 "      <number>%d</number>\n      <encryption>0</encryption>\n      <icon>data/%02d.png</icon>\n"
+                 "      <stream>http://example.invalid/stream/%d.ts</stream>\n    </channel>\n",
+            bRadio ? "Radio" : "TV", i, bRadio ? 1 : 0, i, i % 100, i);
+  }
+}
+
+/*!
+ * The 100 channel icons the data files name, as 256x256 PNGs like those in
+ * pvr.demo/data. Only ICON_DESIGNS of them differ, the way a channel list
+ * repeats a network's logo.
+ */
+const int ICON_DESIGNS = 25;
+
+bool WriteIcons(unsigned int iSeed, const std::string& strDirectory)
+{
+  mkdir((strDirectory + "data").c_str(), 0755);
+  std::vector<std::vector<uint8_t>> designs(ICON_DESIGNS);
+  std::mt19937 rng(iSeed);
+  for (auto& design : designs)
+  {
+    PVRDemoImage image;
+    image.iWidth = image.iHeight = 256;
+    image.pixels.resize(256 * 256 * 4);
+    const uint8_t background[3] = { (uint8_t)rng(), (uint8_t)rng(), (uint8_t)rng() };
+    const int iRadius = 40 + (int)(rng() % 80);
+    for (int y = 0; y < 256; ++y)
+    {
+      for (int x = 0; x < 256; ++x)
+      {
+        uint8_t* p = image.pixels.data() + (y * 256 + x) * 4;
+        const bool bInside = (x - 128) * (x - 128) + (y - 128) * (y - 128) < iRadius * iRadius;
+        for (int c = 0; c < 3; ++c)
+          p[c] = bInside ? 255 - background[c] : background[c];
+        p[3] = 255;
+      }
+    }
+    PVRDemoPng::Encode(image, design);
+  }
+
+  for (int i = 0; i < 100; ++i)
+  {
+    char strPath[32];
+    snprintf(strPath, sizeof(strPath), "data/%02d.png", i);
+    FILE* out = fopen((strDirectory + strPath).c_str(), "wb");
+    if (!out)
+      return false;
+    const std::vector<uint8_t>& design = designs[i % ICON_DESIGNS];
+    fwrite(design.data(), 1, design.size(), out);
+    fclose(out);
+  }
+  return true;
+}
+
+/* same layout as pvr.demo/PVRDemoAddonSettings.xml, sizes from the scale */
+bool WriteDataFile(const Scale& scale, unsigned int iSeed, const std::string& strPath)
+{
+  FILE* out = fopen(strPath.c_str(), "w");
+  if (!out)
+    return false;
+
+  std::mt19937 rng(iSeed);
+  const int iTvChannels = scale.iChannels - scale.iChannels / 5;
+
+  fprintf(out, "<demo>\n  <channels>\n");
+  WriteChannels(out, scale);
+
+  fprintf(out, "  </channels>\n  <channelgroups>\n");
+  for (int i = 1; i <= scale.iGroups; ++i)
+  {
+    const bool bRadio = i > scale.iGroups - scale.iGroups / 5;
+    fprintf(out, "    <group>\n      <name>Bench Group #%d</name>\n      <radio>%d</radio>\n      <position>%d</position>\n      <members>\n",
+            i, bRadio ? 1 : 0, i);
+    const int iFirst = bRadio ? iTvChannels + 1 : 1;
+    const int iLast = bRadio ? scale.iChannels : iTvChannels;
+    for (int iChannel = iFirst; iChannel <= iLast; ++iChannel)
+    {
+      if (rng() % 4 == 0)
+        fprintf(out, "        <member>%d</member>\n", iChannel);
+    }
+    fprintf(out, "      </members>\n    </group>\n");
+  }
+
+  fprintf(out, "  </channelgroups>\n  <epg>\n");
+  int iBroadcastId = 0;
+  for (int iChannel = 1; iChannel <= scale.iChannels; ++iChannel)
+  {
+    int iStart = 0;
+    for (int i = 0; i < scale.iEpgPerChannel; ++i)
+    {
+      const int iDuration = 900 * (1 + (int)(rng() % 8));
+      fprintf(out, "    <entry>\n      <broadcastid>%d</broadcastid>\n      <title>Bench entry %d</title>\n"
+                   "      <channelid>%d</channelid>\n      <start>%d</start>\n      <end>%d</end>\n"
+                   "      <plotoutline>%.56s</plotoutline>\n      <plot>%s</plot>\n      <series>%d</series>\n"
+                   "      <episode>%d</episode>\n      <episodetitle>Bench entry %d episode</episodetitle>\n"
+                   "      <icon></icon>\n      <genretype>%d</genretype>\n      <genresubtype>0</genresubtype>\n    </entry>\n",
+              ++iBroadcastId, i, iChannel, iStart, iStart + iDuration, LOREM, LOREM,
+              1 + (int)(rng() % 5), 1 + i, i, 16 * (1 + (int)(rng() % 10)));
+      iStart += iDuration;
+    }
+  }
+
+  fprintf(out, "  </epg>\n  <recordings>\n");
+  for (int i = 1; i <= scale.iRecordings; ++i)
+  {
+    fprintf(out, "    <recording>\n      <title>Bench recording %d</title>\n      <episodetitle>Bench recording %d episode</episodetitle>\n"
+                 "      <url>http://example.invalid/recording/%d.ts</url>\n      <directory>/Bench/%d/</directory>\n"
+                 "      <channelname>Bench TV Channel %d</channelname>\n      <plotoutline>%.56s</plotoutline>\n"
+                 "      <plot>%s</plot>\n      <genretype>%d</genretype>\n      <genresubtype>0</genresubtype>\n"
+                 "      <time>%02d:%02d</time>\n      <duration>%d</duration>\n      <radio>0</radio>\n"
+                 "      <series>%d</series>\n      <episode>%d</episode>\n    </recording>\n",
+            i, i, i, i % 10, 1 + (int)(rng() % iTvChannels), LOREM, LOREM, 16 * (1 + (int)(rng() % 10)),
+            (int)(rng() % 24), (int)(rng() % 60), 900 * (1 + (int)(rng() % 8)), 1 + (int)(rng() % 5), i);
+  }
+
+  fprintf(out, "  </recordings>\n  <timers>\n");
+  for (int i = 1; i <= scale.iTimers; ++i)
+  {
+    const int iStart = (int)(rng() % (22 * 60));
+    const int iEnd = iStart + 15 + (int)(rng() % 105);
+    fprintf(out, "    <timer>\n      <title>Bench timer #%d</title>\n      <channelid>%d</channelid>\n"
+                 "      <starttime>%02d:%02d</starttime>\n      <endtime>%02d:%02d</endtime>\n      <state>%d</state>\n"
+                 "      <summary>%s</summary>\n    </timer>\n",
+            i, 1 + (int)(rng() % scale.iChannels), iStart / 60, iStart % 60, iEnd / 60, iEnd % 60, (int)(rng() % 3), LOREM);
+  }
+
+  fprintf(out, "  </timers>\n</demo>\n");
+  return fclose(out) == 0;
+}
+
+/* the guide of a manifest: yesterday and the next SHARD_DAYS - 1 days, in blocks of SHARD_CHANNELS */
+const int SHARD_DAYS = 14;
+const int SHARD_CHANNELS = 50;
+
+/*!
+ * The channels of the scale behind a manifest, with a guide in shards per
+ * day and channel block. A programme that runs past midnight is written to
+ * both days' shards, as the add-on expects.
+ */
+bool WriteManifest(const Scale& scale, unsigned int iSeed, const std::string& strDirectory)
+{
+  FILE* out = fopen((strDirectory + "channels.xml").c_str(), "w");
+  if (!out)
+    return false;
+  fprintf(out, "<channels>\n");
+  WriteChannels(out, scale);
+  fprintf(out, "</channels>\n");
+  if (fclose(out) != 0)
+    return false;
+
+  out = fopen((strDirectory + "PVRDemoAddonSettings.xml").c_str(), "w");
+  if (!out)
+    return false;
+  fprintf(out, "<demo>\n  <channels file=\"channels.xml\"/>\n  <guide>\n");
+
+  std::mt19937 rng(iSeed);
+  bool bWritten = true;
+  for (int iFirst = 1; iFirst <= scale.iChannels; iFirst += SHARD_CHANNELS)
+  {
+    const int iLast = std::min(iFirst + SHARD_CHANNELS - 1, scale.iChannels);
+    FILE* shards[SHARD_DAYS];
+    for (int iDay = 0; iDay < SHARD_DAYS; ++iDay)
+    {
+      char strFile[64];
+      snprintf(strFile, sizeof(strFile), "guide-%d-%d.xml", iDay, iFirst);
+      fprintf(out, "    <shard day=\"%+dd\" channels=\"%d-%d\">%s</shard>\n", iDay - 1, iFirst, iLast, strFile);
+      shards[iDay] = fopen((strDirectory + strFile).c_str(), "w");
+      if (!shards[iDay])
+        return false;
+      fprintf(shards[iDay], "<guide>\n");
+    }
+
+    /* seconds from the first day's midnight, taking every day as 24 hours */
+    for (int iChannel = iFirst; iChannel <= iLast; ++iChannel)
+    {
+      int iStart = 0;
+      for (int i = 0; iStart < SHARD_DAYS * 86400; ++i)
+      {
+        const int iEnd = iStart + 900 * (1 + (int)(rng() % 8));
+        for (int iDay = iStart / 86400; iDay < SHARD_DAYS && iDay * 86400 < iEnd; ++iDay)
+        {
+          fprintf(shards[iDay], "  <entry>\n    <broadcastid>%d</broadcastid>\n    <title>Bench programme %d</title>\n"
+                                "    <channelid>%d</channelid>\n    <start>%d</start>\n    <end>%d</end>\n"
+                                "    <plotoutline>%.56s</plotoutline>\n    <plot>Part %d of Bench programme %d on channel %d. %s</plot>\n"
+                                "    <series>%d</series>\n    <episode>%d</episode>\n    <genretype>%d</genretype>\n  </entry>\n",
+                  i + 1, i, iChannel, iStart - iDay * 86400, iEnd - iDay * 86400, LOREM, i, i, iChannel, LOREM,
+                  1 + i % 5, 1 + i, 16 * (1 + i % 10));
+        }
+        iStart = iEnd;
+      }
+    }
+
+    for (int iDay = 0; iDay < SHARD_DAYS; ++iDay)
+    {
+      fprintf(shards[iDay], "</guide>\n");
+      bWritten = fclose(shards[iDay]) == 0 && bWritten;
+    }
+  }
+
+  fprintf(out, "  </guide>\n</demo>\n");
+  return fclose(out) == 0 && bWritten;
+}
+
+/* a week of programmes per channel in XMLTV, for the channels of the data file */
+bool WriteXmltvFile(const Scale& scale, unsigned int iSeed, const std::string& strPath)
+{
+  FILE* out = fopen(strPath.c_str(), "w");
+  if (!out)
+    return false;
+
+  std::mt19937 rng(iSeed);
+  const int iTvChannels = scale.iChannels - scale.iChannels / 5;
+
+  fprintf(out, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<!DOCTYPE tv SYSTEM \"xmltv.dtd\">\n<tv generator-info-name=\"pvrdemo-bench\">\n");
+  for (int i = 1; i <= scale.iChannels; ++i)
+  {
+    fprintf(out, "  <channel id=\"bench%d.example\">\n    <display-name>Bench %s Channel %d</display-name>\n  </channel>\n",
+            i, i > iTvChannels ? "Radio" : "TV", i);
+  }
+
+  const time_t iAnchor = 1600000000;
+  for (int iChannel = 1; iChannel <= scale.iChannels; ++iChannel)
+  {
+    time_t iStart = iAnchor;
+    for (int i = 0; i < scale.iEpgPerChannel * 7; ++i)
+    {
+      const time_t iEnd = iStart + 900 * (1 + (int)(rng() % 8));
+      char strStart[32];
+      char strEnd[32];
+      strftime(strStart, sizeof(strStart), "%Y%m%d%H%M%S +0000", gmtime(&iStart));
+      strftime(strEnd, sizeof(strEnd), "%Y%m%d%H%M%S +0000", gmtime(&iEnd));
+      fprintf(out, "  <programme start=\"%s\" stop=\"%s\" channel=\"bench%d.example\">\n"
+                   "    <title lang=\"en\">Bench programme %d</title>\n    <sub-title lang=\"en\">Part %d &amp; more</sub-title>\n"
+                   "    <desc lang=\"en\">Part %d of Bench programme %d on channel %d. %s</desc>\n"
+                   "    <category lang=\"en\">Drama</category>\n"
+                   "    <episode-num system=\"xmltv_ns\">%d.%d.</episode-num>\n  </programme>\n",
+              strStart, strEnd, iChannel, i, i, i, i, iChannel, LOREM, (int)(rng() % 5), i);
+      iStart = iEnd;
+    }
+  }
+
+  fprintf(out, "</tv>\n");
+  return fclose(out) == 0;
+}
+
+struct Result
+{
+  std::string strScale;
+  std::string strCase;
+  uint64_t    iOps;
+  double      fNsPerOp;
+  double      fAllocsPerOp;
+  double      fBytesPerOp;
+  uint64_t    iTransfersPerOp;
+  int64_t     iPeakHeapKiB;
+  long        iMaxRssKiB;
+};
+
+std::vector<Result> g_results;
+std::string         g_strFilter;
+int                 g_iMinTimeMs = 300;
+unsigned int        g_iMaxThreads = std::max(1u, std::thread::hardware_concurrency());
+
+bool Selected(const char* strCase)
+{
+  return g_strFilter.empty() || std::string(strCase).find(g_strFilter) != std::string::npos;
+}
+
+long MaxRssKiB(void)
+{
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+/*!
+ * Run op in batches until min-time has passed and record the averages.
+ * op returns the number of operations it performed.
+ */
+template<typename F>
+void Run(const Scale& scale, const char* strCase, F op)
+{
+  if (!Selected(strCase))
+    return;
+
+  op();  // warm up caches and lazily built state
+
+  const uint64_t iAllocations = g_iAllocations;
+  const uint64_t iBytes = g_iAllocatedBytes;
+  const uint64_t iTransferred = g_iTransferred;
+  const int64_t iLiveAtStart = g_iLiveBytes;
+  g_iPeakLiveBytes = iLiveAtStart;
+
+  uint64_t iOps = 0;
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  std::chrono::steady_clock::duration elapsed;
+  do
+  {
+    iOps += op();
+    elapsed = std::chrono::steady_clock::now() - start;
+  } while (elapsed < std::chrono::milliseconds(g_iMinTimeMs));
+
+  Result result;
+  result.strScale        = scale.strName;
+  result.strCase         = strCase;
+  result.iOps            = iOps;
+  result.fNsPerOp        = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / iOps;
+  result.fAllocsPerOp    = (double)(g_iAllocations - iAllocations) / iOps;
+  result.fBytesPerOp     = (double)(g_iAllocatedBytes - iBytes) / iOps;
+  result.iTransfersPerOp = (g_iTransferred - iTransferred) / iOps;
+  result.iPeakHeapKiB    = (g_iPeakLiveBytes - iLiveAtStart) / 1024;
+  result.iMaxRssKiB      = MaxRssKiB();
+  g_results.push_back(result);
+
+  printf("%-7s %-36s %10llu ops %14.1f ns/op %10.1f allocs/op %12.1f B/op %8llu xfer/op %8lld KiB heap %8ld KiB rss\n",
+         result.strScale.c_str(), result.strCase.c_str(), (unsigned long long)result.iOps, result.fNsPerOp,
+         result.fAllocsPerOp, result.fBytesPerOp, (unsigned long long)result.iTransfersPerOp,
+         (long long)result.iPeakHeapKiB, result.iMaxRssKiB);
+  fflush(stdout);
+}
+
+/* visit every child of <demo><section> */
+template<typename F>
+uint64_t ForEachNode(TiXmlElement* pRoot, const char* strSection, F visit)
+{
+  uint64_t iCount = 0;
+  TiXmlElement* pElement = pRoot->FirstChildElement(strSection);
+  TiXmlNode* pNode = NULL;
+  while (pElement && (pNode = pElement->IterateChildren(pNode)) != NULL)
+  {
+    visit(pNode, (int)++iCount);
+  }
+  return iCount;
+}
+
+/*!
+ * 1, 2, 4... up to --threads readers asking for a day of guide and the TV
+ * channels over and over, while a writer publishes a new version every
+ * millisecond. Reports the calls per second in total and per reader, and
+ * the total against one reader; readers that never contend scale with the
+ * cores.
+ */
+void RunConcurrentReads(const Scale& scale, PVRDemoData& data)
+{
+  const time_t iAnchor = 1600000000;
+  double fSingle = 0.0;
+  std::vector<unsigned int> threadCounts;
+  for (unsigned int iThreads = 1; iThreads < g_iMaxThreads; iThreads *= 2)
+    threadCounts.push_back(iThreads);
+  threadCounts.push_back(g_iMaxThreads);
+
+  for (unsigned int iThreads : threadCounts)
+  {
+    const std::string strCase = "ConcurrentReads/" + std::to_string(iThreads);
+    if (!Selected(strCase.c_str()))
+      continue;
+
+    std::atomic<bool> bStop(false);
+    std::atomic<uint64_t> iCalls(0);
+    uint64_t iVersions = 0;
+    std::vector<std::thread> readers;
+    for (unsigned int i = 0; i < iThreads; ++i)
+    {
+      readers.emplace_back([&, i] {
+        std::mt19937 rng(i + 1);
+        ADDON_HANDLE_STRUCT handle;
+        memset(&handle, 0, sizeof(handle));
+        uint64_t iDone = 0;
+        while (!bStop.load(std::memory_order_relaxed))
+        {
+          data.GetEPGForChannel(&handle, 1 + rng() % scale.iChannels, iAnchor, iAnchor + 24 * 3600);
+          data.GetChannels(&handle, false);
+          iDone += 2;
+        }
+        iCalls += iDone;
+      });
+    }
+
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    while (std::chrono::steady_clock::now() - start < std::chrono::milliseconds(g_iMinTimeMs))
+    {
+      iVersions += PVRDemoData::BenchmarkAccess::Republish(data);
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    bStop = true;
+    for (auto& reader : readers)
+      reader.join();
+    const double fSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    const double fCallsPerSecond = (double)iCalls / fSeconds;
+    if (iThreads == 1)
+      fSingle = fCallsPerSecond;
+    printf("%-7s %-36s %12.0f calls/s %12.0f calls/s per reader %6.2fx one reader, %llu versions published\n",
+           scale.strName, strCase.c_str(), fCallsPerSecond, fCallsPerSecond / iThreads,
+           fSingle > 0.0 ? fCallsPerSecond / fSingle : 0.0, (unsigned long long)iVersions);
+    fflush(stdout);
+  }
+}
+
+void RunScale(const Scale& scale, unsigned int iSeed, const std::string& strDirectory)
+{
+  g_strClientPath = strDirectory;
+  g_strUserPath = strDirectory;
+
+  const std::string strFile = strDirectory + "PVRDemoAddonSettings.xml";
+  if (!WriteDataFile(scale, iSeed, strFile) || !WriteIcons(iSeed, strDirectory))
+  {
+    fprintf(stderr, "cannot write '%s'\n", strFile.c_str());
+    exit(1);
+  }
+
+  /* a build with generated tables starts out on those, not on the data file */
+  PVRDemoData data;
+  PVRDemoData::BenchmarkAccess::LoadDemoData(data);
+  if (data.GetChannelsAmount() != scale.iChannels)
+  {
+    fprintf(stderr, "cannot load '%s'\n", data.GetSettingsFile().c_str());
+    exit(1);
+  }
+
+  Run(scale, "LoadDemoData", [&] { return (uint64_t)PVRDemoData::BenchmarkAccess::LoadDemoData(data); });
+
+#ifndef PVRDEMO_STATIC_DATA
+  /* what a start after standby reads instead of the data file */
+  const std::string strSnapshot = strDirectory + "snapshot.bin";
+  if (data.SaveSnapshot(strSnapshot))
+  {
+    Run(scale, "LoadSnapshot", [&] { return (uint64_t)PVRDemoData::BenchmarkAccess::LoadSnapshot(data, strSnapshot); });
+    remove(strSnapshot.c_str());
+  }
+#endif
+#ifdef PVRDEMO_STATIC_DATA
+  PVRDemoData staticData;
+  Run(scale, "LoadStaticData", [&] { return (uint64_t)PVRDemoData::BenchmarkAccess::LoadStaticData(staticData); });
+#endif
+
+  /* the scanners on an already parsed document */
+  TiXmlDocument doc;
+  doc.LoadFile(strFile);
+  TiXmlElement* pRoot = doc.RootElement();
+
+  std::vector<PVRDemoChannel> channels;
+  ForEachNode(pRoot, "channels", [&](const TiXmlNode* pNode, int iId) {
+    PVRDemoChannel channel;
+    if (PVRDemoData::BenchmarkAccess::ScanChannel(data, pNode, iId, channel))
+      channels.push_back(channel);
+  });
+
+  Run(scale, "ScanXMLChannelData", [&] {
+    return ForEachNode(pRoot, "channels", [&](const TiXmlNode* pNode, int iId) {
+      PVRDemoChannel channel;
+      PVRDemoData::BenchmarkAccess::ScanChannel(data, pNode, iId, channel);
+    });
+  });
+  /* the first load made the thumbnails, so this is reading and hashing the icons */
+  Run(scale, "ResolveIcons", [&] {
+    std::vector<std::string> paths;
+    for (const auto& channel : channels)
+      paths.push_back(channel.strIconPath);
+    PVRDemoIconCache icons(g_strClientPath, g_strUserPath + "icons", g_iIconSize);
+    for (auto& strPath : paths)
+      icons.Add(strPath);
+    icons.Resolve();
+    return (uint64_t)paths.size();
+  });
+  if (Selected("ScaleIcon"))
+  {
+    std::vector<uint8_t> icon;
+    FILE* in = fopen((strDirectory + "data/01.png").c_str(), "rb");
+    if (in)
+    {
+      icon.resize(65536);
+      icon.resize(fread(icon.data(), 1, icon.size(), in));
+      fclose(in);
+    }
+    Run(scale, "ScaleIcon", [&] {
+      PVRDemoImage image, scaled;
+      std::vector<uint8_t> encoded;
+      PVRDemoPng::Decode(icon.data(), icon.size(), image);
+      PVRDemoPng::Scale(image, g_iIconSize, scaled);
+      PVRDemoPng::Encode(scaled, encoded);
+      return (uint64_t)1;
+    });
+  }
+
+  Run(scale, "ScanXMLChannelGroupData", [&] {
+    return ForEachNode(pRoot, "channelgroups", [&](const TiXmlNode* pNode, int iId) {
+      PVRDemoChannelGroup group;
+      PVRDemoData::BenchmarkAccess::ScanChannelGroup(data, pNode, iId, group);
+    });
+  });
+  std::shared_ptr<PVRDemoTextStore> texts = PVRDemoTextStore::Create(PVRDemoTextStore::MODE_MEMORY, strDirectory);
+  Run(scale, "ScanXMLEpgData", [&] {
+    std::vector<PVRDemoChannel> scratch = channels;
+    return ForEachNode(pRoot, "epg", [&](const TiXmlNode* pNode, int) {
+      PVRDemoData::BenchmarkAccess::ScanEpg(data, pNode, scratch, *texts);
+    });
+  });
+  const PVRDemoTimeResolver times(time(nullptr));
+  Run(scale, "ScanXMLRecordingData", [&] {
+    return ForEachNode(pRoot, "recordings", [&](const TiXmlNode* pNode, int iId) {
+      PVRDemoRecording recording;
+      PVRDemoData::BenchmarkAccess::ScanRecording(data, pNode, iId, times, *texts, recording);
+    });
+  });
+  Run(scale, "ScanXMLTimerData", [&] {
+    return ForEachNode(pRoot, "timers", [&](const TiXmlNode* pNode, int) {
+      PVRDemoTimer timer;
+      PVRDemoData::BenchmarkAccess::ScanTimer(data, pNode, channels, times, timer);
+    });
+  });
+
+  /* the time expressions alone, in each of the accepted forms */
+  static const char* const timeExpressions[] =
+  {
+    "20:15", "-1d+20:15", "+2d", "2020-03-29T02:30", "2020-10-25 02:30:00", "2020-06-01T12:00:00+02:00", "-1d-01:00", "06:45:30"
+  };
+  Run(scale, "ResolveTime", [&] {
+    for (int i = 0; i < 64; ++i)
+    {
+      time_t iTime = 0;
+      times.Resolve(timeExpressions[i % 8], -1, iTime);
+      g_iResolved += (uint64_t)iTime;
+    }
+    return (uint64_t)64;
+  });
+
+  /* query paths, on ids drawn from the same seed */
+  std::mt19937 rng(iSeed);
+  ADDON_HANDLE_STRUCT handle;
+  memset(&handle, 0, sizeof(handle));
+
+  Run(scale, "GetChannel", [&] {
+    PVR_CHANNEL channel = {};
+    PVRDemoChannel result;
+    for (int i = 0; i < 64; ++i)
+    {
+      channel.iUniqueId = 1 + rng() % scale.iChannels;
+      data.GetChannel(channel, result);
+    }
+    return (uint64_t)64;
+  });
+
+  Run(scale, "GetChannelGroupMembers", [&] {
+    PVR_CHANNEL_GROUP group = {};
+    snprintf(group.strGroupName, sizeof(group.strGroupName), "Bench Group #%d", 1 + (int)(rng() % scale.iGroups));
+    data.GetChannelGroupMembers(&handle, group);
+    return (uint64_t)1;
+  });
+
+  /* a fixed anchor keeps the generated schedule identical between runs */
+  const time_t iAnchor = 1600000000;
+  const struct { const char* strCase; int iHours; } windows[] =
+  {
+    { "GetEPGForChannel/3h",    3 },
+    { "GetEPGForChannel/24h",  24 },
+    { "GetEPGForChannel/7d",  168 },
+  };
+  for (const auto& window : windows)
+  {
+    Run(scale, window.strCase, [&] {
+      data.GetEPGForChannel(&handle, 1 + rng() % scale.iChannels, iAnchor, iAnchor + window.iHours * 3600);
+      return (uint64_t)1;
+    });
+  }
+
+  /* the diff behind an EPG change notification: one corrected broadcast in a week */
+  {
+    PVRDemoTextPin pin;
+    std::shared_ptr<const PVRDemoDataSet> snapshot = data.Snapshot();
+    std::vector<EPG_TAG> before;
+    PVRDemoEpgShardList shards;
+    data.GetEpgTags(*snapshot, 1, iAnchor, iAnchor + 168 * 3600, before, shards);
+    std::vector<EPG_TAG> after = before;
+    if (!after.empty())
+      after[after.size() / 2].strTitle = "Corrected Title";
+    std::vector<PVRDemoEpgTracker::Change> changes;
+    Run(scale, "DiffEpg/7d", [&] {
+      PVRDemoEpgTracker::Diff(before, after, PVRDemoEpgTracker::MAX_EVENTS_PER_CHANNEL, changes);
+      return (uint64_t)1;
+    });
+  }
+
+  Run(scale, "GetRecordingURL", [&] {
+    PVR_RECORDING recording = {};
+    for (int i = 0; i < 64; ++i)
+    {
+      snprintf(recording.strRecordingId, sizeof(recording.strRecordingId), "%d", 1 + (int)(rng() % scale.iRecordings));
+      data.GetRecordingURL(recording);
+    }
+    return (uint64_t)64;
+  });
+
+  Run(scale, "GetTimers", [&] {
+    data.GetTimers(&handle);
+    return (uint64_t)1;
+  });
+
+  RunConcurrentReads(scale, data);
+
+  /* XMLTV import against the channels of the data file */
+  const std::string strXmltvFile = strDirectory + "guide.xml";
+  struct stat xmltvStat;
+  if (!WriteXmltvFile(scale, iSeed, strXmltvFile) || stat(strXmltvFile.c_str(), &xmltvStat) != 0)
+  {
+    fprintf(stderr, "cannot write '%s'\n", strXmltvFile.c_str());
+    exit(1);
+  }
+
+  const size_t iResults = g_results.size();
+  std::shared_ptr<PVRDemoTextStore> guideTexts;
+  Run(scale, "ImportXMLTV", [&] {
+    PVRDemoGuide guide;
+    guideTexts = PVRDemoTextStore::Create(PVRDemoTextStore::MODE_MEMORY, strDirectory);
+    PVRDemoXmltvImporter importer(guideTexts);
+    for (const auto& channel : channels)
+      importer.AddChannel(channel.strChannelName, channel.iUniqueId);
+    importer.Import(strXmltvFile, guide);
+    guideTexts->Seal();
+    return (uint64_t)1;
+  });
+  if (g_results.size() > iResults)
+  {
+    printf("%-7s %-36s %.1f MB at %.1f MB/s\n", scale.strName, "ImportXMLTV", (double)xmltvStat.st_size / 1e6,
+           (double)xmltvStat.st_size / 1e6 / (g_results.back().fNsPerOp / 1e9));
+    printf("%-7s %-36s %zu texts, %llu KiB, %llu KiB compressed\n", scale.strName, "ImportXMLTV", guideTexts->Texts(),
+           (unsigned long long)(guideTexts->RawBytes() / 1024), (unsigned long long)(guideTexts->StoredBytes() / 1024));
+  }
+  guideTexts.reset();
+
+  /* the block codec on a block of guide descriptions */
+  std::string strBlock;
+  for (int i = 0; strBlock.size() + 512 < PVRDemoTextStore::BLOCK_SIZE; ++i)
+    strBlock += "Part " + std::to_string(i) + " of Bench programme " + std::to_string(i) + ". " + LOREM + '\0';
+  std::vector<uint8_t> compressed;
+  std::vector<char> decompressed(strBlock.size());
+  Run(scale, "CompressTextBlock", [&] {
+    PVRDemoTextStore::Compress(strBlock.data(), strBlock.size(), compressed);
+    return (uint64_t)1;
+  });
+  Run(scale, "DecompressTextBlock", [&] {
+    PVRDemoTextStore::Decompress(compressed.data(), compressed.size(), decompressed.data(), decompressed.size());
+    return (uint64_t)1;
+  });
+
+  /* an imported guide in each mode of the text store: what stays resident, what a week of it costs to transfer */
+  const char* const textModes[] = { "plain", "memory", "disk" };
+  const time_t iGuideStart = 1600000000;
+  for (int iMode = PVRDemoTextStore::MODE_PLAIN; iMode <= PVRDemoTextStore::MODE_DISK; ++iMode)
+  {
+    const std::string strCase = std::string("GetEPGForChannel/xmltv/7d/") + textModes[iMode];
+    if (!Selected(strCase.c_str()))
+      continue;
+
+    g_iColdText = iMode;
+    g_strXmltvFile = strXmltvFile;
+    const int64_t iLiveBefore = g_iLiveBytes;
+    PVRDemoData guideData;
+    const int64_t iResidentKiB = (g_iLiveBytes - iLiveBefore) / 1024;
+    g_strXmltvFile.clear();
+    g_iColdText = DEFAULT_COLD_TEXT;
+
+    Run(scale, strCase.c_str(), [&] {
+      guideData.GetEPGForChannel(&handle, 1 + rng() % scale.iChannels, iGuideStart, iGuideStart + 168 * 3600);
+      return (uint64_t)1;
+    });
+    printf("%-7s %-36s %lld KiB resident\n", scale.strName, strCase.c_str(), (long long)iResidentKiB);
+
+    /* with a budget that holds the whole guide decompressed, after Kodi fetched every channel once */
+    if (iMode == PVRDemoTextStore::MODE_PLAIN)
+      continue;
+    PVRDemoTextStore::SetCacheBudget(SIZE_MAX);
+    for (int iChannel = 1; iChannel <= scale.iChannels; ++iChannel)
+      guideData.GetEPGForChannel(&handle, iChannel, iGuideStart, iGuideStart + 168 * 3600);
+    Run(scale, (strCase + "/cached").c_str(), [&] {
+      guideData.GetEPGForChannel(&handle, 1 + rng() % scale.iChannels, iGuideStart, iGuideStart + 168 * 3600);
+      return (uint64_t)1;
+    });
+    PVRDemoTextStore::SetCacheBudget((size_t)DEFAULT_COLD_TEXT_CACHE * 1024 * 1024);
+  }
+
+  /*
+   * The channels behind a manifest, with a two-week guide in shards: what a
+   * start costs and keeps, what stays loaded for a window of three days and
+   * for the whole horizon, and what a request costs that reads its shard.
+   */
+  if (Selected("manifest"))
+  {
+    const std::string strManifestDirectory = strDirectory + "manifest/";
+    mkdir(strManifestDirectory.c_str(), 0755);
+    if (!WriteManifest(scale, iSeed, strManifestDirectory))
+    {
+      fprintf(stderr, "cannot write the manifest in '%s'\n", strManifestDirectory.c_str());
+      exit(1);
+    }
+
+    g_strClientPath = strManifestDirectory;
+    const int64_t iLiveBefore = g_iLiveBytes;
+    PVRDemoData shardedData;
+    const int64_t iStartKiB = (g_iLiveBytes - iLiveBefore) / 1024;
+    g_strClientPath = strDirectory;
+    PVRDemoEpgShards* shards = shardedData.Snapshot()->shards.get();
+    if (!shards)
+    {
+      fprintf(stderr, "cannot load the manifest in '%s'\n", strManifestDirectory.c_str());
+      exit(1);
+    }
+
+    Run(scale, "LoadDemoData/manifest", [&] {
+      g_strClientPath = strManifestDirectory;
+      const bool bLoaded = PVRDemoData::BenchmarkAccess::LoadDemoData(shardedData);
+      g_strClientPath = strDirectory;
+      return (uint64_t)bLoaded;
+    });
+    shards = shardedData.Snapshot()->shards.get();
+
+    /* the days of the shards, as the add-on resolved them */
+    const PVRDemoTimeResolver days(time(nullptr));
+    auto dayStart = [&days](int iDay) { return days.LocalTime(days.Today() + iDay, 0); };
+
+    for (int iChannel = 1; iChannel <= scale.iChannels; ++iChannel)
+      shardedData.GetEPGForChannel(&handle, iChannel, dayStart(0), dayStart(3));
+    const int64_t iWindowKiB = (g_iLiveBytes - iLiveBefore) / 1024;
+    const size_t iWindowShards = shards->LoadedShards();
+    const size_t iWindowEntries = shards->LoadedEntries();
+
+    Run(scale, "GetEPGForChannel/manifest/3d", [&] {
+      shardedData.GetEPGForChannel(&handle, 1 + rng() % scale.iChannels, dayStart(0), dayStart(3));
+      return (uint64_t)1;
+    });
+
+    /* a day that the channel's block has not loaded, so every request reads a shard */
+    int iDay = 0;
+    Run(scale, "GetEPGForChannel/manifest/24h/cold", [&] {
+      iDay = (iDay + 1) % (SHARD_DAYS - 1);
+      shardedData.GetEPGForChannel(&handle, 1 + rng() % scale.iChannels, dayStart(iDay), dayStart(iDay + 1));
+      return (uint64_t)1;
+    });
+
+    for (int iChannel = 1; iChannel <= scale.iChannels; ++iChannel)
+      shardedData.GetEPGForChannel(&handle, iChannel, dayStart(-1), dayStart(SHARD_DAYS - 1));
+    const int64_t iHorizonKiB = (g_iLiveBytes - iLiveBefore) / 1024;
+
+    if (Selected("LoadDemoData/manifest"))
+    {
+      printf("%-7s %-36s %lld KiB resident after start, %lld KiB with 3 days loaded (%zu shards, %zu entries), "
+             "%lld KiB with all %d days (%zu shards, %zu entries)\n",
+             scale.strName, "LoadDemoData/manifest", (long long)iStartKiB, (long long)iWindowKiB, iWindowShards, iWindowEntries,
+             (long long)iHorizonKiB, SHARD_DAYS, shards->LoadedShards(), shards->LoadedEntries());
+    }
+  }
+
+  Run(scale, "XmltvParseTime", [&] {
+    time_t iTime;
+    for (int i = 0; i < 64; ++i)
+      PVRDemoXmltvImporter::ParseTime("20200913122640 +0200", iTime);
+    return (uint64_t)64;
+  });
+}
+
+int64_t ProcessCpuUs(void)
+{
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return ((int64_t)usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000 + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+/*!
+ * iStreams synthetic channels recorded at once for at least two seconds.
+ * Unpaced channels measure how fast the captures get to disk, paced ones
+ * what a recording of a real channel costs.
+ */
+void RunRecord(int iStreams, bool bPaced, const std::string& strDirectory)
+{
+  char strCase[64];
+  snprintf(strCase, sizeof(strCase), "Record/%d/%s", iStreams, bPaced ? "20Mbps" : "unpaced");
+  if (!Selected(strCase))
+    return;
+
+  const std::string strURL = std::string("synthetic://bitrate=20M&pids=3&pace=") + (bPaced ? "1" : "0");
+  const time_t endTime = time(nullptr) + std::max(2, (g_iMinTimeMs + 999) / 1000);
+  PVRDemoSessionManager sessions(0, (size_t)iStreams * g_iLiveBufferSize * 1024 * 1024);
+
+  const int64_t iStartCpuUs = ProcessCpuUs();
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  std::vector<std::unique_ptr<PVRDemoCapture>> captures;
+  for (int i = 0; i < iStreams; ++i)
+  {
+    std::shared_ptr<PVRDemoSession> session = sessions.OpenLive(strURL, false, PVRDEMO_SESSION_BACKGROUND);
+    if (!session)
+    {
+      fprintf(stderr, "%s: cannot open session %d\n", strCase, i);
+      return;
+    }
+    captures.emplace_back(new PVRDemoCapture(session, strDirectory + "record-" + std::to_string(i) + ".ts", endTime));
+    if (!captures.back()->Start())
+    {
+      fprintf(stderr, "%s: cannot write to '%s'\n", strCase, strDirectory.c_str());
+      return;
+    }
+  }
+
+  uint64_t iBytes = 0;
+  int64_t iCaptureCpuUs = 0;
+  bool bDirect = true;
+  for (auto& capture : captures)
+  {
+    while (!capture->IsDone())
+      usleep(10000);
+    capture->Finish();
+    const PVRDemoCapture::Statistics statistics = capture->GetStatistics();
+    iBytes += statistics.iBytes;
+    iCaptureCpuUs += std::max<int64_t>(statistics.iCpuUs, 0);
+    bDirect = bDirect && statistics.bDirect;
+    remove(capture->File().c_str());
+  }
+  sessions.CloseAll();
+
+  const double fSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  const double fProcessCpu = (double)(ProcessCpuUs() - iStartCpuUs) / 1e6 / fSeconds / iStreams;
+  const double fCaptureCpu = (double)iCaptureCpuUs / 1e6 / fSeconds / iStreams;
+  printf("%-7s %-36s %8.1f MB/s total %8.1f MB/s per stream %6.2f%% core per stream, %.2f%% in the capture, %s writes\n",
+         "disk", strCase, (double)iBytes / 1048576.0 / fSeconds, (double)iBytes / 1048576.0 / fSeconds / iStreams,
+         fProcessCpu * 100.0, fCaptureCpu * 100.0, bDirect ? "direct" : "buffered");
+  fflush(stdout);
+}
+
+/*!
+ * 1, 2, 4... up to --threads players, each reading its own unpaced
+ * synthetic channel the way Kodi's player does, looking its session up in
+ * the manager for every read. Reports the MB/s in total and per session
+ * and the total against one session.
+ */
+void RunConcurrentSessions(void)
+{
+  double fSingle = 0.0;
+  std::vector<unsigned int> threadCounts;
+  for (unsigned int iThreads = 1; iThreads < g_iMaxThreads; iThreads *= 2)
+    threadCounts.push_back(iThreads);
+  threadCounts.push_back(std::min<unsigned int>(g_iMaxThreads, PVRDemoSessionManager::MAX_SESSIONS));
+
+  for (unsigned int iThreads : threadCounts)
+  {
+    const std::string strCase = "ConcurrentSessions/" + std::to_string(iThreads);
+    if (!Selected(strCase.c_str()))
+      continue;
+
+    PVRDemoSessionManager sessions(0, (size_t)iThreads * g_iLiveBufferSize * 1024 * 1024);
+    std::vector<int> ids;
+    for (unsigned int i = 0; i < iThreads; ++i)
+    {
+      std::shared_ptr<PVRDemoSession> session = sessions.OpenLive("synthetic://bitrate=20M&pids=3&pace=0", false);
+      if (!session)
+        break;
+      ids.push_back(session->Id());
+    }
+    if (ids.size() != iThreads)
+    {
+      fprintf(stderr, "%s: cannot open %u sessions\n", strCase.c_str(), iThreads);
+      return;
+    }
+
+    std::atomic<bool> bStop(false);
+    std::atomic<uint64_t> iBytes(0);
+    std::vector<std::thread> players;
+    for (int iId : ids)
+    {
+      players.emplace_back([&, iId] {
+        std::vector<unsigned char> buffer(64 * 1024);
+        uint64_t iRead = 0;
+        while (!bStop.load(std::memory_order_relaxed))
+        {
+          std::shared_ptr<PVRDemoSession> session = sessions.Get(iId);
+          const int iResult = session ? session->Read(buffer.data(), (unsigned int)buffer.size()) : -1;
+          if (iResult < 0)
+            break;
+          iRead += (uint64_t)iResult;
+        }
+        iBytes += iRead;
+      });
+    }
+
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::this_thread::sleep_for(std::chrono::milliseconds(g_iMinTimeMs));
+    bStop = true;
+    for (auto& player : players)
+      player.join();
+    const double fSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    sessions.CloseAll();
+
+    const double fMBps = (double)iBytes / 1048576.0 / fSeconds;
+    if (iThreads == 1)
+      fSingle = fMBps;
+    printf("%-7s %-36s %8.1f MB/s total %8.1f MB/s per session %6.2fx one session\n", "memory", strCase.c_str(),
+           fMBps, fMBps / iThreads, fSingle > 0.0 ? fMBps / fSingle : 0.0);
+    fflush(stdout);
+  }
+}
+
+/*!
+ * What a live stream delivers when the player never waits on it: the bare
+ * ring buffer between a producer thread and a reader, then the whole
+ * PVRDemoLiveStream with its producer on the I/O pool, reading an unpaced
+ * synthetic channel and a file looped as a channel. Reads are of the size
+ * Kodi asks for; reports the MB/s and the reads that found the buffer empty.
+ */
+const size_t LIVE_STREAM_FILE_SIZE  = 64 * 1024 * 1024;
+const size_t LIVE_STREAM_READ_CHUNK = 64 * 1024;
+
+void RunLiveStream(const std::string& strDirectory)
+{
+  const size_t iBufferSize = (size_t)g_iLiveBufferSize * 1024 * 1024;
+  std::vector<unsigned char> chunk(LIVE_STREAM_READ_CHUNK);
+
+  if (Selected("LiveStream/ring"))
+  {
+    PVRDemoRingBuffer ring(iBufferSize);
+    std::atomic<bool> bStop(false);
+    std::thread producer([&] {
+      uint8_t iValue = 0;
+      while (!bStop.load(std::memory_order_relaxed))
+      {
+        uint8_t* pSpan;
+        const size_t iSpan = std::min<size_t>(ring.GetWriteSpan(pSpan), PVRDemoLiveStream::CHUNK_SIZE);
+        if (iSpan == 0)
+        {
+          std::this_thread::yield();
+          continue;
+        }
+        memset(pSpan, iValue++, iSpan);
+        ring.CommitWrite(iSpan);
+      }
+    });
+
+    uint64_t iBytes = 0;
+    uint64_t iEmpty = 0;
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    const std::chrono::steady_clock::time_point end = start + std::chrono::milliseconds(g_iMinTimeMs);
+    while (std::chrono::steady_clock::now() < end)
+    {
+      const size_t iRead = ring.Read(chunk.data(), chunk.size());
+      if (iRead == 0)
+      {
+        ++iEmpty;
+        std::this_thread::yield();
+      }
+      iBytes += iRead;
+    }
+    const double fSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    bStop = true;
+    producer.join();
+
+    printf("%-7s %-36s %8.1f MB/s %8llu empty reads\n", "memory", "LiveStream/ring",
+           (double)iBytes / 1048576.0 / fSeconds, (unsigned long long)iEmpty);
+    fflush(stdout);
+  }
+
+  const std::string strFile = strDirectory + "live-stream.ts";
+  if (Selected("LiveStream/file"))
+  {
+    FILE* out = fopen(strFile.c_str(), "wb");
+    std::mt19937 random(1);
+    bool bWritten = out != nullptr;
+    for (size_t i = 0; bWritten && i < LIVE_STREAM_FILE_SIZE; i += chunk.size())
+    {
+      for (auto& byte : chunk)
+        byte = (uint8_t)random();
+      bWritten = fwrite(chunk.data(), 1, chunk.size(), out) == chunk.size();
+    }
+    if (out && fclose(out) != 0)
+      bWritten = false;
+    if (!bWritten)
+    {
+      fprintf(stderr, "LiveStream/file: cannot write to '%s'\n", strDirectory.c_str());
+      remove(strFile.c_str());
+    }
+  }
+
+  std::shared_ptr<PVRDemoIOPool> pool = std::make_shared<PVRDemoIOPool>(0);
+  const std::pair<const char*, std::string> sources[] = {
+    { "LiveStream/synthetic", "synthetic://bitrate=20M&pids=3&pace=0" },
+    { "LiveStream/file",      "file://" + strFile },
+  };
+  for (const auto& source : sources)
+  {
+    if (!Selected(source.first))
+      continue;
+
+    PVRDemoStreamSource* streamSource = PVRDemoStreamSource::Create(source.second);
+    if (!streamSource)
+    {
+      fprintf(stderr, "%s: cannot create a source for '%s'\n", source.first, source.second.c_str());
+      continue;
+    }
+    PVRDemoLiveStream stream(pool, streamSource, iBufferSize);
+    if (!stream.Open())
+    {
+      fprintf(stderr, "%s: cannot open '%s'\n", source.first, source.second.c_str());
+      continue;
+    }
+
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    const std::chrono::steady_clock::time_point end = start + std::chrono::milliseconds(g_iMinTimeMs);
+    while (std::chrono::steady_clock::now() < end && stream.Read(chunk.data(), (unsigned int)chunk.size()) >= 0)
+      ;
+    const double fSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    stream.Close();
+
+    printf("%-7s %-36s %8.1f MB/s %8u empty reads\n", "memory", source.first,
+           (double)stream.BytesConsumed() / 1048576.0 / fSeconds, stream.Underruns());
+    fflush(stdout);
+  }
+  remove(strFile.c_str());
+}
+
+/*!
+ * PVRDemoDemux taking apart DEMUX_INPUT_SIZE of an unpaced synthetic
+ * 20 Mbit/s channel, generated up front and looped until min-time has
+ * passed, so the case measures the demuxer and not the generator. Reports
+ * the Mbit/s of input, the time per TS packet and the packets handed out.
+ */
+const size_t DEMUX_INPUT_SIZE = PVRDemoDemux::TS_PACKET_SIZE * 256 * 1024; // 47 MiB
+
+void RunDemux(void)
+{
+  if (!Selected("Demux"))
+    return;
+
+  std::unique_ptr<PVRDemoStreamSource> source(PVRDemoStreamSource::Create("synthetic://bitrate=20M&pids=3&pace=0"));
+  if (!source || !source->Open())
+  {
+    fprintf(stderr, "Demux: cannot open the synthetic channel\n");
+    return;
+  }
+  std::vector<uint8_t> input(DEMUX_INPUT_SIZE);
+  size_t iFilled = 0;
+  while (iFilled < input.size())
+  {
+    const ssize_t iRead = source->Read(input.data() + iFilled, input.size() - iFilled, 1000);
+    if (iRead <= 0)
+    {
+      fprintf(stderr, "Demux: the synthetic channel ended after %llu bytes\n", (unsigned long long)iFilled);
+      return;
+    }
+    iFilled += (size_t)iRead;
+  }
+  source->Close();
+
+  uint64_t iBytes = 0;
+  size_t iOffset = 0;
+  PVRDemoDemux demux([&](unsigned char* pBuffer, unsigned int iSize) {
+    if (iOffset == input.size())
+      iOffset = 0;
+    const size_t iCopy = std::min<size_t>(iSize, input.size() - iOffset);
+    memcpy(pBuffer, input.data() + iOffset, iCopy);
+    iOffset += iCopy;
+    iBytes += iCopy;
+    return (int)iCopy;
+  });
+
+  PVR_STREAM_PROPERTIES props;
+  if (!demux.GetStreamProperties(&props))
+  {
+    fprintf(stderr, "Demux: no PMT in the synthetic channel\n");
+    return;
+  }
+
+  uint64_t iPackets = 0;
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  const std::chrono::steady_clock::time_point end = start + std::chrono::milliseconds(g_iMinTimeMs);
+  while (std::chrono::steady_clock::now() < end)
+  {
+    /* look at the clock every 64 packets */
+    for (int i = 0; i < 64; ++i)
+    {
+      DemuxPacket* pPacket = demux.Read();
+      if (!pPacket)
+      {
+        fprintf(stderr, "Demux: the demuxer stopped\n");
+        return;
+      }
+      PVR->FreeDemuxPacket(pPacket);
+      ++iPackets;
+    }
+  }
+  const double fSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  printf("%-7s %-36s %8.1f Mbit/s %8.1f ns per TS packet %10.0f packets/s, %u streams\n", "memory", "Demux/20Mbps",
+         (double)iBytes * 8 / 1e6 / fSeconds, fSeconds * 1e9 / ((double)iBytes / PVRDemoDemux::TS_PACKET_SIZE),
+         (double)iPackets / fSeconds, props.iStreamCount);
+  fflush(stdout);
+}
+
+/* drop a file from the page cache, so the next read comes from the disk */
+void Evict(int fd)
+{
+  fdatasync(fd);
+  posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+}
+
+/*!
+ * A recording of RECORDED_READ_SIZE read in chunks of the size Kodi asks
+ * for, from a cold cache each time: with one pread() per chunk, as before
+ * the engine, and through a PVRDemoReadahead on either kind of engine.
+ */
+const size_t RECORDED_READ_SIZE  = 64 * 1024 * 1024;
+const size_t RECORDED_READ_CHUNK = 64 * 1024;
+
+void RunRecordedRead(const std::string& strDirectory)
+{
+  if (!Selected("RecordedRead"))
+    return;
+
+  const std::string strFile = strDirectory + "recorded-read.ts";
+  int fd = open(strFile.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+  {
+    fprintf(stderr, "RecordedRead: cannot write to '%s'\n", strDirectory.c_str());
+    return;
+  }
+  std::vector<uint8_t> chunk(RECORDED_READ_CHUNK);
+  std::mt19937 random(1);
+  for (size_t i = 0; i < RECORDED_READ_SIZE; i += chunk.size())
+  {
+    for (auto& byte : chunk)
+      byte = (uint8_t)random();
+    if (write(fd, chunk.data(), chunk.size()) != (ssize_t)chunk.size())
+    {
+      fprintf(stderr, "RecordedRead: cannot write to '%s'\n", strDirectory.c_str());
+      close(fd);
+      remove(strFile.c_str());
+      return;
+    }
+  }
+
+  PVRDemoIOEngine uring;
+  PVRDemoIOEngine threads(false);
+  for (PVRDemoIOEngine* engine : { (PVRDemoIOEngine*)nullptr, &uring, &threads })
+  {
+    const char* strCase = !engine ? "RecordedRead/pread" : engine->IsUring() ? "RecordedRead/io_uring" : "RecordedRead/threads";
+    if (!Selected(strCase) || (engine == &uring && !uring.IsUring()))
+      continue;
+
+    Evict(fd);
+    const uint64_t iSyscallsAtStart = engine ? engine->GetStatistics().iSyscalls : 0;
+    uint64_t iSyscalls = 0;
+    uint64_t iBytes = 0;
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    {
+      std::unique_ptr<PVRDemoReadahead> readahead(engine ? new PVRDemoReadahead(*engine, fd) : nullptr);
+      int64_t iRead;
+      do
+      {
+        if (readahead)
+          iRead = readahead->Read(chunk.data(), chunk.size(), iBytes);
+        else
+        {
+          iRead = pread(fd, chunk.data(), chunk.size(), iBytes);
+          ++iSyscalls;
+        }
+        iBytes += (uint64_t)std::max<int64_t>(iRead, 0);
+      } while (iRead > 0);
+    }
+    const double fSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (engine)
+      iSyscalls = engine->GetStatistics().iSyscalls - iSyscallsAtStart;
+
+    printf("%-7s %-36s %8.1f MB/s %8.1f syscalls per MiB%s\n", "disk", strCase, (double)iBytes / 1048576.0 / fSeconds,
+           (double)iSyscalls * 1048576.0 / (double)iBytes, engine && engine->HasRegisteredBuffers() ? ", registered buffers" : "");
+    fflush(stdout);
+  }
+
+  close(fd);
+  remove(strFile.c_str());
+}
+
+/*!
+ * A directory of SCAN_RECORDINGS recordings, each with its sidecar, loaded
+ * until min-time has passed: by PVRDemoData on either kind of engine, and
+ * with the same calls one at a time as before the engine, stat() of both
+ * files and open(), read() and close() of the sidecar.
+ */
+const int SCAN_RECORDINGS = 500;
+
+void RunScanRecordings(const std::string& strWorkDir)
+{
+  if (!Selected("ScanRecordings"))
+    return;
+
+  const std::string strDirectory = strWorkDir + "recordings/";
+  mkdir(strDirectory.c_str(), 0755);
+  std::vector<std::string> files;
+  for (int i = 0; i < SCAN_RECORDINGS; ++i)
+  {
+    char strName[32];
+    snprintf(strName, sizeof(strName), "recording-%03d.ts", i);
+    files.push_back(strDirectory + strName);
+    FILE* media = fopen(files.back().c_str(), "w");
+    FILE* sidecar = fopen(PVRDemoData::SidecarFile(files.back()).c_str(), "w");
+    if (media)
+      fclose(media);
+    if (!sidecar)
+    {
+      fprintf(stderr, "ScanRecordings: cannot write to '%s'\n", strDirectory.c_str());
+      return;
+    }
+    fprintf(sidecar, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                     "<recording>\n"
+                     "  <title>Recording %d</title>\n"
+                     "  <channelname>Channel %d</channelname>\n"
+                     "  <plot>Recorded by the benchmark.</plot>\n"
+                     "  <genretype>16</genretype>\n"
+                     "  <genresubtype>0</genresubtype>\n"
+                     "  <time>2020-09-13T12:00:00+0200</time>\n"
+                     "  <duration>3600</duration>\n"
+                     "  <radio>0</radio>\n"
+                     "</recording>\n", i, i % 40);
+    fclose(sidecar);
+  }
+
+  PVRDemoData data;
+  const PVRDemoTimeResolver times(time(nullptr));
+  std::shared_ptr<PVRDemoTextStore> texts = PVRDemoTextStore::Create(PVRDemoTextStore::MODE_MEMORY, strWorkDir);
+  PVRDemoIOEngine uring;
+  PVRDemoIOEngine threads(false);
+  for (PVRDemoIOEngine* engine : { (PVRDemoIOEngine*)nullptr, &uring, &threads })
+  {
+    const char* strCase = !engine ? "ScanRecordings/blocking" : engine->IsUring() ? "ScanRecordings/io_uring" : "ScanRecordings/threads";
+    if (!Selected(strCase) || (engine == &uring && !uring.IsUring()))
+      continue;
+
+    const uint64_t iSyscallsAtStart = engine ? engine->GetStatistics().iSyscalls : 0;
+    uint64_t iSyscalls = 0;
+    uint64_t iScanned = 0;
+    std::string strContents;
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::duration elapsed;
+    do
+    {
+      std::vector<PVRDemoRecording> recordings;
+      if (engine)
+        PVRDemoData::BenchmarkAccess::ScanRecordedFiles(data, *engine, strDirectory, times, *texts, recordings);
+      else
+      {
+        for (const auto& strFile : files)
+        {
+          const std::string strSidecar = PVRDemoData::SidecarFile(strFile);
+          struct stat info;
+          iSyscalls += 5;
+          if (stat(strFile.c_str(), &info) != 0 || stat(strSidecar.c_str(), &info) != 0)
+            continue;
+          const int fd = open(strSidecar.c_str(), O_RDONLY);
+          if (fd < 0)
+            continue;
+          strContents.resize((size_t)info.st_size);
+          const bool bRead = read(fd, &strContents[0], strContents.size()) == (ssize_t)strContents.size();
+          close(fd);
+
+          TiXmlDocument sidecar;
+          PVRDemoRecording recording;
+          if (bRead)
+            sidecar.Parse(strContents.c_str());
+          if (!sidecar.Error() && sidecar.RootElement() &&
+              PVRDemoData::BenchmarkAccess::ScanRecording(data, sidecar.RootElement(), 0, times, *texts, recording))
+            recordings.push_back(recording);
+        }
+      }
+      if (recordings.size() != files.size())
+      {
+        fprintf(stderr, "%s: %zu of %zu recordings found\n", strCase, recordings.size(), files.size());
+        break;
+      }
+      iScanned += recordings.size();
+      elapsed = std::chrono::steady_clock::now() - start;
+    } while (elapsed < std::chrono::milliseconds(g_iMinTimeMs));
+    if (engine)
+      iSyscalls = engine->GetStatistics().iSyscalls - iSyscallsAtStart;
+    if (!iScanned)
+      continue;
+
+    printf("%-7s %-36s %8.2f us per recording %8.3f syscalls per recording\n", "disk", strCase,
+           std::chrono::duration<double, std::micro>(elapsed).count() / (double)iScanned, (double)iSyscalls / (double)iScanned);
+    fflush(stdout);
+  }
+
+  for (const auto& strFile : files)
+  {
+    remove(PVRDemoData::SidecarFile(strFile).c_str());
+    remove(strFile.c_str());
+  }
+  rmdir(strDirectory.c_str());
+}
+
+void WriteJson(const char* strPath, unsigned int iSeed)
+{
+  FILE* out = fopen(strPath, "w");
+  if (!out)
+  {
+    fprintf(stderr, "cannot write '%s'\n", strPath);
+    return;
+  }
+
+  fprintf(out, "{\n  \"seed\": %u,\n  \"results\": [", iSeed);
+  for (size_t i = 0; i < g_results.size(); ++i)
+  {
+    const Result& r = g_results[i];
+    fprintf(out, "%s\n    { \"scale\": \"%s\", \"case\": \"%s\", \"ops\": %llu, \"ns_per_op\": %.1f, \"allocs_per_op\": %.2f, "
+                 "\"bytes_per_op\": %.1f, \"transfers_per_op\": %llu, \"peak_heap_kib\": %lld, \"max_rss_kib\": %ld }",
+            i ? "," : "", r.strScale.c_str(), r.strCase.c_str(), (unsigned long long)r.iOps, r.fNsPerOp, r.fAllocsPerOp,
+            r.fBytesPerOp, (unsigned long long)r.iTransfersPerOp, (long long)r.iPeakHeapKiB, r.iMaxRssKiB);
+  }
+  fprintf(out, "\n  ]\n}\n");
+  fclose(out);
+}
+
+void Usage(const char* strName)
+{
+  fprintf(stderr, "usage: %s [--scale small|medium|large]... [--seed N] [--min-time ms]\n"
+                  "          [--filter substring] [--threads N] [--workdir dir] [--json file]\n", strName);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+  std::vector<const Scale*> scales;
+  unsigned int iSeed = 1;
+  const char* strJson = NULL;
+  std::string strWorkDir = "/tmp/pvrdemo-bench/";
+
+  for (int i = 1; i < argc; ++i)
+  {
+    const std::string strArg = argv[i];
+    const bool bHasValue = i + 1 < argc;
+    if (strArg == "--scale" && bHasValue)
+    {
+      const std::string strScale = argv[++i];
+      const Scale* found = NULL;
+      for (const Scale& scale : SCALES)
+      {
+        if (strScale == scale.strName)
+          found = &scale;
+      }
+      if (!found)
+      {
+        Usage(argv[0]);
+        return 2;
+      }
+      scales.push_back(found);
+    }
+    else if (strArg == "--seed" && bHasValue)
+      iSeed = (unsigned int)strtoul(argv[++i], NULL, 10);
+    else if (strArg == "--min-time" && bHasValue)
+      g_iMinTimeMs = std::max(1, atoi(argv[++i]));
+    else if (strArg == "--filter" && bHasValue)
+      g_strFilter = argv[++i];
+    else if (strArg == "--threads" && bHasValue)
+      g_iMaxThreads = (unsigned int)std::max(1, atoi(argv[++i]));
+    else if (strArg == "--workdir" && bHasValue)
+      strWorkDir = argv[++i];
+    else if (strArg == "--json" && bHasValue)
+      strJson = argv[++i];
+    else
+    {
+      Usage(argv[0]);
+      return 2;
+    }
+  }
+
+  if (scales.empty())
+  {
+    for (const Scale& scale : SCALES)
+      scales.push_back(&scale);
+  }
+  if (strWorkDir.empty() || strWorkDir[strWorkDir.size() - 1] != '/')
+    strWorkDir += '/';
+  mkdir(strWorkDir.c_str(), 0755);
+
+  if (!InitHelpers())
+  {
+    fprintf(stderr, "cannot register the add-on helpers\n");
+    return 1;
+  }
+
+  for (const Scale* scale : scales)
+    RunScale(*scale, iSeed, strWorkDir);
+
+  for (int iStreams : { 8, 16 })
+  {
+    RunRecord(iStreams, false, strWorkDir);
+    RunRecord(iStreams, true, strWorkDir);
+  }
+  RunConcurrentSessions();
+  RunLiveStream(strWorkDir);
+  RunDemux();
+  RunRecordedRead(strWorkDir);
+  RunScanRecordings(strWorkDir);
+
+  if (strJson)
+    WriteJson(strJson, iSeed);
+  return 0;
+}
@@ -0,0 +1,753 @@
+/*
+ *  Copyright (C) 2011-2020 Team Kodi (https://kodi.tv)
+ *  Copyright (C) 2011 Pulse-Eight (http://www.pulse-eight.com/)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+/*
+ * Headless stand-in for Kodi. Loads the built add-on with dlopen(), serves
+ * the callback tables ADDON_Create() registers against, drives the call
+ * sequences Kodi's PVR manager issues and reports latency and throughput
+ * per entry point as JSON.
+ *
+ *   pvrdemo-host --addon <pvr.demo.so> --client-path <dir with resources/>
+ *                [--user-path <dir>] [--iterations N] [--scenario name]...
+ *                [--setting name=value]... [--json out.json] [--verbose]
+ *
+ * Scenarios are startup, epg, zap and recordings; all run by default. The
+ * exit code is non-zero if the add-on could not be loaded or any transferred
+ * entry failed validation.
+ */
+
+#include "kodi/libXBMC_addon.h"
+#include "kodi/xbmc_pvr_types.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace ADDON;
+
+namespace
+{
+
+/* entry points looked up in the add-on, same signatures as xbmc_pvr_dll.h */
+typedef ADDON_STATUS (*ADDON_Create_t)(void*, void*);
+typedef void (*ADDON_Destroy_t)(void);
+typedef PVR_ERROR (*GetAddonCapabilities_t)(PVR_ADDON_CAPABILITIES*);
+typedef int (*GetAmount_t)(void);
+typedef PVR_ERROR (*GetChannels_t)(ADDON_HANDLE, bool);
+typedef PVR_ERROR (*GetChannelGroups_t)(ADDON_HANDLE, bool);
+typedef PVR_ERROR (*GetChannelGroupMembers_t)(ADDON_HANDLE, const PVR_CHANNEL_GROUP&);
+typedef PVR_ERROR (*GetEPGForChannel_t)(ADDON_HANDLE, int, time_t, time_t);
+typedef PVR_ERROR (*GetChannelStreamProperties_t)(const PVR_CHANNEL*, PVR_NAMED_VALUE*, unsigned int*);
+typedef bool (*OpenLiveStream_t)(const PVR_CHANNEL&);
+typedef void (*CloseLiveStream_t)(void);
+typedef int (*ReadLiveStream_t)(unsigned char*, unsigned int);
+typedef int (*GetRecordingsAmount_t)(bool);
+typedef PVR_ERROR (*GetRecordings_t)(ADDON_HANDLE, bool);
+typedef PVR_ERROR (*GetTimers_t)(ADDON_HANDLE);
+
+struct AddonLibrary
+{
+  void*                        handle = NULL;
+  ADDON_Create_t               Create = NULL;
+  ADDON_Destroy_t              Destroy = NULL;
+  GetAddonCapabilities_t       GetAddonCapabilities = NULL;
+  GetAmount_t                  GetChannelsAmount = NULL;
+  GetChannels_t                GetChannels = NULL;
+  GetAmount_t                  GetChannelGroupsAmount = NULL;
+  GetChannelGroups_t           GetChannelGroups = NULL;
+  GetChannelGroupMembers_t     GetChannelGroupMembers = NULL;
+  GetEPGForChannel_t           GetEPGForChannel = NULL;
+  GetChannelStreamProperties_t GetChannelStreamProperties = NULL;
+  OpenLiveStream_t             OpenLiveStream = NULL;
+  CloseLiveStream_t            CloseLiveStream = NULL;
+  ReadLiveStream_t             ReadLiveStream = NULL;
+  GetRecordingsAmount_t        GetRecordingsAmount = NULL;
+  GetRecordings_t              GetRecordings = NULL;
+  GetAmount_t                  GetTimersAmount = NULL;
+  GetTimers_t                  GetTimers = NULL;
+};
+
+/* what the transfer callbacks were given during one call */
+struct TransferState
+{
+  int                              iExpectedChannelUid = -1;
+  uint64_t                         iEntries = 0;
+  std::set<unsigned int>           uids;
+  std::set<std::string>            ids;
+  std::vector<PVR_CHANNEL>         channels;
+  std::vector<PVR_CHANNEL_GROUP>   groups;
+};
+
+struct EntryPointStats
+{
+  std::vector<double> latencies;  // microseconds
+  uint64_t            iEntries = 0;
+  uint64_t            iFailures = 0;
+};
+
+struct Host
+{
+  std::map<std::string, std::string>     settings;
+  std::map<std::string, EntryPointStats> stats;
+  std::set<unsigned int>                 knownChannelUids;
+  std::atomic<uint64_t>                  iValidationErrors{0};
+  uint64_t                               iLoggedErrors = 0;
+  uint64_t                               iMenuHooks = 0;
+  std::atomic<uint64_t>                  iTriggers{0};   // the EPG ones come from the add-on's threads
+  std::atomic<uint64_t>                  iEpgEvents{0};
+  bool                                   bVerbose = false;
+};
+
+Host g_host;
+
+void ValidationError(const char* strFormat, const char* strWhat, long long iValue)
+{
+  ++g_host.iValidationErrors;
+  fprintf(stderr, "validation: ");
+  fprintf(stderr, strFormat, strWhat, iValue);
+  fprintf(stderr, "\n");
+}
+
+TransferState& State(const ADDON_HANDLE handle)
+{
+  return *static_cast<TransferState*>(handle->dataAddress);
+}
+
+/* CB_AddOnLib */
+
+void CbLog(void*, const addon_log_t level, const char* strMessage)
+{
+  if (level == LOG_ERROR)
+    ++g_host.iLoggedErrors;
+  if (g_host.bVerbose || level == LOG_ERROR)
+    fprintf(stderr, "[addon %d] %s\n", (int)level, strMessage);
+}
+
+void CbQueueNotification(void*, const queue_msg_t, const char* strMessage)
+{
+  if (g_host.bVerbose)
+    fprintf(stderr, "[notification] %s\n", strMessage);
+}
+
+bool CbWakeOnLan(const char*)
+{
+  return false;
+}
+
+bool CbGetSetting(void*, const char* strName, void* value)
+{
+  std::map<std::string, std::string>::const_iterator it = g_host.settings.find(strName);
+  if (it == g_host.settings.end())
+    return false;  // the add-on falls back to its defaults
+
+  const std::string& strValue = it->second;
+  if (strValue == "true" || strValue == "false")
+    *static_cast<bool*>(value) = strValue == "true";
+  else if (!strValue.empty() && strValue.find_first_not_of("-0123456789") == std::string::npos)
+    *static_cast<int*>(value) = atoi(strValue.c_str());
+  else
+    strcpy(static_cast<char*>(value), strValue.c_str());
+  return true;
+}
+
+char* CbDuplicate(const char* strSource)
+{
+  return strdup(strSource ? strSource : "");
+}
+
+char* CbGetLocalizedString(const void*, long iCode)
+{
+  char strBuffer[32];
+  snprintf(strBuffer, sizeof(strBuffer), "$LOCALIZE[%ld]", iCode);
+  return strdup(strBuffer);
+}
+
+char* CbGetDVDMenuLanguage(const void*)
+{
+  return strdup("en");
+}
+
+void CbFreeString(const void*, char* str)
+{
+  free(str);
+}
+
+/* AddonToKodiFuncTable_PVR */
+
+void CbAddMenuHook(void*, PVR_MENUHOOK*)
+{
+  ++g_host.iMenuHooks;
+}
+
+void CbRecording(void*, const char*, const char*, bool)
+{
+}
+
+void CbConnectionStateChange(void*, const char*, PVR_CONNECTION_STATE, const char*)
+{
+}
+
+void CbEpgEventStateChange(void*, EPG_TAG* tag, EPG_EVENT_STATE state)
+{
+  ++g_host.iEpgEvents;
+  if (!tag)
+    ValidationError("%s: no tag for state %lld", "EpgEventStateChange", state);
+  else if (state != EPG_EVENT_DELETED && tag->startTime >= tag->endTime)
+    ValidationError("%s: broadcast %lld does not end after it starts", "EpgEventStateChange", tag->iUniqueBroadcastId);
+}
+
+void CbTransferEpgEntry(void*, const ADDON_HANDLE handle, const EPG_TAG* tag)
+{
+  TransferState& state = State(handle);
+  ++state.iEntries;
+
+  if ((int)tag->iUniqueChannelId != state.iExpectedChannelUid)
+    ValidationError("%s: epg entry for channel %lld in another channel's sweep", "TransferEpgEntry", tag->iUniqueChannelId);
+  if (tag->startTime >= tag->endTime)
+    ValidationError("%s: broadcast %lld does not end after it starts", "TransferEpgEntry", tag->iUniqueBroadcastId);
+  if (!tag->strTitle || !*tag->strTitle)
+    ValidationError("%s: broadcast %lld has no title", "TransferEpgEntry", tag->iUniqueBroadcastId);
+  if (!state.uids.insert(tag->iUniqueBroadcastId).second)
+    ValidationError("%s: duplicate broadcast id %lld", "TransferEpgEntry", tag->iUniqueBroadcastId);
+}
+
+void CbTransferChannelEntry(void*, const ADDON_HANDLE handle, const PVR_CHANNEL* channel)
+{
+  TransferState& state = State(handle);
+  ++state.iEntries;
+
+  if (channel->iUniqueId == 0)
+    ValidationError("%s: channel '%lld' has no unique id", "TransferChannelEntry", channel->iChannelNumber);
+  if (!*channel->strChannelName)
+    ValidationError("%s: channel %lld has no name", "TransferChannelEntry", channel->iUniqueId);
+  if (!state.uids.insert(channel->iUniqueId).second)
+    ValidationError("%s: duplicate channel uid %lld", "TransferChannelEntry", channel->iUniqueId);
+  state.channels.push_back(*channel);
+}
+
+void CbTransferTimerEntry(void*, const ADDON_HANDLE handle, const PVR_TIMER* timer)
+{
+  TransferState& state = State(handle);
+  ++state.iEntries;
+
+  if (timer->startTime > timer->endTime)
+    ValidationError("%s: timer %lld ends before it starts", "TransferTimerEntry", timer->iClientIndex);
+  if (!state.uids.insert(timer->iClientIndex).second)
+    ValidationError("%s: duplicate timer index %lld", "TransferTimerEntry", timer->iClientIndex);
+}
+
+void CbTransferRecordingEntry(void*, const ADDON_HANDLE handle, const PVR_RECORDING* recording)
+{
+  TransferState& state = State(handle);
+  ++state.iEntries;
+
+  if (!*recording->strRecordingId)
+    ValidationError("%s: recording %lld has no id", "TransferRecordingEntry", (long long)state.iEntries);
+  else if (!state.ids.insert(recording->strRecordingId).second)
+    ValidationError("%s: duplicate recording id at entry %lld", "TransferRecordingEntry", (long long)state.iEntries);
+  if (!*recording->strTitle)
+    ValidationError("%s: recording %lld has no title", "TransferRecordingEntry", (long long)state.iEntries);
+}
+
+void CbTransferChannelGroup(void*, const ADDON_HANDLE handle, const PVR_CHANNEL_GROUP* group)
+{
+  TransferState& state = State(handle);
+  ++state.iEntries;
+
+  if (!*group->strGroupName)
+    ValidationError("%s: group at position %lld has no name", "TransferChannelGroup", group->iPosition);
+  else if (!state.ids.insert(group->strGroupName).second)
+    ValidationError("%s: duplicate group name at position %lld", "TransferChannelGroup", group->iPosition);
+  state.groups.push_back(*group);
+}
+
+void CbTransferChannelGroupMember(void*, const ADDON_HANDLE handle, const PVR_CHANNEL_GROUP_MEMBER* member)
+{
+  TransferState& state = State(handle);
+  ++state.iEntries;
+
+  if (g_host.knownChannelUids.find(member->iChannelUniqueId) == g_host.knownChannelUids.end())
+    ValidationError("%s: group member refers to unknown channel %lld", "TransferChannelGroupMember", member->iChannelUniqueId);
+}
+
+void CbTrigger(void*)
+{
+  ++g_host.iTriggers;
+}
+
+void CbTriggerEpgUpdate(void*, unsigned int)
+{
+  ++g_host.iTriggers;
+}
+
+DemuxPacket* CbAllocateDemuxPacket(void*, int iDataSize)
+{
+  DemuxPacket* packet = static_cast<DemuxPacket*>(calloc(1, sizeof(DemuxPacket)));
+  if (packet && iDataSize > 0)
+  {
+    packet->pData = static_cast<uint8_t*>(malloc(iDataSize));
+    packet->iSize = iDataSize;
+  }
+  return packet;
+}
+
+void CbFreeDemuxPacket(void*, DemuxPacket* packet)
+{
+  if (packet)
+    free(packet->pData);
+  free(packet);
+}
+
+xbmc_codec_t CbGetCodecByName(void*, const char*)
+{
+  xbmc_codec_t codec;
+  codec.codec_type = XBMC_CODEC_TYPE_UNKNOWN;
+  codec.codec_id = XBMC_INVALID_CODEC_ID;
+  return codec;
+}
+
+CB_AddOnLib       g_addonCallbacks;
+AddonInstance_PVR g_pvrCallbacks;
+
+void* RegisterAddOnLib(void*)
+{
+  return &g_addonCallbacks;
+}
+
+void* RegisterPVRLib(void*)
+{
+  return &g_pvrCallbacks;
+}
+
+void UnRegister(void*, void*)
+{
+}
+
+void InitCallbacks(AddonCB& cb, const char* strLibBasePath)
+{
+  memset(&g_addonCallbacks, 0, sizeof(g_addonCallbacks));
+  g_addonCallbacks.Log                     = CbLog;
+  g_addonCallbacks.QueueNotification       = CbQueueNotification;
+  g_addonCallbacks.WakeOnLan               = CbWakeOnLan;
+  g_addonCallbacks.GetSetting              = CbGetSetting;
+  g_addonCallbacks.TranslateSpecialProtocol = CbDuplicate;
+  g_addonCallbacks.UnknownToUTF8           = CbDuplicate;
+  g_addonCallbacks.GetLocalizedString      = CbGetLocalizedString;
+  g_addonCallbacks.GetDVDMenuLanguage      = CbGetDVDMenuLanguage;
+  g_addonCallbacks.FreeString              = CbFreeString;
+
+  memset(&g_pvrCallbacks, 0, sizeof(g_pvrCallbacks));
+  AddonToKodiFuncTable_PVR& toKodi = g_pvrCallbacks.toKodi;
+  toKodi.kodiInstance               = &g_host;
+  toKodi.AddMenuHook                = CbAddMenuHook;
+  toKodi.Recording                  = CbRecording;
+  toKodi.ConnectionStateChange      = CbConnectionStateChange;
+  toKodi.EpgEventStateChange        = CbEpgEventStateChange;
+  toKodi.TransferEpgEntry           = CbTransferEpgEntry;
+  toKodi.TransferChannelEntry       = CbTransferChannelEntry;
+  toKodi.TransferTimerEntry         = CbTransferTimerEntry;
+  toKodi.TransferRecordingEntry     = CbTransferRecordingEntry;
+  toKodi.TransferChannelGroup       = CbTransferChannelGroup;
+  toKodi.TransferChannelGroupMember = CbTransferChannelGroupMember;
+  toKodi.TriggerChannelUpdate       = CbTrigger;
+  toKodi.TriggerChannelGroupsUpdate = CbTrigger;
+  toKodi.TriggerEpgUpdate           = CbTriggerEpgUpdate;
+  toKodi.TriggerRecordingUpdate     = CbTrigger;
+  toKodi.TriggerTimerUpdate         = CbTrigger;
+  toKodi.AllocateDemuxPacket        = CbAllocateDemuxPacket;
+  toKodi.FreeDemuxPacket            = CbFreeDemuxPacket;
+  toKodi.GetCodecByName             = CbGetCodecByName;
+
+  memset(&cb, 0, sizeof(cb));
+  cb.libBasePath           = strLibBasePath;
+  cb.addonData             = &g_host;
+  cb.AddOnLib_RegisterMe   = RegisterAddOnLib;
+  cb.AddOnLib_UnRegisterMe = UnRegister;
+  cb.PVRLib_RegisterMe     = RegisterPVRLib;
+  cb.PVRLib_UnRegisterMe   = UnRegister;
+}
+
+template<typename T>
+bool Resolve(void* handle, const char* strName, T& function)
+{
+  function = reinterpret_cast<T>(dlsym(handle, strName));
+  if (!function)
+    fprintf(stderr, "cannot resolve '%s': %s (built with hidden visibility?)\n", strName, dlerror());
+  return function != NULL;
+}
+
+bool LoadAddon(const char* strPath, AddonLibrary& lib)
+{
+  lib.handle = dlopen(strPath, RTLD_NOW | RTLD_LOCAL);
+  if (!lib.handle)
+  {
+    fprintf(stderr, "cannot load '%s': %s\n", strPath, dlerror());
+    return false;
+  }
+
+  return Resolve(lib.handle, "ADDON_Create", lib.Create) &&
+         Resolve(lib.handle, "ADDON_Destroy", lib.Destroy) &&
+         Resolve(lib.handle, "GetAddonCapabilities", lib.GetAddonCapabilities) &&
+         Resolve(lib.handle, "GetChannelsAmount", lib.GetChannelsAmount) &&
+         Resolve(lib.handle, "GetChannels", lib.GetChannels) &&
+         Resolve(lib.handle, "GetChannelGroupsAmount", lib.GetChannelGroupsAmount) &&
+         Resolve(lib.handle, "GetChannelGroups", lib.GetChannelGroups) &&
+         Resolve(lib.handle, "GetChannelGroupMembers", lib.GetChannelGroupMembers) &&
+         Resolve(lib.handle, "GetEPGForChannel", lib.GetEPGForChannel) &&
+         Resolve(lib.handle, "GetChannelStreamProperties", lib.GetChannelStreamProperties) &&
+         Resolve(lib.handle, "OpenLiveStream", lib.OpenLiveStream) &&
+         Resolve(lib.handle, "CloseLiveStream", lib.CloseLiveStream) &&
+         Resolve(lib.handle, "ReadLiveStream", lib.ReadLiveStream) &&
+         Resolve(lib.handle, "GetRecordingsAmount", lib.GetRecordingsAmount) &&
+         Resolve(lib.handle, "GetRecordings", lib.GetRecordings) &&
+         Resolve(lib.handle, "GetTimersAmount", lib.GetTimersAmount) &&
+         Resolve(lib.handle, "GetTimers", lib.GetTimers);
+}
+
+/*!
+ * Time one call into the add-on and book it, with the number of entries
+ * its transfer callbacks received, against the entry point's name.
+ */
+template<typename F>
+auto Measure(const char* strName, TransferState* state, F call) -> decltype(call())
+{
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  auto result = call();
+  const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+  EntryPointStats& stats = g_host.stats[strName];
+  stats.latencies.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+  if (state)
+    stats.iEntries += state->iEntries;
+  return result;
+}
+
+void Fail(const char* strName, const char* strWhat)
+{
+  ++g_host.stats[strName].iFailures;
+  ++g_host.iValidationErrors;
+  fprintf(stderr, "validation: %s: %s\n", strName, strWhat);
+}
+
+void CheckResult(const char* strName, PVR_ERROR error)
+{
+  if (error != PVR_ERROR_NO_ERROR)
+    Fail(strName, "call did not return PVR_ERROR_NO_ERROR");
+}
+
+ADDON_HANDLE_STRUCT MakeHandle(TransferState& state)
+{
+  ADDON_HANDLE_STRUCT handle;
+  memset(&handle, 0, sizeof(handle));
+  handle.dataAddress = &state;
+  return handle;
+}
+
+std::vector<PVR_CHANNEL> FetchChannels(AddonLibrary& lib, bool bRadio)
+{
+  TransferState state;
+  ADDON_HANDLE_STRUCT handle = MakeHandle(state);
+  CheckResult("GetChannels", Measure("GetChannels", &state, [&] { return lib.GetChannels(&handle, bRadio); }));
+  for (const PVR_CHANNEL& channel : state.channels)
+    g_host.knownChannelUids.insert(channel.iUniqueId);
+  return state.channels;
+}
+
+/* ADDON_Create/Destroy cycles, the way Kodi (re)starts a client */
+void RunStartup(AddonLibrary& lib, AddonCB& cb, PVR_PROPERTIES& props, int iIterations)
+{
+  for (int i = 0; i < iIterations; ++i)
+  {
+    ADDON_STATUS status = Measure("ADDON_Create", NULL, [&] { return lib.Create(&cb, &props); });
+    if (status != ADDON_STATUS_OK)
+    {
+      Fail("ADDON_Create", "add-on did not start");
+      return;
+    }
+
+    PVR_ADDON_CAPABILITIES caps;
+    memset(&caps, 0, sizeof(caps));
+    CheckResult("GetAddonCapabilities", Measure("GetAddonCapabilities", NULL, [&] { return lib.GetAddonCapabilities(&caps); }));
+    Measure("GetChannelsAmount", NULL, [&] { return lib.GetChannelsAmount(); });
+
+    Measure("ADDON_Destroy", NULL, [&] { lib.Destroy(); return 0; });
+  }
+}
+
+/* channel and group import followed by the EPG for every channel */
+void RunEpg(AddonLibrary& lib, int iIterations)
+{
+  for (int i = 0; i < iIterations; ++i)
+  {
+    std::vector<PVR_CHANNEL> channels = FetchChannels(lib, false);
+    std::vector<PVR_CHANNEL> radio = FetchChannels(lib, true);
+    channels.insert(channels.end(), radio.begin(), radio.end());
+
+    const int iAmount = Measure("GetChannelsAmount", NULL, [&] { return lib.GetChannelsAmount(); });
+    if (iAmount != (int)channels.size())
+      Fail("GetChannelsAmount", "amount does not match the transferred channels");
+
+    for (int bRadio = 0; bRadio <= 1; ++bRadio)
+    {
+      TransferState groups;
+      ADDON_HANDLE_STRUCT handle = MakeHandle(groups);
+      CheckResult("GetChannelGroups", Measure("GetChannelGroups", &groups, [&] { return lib.GetChannelGroups(&handle, bRadio != 0); }));
+
+      for (const PVR_CHANNEL_GROUP& group : groups.groups)
+      {
+        TransferState members;
+        ADDON_HANDLE_STRUCT memberHandle = MakeHandle(members);
+        CheckResult("GetChannelGroupMembers", Measure("GetChannelGroupMembers", &members, [&] { return lib.GetChannelGroupMembers(&memberHandle, group); }));
+      }
+    }
+
+    const time_t iNow = time(NULL);
+    for (const PVR_CHANNEL& channel : channels)
+    {
+      TransferState epg;
+      epg.iExpectedChannelUid = (int)channel.iUniqueId;
+      ADDON_HANDLE_STRUCT handle = MakeHandle(epg);
+      CheckResult("GetEPGForChannel", Measure("GetEPGForChannel", &epg, [&] {
+        return lib.GetEPGForChannel(&handle, (int)channel.iUniqueId, iNow - 24 * 60 * 60, iNow + 3 * 24 * 60 * 60);
+      }));
+    }
+  }
+}
+
+/* stream properties, then open/read/close for add-on served channels */
+void RunZap(AddonLibrary& lib, int iIterations)
+{
+  std::vector<PVR_CHANNEL> channels = FetchChannels(lib, false);
+  if (channels.empty())
+    return;
+
+  std::vector<unsigned char> buffer(64 * 1024);
+  for (int i = 0; i < iIterations; ++i)
+  {
+    const PVR_CHANNEL& channel = channels[i % channels.size()];
+
+    PVR_NAMED_VALUE properties[PVR_STREAM_MAX_PROPERTIES];
+    unsigned int iCount = PVR_STREAM_MAX_PROPERTIES;
+    memset(properties, 0, sizeof(properties));
+    CheckResult("GetChannelStreamProperties", Measure("GetChannelStreamProperties", NULL, [&] {
+      return lib.GetChannelStreamProperties(&channel, properties, &iCount);
+    }));
+
+    bool bHasURL = false;
+    for (unsigned int iProperty = 0; iProperty < iCount; ++iProperty)
+      bHasURL |= strcmp(properties[iProperty].strName, PVR_STREAM_PROPERTY_STREAMURL) == 0;
+    if (bHasURL)
+      continue;  // Kodi would open that URL itself
+
+    if (!Measure("OpenLiveStream", NULL, [&] { return lib.OpenLiveStream(channel); }))
+    {
+      Fail("OpenLiveStream", channel.strChannelName);
+      continue;
+    }
+
+    /* time to first byte is what a user notices when zapping */
+    const int iRead = Measure("ReadLiveStream", NULL, [&] { return lib.ReadLiveStream(buffer.data(), (unsigned int)buffer.size()); });
+    if (iRead <= 0)
+      Fail("ReadLiveStream", channel.strChannelName);
+
+    Measure("CloseLiveStream", NULL, [&] { lib.CloseLiveStream(); return 0; });
+  }
+}
+
+/* what Kodi does after TriggerRecordingUpdate/TriggerTimerUpdate */
+void RunRecordings(AddonLibrary& lib, int iIterations)
+{
+  for (int i = 0; i < iIterations; ++i)
+  {
+    for (int bDeleted = 0; bDeleted <= 1; ++bDeleted)
+    {
+      const int iAmount = Measure("GetRecordingsAmount", NULL, [&] { return lib.GetRecordingsAmount(bDeleted != 0); });
+
+      TransferState recordings;
+      ADDON_HANDLE_STRUCT handle = MakeHandle(recordings);
+      CheckResult("GetRecordings", Measure("GetRecordings", &recordings, [&] { return lib.GetRecordings(&handle, bDeleted != 0); }));
+      if (iAmount >= 0 && (uint64_t)iAmount != recordings.iEntries)
+        Fail("GetRecordingsAmount", "amount does not match the transferred recordings");
+    }
+
+    const int iTimers = Measure("GetTimersAmount", NULL, [&] { return lib.GetTimersAmount(); });
+    TransferState timers;
+    ADDON_HANDLE_STRUCT handle = MakeHandle(timers);
+    CheckResult("GetTimers", Measure("GetTimers", &timers, [&] { return lib.GetTimers(&handle); }));
+    if (iTimers >= 0 && (uint64_t)iTimers != timers.iEntries)
+      Fail("GetTimersAmount", "amount does not match the transferred timers");
+  }
+}
+
+double Percentile(const std::vector<double>& sorted, double fFraction)
+{
+  if (sorted.empty())
+    return 0.0;
+  size_t iIndex = (size_t)(fFraction * (double)(sorted.size() - 1) + 0.5);
+  return sorted[std::min(iIndex, sorted.size() - 1)];
+}
+
+void WriteReport(FILE* out, const char* strAddon)
+{
+  fprintf(out, "{\n  \"addon\": \"%s\",\n  \"entry_points\": {", strAddon);
+
+  bool bFirst = true;
+  for (std::map<std::string, EntryPointStats>::iterator it = g_host.stats.begin(); it != g_host.stats.end(); ++it)
+  {
+    std::vector<double> sorted = it->second.latencies;
+    std::sort(sorted.begin(), sorted.end());
+
+    double fTotal = 0.0;
+    for (double fLatency : sorted)
+      fTotal += fLatency;
+    const double fSeconds = fTotal / 1000000.0;
+
+    fprintf(out, "%s\n    \"%s\": { \"calls\": %u, \"failures\": %llu, \"p50_us\": %.1f, \"p90_us\": %.1f, "
+                 "\"p99_us\": %.1f, \"max_us\": %.1f, \"calls_per_s\": %.1f, \"entries\": %llu, \"entries_per_s\": %.1f }",
+            bFirst ? "" : ",", it->first.c_str(), (unsigned int)sorted.size(), (unsigned long long)it->second.iFailures,
+            Percentile(sorted, 0.50), Percentile(sorted, 0.90), Percentile(sorted, 0.99),
+            sorted.empty() ? 0.0 : sorted.back(),
+            fSeconds > 0 ? (double)sorted.size() / fSeconds : 0.0,
+            (unsigned long long)it->second.iEntries,
+            fSeconds > 0 ? (double)it->second.iEntries / fSeconds : 0.0);
+    bFirst = false;
+  }
+
+  fprintf(out, "\n  },\n  \"menu_hooks\": %llu,\n  \"triggers\": %llu,\n  \"epg_events\": %llu,\n  \"logged_errors\": %llu,\n"
+               "  \"validation_errors\": %llu\n}\n",
+          (unsigned long long)g_host.iMenuHooks, (unsigned long long)g_host.iTriggers, (unsigned long long)g_host.iEpgEvents,
+          (unsigned long long)g_host.iLoggedErrors, (unsigned long long)g_host.iValidationErrors);
+}
+
+void Usage(const char* strName)
+{
+  fprintf(stderr, "usage: %s --addon <library> --client-path <dir> [--user-path <dir>] [--iterations N]\n"
+                  "          [--scenario startup|epg|zap|recordings]... [--setting name=value]...\n"
+                  "          [--json <file>] [--verbose]\n", strName);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+  const char* strAddon = NULL;
+  std::string strClientPath;
+  std::string strUserPath = "/tmp/pvrdemo-host/";
+  const char* strJson = NULL;
+  int iIterations = 10;
+  std::set<std::string> scenarios;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    const std::string strArg = argv[i];
+    const bool bHasValue = i + 1 < argc;
+    if (strArg == "--addon" && bHasValue)
+      strAddon = argv[++i];
+    else if (strArg == "--client-path" && bHasValue)
+      strClientPath = argv[++i];
+    else if (strArg == "--user-path" && bHasValue)
+      strUserPath = argv[++i];
+    else if (strArg == "--iterations" && bHasValue)
+      iIterations = std::max(1, atoi(argv[++i]));
+    else if (strArg == "--scenario" && bHasValue)
+      scenarios.insert(argv[++i]);
+    else if (strArg == "--json" && bHasValue)
+      strJson = argv[++i];
+    else if (strArg == "--setting" && bHasValue)
+    {
+      const std::string strSetting = argv[++i];
+      const size_t iEquals = strSetting.find('=');
+      if (iEquals == std::string::npos)
+      {
+        Usage(argv[0]);
+        return 2;
+      }
+      g_host.settings[strSetting.substr(0, iEquals)] = strSetting.substr(iEquals + 1);
+    }
+    else if (strArg == "--verbose")
+      g_host.bVerbose = true;
+    else
+    {
+      Usage(argv[0]);
+      return 2;
+    }
+  }
+
+  if (!strAddon || strClientPath.empty())
+  {
+    Usage(argv[0]);
+    return 2;
+  }
+  if (strClientPath[strClientPath.size() - 1] != '/')
+    strClientPath += '/';
+  if (strUserPath[strUserPath.size() - 1] != '/')
+    strUserPath += '/';
+  if (scenarios.empty())
+    scenarios = { "startup", "epg", "zap", "recordings" };
+
+  AddonLibrary lib;
+  if (!LoadAddon(strAddon, lib))
+    return 1;
+
+  AddonCB cb;
+  InitCallbacks(cb, strClientPath.c_str());
+
+  PVR_PROPERTIES props;
+  memset(&props, 0, sizeof(props));
+  props.strUserPath   = strUserPath.c_str();
+  props.strClientPath = strClientPath.c_str();
+  props.iEpgMaxDays   = 3;
+  g_pvrCallbacks.props = props;
+
+  if (scenarios.count("startup"))
+    RunStartup(lib, cb, props, iIterations);
+
+  if (Measure("ADDON_Create", NULL, [&] { return lib.Create(&cb, &props); }) != ADDON_STATUS_OK)
+  {
+    Fail("ADDON_Create", "add-on did not start");
+  }
+  else
+  {
+    /* group members are checked against the channel list */
+    FetchChannels(lib, false);
+    FetchChannels(lib, true);
+
+    if (scenarios.count("epg"))
+      RunEpg(lib, iIterations);
+    if (scenarios.count("zap"))
+      RunZap(lib, iIterations);
+    if (scenarios.count("recordings"))
+      RunRecordings(lib, iIterations);
+
+    Measure("ADDON_Destroy", NULL, [&] { lib.Destroy(); return 0; });
+  }
+
+  WriteReport(stdout, strAddon);
+  if (strJson)
+  {
+    FILE* out = fopen(strJson, "w");
+    if (!out)
+    {
+      fprintf(stderr, "cannot write '%s'\n", strJson);
+      return 1;
+    }
+    WriteReport(out, strAddon);
+    fclose(out);
+  }
+
+  dlclose(lib.handle);
+  return g_host.iValidationErrors > 0 ? 1 : 0;
+}
@@ -0,0 +1,328 @@
+#!/usr/bin/env python3
+#
+#  Copyright (C) 2011-2020 Team Kodi (https://kodi.tv)
+#  Copyright (C) 2011 Pulse-Eight (http://www.pulse-eight.com/)
+#
+#  SPDX-License-Identifier: GPL-2.0-or-later
+#  See LICENSE.md for more information.
+#
+
+"""
+Turn PVRDemoAddonSettings.xml into constexpr tables for a pvr.demo built
+with PVRDEMO_STATIC_DATA, see src/PVRDemoStaticData.h.
+
+  pvrdemo-codegen.py PVRDemoAddonSettings.xml PVRDemoStaticData.cpp
+
+The tables hold exactly what PVRDemoData::LoadDemoData would have read from
+the file: the same unique ids (comments in a section use up an id, as they
+do there), the same defaults and TinyXML's whitespace condensing. Time
+expressions are kept as written and resolved by the add-on, against the
+moment it loaded the tables.
+"""
+
+import os
+import sys
+import xml.etree.ElementTree as ET
+
+EPG_TAG_INVALID_SERIES_EPISODE = -1
+PVR_TIMER_STATE_NEW = 0
+
+
+def children(parent):
+    """All child nodes IterateChildren would visit, comments included."""
+    return list(parent) if parent is not None else []
+
+
+def is_element(node):
+    return isinstance(node.tag, str)
+
+
+def get_string(node, tag):
+    """XMLUtils::GetString, None if the element is missing."""
+    if not is_element(node):
+        return None
+    child = node.find(tag)
+    if child is None:
+        return None
+    return " ".join((child.text or "").split())
+
+
+def atoi(text):
+    text = text.strip()
+    digits = ""
+    for i, char in enumerate(text):
+        if char.isdigit() or (i == 0 and char in "+-"):
+            digits += char
+        else:
+            break
+    try:
+        return int(digits)
+    except ValueError:
+        return 0
+
+
+def get_int(node, tag, default):
+    """XMLUtils::GetInt, atoi() of the text."""
+    text = get_string(node, tag)
+    if not text:
+        return default
+    return atoi(text)
+
+
+def get_bool(node, tag, default):
+    text = get_string(node, tag)
+    if text is None:
+        return default
+    if text.lower() in ("true", "1"):
+        return True
+    if text.lower() in ("false", "0"):
+        return False
+    return default
+
+
+def literal(value):
+    """A C++ string literal; non-ASCII bytes as octal escapes."""
+    out = '"'
+    for byte in value.encode("utf-8"):
+        char = chr(byte)
+        if char in '"\\':
+            out += "\\" + char
+        elif char == "?":
+            out += "\\?"  # no trigraphs
+        elif 0x20 <= byte < 0x7f:
+            out += char
+        else:
+            out += "\\%03o" % byte
+    return out + '"'
+
+
+def boolean(value):
+    return "true" if value else "false"
+
+
+def parse(path):
+    parser = ET.XMLParser(target=ET.TreeBuilder(insert_comments=True))
+    return ET.parse(path, parser).getroot()
+
+
+def section(root, name, directory):
+    """A section of the data file, read from its own file when a manifest names one."""
+    node = root.find(name)
+    if node is None or node.get("file") is None:
+        return node
+    path = os.path.join(directory, node.get("file"))
+    node = parse(path)
+    if node.tag != name:
+        sys.exit("%s: no <%s> tag found" % (path, name))
+    return node
+
+
+def load(path):
+    root = parse(path)
+    if root.tag != "demo":
+        sys.exit("%s: no <demo> tag found" % path)
+    directory = os.path.dirname(path)
+    if root.find("guide") is not None:
+        print("pvrdemo-codegen: the <guide> shards are read at run time only, the tables leave them out")
+
+    channels = []
+    for uid, node in enumerate(children(section(root, "channels", directory)), 1):
+        name = get_string(node, "name")
+        if name is None:
+            continue
+        icon = get_string(node, "icon")
+        channels.append({
+            "radio": get_bool(node, "radio", False),
+            "uid": uid,
+            "number": get_int(node, "number", uid),
+            "subnumber": get_int(node, "subnumber", 0),
+            "encryption": get_int(node, "encryption", 0),
+            "name": name,
+            "icon": icon or "",
+            "iconinaddon": icon is not None,
+            "stream": get_string(node, "stream") or "",
+            "epg": [],
+        })
+
+    groups = []
+    for gid, node in enumerate(children(section(root, "channelgroups", directory)), 1):
+        name = get_string(node, "name")
+        if name is None:
+            continue
+        members = []
+        for member in children(node.find("members")):
+            if is_element(member):
+                channel_id = atoi(member.text or "")
+                if channel_id > -1:
+                    members.append(channel_id)
+        groups.append({
+            "radio": get_bool(node, "radio", False),
+            "gid": gid,
+            "name": name,
+            "position": get_int(node, "position", 0),
+            "members": members,
+        })
+
+    for node in children(section(root, "epg", directory)):
+        if not is_element(node) or node.find("broadcastid") is None or node.find("channelid") is None:
+            continue
+        channel = channels[get_int(node, "channelid", 0) - 1]
+        title = get_string(node, "title")
+        if title is None or node.find("start") is None or node.find("end") is None:
+            continue
+        channel["epg"].append({
+            "broadcastid": get_int(node, "broadcastid", 0),
+            "title": title,
+            "channel": channel["uid"],
+            "start": get_int(node, "start", 0),
+            "end": get_int(node, "end", 0),
+            "plotoutline": get_string(node, "plotoutline") or "",
+            "plot": get_string(node, "plot") or "",
+            "icon": get_string(node, "icon") or "",
+            "genretype": get_int(node, "genretype", 0),
+            "genresubtype": get_int(node, "genresubtype", 0),
+            "series": get_int(node, "series", EPG_TAG_INVALID_SERIES_EPISODE),
+            "episode": get_int(node, "episode", EPG_TAG_INVALID_SERIES_EPISODE),
+            "episodetitle": get_string(node, "episodetitle") or "",
+        })
+
+    recording_id = [0]
+
+    def recordings(name):
+        result = []
+        for node in children(section(root, name, directory)):
+            recording_id[0] += 1
+            title = get_string(node, "title")
+            if title is None:
+                continue
+            result.append({
+                "radio": get_bool(node, "radio", False),
+                "duration": get_int(node, "duration", 0),
+                "genretype": get_int(node, "genretype", 0),
+                "genresubtype": get_int(node, "genresubtype", 0),
+                "series": get_int(node, "series", 0),
+                "episode": get_int(node, "episode", 0),
+                "channelname": get_string(node, "channelname") or "",
+                "plotoutline": get_string(node, "plotoutline") or "",
+                "plot": get_string(node, "plot") or "",
+                "id": str(recording_id[0]),
+                "url": get_string(node, "url") or "",
+                "title": title,
+                "episodetitle": get_string(node, "episodetitle") or "",
+                "directory": get_string(node, "directory") or "",
+                "time": get_string(node, "time") or "",
+            })
+        return result
+
+    active = recordings("recordings")
+    deleted = recordings("recordingsdeleted")
+
+    timers = []
+    for node in children(section(root, "timers", directory)):
+        if not is_element(node) or node.find("channelid") is None:
+            continue
+        channel = channels[get_int(node, "channelid", 0) - 1]
+        title = get_string(node, "title")
+        summary = get_string(node, "summary")
+        if title is None or summary is None:
+            continue
+        timers.append({
+            "channel": channel["uid"],
+            "start": get_string(node, "starttime") or "",
+            "end": get_string(node, "endtime") or "",
+            "state": get_int(node, "state", PVR_TIMER_STATE_NEW),
+            "title": title,
+            "summary": summary,
+        })
+
+    return channels, groups, active, deleted, timers
+
+
+def array(name, count):
+    return "{ %s, %d }" % (name, count) if count else "{}"
+
+
+def write(out, source, channels, groups, active, deleted, timers):
+    w = out.write
+    w("/* generated by tools/pvrdemo-codegen.py from %s, do not edit */\n\n" % source)
+    w('#include "PVRDemoStaticData.h"\n\nnamespace\n{\n')
+
+    for channel in channels:
+        if not channel["epg"]:
+            continue
+        w("\nconstexpr PVRDemoStaticEpgEntry epg%d[] =\n{\n" % channel["uid"])
+        for entry in channel["epg"]:
+            w("  { %d, %s, %d, %d, %d,\n    %s,\n    %s,\n    %s, %d, %d, %d, %d, %s },\n" % (
+                entry["broadcastid"], literal(entry["title"]), entry["channel"], entry["start"], entry["end"],
+                literal(entry["plotoutline"]), literal(entry["plot"]), literal(entry["icon"]),
+                entry["genretype"], entry["genresubtype"], entry["series"], entry["episode"],
+                literal(entry["episodetitle"])))
+        w("};\n")
+
+    if channels:
+        w("\nconstexpr PVRDemoStaticChannel channels[] =\n{\n")
+        for channel in channels:
+            w("  { %s, %d, %d, %d, %d, %s, %s, %s,\n    %s,\n    %s },\n" % (
+                boolean(channel["radio"]), channel["uid"], channel["number"], channel["subnumber"],
+                channel["encryption"], literal(channel["name"]), literal(channel["icon"]),
+                boolean(channel["iconinaddon"]), literal(channel["stream"]),
+                array("epg%d" % channel["uid"], len(channel["epg"]))))
+        w("};\n")
+
+    for group in groups:
+        if group["members"]:
+            w("\nconstexpr int members%d[] = { %s };\n" % (group["gid"], ", ".join(str(m) for m in group["members"])))
+
+    if groups:
+        w("\nconstexpr PVRDemoStaticChannelGroup groups[] =\n{\n")
+        for group in groups:
+            w("  { %s, %d, %s, %d, %s },\n" % (
+                boolean(group["radio"]), group["gid"], literal(group["name"]), group["position"],
+                array("members%d" % group["gid"], len(group["members"]))))
+        w("};\n")
+
+    for name, section in (("recordings", active), ("recordingsDeleted", deleted)):
+        if not section:
+            continue
+        w("\nconstexpr PVRDemoStaticRecording %s[] =\n{\n" % name)
+        for recording in section:
+            w("  { %s, %d, %d, %d, %d, %d, %s,\n    %s,\n    %s,\n    %s, %s, %s, %s, %s, %s },\n" % (
+                boolean(recording["radio"]), recording["duration"], recording["genretype"],
+                recording["genresubtype"], recording["series"], recording["episode"],
+                literal(recording["channelname"]), literal(recording["plotoutline"]), literal(recording["plot"]),
+                literal(recording["id"]), literal(recording["url"]), literal(recording["title"]),
+                literal(recording["episodetitle"]), literal(recording["directory"]), literal(recording["time"])))
+        w("};\n")
+
+    if timers:
+        w("\nconstexpr PVRDemoStaticTimer timers[] =\n{\n")
+        for timer in timers:
+            w("  { %d, %s, %s, (PVR_TIMER_STATE)%d, %s, %s },\n" % (
+                timer["channel"], literal(timer["start"]), literal(timer["end"]), timer["state"],
+                literal(timer["title"]), literal(timer["summary"])))
+        w("};\n")
+
+    w("\n}\n\nconstexpr PVRDemoStaticDataSet g_staticDemoData =\n{\n")
+    w("  %s,\n" % array("channels", len(channels)))
+    w("  %s,\n" % array("groups", len(groups)))
+    w("  %s,\n" % array("recordings", len(active)))
+    w("  %s,\n" % array("recordingsDeleted", len(deleted)))
+    w("  %s\n" % array("timers", len(timers)))
+    w("};\n")
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit("usage: %s PVRDemoAddonSettings.xml PVRDemoStaticData.cpp" % sys.argv[0])
+
+    tables = load(sys.argv[1])
+    with open(sys.argv[2], "w") as out:
+        write(out, "PVRDemoAddonSettings.xml", *tables)
+
+    print("pvrdemo-codegen: %d channels, %d groups, %d EPG entries, %d recordings, %d timers" % (
+        len(tables[0]), len(tables[1]), sum(len(c["epg"]) for c in tables[0]),
+        len(tables[2]) + len(tables[3]), len(tables[4])))
+
+
+if __name__ == "__main__":
+    main()